@@ -0,0 +1,249 @@
+#include "program-generator.h"
+
+#include "arena.h"
+#include "flat-ast.h"
+#include "grammar.h"
+#include "lexer.h"
+#include "parser.h"
+#include "stack-bytecode.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ------------------------------- ALLOCATIONS --------------------------------
+
+static std::atomic<size_t> allocations = 0;
+static std::atomic<size_t> allocated_bytes = 0;
+
+void* operator new(size_t size) {
+    allocations += 1;
+    allocated_bytes += size;
+
+    if (void* memory = std::malloc(size == 0 ? 1 : size))
+        return memory;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
+struct allocation_counter {
+    size_t start_allocations = allocations;
+    size_t start_bytes = allocated_bytes;
+
+    size_t count() const { return allocations - start_allocations; }
+    size_t bytes() const { return allocated_bytes - start_bytes; }
+};
+
+// ---------------------------------- PHASES ----------------------------------
+
+struct phase_result {
+    std::vector<double> seconds; // Of every run
+
+    size_t allocations = 0;      // Of operator new, during the last run
+    size_t allocated_bytes = 0;
+
+    size_t arena_bytes = 0;      // Syntax tree, only for parsing
+
+    double median() const {
+        std::vector<double> sorted = seconds;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+
+    double best() const { return *std::min_element(seconds.begin(), seconds.end()); }
+};
+
+template <typename function_type>
+static double measure(function_type&& function) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto finish = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(finish - start).count();
+}
+
+// --------------------------------- OPTIONS ----------------------------------
+
+struct bench_options {
+    generator_options generator;
+
+    size_t repeat = 5;
+    bool left_factor = true;
+
+    std::string json_file; // Empty if JSON isn't needed
+};
+
+static bench_options parse_options(int argc, char* argv[]) {
+    bench_options options;
+
+    for (int i = 1; i < argc; ++ i) {
+        std::string_view option = argv[i];
+
+        auto value = [&]() {
+            return std::string(option.substr(option.find('=') + 1));
+        };
+
+        if (option.starts_with("-functions="))
+            options.generator.functions = std::stoul(value());
+        else if (option.starts_with("-depth="))
+            options.generator.depth = std::stoul(value());
+        else if (option.starts_with("-statements="))
+            options.generator.statements = std::max<size_t>(std::stoul(value()), 1);
+        else if (option.starts_with("-chain="))
+            options.generator.chain = std::stoul(value());
+        else if (option.starts_with("-seed="))
+            options.generator.seed = std::stoull(value());
+        else if (option.starts_with("-repeat="))
+            options.repeat = std::max<size_t>(std::stoul(value()), 1);
+        else if (option.starts_with("-json="))
+            options.json_file = value();
+        else if (option == "-fno-left-factor")
+            options.left_factor = false;
+        else
+            throw std::runtime_error("error: unknown option " + std::string(option));
+    }
+
+    return options;
+}
+
+// ---------------------------------- REPORT ----------------------------------
+
+static void print_phase(const char* name, const phase_result& phase, size_t tokens, size_t bytes) {
+    double median = phase.median();
+
+    printf("%-8s %10.6fs (best %.6fs) %8.2fM tokens/s %8.2f MiB/s %10zu allocations %10zu bytes\n",
+           name, median, phase.best(), tokens / median / 1e6, bytes / median / (1024 * 1024),
+           phase.allocations, phase.allocated_bytes);
+}
+
+static void write_phase(std::ostream& os, const char* name, const phase_result& phase,
+                        size_t tokens, size_t bytes, bool last) {
+    double median = phase.median();
+
+    os << "    \"" << name << "\": {\n"
+       << "      \"seconds\": "           << median                << ",\n"
+       << "      \"best_seconds\": "      << phase.best()          << ",\n"
+       << "      \"tokens_per_second\": " << tokens / median       << ",\n"
+       << "      \"bytes_per_second\": "  << bytes / median        << ",\n"
+       << "      \"allocations\": "       << phase.allocations     << ",\n"
+       << "      \"allocated_bytes\": "   << phase.allocated_bytes << ",\n"
+       << "      \"arena_bytes\": "       << phase.arena_bytes     << "\n"
+       << "    }" << (last ? "\n" : ",\n");
+}
+
+static void write_json(std::ostream& os, const bench_options& options, size_t bytes, size_t tokens,
+                       const phase_result& lex, const phase_result& parse) {
+    const generator_options& generator = options.generator;
+
+    os.precision(9);
+    os << "{\n"
+       << "  \"generator\": {\n"
+       << "    \"functions\": "  << generator.functions  << ",\n"
+       << "    \"depth\": "      << generator.depth      << ",\n"
+       << "    \"statements\": " << generator.statements << ",\n"
+       << "    \"chain\": "      << generator.chain      << ",\n"
+       << "    \"seed\": "       << generator.seed       << "\n"
+       << "  },\n"
+       << "  \"repeat\": "      << options.repeat << ",\n"
+       << "  \"left_factor\": " << (options.left_factor ? "true" : "false") << ",\n"
+       << "  \"bytes\": "       << bytes  << ",\n"
+       << "  \"tokens\": "      << tokens << ",\n"
+       << "  \"phases\": {\n";
+
+    write_phase(os, "lex",   lex,   tokens, bytes, false);
+    write_phase(os, "parse", parse, tokens, bytes, true);
+
+    os << "  }\n"
+       << "}\n";
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char* argv[]) try {
+    bench_options options = parse_options(argc, argv);
+
+    std::string program = generate_program(options.generator);
+
+    lang::lexer lexer = create_language_lexer();
+    lexer.compile(); // Not a part of lexing itself
+
+    language_grammar grammar = create_language_grammar();
+    if (options.left_factor)
+        lang::left_factor(grammar.program.node());
+
+    phase_result lex, parse;
+
+    std::vector<lang::lexem> lexems;
+    for (size_t run = 0; run < options.repeat; ++ run) {
+        lexems.clear();
+
+        allocation_counter counter;
+        lex.seconds.push_back(measure([&]() { lexems = lexer.analyse(program, "bench.prog"); }));
+
+        lex.allocations = counter.count();
+        lex.allocated_bytes = counter.bytes();
+    }
+
+    size_t tokens = lexems.size();
+    lang::token_buffer buffer(std::move(lexems));
+
+    for (size_t run = 0; run < options.repeat; ++ run) {
+        arena ast_arena = {};
+        TRY arena_create(&ast_arena)
+            THROW("Failed to create arena for syntax tree!");
+
+        lang::token_cursor cursor(buffer.span());
+        std::optional<ast_program*> parsed;
+
+        allocation_counter counter;
+        parse.seconds.push_back(measure([&]() {
+            lang::arena_scope scope(&ast_arena);
+            parsed = grammar.program.parse(cursor);
+        }));
+
+        parse.allocations = counter.count();
+        parse.allocated_bytes = counter.bytes();
+        parse.arena_bytes = ast_arena.allocated_bytes;
+
+        // Generated program has to compile too, e.g. use only variables in scope
+        std::optional<flat_ast> tree;
+        if (parsed && run == 0)
+            tree = flatten(*parsed);
+
+        arena_destroy(&ast_arena);
+
+        if (!parsed || !cursor.at_end())
+            throw std::runtime_error("error: generated program doesn't parse, stopped at lexem " +
+                                     std::to_string(cursor.index()) + " of " + std::to_string(tokens));
+
+        if (tree)
+            compile_stack_program(*tree); // Throws the same errors the driver reports
+    }
+
+    printf("program: %zu functions, %zu bytes, %zu tokens\n",
+           options.generator.functions, program.size(), tokens);
+
+    print_phase("lex",   lex,   tokens, program.size());
+    print_phase("parse", parse, tokens, program.size());
+
+    if (!options.json_file.empty()) {
+        std::ofstream json(options.json_file);
+        write_json(json, options, program.size(), tokens, lex, parse);
+    }
+} catch (const std::runtime_error& error) {
+    std::cerr << error.what() << "\n";
+    return 1;
+}
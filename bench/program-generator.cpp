@@ -0,0 +1,187 @@
+#include "program-generator.h"
+
+#include <random>
+#include <vector>
+
+class program_generator {
+public:
+    program_generator(const generator_options& options)
+        : m_options(options), m_random(options.seed) {}
+
+    std::string generate() {
+        for (size_t i = 0; i < m_options.functions; ++ i)
+            function(i);
+
+        return std::move(m_program);
+    }
+
+private:
+    const generator_options& m_options;
+    std::mt19937_64 m_random;
+
+    std::string m_program;
+    size_t m_indent = 0;
+
+    size_t m_defined_functions = 0;
+    std::vector<size_t> m_arity; // Of every defined function
+
+    // Visible at the current point of function: v0 ... v(m_variables - 1), blocks
+    // only add variables on top, so ending block just forgets those it added
+    size_t m_variables = 0;
+
+    size_t pick(size_t count) { return std::uniform_int_distribution<size_t>(0, count - 1)(m_random); }
+    bool chance(double probability) { return std::bernoulli_distribution(probability)(m_random); }
+
+    void emit(const std::string& text) { m_program += text; }
+
+    void line(const std::string& text) {
+        m_program.append(m_indent * 4, ' ');
+        m_program += text;
+        m_program += '\n';
+    }
+
+    // -------------------------------- TOP LEVEL ---------------------------------
+
+    void function(size_t index) {
+        size_t arity = pick(4);
+
+        std::string header = "defun f" + std::to_string(index) + "(";
+        for (size_t i = 0; i < arity; ++ i)
+            header += (i == 0 ? "v" : ", v") + std::to_string(i);
+
+        m_variables = arity;
+
+        emit(header + ") ");
+        body(m_options.depth);
+        emit("\n");
+
+        m_arity.push_back(arity);
+        ++ m_defined_functions;
+    }
+
+    // -------------------------------- STATEMENTS --------------------------------
+
+    void body(size_t depth) {
+        size_t outer_variables = m_variables;
+
+        emit("{\n");
+        ++ m_indent;
+
+        size_t count = 1 + pick(m_options.statements);
+        for (size_t i = 0; i < count; ++ i)
+            statement(depth);
+
+        -- m_indent;
+        m_program.append(m_indent * 4, ' ');
+        emit("}");
+
+        m_variables = outer_variables;
+    }
+
+    void statement(size_t depth) {
+        // Nested statements are only generated while there's depth left
+        size_t kind = pick(depth == 0 ? 3 : 6);
+
+        switch (kind) {
+        case 0: {
+            std::string value = expression(depth); // Variable isn't visible in it's own initializer
+            line("let v" + std::to_string(m_variables ++) + " = " + value);
+            break;
+        }
+
+        case 1:
+            if (m_variables != 0) {
+                line(variable() + " = " + expression(depth));
+                break;
+            }
+
+            [[fallthrough]];
+
+        case 2:
+            line("return " + expression(depth) + ";");
+            break;
+
+        case 3:
+        case 4:
+            m_program.append(m_indent * 4, ' ');
+            emit((kind == 3 ? "if (" : "while (") + condition(depth) + ") ");
+            body(depth - 1);
+            emit("\n");
+            break;
+
+        case 5: {
+            std::string from = factor(0), to = factor(0);
+            std::string counter = "v" + std::to_string(m_variables ++); // Only visible in the loop
+
+            m_program.append(m_indent * 4, ' ');
+            emit("for (" + counter + " in " + from + ".." + to + ") ");
+            body(depth - 1);
+            emit("\n");
+
+            -- m_variables;
+            break;
+        }
+        }
+    }
+
+    std::string condition(size_t depth) {
+        static const char* comparisons[] = { "<", "<=", ">", ">=", "==", "!=" };
+        return expression(depth - 1) + " " + comparisons[pick(6)] + " " + expression(depth - 1);
+    }
+
+    // -------------------------------- ARITHMETIC --------------------------------
+
+    std::string expression(size_t depth) {
+        static const char* operators[] = { "+", "-", "*", "/" };
+
+        std::string chain = factor(depth);
+
+        size_t operations = pick(m_options.chain + 1);
+        for (size_t i = 0; i < operations; ++ i)
+            chain += std::string(" ") + operators[pick(4)] + " " + factor(depth);
+
+        return chain;
+    }
+
+    std::string factor(size_t depth) {
+        size_t kinds = depth == 0 ? 2 : 4;
+
+        switch (pick(kinds)) {
+        case 0:
+            return std::to_string(pick(1000));
+
+        case 1:
+            if (m_variables != 0)
+                return variable();
+
+            return std::to_string(pick(1000));
+
+        case 2:
+            return "(" + expression(depth - 1) + ")";
+
+        default:
+            return call(depth);
+        }
+    }
+
+    std::string call(size_t depth) {
+        if (m_defined_functions == 0)
+            return std::to_string(pick(1000));
+
+        size_t callee = pick(m_defined_functions);
+
+        std::string text = "f" + std::to_string(callee) + "(";
+        for (size_t i = 0; i < m_arity[callee]; ++ i)
+            text += (i == 0 ? "" : ", ") + expression(depth - 1);
+
+        return text + ")";
+    }
+
+    std::string variable() {
+        return "v" + std::to_string(pick(m_variables));
+    }
+};
+
+std::string generate_program(const generator_options& options) {
+    return program_generator(options).generate();
+}
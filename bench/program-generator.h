@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct generator_options {
+    size_t functions  = 300;  // Top-level definitions
+    size_t depth      = 3;    // Of nested if/while/for and parenthesized expressions
+    size_t statements = 6;    // At most in each body
+    size_t chain      = 4;    // At most binary operators in arithmetic chain
+
+    uint64_t seed = 1;        // Same seed gives the same program
+};
+
+/**
+ * Random program in the language, generated by walking grammar rules
+ * (see impl/grammar.cpp) with random choices, so it always parses.
+ * Nesting stops at @arg options.depth, functions only call functions
+ * defined before them.
+ */
+std::string generate_program(const generator_options& options);
@@ -0,0 +1,105 @@
+#include "arena.h"
+#include "safe-alloc.h"
+#include "test-framework.h"
+
+#include <cstdint>
+
+TEST(arena_allocations_are_aligned) {
+    arena memory = {};
+    TRY arena_create(&memory, 128) ASSERT_SUCCESS();
+
+    TEST_FINALIZER({ arena_destroy(&memory); });
+
+    void* first = NULL;
+    TRY arena_allocate(&memory, 3, 1, &first) ASSERT_SUCCESS();
+
+    void* second = NULL;
+    TRY arena_allocate(&memory, 8, 8, &second) ASSERT_SUCCESS();
+
+    ASSERT_EQUAL((int) ((uintptr_t) second % 8), 0);
+    ASSERT_EQUAL((int) ((char*) second - (char*) first), 8);
+
+    CALL_TEST_FINALIZER();
+}
+
+TEST(arena_grows_with_new_blocks) {
+    arena memory = {};
+    TRY arena_create(&memory, 64) ASSERT_SUCCESS();
+
+    TEST_FINALIZER({ arena_destroy(&memory); });
+
+    int* numbers[100] = {};
+    for (int i = 0; i < 100; ++ i) {
+        TRY arena_calloc(&memory, 1, &numbers[i]) ASSERT_SUCCESS();
+        *numbers[i] = i;
+    }
+
+    // Every allocation should still hold it's own value
+    for (int i = 0; i < 100; ++ i)
+        ASSERT_EQUAL(*numbers[i], i);
+
+    ASSERT_EQUAL((int) memory.allocated_bytes, (int) (100 * sizeof(int)));
+
+    CALL_TEST_FINALIZER();
+}
+
+TEST(arena_serves_oversized_requests) {
+    arena memory = {};
+    TRY arena_create(&memory, 16) ASSERT_SUCCESS();
+
+    TEST_FINALIZER({ arena_destroy(&memory); });
+
+    char* buffer = NULL;
+    TRY arena_calloc(&memory, 1000, &buffer) ASSERT_SUCCESS();
+
+    buffer[999] = 'x'; // Shouldn't overflow block
+    ASSERT_EQUAL(memory.current->capacity >= 1000, true);
+
+    CALL_TEST_FINALIZER();
+}
+
+struct tracked_memory {
+    int allocations, releases;
+    size_t live_bytes;
+};
+
+static void tracked_allocation(void* context, size_t bytes) {
+    tracked_memory* memory = (tracked_memory*) context;
+    ++ memory->allocations, memory->live_bytes += bytes;
+}
+
+static void tracked_release(void* context, size_t bytes) {
+    tracked_memory* memory = (tracked_memory*) context;
+    ++ memory->releases, memory->live_bytes -= bytes;
+}
+
+TEST(arena_blocks_are_tracked) {
+    tracked_memory tracked = {};
+    allocation_tracker tracker = { tracked_allocation, tracked_release, &tracked };
+
+    current_allocation_tracker = &tracker;
+    TEST_FINALIZER({ current_allocation_tracker = NULL; });
+
+    arena memory = {};
+    TRY arena_create(&memory, 64) ASSERT_SUCCESS();
+
+    for (int i = 0; i < 3; ++ i) {
+        char* buffer = NULL;
+        TRY arena_calloc(&memory, 64, &buffer) ASSERT_SUCCESS();
+    }
+
+    // Each allocation fills a whole block
+    ASSERT_EQUAL(tracked.allocations, 3);
+    ASSERT_EQUAL(tracked.live_bytes >= memory.reserved_bytes, true);
+
+    arena_destroy(&memory);
+
+    ASSERT_EQUAL(tracked.releases, 3);
+    ASSERT_EQUAL((int) tracked.live_bytes, 0);
+
+    CALL_TEST_FINALIZER();
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
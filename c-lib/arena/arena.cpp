@@ -0,0 +1,75 @@
+#include "arena.h"
+#include "safe-alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static stack_trace* arena_push_block(arena* arena, size_t capacity) {
+    arena_block* new_block =
+        (arena_block*) malloc(sizeof(arena_block) + capacity);
+
+    if (new_block == NULL)
+        return FAILURE(RUNTIME_ERROR, "Failed to allocate arena block due to %s!"
+                       "\n\t" "block capacity: %zu", strerror(errno), capacity);
+
+    track_allocation(new_block);
+
+    new_block->previous = arena->current;
+    new_block->capacity = capacity;
+    new_block->used     = 0;
+
+    arena->current = new_block;
+    arena->reserved_bytes += sizeof(arena_block) + capacity;
+
+    return SUCCESS();
+}
+
+stack_trace* arena_create(arena* arena, size_t block_size) {
+    *arena = { .current = NULL, .block_size = block_size };
+
+    TRY arena_push_block(arena, block_size)
+        FAIL("Failed to create arena!");
+
+    return SUCCESS();
+}
+
+static size_t align_up(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+stack_trace* arena_allocate(arena* arena, size_t size, size_t alignment,
+                            void** allocated_space) {
+
+    arena_block* block = arena->current;
+
+    size_t offset = align_up(block->used, alignment);
+    if (offset + size > block->capacity) {
+        // Memory of block's /memory/ is aligned to max_align_t, so
+        // fresh block doesn't need any padding for usual alignments
+        size_t capacity = size > arena->block_size ? size : arena->block_size;
+
+        TRY arena_push_block(arena, capacity)
+            FAIL("Arena ran out of memory, allocation of %zu bytes failed!", size);
+
+        block  = arena->current;
+        offset = align_up(block->used, alignment);
+    }
+
+    block->used = offset + size;
+    arena->allocated_bytes += size;
+
+    *allocated_space = block->memory + offset;
+    return SUCCESS();
+}
+
+void arena_destroy(arena* arena) {
+    arena_block* current = arena->current;
+    while (current != NULL) {
+        arena_block* previous = current->previous;
+
+        track_free(current);
+        free(current), current = previous;
+    }
+
+    *arena = {};
+}
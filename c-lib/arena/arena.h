@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "trace.h"
+
+/**
+ * Chunk of memory arena hands out allocations from. Blocks are chained
+ * from the newest to the oldest, so the whole arena can be released
+ * without knowing anything about objects that live in it.
+ */
+struct arena_block {
+    arena_block* previous; //!< Block that was filled before this one, or #NULL
+
+    size_t capacity;       //!< Usable bytes in #memory
+    size_t used;           //!< Bytes already handed out from #memory
+
+    alignas(max_align_t) char memory[];
+};
+
+/**
+ * Bump allocator: allocation is a pointer increment, individual
+ * allocations are never freed, everything is released at once with
+ * #arena_destroy.
+ *
+ * @note Destructors of objects placed in arena are never called, so
+ * only trivially destructible objects should be stored in it.
+ */
+struct arena {
+    arena_block* current;  //!< Block allocations are taken from
+
+    size_t block_size;     //!< Capacity of each newly created block
+
+    size_t allocated_bytes; //!< Sum of all requested allocation sizes
+    size_t reserved_bytes;  //!< Memory taken from system, including headers
+};
+
+const size_t ARENA_DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+stack_trace* arena_create(arena* arena, size_t block_size = ARENA_DEFAULT_BLOCK_SIZE);
+
+/**
+ * Allocate @arg size bytes aligned to @arg alignment (which should be
+ * power of two), requests bigger than block size get a block of their own
+ */
+stack_trace* arena_allocate(arena* arena, size_t size, size_t alignment,
+                            void** allocated_space);
+
+/**
+ * Release every block of the arena, cost doesn't depend on the number
+ * of allocations made, only on the number of blocks
+ */
+void arena_destroy(arena* arena);
+
+template <typename E>
+stack_trace* arena_calloc(arena* arena, size_t number_of_members, E** allocated_space) {
+    void* new_space = NULL;
+    TRY arena_allocate(arena, number_of_members * sizeof(E), alignof(E), &new_space)
+        FAIL("Failed to allocate %zu members of size %zu in arena!",
+             number_of_members, sizeof(E));
+
+    *allocated_space = (E*) new_space;
+    return SUCCESS();
+}
@@ -224,7 +224,7 @@ bool hash_table_insert(hash_table<K, V>* table, K key, V value) {
 template <typename K, typename V>
 void hash_table_destroy(hash_table<K, V>* table) {
     linked_list_destroy(&table->values);
-    free(table->hash_table), table->hash_table = NULL;
+    safe_free(&table->hash_table); // Allocated with safe_calloc
 }
 
 template <typename K, typename V>
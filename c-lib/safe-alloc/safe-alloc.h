@@ -8,6 +8,32 @@
 
 // static hash_table<void*, char*> entries;
 
+/**
+ * Receives every allocation and release made through safe_* functions
+ * (and arenas), sizes are the ones malloc reserved, see malloc_usable_size
+ */
+struct allocation_tracker {
+    void (*allocated)(void* context, size_t bytes);
+    void (*freed)(void* context, size_t bytes);
+
+    void* context;
+};
+
+// Not thread local, allocations of every thread are tracked
+inline allocation_tracker* current_allocation_tracker = NULL;
+
+inline void track_allocation(void* memory) {
+    allocation_tracker* tracker = current_allocation_tracker;
+    if (tracker != NULL && memory != NULL)
+        tracker->allocated(tracker->context, malloc_usable_size(memory));
+}
+
+inline void track_free(void* memory) {
+    allocation_tracker* tracker = current_allocation_tracker;
+    if (tracker != NULL && memory != NULL)
+        tracker->freed(tracker->context, malloc_usable_size(memory));
+}
+
 template <typename E>
 stack_trace* safe_calloc(size_t number_of_members, E** allocated_space) {
     E* new_space = (E*) calloc(number_of_members, sizeof(E));
@@ -21,13 +47,17 @@ stack_trace* safe_calloc(size_t number_of_members, E** allocated_space) {
                        number_of_members,  sizeof(E),
                        number_of_members * sizeof(E));
 
+    track_allocation(new_space);
+
     *allocated_space = new_space; // Successfully allocated
     return SUCCESS();
 }
 
 template <typename E>
 stack_trace* safe_realloc(E** old_space, size_t number_of_members) {
-    E* new_space = (E*) realloc(old_space, number_of_members * sizeof(E));
+    size_t old_size = *old_space != NULL ? malloc_usable_size(*old_space) : 0;
+
+    E* new_space = (E*) realloc(*old_space, number_of_members * sizeof(E));
     if (new_space == NULL)
         return FAILURE(RUNTIME_ERROR, "Realloc failed due to %s!"
                        "\n\t"  "  reallocated pointer: %p" "\n",
@@ -40,11 +70,17 @@ stack_trace* safe_realloc(E** old_space, size_t number_of_members) {
 
     // TODO: Add option to zero out memory 
 
+    if (current_allocation_tracker != NULL && old_size != 0)
+        current_allocation_tracker->freed(current_allocation_tracker->context, old_size);
+
+    track_allocation(new_space);
+
     *old_space = new_space; // Successfully allocated
     return SUCCESS();
 }
 
 template <typename E>
 void safe_free(E** link_to_free) {
+    track_free(*link_to_free);
     free(*link_to_free), *link_to_free = NULL;
 }
@@ -10,6 +10,8 @@
 #include <signal.h>
 #include <setjmp.h>
 
+#include <string>
+
 #include "ansi-colors.h"
 #include "trace.h"
 
@@ -160,6 +162,13 @@ inline void __test_framework_get_test_name_with_spaces(const char* const name,
         ASSERT_TRUE_WITH_EXPECTATION(__actual == __expected, "%d", __actual, __expected);              \
     } while(false)
 
+#define ASSERT_STRING_EQUAL(actual, expected)                                                          \
+    do {                                                                                               \
+        const std::string __actual = actual, __expected = expected;                                    \
+        ASSERT_TRUE_WITH_EXPECTATION(                                                                  \
+            __actual == __expected, "%s", __actual.c_str(), __expected.c_str());                       \
+    } while(false)
+
 #define ASSERT_SUCCESS() CATCH({                                                             \
         __test_framework_state *state = &__test_framework_current_state;                     \
         const char* test_name = state->running_test->test_name;                              \
@@ -1,13 +1,19 @@
 #pragma once
 
 #include "graphviz.h"
+#include "flat-ast.h"
 
-#include <memory>
+#include <cstdint>
+#include <span>
+#include <string_view>
 #include <vector>
-#include <string>
+
+// Nodes are allocated in arena by lang::construct<> and are never destroyed
+// one by one, so they only hold views and pointers into the same arena
 
 struct ast {
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) = 0;
+    virtual uint32_t flatten(flat_ast_builder& builder) = 0; // Append in post-order, see flat-ast.h
 
     digraph graph() {
         return NEW_GRAPH({
@@ -38,10 +44,10 @@ struct ast {
 struct ast_statement: public ast {};
 
 struct ast_body: public ast {
-    ast_body(std::vector<std::shared_ptr<ast_statement>> statements):
+    ast_body(std::span<ast_statement*> statements):
         m_statements(statements) {}
 
-    std::vector<std::shared_ptr<ast_statement>> m_statements;
+    std::span<ast_statement*> m_statements;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         node_id body = NODE("{ ... }"); EDGE(parent, body);
@@ -49,29 +55,46 @@ struct ast_body: public ast {
         for (const auto& statement: m_statements)
             statement->show_graph(CURRENT_SUBGRAPH_CONTEXT, body);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        std::vector<uint32_t> statements;
+        for (const auto& statement: m_statements)
+            statements.push_back(statement->flatten(builder));
+
+        return builder.add(ast_kind::BODY, statements);
+    }
 };
 
 struct ast_function: public ast {
-    ast_function(std::string name, std::vector<std::string> args, std::shared_ptr<ast_body> body)
-        : m_name(name), m_args(std::move(args)), m_body(std::move(body)) {}
+    ast_function(std::string_view name, std::span<std::string_view> args, ast_body* body)
+        : m_name(name), m_args(args), m_body(body) {}
 
-    std::string m_name;
+    std::string_view m_name;
 
-    std::vector<std::string> m_args;
-    std::shared_ptr<ast_body> m_body;
+    std::span<std::string_view> m_args;
+    ast_body* m_body;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
-        node_id function = NODE("defun %s()", m_name.c_str());
+        node_id function = NODE("defun %.*s()", (int) m_name.size(), m_name.data());
         EDGE(parent, function);
 
         node_id args = NODE("args");
         EDGE(function, args);
 
         for (const auto& arg: m_args)
-            EDGE(args, NODE("%s", arg.c_str()));
+            EDGE(args, NODE("%.*s", (int) arg.size(), arg.data()));
 
         m_body->show_graph(CURRENT_SUBGRAPH_CONTEXT, function);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        std::vector<uint32_t> children;
+        for (const auto& arg: m_args)
+            children.push_back(builder.add(ast_kind::PARAMETER, {}, builder.name(arg)));
+
+        children.push_back(m_body->flatten(builder));
+        return builder.add(ast_kind::FUNCTION, children, builder.name(m_name));
+    }
 };
 
 struct ast_expression: public ast {};
@@ -79,26 +102,34 @@ struct ast_expression: public ast {};
 struct ast_term: public ast_expression {};
 
 struct ast_function_call: ast_term {
-    ast_function_call(std::string name, std::vector<std::shared_ptr<ast_expression>> parameters)
+    ast_function_call(std::string_view name, std::span<ast_expression*> parameters)
         : m_name(name), m_parameters(parameters) {}
 
-    std::string m_name;
-    std::vector<std::shared_ptr<ast_expression>> m_parameters;
+    std::string_view m_name;
+    std::span<ast_expression*> m_parameters;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
-        node_id function_call = NODE("%s()", m_name.c_str());
+        node_id function_call = NODE("%.*s()", (int) m_name.size(), m_name.data());
         EDGE(parent, function_call);
 
         for (const auto& arg: m_parameters)
             arg->show_graph(CURRENT_SUBGRAPH_CONTEXT, function_call);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        std::vector<uint32_t> args;
+        for (const auto& arg: m_parameters)
+            args.push_back(arg->flatten(builder));
+
+        return builder.add(ast_kind::FUNCTION_CALL, args, builder.name(m_name));
+    }
 };
 
 struct ast_unary_minus: public ast_term {
-    ast_unary_minus(std::shared_ptr<ast_term> term)
+    ast_unary_minus(ast_term* term)
         : m_term(term) {}
 
-    std::shared_ptr<ast_term> m_term;
+    ast_term* m_term;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         node_id function = NODE("-");
@@ -106,6 +137,10 @@ struct ast_unary_minus: public ast_term {
 
         m_term->show_graph(CURRENT_SUBGRAPH_CONTEXT, function);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return builder.add(ast_kind::UNARY_MINUS, { m_term->flatten(builder) });
+    }
 };
 
 struct ast_number: public ast_term {
@@ -117,36 +152,48 @@ struct ast_number: public ast_term {
         node_id number = NODE("%d", m_number);
         EDGE(parent, number);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return builder.add(ast_kind::NUMBER, {}, m_number);
+    }
 };
 
 struct ast_var: public ast_term {
-    ast_var(std::string name): m_name(name) {}
+    ast_var(std::string_view name): m_name(name) {}
 
-    std::string m_name;
+    std::string_view m_name;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
-        node_id var = NODE("%s", m_name.c_str());
+        node_id var = NODE("%.*s", (int) m_name.size(), m_name.data());
         EDGE(parent, var);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return builder.add(ast_kind::VAR, {}, builder.name(m_name));
+    }
 };
 
 struct ast_wrapped_expression: public ast_term {
-    ast_wrapped_expression(std::shared_ptr<ast_expression> expression)
+    ast_wrapped_expression(ast_expression* expression)
         : m_expression(expression) {}
   
-    std::shared_ptr<ast_expression> m_expression;
+    ast_expression* m_expression;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         m_expression->show_graph(CURRENT_SUBGRAPH_CONTEXT, parent);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return m_expression->flatten(builder);
+    }
 };
 
 struct ast_mul: public ast_term {
-    ast_mul(std::shared_ptr<ast_term> lhs,
-            std::shared_ptr<ast_term> rhs)
+    ast_mul(ast_term* lhs,
+            ast_term* rhs)
         : m_expression { lhs, rhs } {};
 
-    std::shared_ptr<ast_term> m_expression[2];       // Left and right
+    ast_term* m_expression[2];       // Left and right
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         node_id mul = NODE("*"); EDGE(parent, mul);
@@ -154,14 +201,19 @@ struct ast_mul: public ast_term {
         for (auto expr: m_expression)
             expr->show_graph(CURRENT_SUBGRAPH_CONTEXT, mul);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        uint32_t lhs = m_expression[0]->flatten(builder), rhs = m_expression[1]->flatten(builder);
+        return builder.add(ast_kind::MUL, { lhs, rhs });
+    }
 };
 
 struct ast_div: public ast_term {
-    ast_div(std::shared_ptr<ast_term> lhs,
-            std::shared_ptr<ast_term> rhs)
+    ast_div(ast_term* lhs,
+            ast_term* rhs)
         : m_expression { lhs, rhs } {};
 
-    std::shared_ptr<ast_term> m_expression[2];       // Left and right
+    ast_term* m_expression[2];       // Left and right
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         node_id div = NODE("/"); EDGE(parent, div);
@@ -169,15 +221,20 @@ struct ast_div: public ast_term {
         for (auto expr: m_expression)
             expr->show_graph(CURRENT_SUBGRAPH_CONTEXT, div);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        uint32_t lhs = m_expression[0]->flatten(builder), rhs = m_expression[1]->flatten(builder);
+        return builder.add(ast_kind::DIV, { lhs, rhs });
+    }
 };
 
 struct ast_add: public ast_expression {
-    ast_add(std::shared_ptr<ast_term> lhs,
-            std::shared_ptr<ast_expression> rhs)
+    ast_add(ast_term* lhs,
+            ast_expression* rhs)
         : m_lhs(lhs), m_rhs(rhs) {}
 
-    std::shared_ptr<ast_term> m_lhs;
-    std::shared_ptr<ast_expression> m_rhs;
+    ast_term* m_lhs;
+    ast_expression* m_rhs;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         node_id add = NODE("+"); EDGE(parent, add);
@@ -185,15 +242,20 @@ struct ast_add: public ast_expression {
         m_lhs->show_graph(CURRENT_SUBGRAPH_CONTEXT, add);
         m_rhs->show_graph(CURRENT_SUBGRAPH_CONTEXT, add);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        uint32_t lhs = m_lhs->flatten(builder), rhs = m_rhs->flatten(builder);
+        return builder.add(ast_kind::ADD, { lhs, rhs });
+    }
 };
 
 struct ast_sub: public ast_expression {
-    ast_sub(std::shared_ptr<ast_term> lhs,
-            std::shared_ptr<ast_expression> rhs)
+    ast_sub(ast_term* lhs,
+            ast_expression* rhs)
         : m_lhs(lhs), m_rhs(rhs) {}
 
-    std::shared_ptr<ast_term> m_lhs;
-    std::shared_ptr<ast_expression> m_rhs;
+    ast_term* m_lhs;
+    ast_expression* m_rhs;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         node_id sub = NODE("-"); EDGE(parent, sub);
@@ -201,19 +263,29 @@ struct ast_sub: public ast_expression {
         m_lhs->show_graph(CURRENT_SUBGRAPH_CONTEXT, sub);
         m_rhs->show_graph(CURRENT_SUBGRAPH_CONTEXT, sub);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        uint32_t lhs = m_lhs->flatten(builder), rhs = m_rhs->flatten(builder);
+        return builder.add(ast_kind::SUB, { lhs, rhs });
+    }
 };
 
 struct ast_cond: public ast {
-    ast_cond(std::shared_ptr<ast_expression> lhs,
-             std::shared_ptr<ast_expression> rhs)
+    ast_cond(ast_expression* lhs,
+             ast_expression* rhs)
         : m_expression { lhs, rhs } {}
 
-    std::shared_ptr<ast_expression> m_expression[2]; // Left and right
+    ast_expression* m_expression[2]; // Left and right
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         m_expression[0]->show_graph(CURRENT_SUBGRAPH_CONTEXT, parent);
         m_expression[1]->show_graph(CURRENT_SUBGRAPH_CONTEXT, parent);
     }
+
+    uint32_t flatten_as(flat_ast_builder& builder, ast_kind kind) {
+        uint32_t lhs = m_expression[0]->flatten(builder), rhs = m_expression[1]->flatten(builder);
+        return builder.add(kind, { lhs, rhs });
+    }
 };
 
 struct ast_less: public ast_cond {
@@ -223,6 +295,10 @@ struct ast_less: public ast_cond {
         node_id node = NODE("<"); EDGE(parent, node);
         this->ast_cond::show_graph(CURRENT_SUBGRAPH_CONTEXT, node);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return flatten_as(builder, ast_kind::LESS);
+    }
 };
 
 struct ast_less_or_equal: public ast_cond {
@@ -232,6 +308,10 @@ struct ast_less_or_equal: public ast_cond {
         node_id node = NODE("<="); EDGE(parent, node);
         this->ast_cond::show_graph(CURRENT_SUBGRAPH_CONTEXT, node);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return flatten_as(builder, ast_kind::LESS_OR_EQUAL);
+    }
 };
 
 struct ast_greater: public ast_cond {
@@ -241,6 +321,10 @@ struct ast_greater: public ast_cond {
         node_id node = NODE(">"); EDGE(parent, node);
         this->ast_cond::show_graph(CURRENT_SUBGRAPH_CONTEXT, node);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return flatten_as(builder, ast_kind::GREATER);
+    }
 }; 
 
 struct ast_greater_or_equal: public ast_cond {
@@ -250,6 +334,10 @@ struct ast_greater_or_equal: public ast_cond {
         node_id node = NODE(">="); EDGE(parent, node);
         this->ast_cond::show_graph(CURRENT_SUBGRAPH_CONTEXT, node);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return flatten_as(builder, ast_kind::GREATER_OR_EQUAL);
+    }
 };
 
 struct ast_equals: public ast_cond {
@@ -259,6 +347,10 @@ struct ast_equals: public ast_cond {
         node_id node = NODE("=="); EDGE(parent, node);
         this->ast_cond::show_graph(CURRENT_SUBGRAPH_CONTEXT, node);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return flatten_as(builder, ast_kind::EQUALS);
+    }
 };
 
 struct ast_not_equals: public ast_cond {
@@ -268,21 +360,25 @@ struct ast_not_equals: public ast_cond {
         node_id node = NODE("!="); EDGE(parent, node);
         this->ast_cond::show_graph(CURRENT_SUBGRAPH_CONTEXT, node);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return flatten_as(builder, ast_kind::NOT_EQUALS);
+    }
 };
 
 struct ast_for: public ast_statement {
-    ast_for(std::string var_name,
-            std::shared_ptr<ast_term> lhs,
-            std::shared_ptr<ast_term> rhs,
-            std::shared_ptr<ast_body> body)
+    ast_for(std::string_view var_name,
+            ast_term* lhs,
+            ast_term* rhs,
+            ast_body* body)
         : m_var_name(var_name), m_term { lhs, rhs }, m_body(body) {}
 
-    std::string m_var_name;
-    std::shared_ptr<ast_term> m_term[2]; // Left and right
-    std::shared_ptr<ast_body> m_body;
+    std::string_view m_var_name;
+    ast_term* m_term[2]; // Left and right
+    ast_body* m_body;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
-        node_id node = NODE("for %s", m_var_name.c_str());
+        node_id node = NODE("for %.*s", (int) m_var_name.size(), m_var_name.data());
         EDGE(parent, node);
 
         node_id ellipsis = NODE(".."); EDGE(node, ellipsis);
@@ -291,14 +387,21 @@ struct ast_for: public ast_statement {
 
         m_body->show_graph(CURRENT_SUBGRAPH_CONTEXT, node);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        uint32_t from = m_term[0]->flatten(builder), to = m_term[1]->flatten(builder);
+        uint32_t body = m_body->flatten(builder);
+
+        return builder.add(ast_kind::FOR, { from, to, body }, builder.name(m_var_name));
+    }
 };
 
 struct ast_while: public ast_statement {
-    ast_while(std::shared_ptr<ast_cond> cond, std::shared_ptr<ast_body> body)
+    ast_while(ast_cond* cond, ast_body* body)
         : m_cond(cond), m_body(body) {}
 
-    std::shared_ptr<ast_cond> m_cond;
-    std::shared_ptr<ast_body> m_body;
+    ast_cond* m_cond;
+    ast_body* m_body;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         node_id node = NODE("while"); EDGE(parent, node);
@@ -307,52 +410,69 @@ struct ast_while: public ast_statement {
         m_cond->show_graph(CURRENT_SUBGRAPH_CONTEXT, cond);
         m_body->show_graph(CURRENT_SUBGRAPH_CONTEXT, node);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        uint32_t cond = m_cond->flatten(builder), body = m_body->flatten(builder);
+        return builder.add(ast_kind::WHILE, { cond, body });
+    }
 };
 
 struct ast_assignment: public ast_statement {
-    ast_assignment(std::string arg,
-                   std::shared_ptr<ast_expression> expression)
+    ast_assignment(std::string_view arg,
+                   ast_expression* expression)
         : m_arg(arg), m_expression(expression) {}
   
-    std::string m_arg;
-    std::shared_ptr<ast_expression> m_expression;
+    std::string_view m_arg;
+    ast_expression* m_expression;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
-        node_id assignment = NODE("%s =", m_arg.c_str()); EDGE(parent, assignment);
+        node_id assignment = NODE("%.*s =", (int) m_arg.size(), m_arg.data()); EDGE(parent, assignment);
         m_expression->show_graph(CURRENT_SUBGRAPH_CONTEXT, assignment);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return builder.add(ast_kind::ASSIGNMENT, { m_expression->flatten(builder) }, builder.name(m_arg));
+    }
 };
 
 struct ast_reassignment: public ast_statement {
-    ast_reassignment(std::string name, std::shared_ptr<ast_expression> expression)
+    ast_reassignment(std::string_view name, ast_expression* expression)
         : m_name(name), m_expression(expression) {}
 
-    std::string m_name;
-    std::shared_ptr<ast_expression> m_expression;
+    std::string_view m_name;
+    ast_expression* m_expression;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
-        node_id assignment = NODE("%s =", m_name.c_str()); EDGE(parent, assignment);
+        node_id assignment = NODE("%.*s =", (int) m_name.size(), m_name.data()); EDGE(parent, assignment);
         m_expression->show_graph(CURRENT_SUBGRAPH_CONTEXT, assignment);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return builder.add(ast_kind::REASSIGNMENT, { m_expression->flatten(builder) }, builder.name(m_name));
+    }
 };
 
 struct ast_return: public ast_statement {
-    ast_return(std::shared_ptr<ast_expression> expression)
+    ast_return(ast_expression* expression)
         : m_expression(expression) {}
 
-    std::shared_ptr<ast_expression> m_expression;
+    ast_expression* m_expression;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         node_id node = NODE("return"); EDGE(parent, node);
         m_expression->show_graph(CURRENT_SUBGRAPH_CONTEXT, node);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        return builder.add(ast_kind::RETURN, { m_expression->flatten(builder) });
+    }
 };
 
 struct ast_program: public ast {
-    ast_program(std::vector<std::shared_ptr<ast_function>> functions)
+    ast_program(std::span<ast_function*> functions)
         : m_functions(functions) {};
 
-    std::vector<std::shared_ptr<ast_function>> m_functions;
+    std::span<ast_function*> m_functions;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         node_id program = NODE("program"); EDGE(parent, program);
@@ -360,14 +480,22 @@ struct ast_program: public ast {
         for (const auto& func: m_functions)
             func->show_graph(CURRENT_SUBGRAPH_CONTEXT, program);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        std::vector<uint32_t> functions;
+        for (const auto& func: m_functions)
+            functions.push_back(func->flatten(builder));
+
+        return builder.add(ast_kind::PROGRAM, functions);
+    }
 };
 
 struct ast_if: ast_statement {
-    ast_if(std::shared_ptr<ast_cond> cond, std::shared_ptr<ast_body> then)
+    ast_if(ast_cond* cond, ast_body* then)
         : m_cond(cond), m_then(then) {};
 
-    std::shared_ptr<ast_cond> m_cond;
-    std::shared_ptr<ast_body> m_then;
+    ast_cond* m_cond;
+    ast_body* m_then;
 
     virtual void show_graph(SUBGRAPH_CONTEXT, node_id parent) override {
         node_id node = NODE("if"); EDGE(parent, node);
@@ -376,4 +504,9 @@ struct ast_if: ast_statement {
         m_cond->show_graph(CURRENT_SUBGRAPH_CONTEXT, cond);
         m_then->show_graph(CURRENT_SUBGRAPH_CONTEXT, node);
     }
+
+    virtual uint32_t flatten(flat_ast_builder& builder) override {
+        uint32_t cond = m_cond->flatten(builder), then = m_then->flatten(builder);
+        return builder.add(ast_kind::IF, { cond, then });
+    }
 };
@@ -27,5 +27,5 @@ enum class language_lexem {
 
     NAME, NUMBER,
 
-    END // Special mark used by parser
+    END // Reported by parser past the last lexem
 };
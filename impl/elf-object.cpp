@@ -0,0 +1,181 @@
+#include "elf-object.h"
+#include "x86-encoder.h"
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+// Constants of ELF specification that are used here
+static const uint16_t elf_relocatable = 1;
+static const uint16_t elf_machine_x86_64 = 62;
+
+static const uint32_t section_progbits = 1, section_symtab = 2, section_strtab = 3;
+static const uint64_t section_alloc = 0x2, section_executable = 0x4;
+
+static const uint8_t symbol_section = 3, symbol_function = 2;
+static const uint8_t binding_local = 0, binding_global = 1;
+
+static const size_t header_size = 64, section_header_size = 64, symbol_size = 24;
+
+// Little-endian buffer of the whole file
+class elf_buffer {
+public:
+    void u8(uint8_t value) { m_bytes.push_back(value); }
+    void u16(uint16_t value) { little_endian(value, 2); }
+    void u32(uint32_t value) { little_endian(value, 4); }
+    void u64(uint64_t value) { little_endian(value, 8); }
+
+    void bytes(const std::vector<uint8_t>& bytes) { m_bytes.insert(m_bytes.end(), bytes.begin(), bytes.end()); }
+
+    void align(size_t alignment) {
+        while (m_bytes.size() % alignment != 0)
+            m_bytes.push_back(0);
+    }
+
+    size_t size() const { return m_bytes.size(); }
+    const std::vector<uint8_t>& data() const { return m_bytes; }
+
+private:
+    std::vector<uint8_t> m_bytes;
+
+    void little_endian(uint64_t value, int size) {
+        for (int i = 0; i < size; ++ i)
+            m_bytes.push_back((uint8_t) (value >> (8 * i)));
+    }
+};
+
+// Table of null-terminated strings, that starts with empty one
+class string_table {
+public:
+    string_table(): m_bytes(1, 0) {}
+
+    uint32_t add(const std::string& string) {
+        uint32_t offset = (uint32_t) m_bytes.size();
+        m_bytes.insert(m_bytes.end(), string.begin(), string.end());
+        m_bytes.push_back(0);
+
+        return offset;
+    }
+
+    const std::vector<uint8_t>& bytes() const { return m_bytes; }
+
+private:
+    std::vector<uint8_t> m_bytes;
+};
+
+struct elf_section {
+    uint32_t name, type;
+    uint64_t flags, offset, size;
+    uint32_t link, info;
+    uint64_t alignment, entry_size;
+};
+
+void write_elf_object(std::ostream& os, const std::vector<x86_function>& functions) {
+    x86_encoder encoder; // Without runtime, code with runtime checks is rejected
+
+    std::vector<uint32_t> offsets, sizes;
+    for (const auto& function: functions) {
+        encoder.align(16);
+
+        offsets.push_back((uint32_t) encoder.bytes().size());
+        encoder.encode(function);
+        sizes.push_back((uint32_t) encoder.bytes().size() - offsets.back());
+    }
+
+    std::vector<uint8_t> text = encoder.bytes();
+    for (const auto& call: encoder.calls()) {
+        int32_t displacement = (int32_t) (offsets[call.function] - (call.offset + 4));
+        std::memcpy(&text[call.offset], &displacement, sizeof(displacement));
+    }
+
+    string_table names, section_names;
+
+    // Section symbol first, locals have to precede globals
+    elf_buffer symbols;
+    auto symbol = [&](uint32_t name, uint8_t binding, uint8_t type, uint16_t section, uint64_t value, uint64_t size) {
+        symbols.u32(name);
+        symbols.u8((uint8_t) (binding << 4 | type));
+        symbols.u8(0); // Default visibility
+        symbols.u16(section);
+        symbols.u64(value);
+        symbols.u64(size);
+    };
+
+    // Sections are null, .text, .symtab, .strtab, .note.GNU-stack, .shstrtab
+    const uint16_t text_index = 1;
+    const uint32_t strtab_index = 3;
+
+    symbol(0, binding_local, 0, 0, 0, 0);
+    symbol(0, binding_local, symbol_section, text_index, 0, 0);
+    uint32_t first_global = 2;
+
+    for (size_t i = 0; i < functions.size(); ++ i)
+        symbol(names.add(functions[i].name), binding_global, symbol_function, text_index, offsets[i], sizes[i]);
+
+    elf_buffer file;
+    file.bytes(std::vector<uint8_t>(header_size)); // Header is written over it at the end
+
+    std::vector<elf_section> sections(1); // Null section
+
+    auto add_section = [&](const char* name, uint32_t type, uint64_t flags, const std::vector<uint8_t>& data,
+                           uint64_t alignment, uint32_t link = 0, uint32_t info = 0, uint64_t entry_size = 0) {
+        file.align(alignment);
+        sections.push_back({ section_names.add(name), type, flags, file.size(), data.size(),
+                             link, info, alignment, entry_size });
+        file.bytes(data);
+    };
+
+    add_section(".text", section_progbits, section_alloc | section_executable, text, 16);
+    add_section(".symtab", section_symtab, 0, symbols.data(), 8, strtab_index, first_global, symbol_size);
+    add_section(".strtab", section_strtab, 0, names.bytes(), 1);
+
+    // Without it linker assumes that code needs executable stack
+    add_section(".note.GNU-stack", section_progbits, 0, {}, 1);
+
+    uint32_t shstrtab_name = section_names.add(".shstrtab");
+    sections.push_back({ shstrtab_name, section_strtab, 0, file.size(), section_names.bytes().size(), 0, 0, 1, 0 });
+    file.bytes(section_names.bytes());
+
+    file.align(8);
+    uint64_t section_headers = file.size();
+
+    for (const auto& section: sections) {
+        file.u32(section.name);
+        file.u32(section.type);
+        file.u64(section.flags);
+        file.u64(0); // Address
+        file.u64(section.offset);
+        file.u64(section.size);
+        file.u32(section.link);
+        file.u32(section.info);
+        file.u64(section.alignment);
+        file.u64(section.entry_size);
+    }
+
+    elf_buffer header;
+    header.u8(0x7F); header.u8('E'); header.u8('L'); header.u8('F');
+    header.u8(2); // 64-bit
+    header.u8(1); // Little-endian
+    header.u8(1); // Version
+    header.align(16);
+
+    header.u16(elf_relocatable);
+    header.u16(elf_machine_x86_64);
+    header.u32(1);  // Version
+    header.u64(0);  // Entry
+    header.u64(0);  // Program headers
+    header.u64(section_headers);
+    header.u32(0);  // Flags
+    header.u16((uint16_t) header_size);
+    header.u16(0);  // Size of program header
+    header.u16(0);  // Number of program headers
+    header.u16((uint16_t) section_header_size);
+    header.u16((uint16_t) sections.size());
+    header.u16((uint16_t) (sections.size() - 1)); // .shstrtab is the last
+
+    std::vector<uint8_t> bytes = file.data();
+    std::memcpy(bytes.data(), header.data().data(), header_size);
+
+    os.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize) bytes.size());
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "x86.h"
+
+#include <iosfwd>
+#include <vector>
+
+/**
+ * Encode functions to relocatable ELF64 object for x86-64, which cc
+ * links like any other object. Every function is a global symbol in
+ * .text. Functions only call each other, so calls are resolved right
+ * away and the object has no relocations.
+ *
+ * /functions/ are all functions of the program in order of their
+ * indices, lowered without runtime checks.
+ */
+void write_elf_object(std::ostream& os, const std::vector<x86_function>& functions);
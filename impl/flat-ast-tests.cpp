@@ -0,0 +1,173 @@
+#include "flat-ast.h"
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+static const char* const sample_program = R"(
+defun add(a, b) {
+    return a + b;
+}
+
+defun main() {
+    let total = 0
+    for (i in 0..10) {
+        total = add(total, i * 2)
+    }
+    return total;
+}
+)";
+
+static bool same_nodes(const flat_node& lhs, const flat_node& rhs) {
+    return lhs.kind == rhs.kind && lhs.first_child == rhs.first_child &&
+           lhs.child_count == rhs.child_count && lhs.value == rhs.value;
+}
+
+TEST(flat_tree_survives_write_and_read) {
+    flat_ast tree = parse_program(sample_program);
+
+    std::stringstream stream;
+    tree.write(stream);
+
+    flat_ast read = flat_ast::read(stream);
+
+    ASSERT_EQUAL((int) read.nodes.size(), (int) tree.nodes.size());
+    for (size_t i = 0; i < tree.nodes.size(); ++ i)
+        ASSERT_EQUAL(same_nodes(read.nodes[i], tree.nodes[i]), true);
+
+    ASSERT_EQUAL(read.children == tree.children, true);
+    ASSERT_EQUAL(read.name_offsets == tree.name_offsets, true);
+    ASSERT_STRING_EQUAL(read.names, tree.names);
+
+    std::stringstream dumped, dumped_read;
+    tree.dump(dumped);
+    read.dump(dumped_read);
+    ASSERT_STRING_EQUAL(dumped_read.str(), dumped.str());
+}
+
+TEST(read_tree_compiles_like_the_original) {
+    flat_ast tree = parse_program(sample_program);
+
+    std::stringstream stream;
+    tree.write(stream);
+
+    register_program original = compile_register_program(tree);
+    register_program read = compile_register_program(flat_ast::read(stream));
+    ASSERT_STRING_EQUAL(run_main(read), run_main(original));
+}
+
+static std::string read_error(const std::string& bytes) {
+    std::stringstream stream(bytes);
+    try {
+        flat_ast::read(stream);
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+
+    return "";
+}
+
+TEST(bad_magic_is_rejected) {
+    std::stringstream stream;
+    parse_program(sample_program).write(stream);
+
+    std::string bytes = stream.str();
+    std::memcpy(bytes.data(), "TSAF", 4);
+
+    ASSERT_STRING_EQUAL(read_error(bytes), "error: input isn't a flat syntax tree");
+    ASSERT_STRING_EQUAL(read_error(""), "error: input isn't a flat syntax tree");
+}
+
+TEST(truncated_tree_is_rejected) {
+    std::stringstream stream;
+    parse_program(sample_program).write(stream);
+
+    std::string bytes = stream.str();
+    bytes.resize(bytes.size() - 1);
+
+    ASSERT_STRING_EQUAL(read_error(bytes), "error: flat syntax tree is truncated");
+}
+
+// Counts in header are checked against the stream, not trusted with allocation
+TEST(oversized_counts_are_rejected) {
+    std::stringstream stream;
+    parse_program(sample_program).write(stream);
+
+    std::string bytes = stream.str();
+    for (size_t count = 4; count < 20; count += 4) {
+        std::string broken = bytes;
+        std::memset(broken.data() + count, 0xFF, sizeof(uint32_t));
+
+        ASSERT_STRING_EQUAL(read_error(broken), "error: flat syntax tree is truncated");
+    }
+}
+
+// Tree with /broken/ applied to it, written and read back
+static std::string broken_tree_error(void (*broken)(flat_ast& tree)) {
+    flat_ast tree = parse_program(sample_program);
+    broken(tree);
+
+    std::stringstream stream;
+    tree.write(stream);
+    return read_error(stream.str());
+}
+
+TEST(broken_structure_is_rejected) {
+    const char* rejected = "error: input isn't a flat syntax tree";
+
+    ASSERT_STRING_EQUAL(broken_tree_error([](flat_ast& tree) { tree = {}; }), rejected);
+
+    // Children out of the array, and ones that don't precede their parent
+    ASSERT_STRING_EQUAL(broken_tree_error([](flat_ast& tree) {
+        tree.nodes.back().first_child = (uint32_t) tree.children.size();
+    }), rejected);
+    ASSERT_STRING_EQUAL(broken_tree_error([](flat_ast& tree) { tree.children.front() = tree.root(); }), rejected);
+    ASSERT_STRING_EQUAL(broken_tree_error([](flat_ast& tree) { tree.children.back() = tree.root(); }), rejected);
+
+    // Names out of the array, and ones that don't end
+    ASSERT_STRING_EQUAL(broken_tree_error([](flat_ast& tree) {
+        tree.name_offsets.back() = (uint32_t) tree.names.size();
+    }), rejected);
+    ASSERT_STRING_EQUAL(broken_tree_error([](flat_ast& tree) { tree.names.back() = 'x'; }), rejected);
+    ASSERT_STRING_EQUAL(broken_tree_error([](flat_ast& tree) {
+        tree.nodes[tree.children_of(tree.root())[0]].value = (int32_t) tree.name_offsets.size();
+    }), rejected);
+
+    ASSERT_STRING_EQUAL(broken_tree_error([](flat_ast& tree) { tree.nodes.back().kind = (ast_kind) 200; }), rejected);
+    ASSERT_STRING_EQUAL(broken_tree_error([](flat_ast&) {}), "");
+}
+
+TEST(padding_is_written_as_zeros) {
+    flat_ast tree = parse_program(sample_program);
+
+    // Garbage in padding of every node, as a copy that doesn't zero it could leave
+    flat_ast garbage = tree;
+    for (size_t i = 0; i < tree.nodes.size(); ++ i) {
+        std::memset(&garbage.nodes[i], 0xAB, sizeof(flat_node));
+
+        garbage.nodes[i].kind        = tree.nodes[i].kind;
+        garbage.nodes[i].first_child = tree.nodes[i].first_child;
+        garbage.nodes[i].child_count = tree.nodes[i].child_count;
+        garbage.nodes[i].value       = tree.nodes[i].value;
+    }
+
+    std::stringstream written, written_garbage;
+    tree.write(written);
+    garbage.write(written_garbage);
+
+    ASSERT_EQUAL(written_garbage.str() == written.str(), true);
+
+    // Nodes follow the header of five words
+    std::string bytes = written.str();
+    for (size_t i = 0; i < tree.nodes.size(); ++ i)
+        for (size_t j = sizeof(ast_kind); j < offsetof(flat_node, first_child); ++ j)
+            ASSERT_EQUAL((int) bytes[20 + i * sizeof(flat_node) + j], 0);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
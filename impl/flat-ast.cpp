@@ -0,0 +1,263 @@
+#include "flat-ast.h"
+#include "ast.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+const char* ast_kind_name(ast_kind kind) {
+    switch (kind) {
+    case ast_kind::PROGRAM:          return "program";
+    case ast_kind::FUNCTION:         return "defun";
+    case ast_kind::PARAMETER:        return "parameter";
+    case ast_kind::BODY:             return "{ ... }";
+    case ast_kind::NUMBER:           return "number";
+    case ast_kind::VAR:              return "var";
+    case ast_kind::FUNCTION_CALL:    return "call";
+    case ast_kind::UNARY_MINUS:      return "-";
+    case ast_kind::MUL:              return "*";
+    case ast_kind::DIV:              return "/";
+    case ast_kind::ADD:              return "+";
+    case ast_kind::SUB:              return "-";
+    case ast_kind::LESS:             return "<";
+    case ast_kind::LESS_OR_EQUAL:    return "<=";
+    case ast_kind::GREATER:          return ">";
+    case ast_kind::GREATER_OR_EQUAL: return ">=";
+    case ast_kind::EQUALS:           return "==";
+    case ast_kind::NOT_EQUALS:       return "!=";
+    case ast_kind::FOR:              return "for";
+    case ast_kind::WHILE:            return "while";
+    case ast_kind::IF:               return "if";
+    case ast_kind::ASSIGNMENT:       return "let";
+    case ast_kind::REASSIGNMENT:     return "=";
+    case ast_kind::RETURN:           return "return";
+    }
+
+    return "?";
+}
+
+static bool has_name(ast_kind kind) {
+    switch (kind) {
+    case ast_kind::FUNCTION:      case ast_kind::PARAMETER:
+    case ast_kind::VAR:           case ast_kind::FUNCTION_CALL:
+    case ast_kind::FOR:           case ast_kind::ASSIGNMENT:
+    case ast_kind::REASSIGNMENT:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+std::span<const uint32_t> flat_ast::children_of(uint32_t node) const {
+    const flat_node& current = nodes[node];
+    return std::span(children).subspan(current.first_child, current.child_count);
+}
+
+std::string_view flat_ast::name(int32_t id) const {
+    return std::string_view(names.c_str() + name_offsets[id]);
+}
+
+//------------------------------------------------------------------------------
+
+// Layout of the written tree: header followed by raw arrays in the same order,
+// in host's byte order, so file can be mapped and used in place
+
+struct flat_ast_header {
+    char     magic[4];
+    uint32_t node_count;
+    uint32_t children_count;
+    uint32_t name_count;
+    uint32_t names_size;
+};
+
+static const char flat_ast_magic[4] = { 'F', 'A', 'S', 'T' };
+
+template <typename type>
+static void write_array(std::ostream& os, const std::vector<type>& array) {
+    os.write(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(type));
+}
+
+// Read in chunks, so that size from header of stream that can't tell its own
+// size (see remaining_size) allocates no more than what the stream has
+template <typename array_type>
+static void read_array(std::istream& is, array_type& array, uint32_t size) {
+    const size_t chunk_size = 64 * 1024;
+
+    array.clear();
+    while (array.size() < size && is) {
+        size_t start = array.size();
+        array.resize(std::min<size_t>(size, start + chunk_size));
+        is.read(reinterpret_cast<char*>(array.data() + start), (array.size() - start) * sizeof(array[0]));
+    }
+}
+
+// Bytes left in stream, so sizes in header can be checked before anything is allocated
+static uint64_t remaining_size(std::istream& is) {
+    std::streampos position = is.tellg();
+    if (position == std::streampos(-1))
+        return UINT64_MAX; // Stream can't tell, short one fails while it's read
+
+    is.seekg(0, std::ios::end);
+    std::streampos end = is.tellg();
+    is.seekg(position);
+
+    return (uint64_t) (end - position);
+}
+
+// Whether arrays reference only what exists, and children precede parents, as in trees that flatten() builds
+static bool valid_structure(const flat_ast& tree) {
+    if (tree.nodes.empty())
+        return false;
+
+    for (uint32_t i = 0; i < tree.nodes.size(); ++ i) {
+        const flat_node& node = tree.nodes[i];
+        if (node.kind > ast_kind::RETURN)
+            return false;
+
+        if ((uint64_t) node.first_child + node.child_count > tree.children.size())
+            return false;
+
+        for (uint32_t child: tree.children_of(i))
+            if (child >= i)
+                return false;
+
+        if (has_name(node.kind) && (node.value < 0 || (uint32_t) node.value >= tree.name_offsets.size()))
+            return false;
+    }
+
+    // Name runs to the first NUL after its offset, the last one ends with the string
+    if (!tree.name_offsets.empty() && (tree.names.empty() || tree.names.back() != '\0'))
+        return false;
+
+    for (uint32_t offset: tree.name_offsets)
+        if (offset >= tree.names.size())
+            return false;
+
+    return true;
+}
+
+void flat_ast::write(std::ostream& os) const {
+    flat_ast_header header = {
+        .magic          = {},
+        .node_count     = (uint32_t) nodes.size(),
+        .children_count = (uint32_t) children.size(),
+        .name_count     = (uint32_t) name_offsets.size(),
+        .names_size     = (uint32_t) names.size()
+    };
+
+    std::memcpy(header.magic, flat_ast_magic, sizeof(flat_ast_magic));
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Nodes are copied field by field into zeroed ones, so that padding
+    // after kind isn't garbage and the same tree is always the same bytes
+    std::vector<flat_node> zeroed(nodes.size());
+    std::memset(zeroed.data(), 0, zeroed.size() * sizeof(flat_node));
+
+    for (size_t i = 0; i < nodes.size(); ++ i) {
+        zeroed[i].kind        = nodes[i].kind;
+        zeroed[i].first_child = nodes[i].first_child;
+        zeroed[i].child_count = nodes[i].child_count;
+        zeroed[i].value       = nodes[i].value;
+    }
+
+    write_array(os, zeroed);
+    write_array(os, children);
+    write_array(os, name_offsets);
+
+    os.write(names.data(), names.size());
+}
+
+flat_ast flat_ast::read(std::istream& is) {
+    flat_ast_header header = {};
+    is.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    if (!is || std::memcmp(header.magic, flat_ast_magic, sizeof(flat_ast_magic)) != 0)
+        throw std::runtime_error("error: input isn't a flat syntax tree");
+
+    uint64_t size = (uint64_t) header.node_count     * sizeof(flat_node) +
+                    (uint64_t) header.children_count * sizeof(uint32_t)  +
+                    (uint64_t) header.name_count     * sizeof(uint32_t)  + header.names_size;
+
+    if (size > remaining_size(is))
+        throw std::runtime_error("error: flat syntax tree is truncated");
+
+    flat_ast tree;
+    read_array(is, tree.nodes,        header.node_count);
+    read_array(is, tree.children,     header.children_count);
+    read_array(is, tree.name_offsets, header.name_count);
+    read_array(is, tree.names,        header.names_size);
+
+    if (!is)
+        throw std::runtime_error("error: flat syntax tree is truncated");
+
+    if (!valid_structure(tree))
+        throw std::runtime_error("error: input isn't a flat syntax tree");
+
+    return tree;
+}
+
+void flat_ast::dump(std::ostream& os) const {
+    for (uint32_t i = 0; i < nodes.size(); ++ i) {
+        const flat_node& node = nodes[i];
+
+        os << i << ": " << ast_kind_name(node.kind);
+        if (node.kind == ast_kind::NUMBER)
+            os << " " << node.value;
+        else if (has_name(node.kind))
+            os << " " << name(node.value);
+
+        std::span<const uint32_t> node_children = children_of(i);
+        for (size_t j = 0; j < node_children.size(); ++ j)
+            os << (j == 0 ? " (" : ", ") << node_children[j];
+
+        if (!node_children.empty())
+            os << ")";
+
+        os << "\n";
+    }
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t flat_ast_builder::add(ast_kind kind, std::span<const uint32_t> children, int32_t value) {
+    flat_node node = {
+        .kind        = kind,
+        .first_child = (uint32_t) m_tree.children.size(),
+        .child_count = (uint32_t) children.size(),
+        .value       = value
+    };
+
+    m_tree.children.insert(m_tree.children.end(), children.begin(), children.end());
+    m_tree.nodes.push_back(node);
+
+    return (uint32_t) m_tree.nodes.size() - 1;
+}
+
+uint32_t flat_ast_builder::add(ast_kind kind, std::initializer_list<uint32_t> children, int32_t value) {
+    return add(kind, std::span(children.begin(), children.size()), value);
+}
+
+int32_t flat_ast_builder::name(std::string_view name) {
+    auto [position, inserted] =
+        m_name_ids.try_emplace(std::string(name), (int32_t) m_tree.name_offsets.size());
+
+    if (inserted) {
+        m_tree.name_offsets.push_back((uint32_t) m_tree.names.size());
+
+        m_tree.names.append(name);
+        m_tree.names.push_back('\0');
+    }
+
+    return position->second;
+}
+
+flat_ast flatten(ast* tree) {
+    flat_ast_builder builder;
+    tree->flatten(builder);
+
+    return builder.build();
+}
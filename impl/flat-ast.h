@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <iosfwd>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class ast_kind: uint8_t {
+    PROGRAM, FUNCTION, PARAMETER, BODY,
+
+    NUMBER, VAR, FUNCTION_CALL, UNARY_MINUS,
+
+    MUL, DIV, ADD, SUB,
+
+    LESS, LESS_OR_EQUAL, GREATER, GREATER_OR_EQUAL, EQUALS, NOT_EQUALS,
+
+    FOR, WHILE, IF,
+
+    ASSIGNMENT, REASSIGNMENT, RETURN
+};
+
+const char* ast_kind_name(ast_kind kind);
+
+/**
+ * Fixed size node of flat tree, children are referenced by their
+ * indices, so the whole tree can be copied, written or mapped as is.
+ */
+struct flat_node {
+    ast_kind kind;
+
+    uint32_t first_child; //!< Offset of the first child in flat_ast::children
+    uint32_t child_count;
+
+    int32_t value;        //!< Number for NUMBER, name id for named nodes, 0 otherwise
+};
+
+/**
+ * Alternative representation of syntax tree: nodes are stored in
+ * post-order, so every child precedes it's parent and root is the
+ * last node, passes that don't care about structure scan it linearly.
+ */
+struct flat_ast {
+    std::vector<flat_node> nodes;
+    std::vector<uint32_t>  children;     // Concatenated child lists of all nodes
+
+    std::vector<uint32_t>  name_offsets; // Name id -> offset of name in /names/
+    std::string            names;        // Null separated names
+
+    uint32_t root() const { return (uint32_t) nodes.size() - 1; }
+
+    std::span<const uint32_t> children_of(uint32_t node) const;
+    std::string_view name(int32_t id) const;
+
+    void write(std::ostream& os) const;
+    static flat_ast read(std::istream& is);
+
+    void dump(std::ostream& os) const;
+};
+
+class flat_ast_builder {
+public:
+    uint32_t add(ast_kind kind, std::span<const uint32_t> children, int32_t value = 0);
+    uint32_t add(ast_kind kind, std::initializer_list<uint32_t> children = {}, int32_t value = 0);
+
+    int32_t name(std::string_view name); // Intern name, equal names share id
+
+    flat_ast build() { return std::move(m_tree); }
+
+private:
+    flat_ast m_tree;
+    std::unordered_map<std::string, int32_t> m_name_ids;
+};
+
+struct ast;
+flat_ast flatten(ast* tree);
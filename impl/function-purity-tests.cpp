@@ -0,0 +1,78 @@
+#include "function-purity.h"
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Purity and recursion of every function, as "pure recursive", "pure" and so on
+static std::vector<std::string> purity(const std::string& source) {
+    std::vector<std::string> described;
+    for (const auto& function: analyze_purity(parse_program(source)))
+        described.push_back(std::string(function.pure ? "pure" : "impure") + (function.recursive ? " recursive" : ""));
+
+    return described;
+}
+
+TEST(self_recursion) {
+    std::vector<std::string> functions = purity("defun fib(n) {\n"
+                                                "    if (n < 2) {\n"
+                                                "        return n;\n"
+                                                "    }\n"
+                                                "    return fib(n - 1) + fib(n - 2);\n"
+                                                "}\n"
+                                                "defun main() { return fib(20); }\n");
+
+    ASSERT_EQUAL(functions == std::vector<std::string>({ "pure recursive", "pure" }), true);
+}
+
+// Functions of a cycle are recursive, the ones that only call into it aren't
+TEST(mutual_recursion) {
+    std::vector<std::string> functions = purity("defun is_even(n) {\n"
+                                                "    if (n == 0) {\n"
+                                                "        return 1;\n"
+                                                "    }\n"
+                                                "    return is_odd(n - 1);\n"
+                                                "}\n"
+                                                "defun is_odd(n) {\n"
+                                                "    if (n == 0) {\n"
+                                                "        return 0;\n"
+                                                "    }\n"
+                                                "    return is_even(n - 1);\n"
+                                                "}\n"
+                                                "defun twice(n) { return is_even(n) + is_even(n); }\n"
+                                                "defun main() { return twice(7); }\n");
+
+    ASSERT_EQUAL(functions == std::vector<std::string>({ "pure recursive", "pure recursive", "pure", "pure" }), true);
+}
+
+TEST(loops_and_locals_are_not_effects) {
+    std::vector<std::string> functions = purity("defun sum(n) {\n"
+                                                "    let total = 0\n"
+                                                "    for (i in 0..n) {\n"
+                                                "        total = total + i\n"
+                                                "    }\n"
+                                                "    while (total > 100) {\n"
+                                                "        total = total / 2\n"
+                                                "    }\n"
+                                                "    return total;\n"
+                                                "}\n");
+
+    ASSERT_EQUAL(functions == std::vector<std::string>({ "pure" }), true);
+}
+
+TEST(undefined_callee_is_an_error) {
+    std::string error;
+    try {
+        purity("defun main() { return g(1); }");
+    } catch (const std::runtime_error& thrown) {
+        error = thrown.what();
+    }
+
+    ASSERT_STRING_EQUAL(error, std::string("error: call of undefined function g in function main"));
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
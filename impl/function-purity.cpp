@@ -0,0 +1,68 @@
+#include "function-purity.h"
+#include "ir-call-graph.h"
+#include "program-symbols.h"
+
+#include <utility>
+
+// Whether node does anything but compute its value, every kind is listed, so that new ones get decided
+static bool has_effect(ast_kind kind) {
+    switch (kind) {
+    case ast_kind::PROGRAM: case ast_kind::FUNCTION: case ast_kind::PARAMETER: case ast_kind::BODY:
+    case ast_kind::NUMBER: case ast_kind::VAR: case ast_kind::UNARY_MINUS:
+    case ast_kind::MUL: case ast_kind::DIV: case ast_kind::ADD: case ast_kind::SUB:
+    case ast_kind::LESS: case ast_kind::LESS_OR_EQUAL: case ast_kind::GREATER:
+    case ast_kind::GREATER_OR_EQUAL: case ast_kind::EQUALS: case ast_kind::NOT_EQUALS:
+    case ast_kind::FOR: case ast_kind::WHILE: case ast_kind::IF:
+    case ast_kind::ASSIGNMENT: case ast_kind::REASSIGNMENT: case ast_kind::RETURN:
+        return false; // Locals are slots of the call
+
+    case ast_kind::FUNCTION_CALL:
+        return false; // Callee decides
+    }
+
+    return true;
+}
+
+std::vector<function_purity> analyze_purity(const flat_ast& tree) {
+    function_table table(tree);
+    const auto& functions = table.functions();
+
+    std::vector<function_purity> purity(functions.size());
+    std::vector<std::vector<uint32_t>> callees(functions.size());
+
+    // Nodes are in post-order, so function is the range of nodes that ends with its node
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < functions.size(); ++ i) {
+        for (uint32_t node = first; node < functions[i].node; ++ node) {
+            ast_kind kind = tree.nodes[node].kind;
+
+            if (kind == ast_kind::FUNCTION_CALL)
+                callees[i].push_back(table.callee(tree, node, functions[i].name));
+            else if (has_effect(kind))
+                purity[i].pure = false;
+        }
+
+        first = functions[i].node + 1;
+    }
+
+    call_graph graph(std::move(callees));
+
+    // Callees outside of component are decided before it, functions of a cycle are pure together
+    for (const auto& component: graph.components()) {
+        bool pure = true;
+        for (uint32_t function: component) {
+            pure = pure && purity[function].pure;
+
+            for (uint32_t callee: graph.callees(function))
+                if (graph.component(callee) != graph.component(function))
+                    pure = pure && purity[callee].pure;
+        }
+
+        for (uint32_t function: component) {
+            purity[function].pure = pure;
+            purity[function].recursive = graph.recursive(function);
+        }
+    }
+
+    return purity;
+}
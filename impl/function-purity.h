@@ -0,0 +1,23 @@
+#pragma once
+
+#include "flat-ast.h"
+
+#include <vector>
+
+struct function_purity {
+    bool pure = true;       // Result depends only on arguments, and calling has no other effect
+    bool recursive = false; // Can end up calling itself, directly or through others
+};
+
+/**
+ * Which functions of flattened program are pure, by index of
+ * function_table. Function is pure when nothing in its body has effect
+ * beyond the value it computes and all functions it calls are pure.
+ * Errors such as division by zero aren't effects, call that fails has
+ * no result that could be reused.
+ *
+ * The language has neither globals nor I/O yet, so every function is
+ * pure for now, constructs that add effects are to be marked in the
+ * analysis. Throws on calls of undefined functions, as compilers do.
+ */
+std::vector<function_purity> analyze_purity(const flat_ast& tree);
@@ -0,0 +1,204 @@
+#include "grammar.h"
+
+#include "definitions.h"
+
+#include <string>
+
+language_grammar create_language_grammar() {
+    using namespace lang;
+    using enum language_lexem;
+
+    // ----------------------------------------- PRIMITIVES ----------------------------------------
+    auto name                  = transform(static_p(NAME), [](auto tree) { return tree.value; });
+    alloc_p<ast_number> number = 
+        transform(static_p(NUMBER), [](auto tree) { return std::stoi(tree.value); });
+
+    // ========================================= ARITHMETIC ========================================
+
+    // -------------------------------------------- BASIC ------------------------------------------
+
+    lazy_w<ast_term*> factor;
+    lazy_w<ast_term*> term;
+    lazy_w<ast_expression*> expression;
+
+    // --------------------------------------- 1ST PRECEDENCE --------------------------------------
+    alloc_p<ast_var> var = name;
+
+    alloc_p<ast_mul> mul = factor & ignore_p(MUL) & term;
+    alloc_p<ast_div> div = factor & ignore_p(DIV) & term;
+
+    term = variant_upcast<ast_term>(mul | div | factor);
+
+    // --------------------------------------- 2ND PRECEDENCE --------------------------------------
+    alloc_p<ast_add> add = term & ignore_p(PLUS)  & expression;
+    alloc_p<ast_sub> sub = term & ignore_p(MINUS) & expression;
+
+    expression = variant_upcast<ast_expression>(add | sub | term);
+
+    // ----------------------------------------- COMPARISON ----------------------------------------
+    auto named_comparison = [&](named_lexem lexem) { return expression & ignore_parser(lexem) & expression; };
+    #define comparison(id) named_comparison(named_lexem { id, #id })
+
+    alloc_p<ast_less>             less             = comparison(LESS);
+    alloc_p<ast_less_or_equal>    less_or_equal    = comparison(LESS_OR_EQUAL);
+    alloc_p<ast_greater>          greater          = comparison(GREATER);
+    alloc_p<ast_greater_or_equal> greater_or_equal = comparison(GREATER_OR_EQUAL);
+    alloc_p<ast_equals>           equals           = comparison(EQUALS);
+    alloc_p<ast_not_equals>       not_equal        = comparison(NOT_EQUAL);
+
+    #undef comparison
+
+    auto cond = variant_upcast<ast_cond>(less | less_or_equal | greater | greater_or_equal | equals | not_equal);
+
+    // ---------------------------------------- ASSIGNMENT -----------------------------------------
+    auto assignment = name & ignore_p(EQUAL) & expression;
+
+    alloc_p<ast_assignment>   assignment_p   = ignore_p(LET) & assignment;
+    alloc_p<ast_reassignment> reassignment_p = assignment;
+
+    // ------------------------------------------ TERMS --------------------------------------------
+    alloc_p<ast_unary_minus> unary_minus = ignore_p(MINUS) & factor;
+
+    auto arguments = ignore_p(LRB) & separated_by(expression, ignore_p(COMMA)) & ignore_p(RRB);
+    alloc_p<ast_function_call> function_call = name & arguments;
+
+    alloc_p<ast_wrapped_expression> wrapped_expression = ignore_p(LRB) & expression & ignore_p(RRB);
+
+    // <== Term declaration (see forward declaration in "arithmetic" section)
+    // Calls and variables both start with a name, so they go one after another to share it
+    factor = variant_upcast<ast_term>(wrapped_expression | number | function_call | var); // TODO: unary minus
+
+    // ========================================= STATMENTS =========================================
+
+    lazy_w<ast_body*> body; // Forward declared (recursive declaration)
+
+    // ---------------------------------------- CONDITIONAL ----------------------------------------
+    auto condition_and_body = ignore_p(LRB) & cond & ignore_p(RRB) & body;
+
+    // Keywords leave no other way to parse the rest, so it's committed to
+    alloc_p<ast_if> if_p = ignore_p(IF) & commit(condition_and_body);
+    alloc_p<ast_while> while_p = ignore_p(WHILE) & commit(condition_and_body);
+
+    // ---------------------------------------------------------------------------------------------
+    alloc_p<ast_for> for_p = ignore_p(FOR) & commit(ignore_p(LRB) & name &
+        ignore_p(IN) & factor & ignore_p(ELLIPSIS) & factor & ignore_p(RRB) & body);
+
+    alloc_p<ast_return> return_p = ignore_p(RETURN) & expression;
+
+    // ---------------------------------------------------------------------------------------------
+    auto statement_without_semicolon = variant_upcast<ast_statement>(if_p | while_p | for_p);
+    auto statement_with_semicolon    = variant_upcast<ast_statement>(
+        assignment_p | reassignment_p | return_p & ignore_p(SEMICOLON));
+
+    auto statement = variant_upcast<ast_statement>(statement_with_semicolon | statement_without_semicolon);
+
+    // In recovery mode (see lang::diagnostics_scope) broken statements are skipped
+    recovery_tokens statement_recovery = {
+        .skip_past = { SEMICOLON },
+        .resume_at = { LET, IF, WHILE, FOR, RETURN },
+        .stop_at   = { DEFUN },
+        .nested    = std::pair(LCB, RCB)
+    };
+
+    // <== Body declaration (see forward declaration in "statements" section)
+    body = construct<ast_body>(ignore_p(LCB) & recovering_many(statement, statement_recovery) & ignore_p(RCB));
+
+    // ---------------------------------------- TOP LEVEL ------------------------------------------
+    auto argument_declaration = ignore_p(LRB) & separated_by(name, ignore_p(COMMA)) & ignore_p(RRB);
+    alloc_p<ast_function> function = ignore_p(DEFUN) & commit(name & argument_declaration & body);
+
+    recovery_tokens function_recovery = {
+        .skip_past = {},
+        .resume_at = { DEFUN },
+        .stop_at   = {},
+        .nested    = std::nullopt
+    };
+
+    auto program = construct<ast_program>(recovering_many(function, function_recovery)); // <== Topmost parser
+    // ---------------------------------------------------------------------------------------------
+
+    // Named parsers only reference each other, make returned ones own all of them
+    share_ownership(program, name, number, factor, term, expression, var, mul, div, add, sub,
+                    less, less_or_equal, greater, greater_or_equal, equals, not_equal, cond,
+                    assignment, assignment_p, reassignment_p, unary_minus, arguments, function_call,
+                    wrapped_expression, body, condition_and_body, if_p, while_p, for_p, return_p,
+                    statement_without_semicolon, statement_with_semicolon, statement,
+                    argument_declaration, function);
+
+    #define rule(parser) { &node_of(parser), #parser }
+
+    rule_names names = {
+        rule(name), rule(number), rule(factor), rule(term), rule(expression), rule(var), rule(mul),
+        rule(div), rule(add), rule(sub), rule(less), rule(less_or_equal), rule(greater),
+        rule(greater_or_equal), rule(equals), rule(not_equal), rule(cond), rule(assignment),
+        rule(assignment_p), rule(reassignment_p), rule(unary_minus), rule(arguments),
+        rule(function_call), rule(wrapped_expression), rule(body), rule(condition_and_body),
+        rule(if_p), rule(while_p), rule(for_p), rule(return_p), rule(statement_without_semicolon),
+        rule(statement_with_semicolon), rule(statement), rule(argument_declaration),
+        rule(function), rule(program)
+    };
+
+    #undef rule
+
+    parser_w<ast_function*> single_function = function;
+    share_ownership(single_function, program);
+
+    return { program, single_function, names };
+}
+
+lang::lexer create_language_lexer() {
+    using enum language_lexem;
+
+    lang::lexer lexer;
+
+    // Whitespace rule
+    lexer.ignore_rule("[\n \t]([\n \t])");
+
+    lexer.add_rules({
+        { named(ARROW),            "->"                        },
+        { named(COLON),            ":"                         },
+        { named(COMMA),            ","                         },
+        { named(ELLIPSIS),         ".."                        },
+
+        { named(EQUAL),            "="                         },
+
+        { named(EQUALS),           "=="                        },
+        { named(NOT_EQUAL),        "!="                        },
+        { named(GREATER),          ">"                         },
+        { named(GREATER_OR_EQUAL), ">="                        },
+        { named(LESS),             "<"                         },
+        { named(LESS_OR_EQUAL),    "<="                        },
+
+        { named(MINUS),            "-"                         },
+        { named(MUL),              "*"                         },
+        { named(PLUS),             "+"                         },
+        { named(DIV),              "/"                         },
+        { named(SEMICOLON),        ";"                         },
+
+        { named(LCB),              "{"                         },
+        { named(RCB),              "}"                         },
+
+        { named(LRB),              "[(]"                       },
+        { named(RRB),              "[)]"                       },
+
+        { named(DEFUN),            "defun"                     },
+        { named(RETURN),           "return"                    },
+
+        { named(IF),               "if"                        },
+        { named(ELSE),             "else"                      },
+
+        { named(LET),              "let"                       },
+
+        { named(WHILE),            "while"                     },
+
+        { named(FOR),              "for"                       },
+        { named(IN),               "in"                        },
+
+        { named(INT),              "int"                       },
+
+        { named(NAME),             "[A-Za-z_]([A-Za-z0-9_])"   },
+        { named(NUMBER),           "[0-9]([0-9])"              }
+    });
+
+    return lexer;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ast.h"
+#include "grammar-analysis.h"
+#include "lexer.h"
+#include "parser.h"
+
+struct language_grammar {
+    lang::parser_w<ast_program*>  program;  // Topmost parser
+    lang::parser_w<ast_function*> function; // Single top-level definition
+
+    lang::rule_names names; // Of every named parser, for diagnostics
+};
+
+language_grammar create_language_grammar();
+lang::lexer create_language_lexer();
@@ -0,0 +1,136 @@
+#include "incremental-parse.h"
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <sstream>
+#include <string>
+
+static const std::string first  = "defun first(a) {\n    return a + 1;\n}\n";
+static const std::string second = "defun second(b) {\n    return b * 2;\n}\n";
+static const std::string third  = "defun third(c) {\n    return c - 3;\n}\n";
+
+// Parser keeps reused functions, so the same one parses every version of the file
+struct incremental_session {
+    incremental_parser parser { test_grammar().function };
+
+    // Dump of flat tree of the program, so results of parses can be compared
+    std::string parse(const std::string& source) {
+        lang::token_buffer tokens(test_lexer().analyse(source, "test.prog"));
+
+        std::stringstream dump;
+        flatten(parser.parse(tokens.span())).dump(dump);
+        return dump.str();
+    }
+
+    // Syntax error of the parse, or "" if there is none
+    std::string error(const std::string& source) {
+        try {
+            parse(source);
+        } catch (const lang::parse_error& error) {
+            return error.what();
+        }
+
+        return "";
+    }
+};
+
+static std::string fresh_dump(const std::string& source) {
+    std::stringstream dump;
+    parse_program(source).dump(dump);
+    return dump.str();
+}
+
+static std::string fresh_error(const std::string& source) {
+    try {
+        parse_program(source);
+    } catch (const lang::parse_error& error) {
+        return error.what();
+    }
+
+    return "";
+}
+
+TEST(first_parse_parses_every_function) {
+    incremental_session session;
+    ASSERT_STRING_EQUAL(session.parse(first + second + third), fresh_dump(first + second + third));
+
+    ASSERT_EQUAL((int) session.parser.reparsed_functions(), 3);
+    ASSERT_EQUAL((int) session.parser.reused_functions(), 0);
+}
+
+TEST(unchanged_functions_are_reused) {
+    incremental_session session;
+    session.parse(first + second + third);
+
+    // Only locations change, they aren't part of what's compared
+    std::string moved = "\n\n" + first + "\n" + second + third;
+    ASSERT_STRING_EQUAL(session.parse(moved), fresh_dump(moved));
+
+    ASSERT_EQUAL((int) session.parser.reparsed_functions(), 0);
+    ASSERT_EQUAL((int) session.parser.reused_functions(), 3);
+}
+
+TEST(edited_body_is_reparsed) {
+    incremental_session session;
+    session.parse(first + second + third);
+
+    std::string edited = first + "defun second(b) {\n    return b * 3;\n}\n" + third;
+    ASSERT_STRING_EQUAL(session.parse(edited), fresh_dump(edited));
+
+    ASSERT_EQUAL((int) session.parser.reparsed_functions(), 1);
+    ASSERT_EQUAL((int) session.parser.reused_functions(), 2);
+}
+
+TEST(renamed_function_is_reparsed) {
+    incremental_session session;
+    session.parse(first + second + third);
+
+    std::string renamed = first + "defun renamed(b) {\n    return b * 2;\n}\n" + third;
+    ASSERT_STRING_EQUAL(session.parse(renamed), fresh_dump(renamed));
+
+    ASSERT_EQUAL((int) session.parser.reparsed_functions(), 1);
+    ASSERT_EQUAL((int) session.parser.reused_functions(), 2);
+}
+
+TEST(function_added_between_others_is_the_only_one_parsed) {
+    incremental_session session;
+    session.parse(first + third);
+
+    std::string added = first + second + third;
+    ASSERT_STRING_EQUAL(session.parse(added), fresh_dump(added));
+
+    ASSERT_EQUAL((int) session.parser.reparsed_functions(), 1);
+    ASSERT_EQUAL((int) session.parser.reused_functions(), 2);
+}
+
+TEST(removed_function_leaves_the_rest_reused) {
+    incremental_session session;
+    session.parse(first + second + third);
+
+    std::string removed = first + third;
+    ASSERT_STRING_EQUAL(session.parse(removed), fresh_dump(removed));
+
+    ASSERT_EQUAL((int) session.parser.reparsed_functions(), 0);
+    ASSERT_EQUAL((int) session.parser.reused_functions(), 2);
+}
+
+TEST(input_outside_functions_is_an_error) {
+    incremental_session session;
+
+    std::string trailing = first + second + "return 2;\n";
+    ASSERT_EQUAL(session.error(trailing).empty(), false);
+    ASSERT_STRING_EQUAL(session.error(trailing), fresh_error(trailing));
+
+    std::string leading = "return 2;\n" + first;
+    ASSERT_EQUAL(session.error(leading).empty(), false);
+    ASSERT_STRING_EQUAL(session.error(leading), fresh_error(leading));
+
+    // Function parsed together with what follows it isn't kept
+    ASSERT_STRING_EQUAL(session.parse(first + second), fresh_dump(first + second));
+    ASSERT_EQUAL((int) session.parser.reparsed_functions(), 1);
+    ASSERT_EQUAL((int) session.parser.reused_functions(), 1);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,172 @@
+#include "incremental-parse.h"
+#include "parallel-parse.h"
+#include "trace-events.h"
+
+#include <algorithm>
+#include <new>
+#include <thread>
+
+// Functions are usually small, so are their arenas
+static const size_t function_arena_block_size = 4 * 1024;
+
+static void create_arena(arena* new_arena, size_t block_size) {
+    TRY arena_create(new_arena, block_size)
+        CATCH({ trace_destruct(__trace); throw std::bad_alloc(); });
+}
+
+// FNV-1a over ids and values, locations are left out on purpose,
+// so function that only moved in the file is reused as well
+static uint64_t hash_range(const lang::token_span& tokens, size_t begin, size_t end) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    auto mix = [&](const void* data, size_t size) {
+        for (size_t i = 0; i < size; ++ i) {
+            hash ^= static_cast<const unsigned char*>(data)[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    for (size_t i = begin; i < end; ++ i) {
+        mix(&tokens.ids[i], sizeof(tokens.ids[i]));
+        mix(tokens.lexems[i].value.data(), tokens.lexems[i].value.size() + 1 /* Separator */);
+    }
+
+    return hash;
+}
+
+incremental_parser::incremental_parser(lang::parser_w<ast_function*>& function, size_t thread_count)
+    : m_function(function), m_thread_count(thread_count), m_program_arena({}) {
+
+    create_arena(&m_program_arena, function_arena_block_size);
+}
+
+incremental_parser::~incremental_parser() {
+    for (auto& [hash, cached]: m_cache)
+        arena_destroy(&cached.memory);
+
+    arena_destroy(&m_program_arena);
+}
+
+incremental_parser::cached_function*
+incremental_parser::find(uint64_t hash, const lang::token_span& tokens,
+                         size_t begin, size_t end) {
+
+    auto [first, last] = m_cache.equal_range(hash);
+    for (auto current = first; current != last; ++ current) {
+        auto& cached = current->second.tokens;
+        if (cached.size() != end - begin)
+            continue;
+
+        bool same = true;
+        for (size_t i = 0; i < cached.size() && same; ++ i)
+            same = cached[i].first  == tokens.ids[begin + i] &&
+                   cached[i].second == tokens.lexems[begin + i].value;
+
+        if (same)
+            return &current->second;
+    }
+
+    return nullptr;
+}
+
+ast_program* incremental_parser::parse(const lang::token_span& tokens) {
+    std::vector<token_range> ranges = split_top_level_functions(tokens);
+
+    for (auto& [hash, cached]: m_cache)
+        cached.used = false;
+
+    std::vector<cached_function*> functions(ranges.size());
+    std::vector<size_t> changed; // Indices of ranges to parse again
+
+    for (size_t i = 0; i < ranges.size(); ++ i) {
+        uint64_t hash = hash_range(tokens, ranges[i].begin, ranges[i].end);
+
+        // If the same function occurs twice, it's tree is shared
+        functions[i] = find(hash, tokens, ranges[i].begin, ranges[i].end);
+        if (functions[i] != nullptr) {
+            functions[i]->used = true;
+            continue;
+        }
+
+        cached_function new_function = {
+            .tokens = {}, .function = nullptr, .memory = {}, .used = true, .error = nullptr
+        };
+        for (size_t j = ranges[i].begin; j < ranges[i].end; ++ j)
+            new_function.tokens.emplace_back(tokens.ids[j], tokens.lexems[j].value);
+
+        create_arena(&new_function.memory, function_arena_block_size);
+
+        // References to elements survive insertion, so they can be filled in by workers
+        functions[i] = &m_cache.emplace(hash, std::move(new_function))->second;
+        changed.push_back(i);
+    }
+
+    m_reparsed = changed.size();
+    m_reused = ranges.size() - changed.size();
+
+    size_t thread_count = m_thread_count;
+    if (thread_count == 0)
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    thread_count = std::max<size_t>(std::min(thread_count, changed.size()), 1);
+
+    run_on_workers(changed.size(), thread_count, [&](size_t, size_t task) {
+        size_t range = changed[task];
+
+        cached_function* cached = functions[range];
+        lang::arena_scope scope(&cached->memory);
+        trace_span span("parse", tracing() ? "parse " + defined_function_name(tokens, ranges[range]) : "");
+
+        try {
+            lang::token_cursor position(tokens, ranges[range].begin);
+            lang::furthest_failure = { position, {} };
+
+            auto result = m_function.parse(position);
+            if (result)
+                cached->function = *result;
+
+            // Same rule as in parse_in_parallel, see there
+            if (result && position.index() != ranges[range].end) {
+                lang::token_cursor next = position;
+                m_function.parse(next);
+            }
+
+            if (!result || position.index() != ranges[range].end)
+                throw lang::unparsed_input_error(position);
+        } catch (...) {
+            cached->error = std::current_exception();
+        }
+    });
+
+    std::vector<ast_function*> program;
+    std::exception_ptr error = nullptr;
+
+    for (size_t i = 0; i < ranges.size(); ++ i) {
+        if (functions[i]->error) {
+            error = functions[i]->error;
+            break;
+        }
+
+        program.push_back(functions[i]->function);
+    }
+
+    // Functions that threw are dropped, so they are parsed again next time
+    for (auto current = m_cache.begin(); current != m_cache.end(); ) {
+        if (current->second.used && !current->second.error) {
+            ++ current;
+            continue;
+        }
+
+        arena_destroy(&current->second.memory);
+        current = m_cache.erase(current);
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+
+    arena_destroy(&m_program_arena);
+    create_arena(&m_program_arena, function_arena_block_size);
+
+    lang::arena_scope scope(&m_program_arena);
+    return lang::allocate_node<ast_program>(program);
+}
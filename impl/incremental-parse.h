@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ast.h"
+#include "arena.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Parser that keeps trees of top-level functions between parses of
+ * the same file. Lexems are split like in parse_in_parallel, and only
+ * ranges whose tokens changed since the last parse are parsed again.
+ */
+class incremental_parser {
+public:
+    // @arg thread_count for changed functions, 0 to use all available cores
+    incremental_parser(lang::parser_w<ast_function*>& function, size_t thread_count = 1);
+    ~incremental_parser();
+
+    incremental_parser(const incremental_parser&) = delete;
+    incremental_parser& operator=(const incremental_parser&) = delete;
+
+    /**
+     * Parse tokens, result is the same as of many(function) that has to
+     * parse all tokens, or lang::parse_error. Returned tree stays valid
+     * until the next parse.
+     */
+    ast_program* parse(const lang::token_span& tokens);
+
+    size_t reused_functions()   const { return m_reused;   } // During the last parse
+    size_t reparsed_functions() const { return m_reparsed; }
+
+private:
+    struct cached_function {
+        std::vector<std::pair<language_lexem, std::string>> tokens; // To rule out collisions
+
+        ast_function* function; // nullptr if range failed to parse
+
+        arena memory;           // Holds only this function's nodes
+        bool used;              // By the current parse
+
+        std::exception_ptr error;
+    };
+
+    lang::parser_w<ast_function*> m_function;
+    size_t m_thread_count;
+
+    std::unordered_multimap<uint64_t, cached_function> m_cache;
+    arena m_program_arena;
+
+    size_t m_reused = 0, m_reparsed = 0;
+
+    cached_function* find(uint64_t hash, const lang::token_span& tokens,
+                          size_t begin, size_t end);
+};
@@ -0,0 +1,98 @@
+#include "ir-call-graph.h"
+
+#include <algorithm>
+#include <utility>
+
+static std::vector<std::vector<uint32_t>> callees_of(const ir_program& program) {
+    std::vector<std::vector<uint32_t>> callees(program.functions.size());
+
+    for (uint32_t i = 0; i < program.functions.size(); ++ i)
+        for (const ir_block& block: program.functions[i].blocks)
+            for (const auto& instruction: block.code)
+                if (instruction.op == ir_op::CALL)
+                    callees[i].push_back(instruction.c);
+
+    return callees;
+}
+
+call_graph::call_graph(const ir_program& program)
+    : call_graph(callees_of(program)) {}
+
+call_graph::call_graph(std::vector<std::vector<uint32_t>> callees)
+    : m_callees(std::move(callees)) {
+
+    uint32_t count = (uint32_t) m_callees.size();
+
+    for (uint32_t i = 0; i < count; ++ i) {
+        std::sort(m_callees[i].begin(), m_callees[i].end());
+        m_callees[i].erase(std::unique(m_callees[i].begin(), m_callees[i].end()), m_callees[i].end());
+    }
+
+    // Tarjan's algorithm with explicit stack, call chains can be as deep as there are functions,
+    // it finishes a component only after all components reachable from it
+    static const uint32_t unvisited = UINT32_MAX;
+
+    std::vector<uint32_t> index(count, unvisited), lowlink(count);
+    std::vector<bool> on_stack(count);
+    std::vector<uint32_t> stack;
+    uint32_t next_index = 0;
+
+    struct frame { uint32_t function, next_callee; };
+    std::vector<frame> walk;
+
+    m_component.resize(count);
+
+    for (uint32_t root = 0; root < count; ++ root) {
+        if (index[root] != unvisited)
+            continue;
+
+        walk.push_back({ root, 0 });
+        index[root] = lowlink[root] = next_index ++;
+        stack.push_back(root);
+        on_stack[root] = true;
+
+        while (!walk.empty()) {
+            frame& top = walk.back();
+            uint32_t function = top.function;
+
+            if (top.next_callee < m_callees[function].size()) {
+                uint32_t callee = m_callees[function][top.next_callee ++];
+
+                if (index[callee] == unvisited) {
+                    index[callee] = lowlink[callee] = next_index ++;
+                    stack.push_back(callee);
+                    on_stack[callee] = true;
+                    walk.push_back({ callee, 0 }); // Invalidates top
+                } else if (on_stack[callee])
+                    lowlink[function] = std::min(lowlink[function], index[callee]);
+
+                continue;
+            }
+
+            walk.pop_back();
+            if (!walk.empty())
+                lowlink[walk.back().function] = std::min(lowlink[walk.back().function], lowlink[function]);
+
+            if (lowlink[function] != index[function])
+                continue;
+
+            std::vector<uint32_t> component;
+            uint32_t member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                on_stack[member] = false;
+
+                m_component[member] = (uint32_t) m_components.size();
+                component.push_back(member);
+            } while (member != function);
+
+            m_components.push_back(std::move(component));
+        }
+    }
+
+    m_recursive.resize(count);
+    for (uint32_t i = 0; i < count; ++ i)
+        m_recursive[i] = m_components[m_component[i]].size() > 1 ||
+                         std::binary_search(m_callees[i].begin(), m_callees[i].end(), i);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "ir.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Which functions of ir_program call which, and its strongly connected
+ * components (Tarjan), which are groups of functions that can call
+ * each other in a cycle. Components are in bottom-up order, so passes
+ * that go through them see callees before their callers.
+ */
+class call_graph {
+public:
+    explicit call_graph(const ir_program& program);
+
+    // Of program whose function i calls callees[i], e.g. of syntax tree
+    explicit call_graph(std::vector<std::vector<uint32_t>> callees);
+
+    // Functions /function/ calls, each once
+    const std::vector<uint32_t>& callees(uint32_t function) const { return m_callees[function]; }
+
+    // Every component comes after all components its functions call
+    const std::vector<std::vector<uint32_t>>& components() const { return m_components; }
+    uint32_t component(uint32_t function) const { return m_component[function]; }
+
+    // Whether function can end up calling itself, directly or through others
+    bool recursive(uint32_t function) const { return m_recursive[function]; }
+
+private:
+    std::vector<std::vector<uint32_t>> m_callees;
+
+    std::vector<std::vector<uint32_t>> m_components;
+    std::vector<uint32_t> m_component;
+    std::vector<bool> m_recursive;
+};
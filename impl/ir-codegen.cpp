@@ -0,0 +1,561 @@
+#include "ir-codegen.h"
+#include "ir-dominance.h"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+// Dense set of values of a function
+class value_set {
+public:
+    explicit value_set(uint32_t size = 0): m_words((size + 63) / 64) {}
+
+    bool contains(uint32_t value) const { return m_words[value / 64] >> (value % 64) & 1; }
+    void insert(uint32_t value) { m_words[value / 64] |= uint64_t(1) << (value % 64); }
+    void erase(uint32_t value) { m_words[value / 64] &= ~(uint64_t(1) << (value % 64)); }
+
+    // Returns whether anything was added
+    bool insert_all(const value_set& other) {
+        bool changed = false;
+        for (size_t i = 0; i < m_words.size(); ++ i) {
+            uint64_t merged = m_words[i] | other.m_words[i];
+            changed |= merged != m_words[i];
+            m_words[i] = merged;
+        }
+
+        return changed;
+    }
+
+    template <typename visitor>
+    void for_each(visitor&& visit) const {
+        for (size_t i = 0; i < m_words.size(); ++ i)
+            for (uint64_t word = m_words[i]; word != 0; word &= word - 1)
+                visit((uint32_t) (i * 64 + __builtin_ctzll(word)));
+    }
+
+private:
+    std::vector<uint64_t> m_words;
+};
+
+static register_op branch_of(ir_op comparison) {
+    switch (comparison) {
+    case ir_op::LESS:             return register_op::JUMP_IF_LESS;
+    case ir_op::LESS_OR_EQUAL:    return register_op::JUMP_IF_LESS_OR_EQUAL;
+    case ir_op::GREATER:          return register_op::JUMP_IF_GREATER;
+    case ir_op::GREATER_OR_EQUAL: return register_op::JUMP_IF_GREATER_OR_EQUAL;
+    case ir_op::EQUALS:           return register_op::JUMP_IF_EQUALS;
+    case ir_op::NOT_EQUALS:       return register_op::JUMP_IF_NOT_EQUALS;
+
+    default:
+        throw std::logic_error(std::string("ir: ") + ir_op_name(comparison) + " isn't a comparison");
+    }
+}
+
+static uint32_t phi_count(const ir_block& block) {
+    uint32_t count = 0;
+    while (count < block.code.size() && block.code[count].op == ir_op::PHI)
+        ++ count;
+
+    return count;
+}
+
+// Copies for phis go to the end of predecessor, so it has to have only one successor
+static void split_edges_to_phis(ir_function& function) {
+    auto& blocks = function.blocks;
+
+    for (uint32_t i = 0, count = (uint32_t) blocks.size(); i < count; ++ i) {
+        if (blocks[i].terminator().op != ir_op::BRANCH)
+            continue;
+
+        for (uint32_t ir_instruction::* target: { &ir_instruction::b, &ir_instruction::c }) {
+            uint32_t successor = blocks[i].code.back().*target;
+            if (phi_count(blocks[successor]) == 0)
+                continue;
+
+            uint32_t split = (uint32_t) blocks.size();
+            blocks.emplace_back();
+            blocks[split].code.push_back({ ir_op::JUMP, ir_type::VOID, function.new_value(), 0, successor });
+            blocks[split].predecessors.push_back(i);
+
+            auto& predecessors = blocks[successor].predecessors;
+            *std::find(predecessors.begin(), predecessors.end(), i) = split;
+
+            blocks[i].code.back().*target = split;
+        }
+    }
+}
+
+class ir_codegen {
+public:
+    ir_codegen(const ir_program& ir, register_program& program, uint32_t index)
+        : m_ir(ir), m_program(program), m_function(ir.functions[index]) {}
+
+    void compile() {
+        split_edges_to_phis(m_function);
+        m_dominators.emplace(m_function);
+
+        find_definitions();
+        assign_constants();
+        find_direct_arguments();
+        compute_liveness();
+        allocate_registers();
+
+        emit_code();
+    }
+
+private:
+    const ir_program& m_ir;
+    register_program& m_program;
+
+    ir_function m_function; // Copy, edges get split
+    std::optional<dominator_tree> m_dominators;
+
+    static constexpr uint32_t none = UINT32_MAX;
+
+    std::vector<const ir_instruction*> m_definitions; // By value
+    std::vector<uint32_t> m_uses;
+
+    std::vector<int64_t> m_constants;
+    std::unordered_map<int64_t, uint32_t> m_constant_indices;
+
+    std::vector<uint32_t> m_direct;     // Argument position a value is computed right into, or none
+    uint32_t m_call_area = 0;           // Size of registers of arguments
+
+    std::vector<value_set> m_live_in, m_live_out; // Not counting phis of the block itself
+
+    std::vector<uint32_t> m_register;   // Virtual register of value, see real_register()
+    uint32_t m_virtual_registers = 0;
+
+    bool allocated(uint32_t value) const {
+        const ir_instruction* definition = m_definitions[value];
+        return definition->type == ir_type::INT && definition->op != ir_op::CONSTANT && m_direct[value] == none;
+    }
+
+    void find_definitions() {
+        m_definitions.assign(m_function.values, nullptr);
+        m_uses.assign(m_function.values, 0);
+
+        for (const ir_block& block: m_function.blocks)
+            for (const ir_instruction& instruction: block.code) {
+                m_definitions[instruction.id] = &instruction;
+                for_each_operand(block, instruction, [&](uint32_t operand) { ++ m_uses[operand]; });
+            }
+    }
+
+    void assign_constants() {
+        for (const ir_block& block: m_function.blocks)
+            for (const ir_instruction& instruction: block.code)
+                if (instruction.op == ir_op::CONSTANT &&
+                    m_constant_indices.try_emplace(instruction.value, (uint32_t) m_constants.size()).second)
+                    m_constants.push_back(instruction.value);
+    }
+
+    // Argument that is only used by call, and computed after every call before it,
+    // can be computed right into the register it's passed in
+    void find_direct_arguments() {
+        m_direct.assign(m_function.values, none);
+
+        for (const ir_block& block: m_function.blocks) {
+            uint32_t last_call = 0; // Index + 1 of the last call
+
+            std::unordered_map<uint32_t, uint32_t> defined_at; // Value -> index in block
+            for (uint32_t i = 0; i < block.code.size(); ++ i) {
+                const ir_instruction& instruction = block.code[i];
+                if (instruction.op != ir_op::CALL) {
+                    defined_at[instruction.id] = i;
+                    continue;
+                }
+
+                m_call_area = std::max(m_call_area, instruction.b);
+
+                for (uint32_t j = 0; j < instruction.b; ++ j) {
+                    uint32_t argument = block.operands_of(instruction)[j];
+                    const ir_instruction* definition = m_definitions[argument];
+
+                    auto found = defined_at.find(argument);
+                    bool computed = definition->op != ir_op::CONSTANT && definition->op != ir_op::PARAMETER &&
+                                    definition->op != ir_op::PHI;
+
+                    if (computed && m_uses[argument] == 1 && found != defined_at.end() && found->second + 1 >= last_call)
+                        m_direct[argument] = j;
+                }
+
+                defined_at[instruction.id] = i;
+                last_call = i + 1;
+            }
+        }
+    }
+
+    void compute_liveness() {
+        const auto& blocks = m_function.blocks;
+        size_t count = blocks.size();
+
+        std::vector<value_set> uses(count, value_set(m_function.values)), definitions(count, value_set(m_function.values));
+
+        for (uint32_t i = 0; i < count; ++ i)
+            for (const ir_instruction& instruction: blocks[i].code) {
+                if (instruction.op != ir_op::PHI)
+                    for_each_operand(blocks[i], instruction, [&](uint32_t operand) {
+                        if (allocated(operand) && !definitions[i].contains(operand))
+                            uses[i].insert(operand);
+                    });
+
+                definitions[i].insert(instruction.id);
+            }
+
+        m_live_in.assign(count, value_set(m_function.values));
+        m_live_out.assign(count, value_set(m_function.values));
+
+        const auto& order = m_dominators->reverse_postorder();
+
+        for (bool changed = true; changed; ) {
+            changed = false;
+
+            for (auto block = order.rbegin(); block != order.rend(); ++ block) {
+                uint32_t index = *block;
+                value_set& out = m_live_out[index];
+
+                for (uint32_t successor: blocks[index].successors()) {
+                    out.insert_all(m_live_in[successor]);
+
+                    for_each_phi_operand(successor, index, [&](const ir_instruction&, uint32_t operand) {
+                        if (allocated(operand))
+                            out.insert(operand);
+                    });
+                }
+
+                value_set in = uses[index];
+                out.for_each([&](uint32_t value) {
+                    if (!definitions[index].contains(value))
+                        in.insert(value);
+                });
+
+                changed |= m_live_in[index].insert_all(in);
+            }
+        }
+    }
+
+    // Call visit(phi, operand) for phis of /block/, with operands that come from /predecessor/
+    template <typename visitor>
+    void for_each_phi_operand(uint32_t block, uint32_t predecessor, visitor&& visit) const {
+        const ir_block& target = m_function.blocks[block];
+
+        auto position = std::find(target.predecessors.begin(), target.predecessors.end(), predecessor);
+        uint32_t index = (uint32_t) (position - target.predecessors.begin());
+
+        for (uint32_t i = 0, count = phi_count(target); i < count; ++ i)
+            visit(target.code[i], target.operands_of(target.code[i])[index]);
+    }
+
+    void allocate_registers() {
+        const auto& blocks = m_function.blocks;
+
+        m_register.assign(m_function.values, none);
+        std::vector<uint32_t> hints(m_function.values, none);
+
+        std::vector<bool> occupied;
+        auto is_free = [&](uint32_t reg) { return reg >= occupied.size() || !occupied[reg]; };
+
+        auto take = [&](uint32_t value, uint32_t reg) {
+            if (reg >= occupied.size())
+                occupied.resize(reg + 1);
+
+            occupied[reg] = true;
+            m_register[value] = reg;
+            m_virtual_registers = std::max(m_virtual_registers, reg + 1);
+        };
+
+        auto allocate = [&](uint32_t value, uint32_t preferred) {
+            if (preferred == none || !is_free(preferred))
+                preferred = hints[value];
+
+            if (preferred == none || !is_free(preferred))
+                for (preferred = m_function.arity; !is_free(preferred); ++ preferred) {}
+
+            take(value, preferred);
+        };
+
+        auto release = [&](uint32_t value) { occupied[m_register[value]] = false; };
+
+        m_virtual_registers = m_function.arity;
+
+        for (uint32_t index: m_dominators->preorder()) {
+            const ir_block& block = blocks[index];
+
+            occupied.assign(m_virtual_registers, false);
+            m_live_in[index].for_each([&](uint32_t value) { occupied[m_register[value]] = true; });
+
+            // Where values die: last use in block, unless they are live out of it
+            std::unordered_map<uint32_t, uint32_t> last_use;
+            for (uint32_t i = 0; i < block.code.size(); ++ i)
+                if (block.code[i].op != ir_op::PHI)
+                    for_each_operand(block, block.code[i], [&](uint32_t operand) { last_use[operand] = i; });
+
+            auto dead_after = [&](uint32_t value, uint32_t i) {
+                if (m_live_out[index].contains(value))
+                    return false;
+
+                auto found = last_use.find(value);
+                return found == last_use.end() ? true : found->second <= i;
+            };
+
+            // Parameters arrive in the first registers
+            if (index == 0)
+                for (const ir_instruction& instruction: block.code)
+                    if (instruction.op == ir_op::PARAMETER)
+                        take(instruction.id, instruction.a);
+
+            uint32_t phis = phi_count(block);
+            for (uint32_t i = 0; i < phis; ++ i) {
+                const ir_instruction& phi = block.code[i];
+
+                // Prefer register of operand that is already assigned and dead here
+                uint32_t preferred = none;
+                for (uint32_t j = 0; j < phi.b; ++ j) {
+                    uint32_t operand = block.operands_of(phi)[j];
+                    if (allocated(operand) && m_register[operand] != none && is_free(m_register[operand])) {
+                        preferred = m_register[operand];
+                        break;
+                    }
+                }
+
+                allocate(phi.id, preferred);
+
+                for (uint32_t j = 0; j < phi.b; ++ j)
+                    if (hints[block.operands_of(phi)[j]] == none)
+                        hints[block.operands_of(phi)[j]] = m_register[phi.id];
+            }
+
+            for (uint32_t i = 0; i < phis; ++ i)
+                if (dead_after(block.code[i].id, phis - 1))
+                    release(block.code[i].id);
+
+            for (uint32_t i = phis; i < block.code.size(); ++ i) {
+                const ir_instruction& instruction = block.code[i];
+
+                if (instruction.op == ir_op::PARAMETER) {
+                    if (dead_after(instruction.id, i))
+                        release(instruction.id);
+                    continue;
+                }
+
+                // Operands are read before result is written, so result can take register of one
+                uint32_t freed = none;
+                for_each_operand(block, instruction, [&](uint32_t operand) {
+                    if (allocated(operand) && is_free(m_register[operand]) == false && dead_after(operand, i)) {
+                        release(operand);
+                        if (freed == none)
+                            freed = m_register[operand];
+                    }
+                });
+
+                if (!allocated(instruction.id))
+                    continue;
+
+                allocate(instruction.id, freed);
+                if (dead_after(instruction.id, i))
+                    release(instruction.id);
+            }
+        }
+    }
+
+    uint32_t real_register(uint32_t virtual_register) const {
+        return virtual_register < m_function.arity ? virtual_register
+                                                   : virtual_register + (uint32_t) m_constants.size();
+    }
+
+    uint32_t scratch() const { return m_function.arity + (uint32_t) m_constants.size() +
+                                      (m_virtual_registers - m_function.arity); }
+
+    uint32_t call_area() const { return scratch() + 1; }
+
+    uint32_t location(uint32_t value) const {
+        const ir_instruction* definition = m_definitions[value];
+
+        if (definition->op == ir_op::CONSTANT)
+            return m_function.arity + m_constant_indices.at(definition->value);
+
+        if (m_direct[value] != none)
+            return call_area() + m_direct[value];
+
+        return real_register(m_register[value]);
+    }
+
+    // Code
+
+    std::vector<uint32_t> m_labels;                     // Of blocks, by index
+    std::vector<std::pair<uint32_t, uint32_t>> m_jumps; // Instruction, block it jumps to
+
+    void emit(register_op op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+        m_program.code.push_back({ op, a, b, c });
+    }
+
+    void emit_jump(register_op op, uint32_t block, uint32_t lhs = 0, uint32_t rhs = 0) {
+        m_jumps.emplace_back((uint32_t) m_program.code.size(), block);
+        emit(op, 0, lhs, rhs);
+    }
+
+    void emit_code() {
+        const auto& blocks = m_function.blocks;
+        const auto& order = m_dominators->reverse_postorder();
+
+        uint32_t entry = (uint32_t) m_program.code.size();
+        m_labels.assign(blocks.size(), none);
+
+        for (size_t i = 0; i < order.size(); ++ i) {
+            uint32_t index = order[i];
+            uint32_t next = i + 1 < order.size() ? order[i + 1] : none;
+
+            const ir_block& block = blocks[index];
+            m_labels[index] = (uint32_t) m_program.code.size();
+
+            for (size_t j = 0; j < block.code.size(); ++ j) {
+                const ir_instruction& instruction = block.code[j];
+
+                // Call whose value is returned right away returns to caller of this function
+                if (instruction.op == ir_op::CALL && j + 1 < block.code.size() &&
+                    block.code[j + 1].op == ir_op::RETURN && block.code[j + 1].a == instruction.id) {
+                    emit_arguments(block, instruction);
+                    emit(register_op::TAIL_CALL, 0, call_area(), instruction.c);
+                    break;
+                }
+
+                emit_instruction(block, index, instruction, next);
+            }
+        }
+
+        for (const auto& [jump, block]: m_jumps)
+            m_program.code[jump].a = m_labels[block];
+
+        m_program.functions.push_back({
+            .name = m_function.name,
+            .arity = m_function.arity,
+            .registers = call_area() + m_call_area,
+            .constants = m_constants,
+            .entry = entry
+        });
+    }
+
+    void emit_arguments(const ir_block& block, const ir_instruction& call) {
+        for (uint32_t i = 0; i < call.b; ++ i) {
+            uint32_t argument = block.operands_of(call)[i];
+            if (m_direct[argument] == none)
+                emit(register_op::MOVE, call_area() + i, location(argument));
+        }
+    }
+
+    void emit_instruction(const ir_block& block, uint32_t index, const ir_instruction& instruction, uint32_t next) {
+        switch (instruction.op) {
+        case ir_op::CONSTANT: case ir_op::PARAMETER: case ir_op::PHI:
+            break;
+
+        case ir_op::ADD: emit(register_op::ADD, location(instruction.id), location(instruction.a), location(instruction.b)); break;
+        case ir_op::SUB: emit(register_op::SUB, location(instruction.id), location(instruction.a), location(instruction.b)); break;
+        case ir_op::MUL: emit(register_op::MUL, location(instruction.id), location(instruction.a), location(instruction.b)); break;
+        case ir_op::DIV: emit(register_op::DIV, location(instruction.id), location(instruction.a), location(instruction.b)); break;
+        case ir_op::NEG: emit(register_op::NEG, location(instruction.id), location(instruction.a));                          break;
+
+        case ir_op::CALL:
+            emit_arguments(block, instruction);
+            emit(register_op::CALL, location(instruction.id), call_area(), instruction.c);
+            break;
+
+        case ir_op::RETURN:
+            emit(register_op::RETURN, location(instruction.a));
+            break;
+
+        case ir_op::JUMP:
+            emit_phi_copies(instruction.b, index);
+
+            if (instruction.b == next)
+                break;
+
+            if (tests_only(instruction.b)) { // Take the branch here instead of jumping to it
+                emit_branch(m_function.blocks[instruction.b], next);
+                break;
+            }
+
+            emit_jump(register_op::JUMP, instruction.b);
+            break;
+
+        case ir_op::BRANCH:
+            emit_branch(block, next);
+            break;
+
+        case ir_op::LOAD_VARIABLE: case ir_op::STORE_VARIABLE:
+            throw std::logic_error("ir: variable is left in function " + m_function.name);
+
+        default: // Comparisons are part of branches
+            break;
+        }
+    }
+
+    // Block of phis, comparison and branch on it
+    bool tests_only(uint32_t index) const {
+        const ir_block& block = m_function.blocks[index];
+        return block.code.size() == phi_count(block) + 2 && block.terminator().op == ir_op::BRANCH;
+    }
+
+    void emit_branch(const ir_block& block, uint32_t next) {
+        const ir_instruction& branch = block.terminator();
+        const ir_instruction& comparison = block.code[block.code.size() - 2];
+
+        register_op op = branch_of(comparison.op);
+        uint32_t lhs = location(comparison.a), rhs = location(comparison.b);
+
+        if (branch.b == next) {
+            emit_jump(inverted_branch(op), branch.c, lhs, rhs);
+            return;
+        }
+
+        emit_jump(op, branch.b, lhs, rhs);
+        if (branch.c != next)
+            emit_jump(register_op::JUMP, branch.c);
+    }
+
+    // Phis of /block/ take their values from /predecessor/ all at once
+    void emit_phi_copies(uint32_t block, uint32_t predecessor) {
+        std::vector<std::pair<uint32_t, uint32_t>> copies; // Destination, source
+
+        for_each_phi_operand(block, predecessor, [&](const ir_instruction& phi, uint32_t operand) {
+            uint32_t destination = location(phi.id), source = location(operand);
+            if (destination != source)
+                copies.emplace_back(destination, source);
+        });
+
+        while (!copies.empty()) {
+            // Copy to register that no other copy reads, if there is one
+            auto ready = std::find_if(copies.begin(), copies.end(), [&](const auto& copy) {
+                return std::none_of(copies.begin(), copies.end(),
+                                    [&](const auto& other) { return other.second == copy.first; });
+            });
+
+            if (ready != copies.end()) {
+                emit(register_op::MOVE, ready->first, ready->second);
+                copies.erase(ready);
+                continue;
+            }
+
+            // Only cycles are left, break one by saving a register
+            uint32_t saved = copies.front().first;
+            emit(register_op::MOVE, scratch(), saved);
+
+            for (auto& copy: copies)
+                if (copy.second == saved)
+                    copy.second = scratch();
+        }
+    }
+};
+
+register_program compile_ir_program(const ir_program& ir) {
+    register_program program;
+
+    for (uint32_t i = 0; i < ir.functions.size(); ++ i) {
+        ir_codegen codegen(ir, program, i);
+        codegen.compile();
+    }
+
+    return program;
+}
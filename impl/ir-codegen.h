@@ -0,0 +1,23 @@
+#pragma once
+
+#include "ir.h"
+#include "register-bytecode.h"
+
+/**
+ * Translate SSA form to register bytecode, so that everything that
+ * runs register_program (register_vm, JIT, -S and -c) runs optimized
+ * code too.
+ *
+ * Values are assigned registers in dominator tree order, register is
+ * reused as soon as its value is dead, phis and values that flow into
+ * them prefer to share registers, so most phis need no copies. Other
+ * phis become parallel copies at the end of predecessors. Constants
+ * are function's constant registers, arguments of calls are computed
+ * right into the registers call passes. Call whose value is returned
+ * right away is tail call, which passes frame of caller to callee.
+ *
+ * Loop header that only tests condition is duplicated at the end of
+ * the loop, so every iteration takes one jump, like the bytecode
+ * compiler's loops do.
+ */
+register_program compile_ir_program(const ir_program& program);
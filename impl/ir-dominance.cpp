@@ -0,0 +1,133 @@
+#include "ir-dominance.h"
+
+#include <algorithm>
+#include <utility>
+
+dominator_tree::dominator_tree(const ir_function& function) {
+    size_t count = function.blocks.size();
+    const auto& blocks = function.blocks;
+
+    // Postorder of control flow graph, second successor is visited first,
+    // so that the first one comes earlier in reverse postorder
+    m_postorder_index.assign(count, unreachable);
+
+    std::vector<uint32_t> postorder;
+    std::vector<bool> visited(count);
+    std::vector<std::pair<uint32_t, uint32_t>> stack; // Block, successors visited
+
+    visited[0] = true;
+    stack.emplace_back(0, 0);
+
+    while (!stack.empty()) {
+        auto& [block, next] = stack.back();
+        ir_successors successors = blocks[block].successors();
+
+        if (next == successors.count) {
+            m_postorder_index[block] = (uint32_t) postorder.size();
+            postorder.push_back(block);
+            stack.pop_back();
+            continue;
+        }
+
+        uint32_t successor = successors.blocks[successors.count - 1 - next ++];
+        if (!visited[successor]) {
+            visited[successor] = true;
+            stack.emplace_back(successor, 0);
+        }
+    }
+
+    m_reverse_postorder.assign(postorder.rbegin(), postorder.rend());
+
+    // Immediate dominators, intersect walks up the tree by postorder index
+    m_idom.assign(count, unreachable);
+    m_idom[0] = 0;
+
+    auto intersect = [&](uint32_t lhs, uint32_t rhs) {
+        while (lhs != rhs) {
+            while (m_postorder_index[lhs] < m_postorder_index[rhs])
+                lhs = m_idom[lhs];
+            while (m_postorder_index[rhs] < m_postorder_index[lhs])
+                rhs = m_idom[rhs];
+        }
+
+        return lhs;
+    };
+
+    for (bool changed = true; changed; ) {
+        changed = false;
+
+        for (uint32_t block: m_reverse_postorder) {
+            if (block == 0)
+                continue;
+
+            uint32_t idom = unreachable;
+            for (uint32_t predecessor: blocks[block].predecessors) {
+                if (m_idom[predecessor] == unreachable)
+                    continue;
+
+                idom = idom == unreachable ? predecessor : intersect(predecessor, idom);
+            }
+
+            if (m_idom[block] != idom) {
+                m_idom[block] = idom;
+                changed = true;
+            }
+        }
+    }
+
+    m_children.assign(count, {});
+    for (uint32_t block: m_reverse_postorder)
+        if (block != 0)
+            m_children[m_idom[block]].push_back(block);
+
+    // Enter and leave times of the tree answer dominates() in constant time
+    m_tree_enter.assign(count, 0);
+    m_tree_leave.assign(count, 0);
+
+    uint32_t time = 0;
+    std::vector<std::pair<uint32_t, size_t>> tree_stack; // Block, children visited
+    tree_stack.emplace_back(0, 0);
+    m_tree_enter[0] = time ++;
+    m_preorder.push_back(0);
+
+    while (!tree_stack.empty()) {
+        auto& [block, next] = tree_stack.back();
+
+        if (next == m_children[block].size()) {
+            m_tree_leave[block] = time ++;
+            tree_stack.pop_back();
+            continue;
+        }
+
+        uint32_t child = m_children[block][next ++];
+        m_tree_enter[child] = time ++;
+        m_preorder.push_back(child);
+        tree_stack.emplace_back(child, 0);
+    }
+
+    // Frontier of a block is where its dominance ends: walk up from
+    // predecessors of every join until its immediate dominator
+    m_frontiers.assign(count, {});
+    for (uint32_t block: m_reverse_postorder) {
+        if (blocks[block].predecessors.size() < 2)
+            continue;
+
+        for (uint32_t predecessor: blocks[block].predecessors) {
+            if (!reachable(predecessor))
+                continue;
+
+            for (uint32_t runner = predecessor; runner != m_idom[block]; runner = m_idom[runner]) {
+                auto& frontier = m_frontiers[runner];
+                if (std::find(frontier.begin(), frontier.end(), block) == frontier.end())
+                    frontier.push_back(block);
+            }
+        }
+    }
+}
+
+bool dominator_tree::dominates(uint32_t dominator, uint32_t block) const {
+    if (!reachable(dominator) || !reachable(block))
+        return false;
+
+    return m_tree_enter[dominator] <= m_tree_enter[block] && m_tree_leave[block] <= m_tree_leave[dominator];
+}
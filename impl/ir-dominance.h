@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ir.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Dominators of blocks of ir_function, computed with the iterative
+ * algorithm of Cooper, Harvey and Kennedy over reverse postorder, and
+ * dominance frontiers, which is where phis of a variable go.
+ *
+ * Tree describes function as it was when it was built, blocks that are
+ * unreachable from entry are in neither order and dominate nothing.
+ */
+class dominator_tree {
+public:
+    explicit dominator_tree(const ir_function& function);
+
+    bool reachable(uint32_t block) const { return m_postorder_index[block] != unreachable; }
+
+    uint32_t immediate_dominator(uint32_t block) const { return m_idom[block]; } // Entry is its own
+    const std::vector<uint32_t>& children(uint32_t block) const { return m_children[block]; }
+
+    // Whether every path from entry to /block/ goes through /dominator/, block dominates itself
+    bool dominates(uint32_t dominator, uint32_t block) const;
+
+    // Branches go to their first successor before the second one
+    const std::vector<uint32_t>& reverse_postorder() const { return m_reverse_postorder; }
+
+    // Parents precede children
+    const std::vector<uint32_t>& preorder() const { return m_preorder; }
+
+    const std::vector<uint32_t>& frontier(uint32_t block) const { return m_frontiers[block]; }
+
+private:
+    static constexpr uint32_t unreachable = UINT32_MAX;
+
+    std::vector<uint32_t> m_reverse_postorder;
+    std::vector<uint32_t> m_postorder_index; // Of block in postorder of control flow graph
+
+    std::vector<uint32_t> m_idom;
+    std::vector<std::vector<uint32_t>> m_children;
+
+    std::vector<uint32_t> m_preorder;
+    std::vector<uint32_t> m_tree_enter, m_tree_leave; // Times of depth-first walk of the tree
+
+    std::vector<std::vector<uint32_t>> m_frontiers;
+};
@@ -0,0 +1,135 @@
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <string>
+
+// Calls of /callee/ left in /caller/ after -O1 with /options/
+static int calls(const std::string& source, const std::string& caller, const std::string& callee,
+                 const ir_optimizer_options& options = {}) {
+    ir_program program = lower_program(source, true, options);
+    uint32_t index = (uint32_t) (program.find(callee) - program.functions.data());
+
+    int count = 0;
+    for (const auto& block: program.find(caller)->blocks)
+        for (const auto& instruction: block.code)
+            count += instruction.op == ir_op::CALL && instruction.c == index;
+
+    return count;
+}
+
+static ir_optimizer_options limits(uint32_t size_limit, uint32_t growth_budget) {
+    return { .inlining = { .size_limit = size_limit, .growth_budget = growth_budget } };
+}
+
+// Sizes are 2 and 7: arithmetic and return, call saves 3 of them with one argument
+static const std::string callees =
+    "defun small(a) {\n"
+    "    return a + 1;\n"
+    "}\n"
+    "defun medium(a) {\n"
+    "    return a * a + a * 3 - (a + 7) * 2;\n"
+    "}\n"
+    "defun caller(n) {\n"
+    "    return small(n) + medium(n) + medium(n + 1);\n"
+    "}\n";
+
+TEST(size_limit_decides_which_calls_are_inlined) {
+    ASSERT_EQUAL(calls(callees, "caller", "small"), 0);
+    ASSERT_EQUAL(calls(callees, "caller", "medium"), 0);
+
+    // Cost of medium is 7 - 3 = 4
+    ASSERT_EQUAL(calls(callees, "caller", "small", limits(4, 400)), 0);
+    ASSERT_EQUAL(calls(callees, "caller", "medium", limits(4, 400)), 0);
+    ASSERT_EQUAL(calls(callees, "caller", "small", limits(3, 400)), 0);
+    ASSERT_EQUAL(calls(callees, "caller", "medium", limits(3, 400)), 2);
+
+    // Constant arguments make call cheaper, constant propagation folds what they flow into
+    std::string constant = callees + "defun main() { return medium(5) + medium(6); }\n";
+    ASSERT_EQUAL(calls(constant, "main", "medium", limits(1, 400)), 0);
+    ASSERT_EQUAL(calls(constant, "caller", "medium", limits(1, 400)), 2);
+}
+
+TEST(growth_budget_goes_to_cheapest_calls) {
+    ASSERT_EQUAL(calls(callees, "caller", "small", limits(40, 0)), 1);
+    ASSERT_EQUAL(calls(callees, "caller", "medium", limits(40, 0)), 2);
+
+    // Enough for small and one medium, calls are taken in order when they cost the same
+    ASSERT_EQUAL(calls(callees, "caller", "small", limits(40, 9)), 0);
+    ASSERT_EQUAL(calls(callees, "caller", "medium", limits(40, 9)), 1);
+
+    // One short of that, medium doesn't fit after small went first
+    ASSERT_EQUAL(calls(callees, "caller", "small", limits(40, 8)), 0);
+    ASSERT_EQUAL(calls(callees, "caller", "medium", limits(40, 8)), 2);
+    ASSERT_EQUAL(calls(callees, "caller", "small", limits(40, 1)), 1);
+    ASSERT_EQUAL(calls(callees, "caller", "medium", limits(40, 1)), 2);
+}
+
+TEST(recursive_functions_are_not_inlined) {
+    std::string source = "defun fib(n) {\n"
+                         "    if (n < 2) {\n"
+                         "        return n;\n"
+                         "    }\n"
+                         "    return fib(n - 1) + fib(n - 2);\n"
+                         "}\n"
+                         "defun is_even(n) {\n"
+                         "    if (n == 0) {\n"
+                         "        return 1;\n"
+                         "    }\n"
+                         "    return is_odd(n - 1) + 0;\n"
+                         "}\n"
+                         "defun is_odd(n) {\n"
+                         "    if (n == 0) {\n"
+                         "        return 0;\n"
+                         "    }\n"
+                         "    return is_even(n - 1) + 0;\n"
+                         "}\n"
+                         "defun caller(n) { return fib(n) + is_even(n) + is_odd(n); }\n";
+
+    ASSERT_EQUAL(calls(source, "caller", "fib"), 1);
+    ASSERT_EQUAL(calls(source, "caller", "is_even"), 1);
+    ASSERT_EQUAL(calls(source, "caller", "is_odd"), 1);
+
+    // Only tail recursive function is a loop by then, and is inlined
+    std::string tail = "defun count(n, total) {\n"
+                       "    if (n == 0) {\n"
+                       "        return total;\n"
+                       "    }\n"
+                       "    return count(n - 1, total + 1);\n"
+                       "}\n"
+                       "defun caller(n) { return count(n, 0); }\n";
+
+    ASSERT_EQUAL(calls(tail, "caller", "count"), 0);
+    ASSERT_STRING_EQUAL(run_source(tail + "defun main() { return caller(10); }", 1), std::string("10"));
+}
+
+TEST(functions_that_never_return_are_not_inlined) {
+    std::string source = "defun spin(a) {\n"
+                         "    while (1 < 2) {\n"
+                         "        a = a + 1\n"
+                         "    }\n"
+                         "}\n"
+                         "defun caller(n) { return spin(n) + 1; }\n";
+
+    ASSERT_EQUAL(calls(source, "caller", "spin"), 1);
+}
+
+// Function that may divide by zero has to be the one named in the error
+TEST(division_errors_name_original_function) {
+    std::string source = "defun divide(a, b) {\n"
+                         "    return a / b;\n"
+                         "}\n"
+                         "defun half(a) {\n"
+                         "    return a / 2;\n"
+                         "}\n"
+                         "defun main() { return half(9) + divide(1, 0); }\n";
+
+    ASSERT_EQUAL(calls(source, "main", "divide"), 1);
+    ASSERT_EQUAL(calls(source, "main", "half"), 0);
+
+    ASSERT_STRING_EQUAL(run_source(source, 1), std::string("error: division by zero in function divide"));
+    ASSERT_STRING_EQUAL(run_source(source, 0), run_source(source, 1));
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
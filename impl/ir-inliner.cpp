@@ -0,0 +1,228 @@
+#include "ir-inliner.h"
+#include "ir-call-graph.h"
+
+#include <algorithm>
+#include <vector>
+
+// Constants are constant registers and parameters are where arguments are passed, neither costs anything
+static uint32_t function_size(const ir_function& function) {
+    uint32_t size = 0;
+    for (const ir_block& block: function.blocks)
+        for (const auto& instruction: block.code)
+            if (instruction.op != ir_op::CONSTANT && instruction.op != ir_op::PARAMETER)
+                ++ size;
+
+    return size;
+}
+
+// Whether body can be copied to callers: division by zero reports the function it's in,
+// and caller of function that never returns would have no value of the call
+static bool can_inline(const ir_function& function) {
+    std::vector<const ir_instruction*> definitions(function.values, nullptr);
+    for (const ir_block& block: function.blocks)
+        for (const auto& instruction: block.code)
+            definitions[instruction.id] = &instruction;
+
+    bool returns = false;
+    for (const ir_block& block: function.blocks)
+        for (const auto& instruction: block.code) {
+            if (instruction.op == ir_op::RETURN)
+                returns = true;
+
+            if (instruction.op == ir_op::DIV &&
+                (definitions[instruction.b]->op != ir_op::CONSTANT || definitions[instruction.b]->value == 0))
+                return false;
+        }
+
+    return returns;
+}
+
+class inliner {
+public:
+    inliner(ir_program& program, const ir_inliner_options& options)
+        : m_program(program), m_options(options),
+          m_inlinable(program.functions.size()), m_size(program.functions.size()) {}
+
+    void inline_program() {
+        call_graph graph(m_program);
+
+        // Callees in the same component aren't decided yet, so calls between them stay
+        for (const auto& component: graph.components())
+            for (uint32_t function: component) {
+                inline_calls(m_program.functions[function]);
+
+                m_size[function] = function_size(m_program.functions[function]);
+                m_inlinable[function] = !graph.recursive(function) && can_inline(m_program.functions[function]);
+            }
+    }
+
+private:
+    ir_program& m_program;
+    const ir_inliner_options& m_options;
+
+    std::vector<bool> m_inlinable;
+    std::vector<uint32_t> m_size;
+
+    static constexpr int64_t constant_argument_bonus = 3;
+
+    struct candidate {
+        uint32_t call;
+        int64_t cost;
+    };
+
+    void inline_calls(ir_function& function) {
+        std::vector<bool> constant(function.values);
+        for (const ir_block& block: function.blocks)
+            for (const auto& instruction: block.code)
+                constant[instruction.id] = instruction.op == ir_op::CONSTANT;
+
+        std::vector<candidate> candidates;
+        for (const ir_block& block: function.blocks)
+            for (const auto& instruction: block.code) {
+                if (instruction.op != ir_op::CALL || !m_inlinable[instruction.c])
+                    continue;
+
+                // Call, return and moves of arguments are saved
+                int64_t cost = (int64_t) m_size[instruction.c] - 2 - instruction.b;
+                for (uint32_t i = 0; i < instruction.b; ++ i)
+                    if (constant[block.operands_of(instruction)[i]])
+                        cost -= constant_argument_bonus;
+
+                if (cost <= (int64_t) m_options.size_limit)
+                    candidates.push_back({ instruction.id, cost });
+            }
+
+        if (candidates.empty())
+            return;
+
+        std::stable_sort(candidates.begin(), candidates.end(), [](const candidate& lhs, const candidate& rhs) {
+            return lhs.cost < rhs.cost;
+        });
+
+        uint32_t budget = m_options.growth_budget;
+        for (const candidate& call: candidates) {
+            auto [block, index] = find_call(function, call.call);
+            uint32_t callee = function.blocks[block].code[index].c;
+
+            if (m_size[callee] > budget)
+                continue;
+
+            budget -= m_size[callee];
+            inline_call(function, block, index, m_program.functions[callee]);
+        }
+
+        function.simplify_control_flow();
+    }
+
+    static std::pair<uint32_t, uint32_t> find_call(const ir_function& function, uint32_t call) {
+        for (uint32_t i = 0; i < function.blocks.size(); ++ i)
+            for (uint32_t j = 0; j < function.blocks[i].code.size(); ++ j)
+                if (function.blocks[i].code[j].id == call)
+                    return { i, j };
+
+        return { 0, 0 }; // Every candidate is in function
+    }
+
+    // Block is split after the call, callee's blocks go between the halves, and its returns
+    // jump to the second half, where phi of returned values replaces the call
+    static void inline_call(ir_function& function, uint32_t block_index, uint32_t index, const ir_function& callee) {
+        uint32_t tail_index = (uint32_t) function.blocks.size();
+        uint32_t first = tail_index + 1;
+        function.blocks.resize(first + callee.blocks.size());
+
+        ir_block& block = function.blocks[block_index];
+        ir_block& tail = function.blocks[tail_index];
+
+        ir_instruction call = block.code[index];
+        std::vector<uint32_t> arguments(block.operands_of(call), block.operands_of(call) + call.b);
+
+        tail.code.assign(block.code.begin() + index + 1, block.code.end());
+        tail.operands = block.operands;
+        tail.compact_operands();
+
+        for (uint32_t successor: tail.successors()) {
+            auto& predecessors = function.blocks[successor].predecessors;
+            std::replace(predecessors.begin(), predecessors.end(), block_index, tail_index);
+        }
+
+        block.code.resize(index);
+        block.code.push_back({ ir_op::JUMP, ir_type::VOID, function.new_value(), 0, first });
+        block.compact_operands();
+
+        std::vector<uint32_t> renamed(callee.values);
+        for (uint32_t i = 0; i < callee.values; ++ i)
+            renamed[i] = function.values + i;
+
+        function.values += callee.values;
+
+        for (const auto& instruction: callee.blocks[0].code)
+            if (instruction.op == ir_op::PARAMETER)
+                renamed[instruction.id] = arguments[instruction.a];
+
+        std::vector<uint32_t> returned;
+
+        for (uint32_t i = 0; i < callee.blocks.size(); ++ i) {
+            const ir_block& source = callee.blocks[i];
+            ir_block& copy = function.blocks[first + i];
+
+            copy.operands = source.operands;
+
+            copy.predecessors = source.predecessors;
+            for (uint32_t& predecessor: copy.predecessors)
+                predecessor += first;
+
+            if (i == 0)
+                copy.predecessors = { block_index };
+
+            for (const auto& instruction: source.code) {
+                if (instruction.op == ir_op::PARAMETER)
+                    continue;
+
+                ir_instruction cloned = instruction;
+                cloned.id = renamed[cloned.id];
+                for_each_operand(copy, cloned, [&](uint32_t& operand) { operand = renamed[operand]; });
+
+                switch (cloned.op) {
+                case ir_op::BRANCH:
+                    cloned.c += first;
+                    [[fallthrough]];
+
+                case ir_op::JUMP:
+                    cloned.b += first;
+                    break;
+
+                case ir_op::RETURN:
+                    returned.push_back(cloned.a);
+                    tail.predecessors.push_back(first + i);
+                    cloned = { ir_op::JUMP, ir_type::VOID, cloned.id, 0, tail_index };
+                    break;
+
+                default:
+                    break;
+                }
+
+                copy.code.push_back(cloned);
+            }
+        }
+
+        if (returned.size() == 1) {
+            std::vector<uint32_t> replacement(function.values);
+            for (uint32_t i = 0; i < function.values; ++ i)
+                replacement[i] = i;
+
+            replacement[call.id] = returned[0];
+            function.replace_values(replacement);
+            return;
+        }
+
+        // Phi takes the place of the call
+        tail.code.insert(tail.code.begin(), { ir_op::PHI, ir_type::INT, call.id,
+                                              (uint32_t) tail.operands.size(), (uint32_t) returned.size() });
+        tail.operands.insert(tail.operands.end(), returned.begin(), returned.end());
+    }
+};
+
+void inline_functions(ir_program& program, const ir_inliner_options& options) {
+    inliner pass(program, options);
+    pass.inline_program();
+}
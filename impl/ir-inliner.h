@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ir.h"
+
+#include <cstdint>
+
+struct ir_inliner_options {
+    // Largest cost of callee that is inlined, cost is its size less what the call itself takes
+    uint32_t size_limit = 40;
+
+    // Instructions inlining can add to one function, 0 disables inlining
+    uint32_t growth_budget = 400;
+};
+
+/**
+ * Replace calls of small functions with their bodies. Functions are
+ * visited bottom-up by components of call_graph, so callee is already
+ * as small as inlining and later passes made it, when its callers
+ * decide about it. Recursive functions aren't inlined, neither are
+ * functions that may divide by zero, whose error names them.
+ *
+ * Size of callee is number of its instructions, call saves itself,
+ * return and moves of arguments, constant arguments count for more,
+ * since constant propagation that runs afterwards folds code they
+ * flow into. Cheapest calls are inlined first while budget lasts.
+ */
+void inline_functions(ir_program& program, const ir_inliner_options& options = {});
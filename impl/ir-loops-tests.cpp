@@ -0,0 +1,201 @@
+#include "ir-loops.h"
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <span>
+#include <string>
+#include <vector>
+
+static std::string run_optimized(const std::string& source, int optimize) {
+    try {
+        return run_source(source, optimize);
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+}
+
+// Whether block can run again after it ran once
+static bool in_loop(const ir_function& function, uint32_t block) {
+    std::vector<bool> seen(function.blocks.size());
+
+    ir_successors successors = function.blocks[block].successors();
+    std::vector<uint32_t> pending(successors.begin(), successors.end());
+    while (!pending.empty()) {
+        uint32_t current = pending.back();
+        pending.pop_back();
+
+        if (current == block)
+            return true;
+
+        if (seen[current])
+            continue;
+
+        seen[current] = true;
+        for (uint32_t successor: function.blocks[current].successors())
+            pending.push_back(successor);
+    }
+
+    return false;
+}
+
+// Instructions /op/ of /function/, either all of them or only those in loops
+static int count(const ir_program& program, const std::string& function, ir_op op, bool loops_only = false) {
+    const ir_function& counted = *program.find(function);
+
+    int count = 0;
+    for (uint32_t i = 0; i < counted.blocks.size(); ++ i)
+        for (const auto& instruction: counted.blocks[i].code)
+            count += instruction.op == op && (!loops_only || in_loop(counted, i));
+
+    return count;
+}
+
+// Division in loop that may not run can't go before it, unless divisor is known not to be zero
+TEST(zero_trip_loop_dividing_by_zero) {
+    std::string divisions = "defun f(n, d) {\n"
+                            "    let sum = 0\n"
+                            "    for (i in 0..n) {\n"
+                            "        sum = sum + 100 / d + i\n"
+                            "    }\n"
+                            "    return sum;\n"
+                            "}\n";
+
+    for (std::string call: { "f(0, 0)", "f(3, 0)", "f(3, 7)" }) {
+        std::string source = divisions + "defun main() { return " + call + "; }\n";
+        ASSERT_STRING_EQUAL(run_optimized(source, 1), run_optimized(source, 0));
+    }
+
+    ASSERT_STRING_EQUAL(run_optimized(divisions + "defun main() { return f(0, 0); }\n", 1), std::string("0"));
+    ASSERT_STRING_EQUAL(run_optimized(divisions + "defun main() { return f(3, 0); }\n", 1),
+                        std::string("error: division by zero in function f"));
+
+    // Constant divisor does leave the loop
+    ir_program hoisted = lower_program("defun f(n, a) {\n"
+                                       "    let sum = 0\n"
+                                       "    for (i in 0..n) {\n"
+                                       "        sum = sum + a / 7\n"
+                                       "    }\n"
+                                       "    return sum;\n"
+                                       "}\n", true);
+
+    ASSERT_EQUAL(count(hoisted, "f", ir_op::DIV), 1);
+    ASSERT_EQUAL(count(hoisted, "f", ir_op::DIV, true), 0);
+}
+
+// Smallest value divided by -1 wraps, also when division is hoisted and computed once
+TEST(smallest_value_divided_in_loop) {
+    std::string source = "defun f(min, n) {\n"
+                         "    let sum = 0\n"
+                         "    for (i in 0..n) {\n"
+                         "        sum = sum + min / (0 - 1) + min / (i - 1)\n"
+                         "    }\n"
+                         "    return sum;\n"
+                         "}\n"
+                         "defun main() { return f(1073741824 * 1073741824 * 8, 3); }\n";
+
+    ASSERT_STRING_EQUAL(run_optimized(source, 1), run_optimized(source, 0));
+    ASSERT_STRING_EQUAL(run_optimized(source, 1), std::string("error: division by zero in function f"));
+
+    std::string wrapping = "defun f(min, n) {\n"
+                           "    let sum = 0\n"
+                           "    for (i in 0..n) {\n"
+                           "        sum = sum + min / (0 - 1)\n"
+                           "    }\n"
+                           "    return sum;\n"
+                           "}\n"
+                           "defun main() { return f(1073741824 * 1073741824 * 8, 3) - 1; }\n";
+
+    ASSERT_STRING_EQUAL(run_optimized(wrapping, 1), run_optimized(wrapping, 0));
+    ASSERT_STRING_EQUAL(run_optimized(wrapping, 1), std::string("9223372036854775807"));
+}
+
+// Inner counter times k is reduced in inner loop, outer one is invariant there and reduced in outer loop
+TEST(multiples_of_counters_in_nested_loops) {
+    std::string nested = "defun f(n, k) {\n"
+                         "    let sum = 0\n"
+                         "    for (i in 0..n) {\n"
+                         "        for (j in 1..i) {\n"
+                         "            sum = sum + i * k - j * k + j * (k + 1)\n"
+                         "        }\n"
+                         "    }\n"
+                         "    return sum;\n"
+                         "}\n";
+
+    // Only starts of new variables, 1 * k and 1 * (k + 1), are multiplied, once before loops
+    ASSERT_EQUAL(count(lower_program(nested, true), "f", ir_op::MUL), 2);
+    ASSERT_EQUAL(count(lower_program(nested, true), "f", ir_op::MUL, true), 0);
+
+    for (std::string call: { "f(10, 3)", "f(0, 3)", "f(7, 0 - 5)", "f(4, 1000000 * 1000000 * 1000)" }) {
+        std::string source = nested + "defun main() { return " + call + "; }\n";
+        ASSERT_STRING_EQUAL(run_optimized(source, 1), run_optimized(source, 0));
+    }
+}
+
+static ir_instruction instruction(ir_op op, ir_type type, uint32_t id, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+    return { op, type, id, a, b, c };
+}
+
+static ir_instruction constant(uint32_t id, int64_t value) {
+    return { ir_op::CONSTANT, ir_type::INT, id, 0, 0, 0, value };
+}
+
+/**
+ * Loop that is entered from both sides of if, which lowering never
+ * makes, since join of if is a block of its own:
+ *
+ *   x = a < 3 ? 5 : 0
+ *   while (x < 10)
+ *       x = x + a * 2
+ *   return x
+ */
+static ir_program entered_twice() {
+    using enum ir_op;
+    using enum ir_type;
+
+    ir_function function = { "f", 1, std::vector<ir_block>(5), 16 };
+
+    function.blocks[0] = { { instruction(PARAMETER, INT, 0), constant(1, 3), constant(3, 0), constant(10, 2),
+                             instruction(LESS, BOOL, 2, 0, 1), instruction(BRANCH, VOID, 11, 2, 1, 2) }, {}, {} };
+    function.blocks[1] = { { constant(4, 5), instruction(JUMP, VOID, 12, 0, 2) }, {}, { 0 } };
+    function.blocks[2] = { { instruction(PHI, INT, 5, 0, 3), constant(6, 10), instruction(LESS, BOOL, 7, 5, 6),
+                             instruction(BRANCH, VOID, 13, 7, 3, 4) },
+                           { 3, 4, 9 }, { 0, 1, 3 } };
+    function.blocks[3] = { { instruction(MUL, INT, 8, 0, 10), instruction(ADD, INT, 9, 5, 8), instruction(JUMP, VOID, 14, 0, 2) },
+                           {}, { 2 } };
+    function.blocks[4] = { { instruction(RETURN, VOID, 15, 5) }, {}, { 2 } };
+
+    ir_program program;
+    program.functions.push_back(function);
+    program.verify();
+
+    return program;
+}
+
+static int64_t run(const ir_program& program, int64_t argument) {
+    register_program compiled = compile_ir_program(program);
+    register_vm vm(compiled);
+
+    int64_t arguments[] = { argument };
+    return vm.call(0, arguments);
+}
+
+TEST(loop_with_two_outside_predecessors) {
+    ir_program original = entered_twice();
+    ir_program optimized = entered_twice();
+
+    optimize_loops(optimized.functions[0]);
+    optimized.verify();
+
+    // Header is entered from preheader alone, where invariant went
+    const ir_function& function = optimized.functions[0];
+    ASSERT_EQUAL((int) function.blocks[2].predecessors.size(), 2);
+    ASSERT_EQUAL(count(optimized, "f", ir_op::MUL), 1);
+    ASSERT_EQUAL(count(optimized, "f", ir_op::MUL, true), 0);
+
+    for (int64_t a: { 1, 2, 3, 4, 9, 11 })
+        ASSERT_EQUAL((int) run(optimized, a), (int) run(original, a));
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
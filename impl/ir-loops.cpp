@@ -0,0 +1,391 @@
+#include "ir-loops.h"
+#include "ir-dominance.h"
+#include "vm-arithmetic.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+struct natural_loop {
+    uint32_t header;
+    std::vector<uint32_t> latches; // Blocks of loop that jump to header
+    std::vector<bool> body;        // Whether block is in loop, header is
+    uint32_t size = 0;
+};
+
+// Inner loops come before loops that contain them
+static std::vector<natural_loop> find_loops(const ir_function& function, const dominator_tree& dominators) {
+    const auto& blocks = function.blocks;
+
+    std::vector<natural_loop> loops;
+    std::vector<uint32_t> loop_of(blocks.size(), UINT32_MAX);
+
+    for (uint32_t header: dominators.reverse_postorder())
+        for (uint32_t predecessor: blocks[header].predecessors) {
+            if (!dominators.dominates(header, predecessor))
+                continue;
+
+            if (loop_of[header] == UINT32_MAX) {
+                loop_of[header] = (uint32_t) loops.size();
+                loops.push_back({ header, {}, std::vector<bool>(blocks.size()) });
+            }
+
+            auto& latches = loops[loop_of[header]].latches;
+            if (std::find(latches.begin(), latches.end(), predecessor) == latches.end())
+                latches.push_back(predecessor);
+        }
+
+    // Body is what reaches latches going backwards without passing header
+    for (natural_loop& loop: loops) {
+        loop.body[loop.header] = true;
+        loop.size = 1;
+
+        std::vector<uint32_t> worklist = loop.latches;
+        while (!worklist.empty()) {
+            uint32_t block = worklist.back();
+            worklist.pop_back();
+
+            if (loop.body[block])
+                continue;
+
+            loop.body[block] = true;
+            ++ loop.size;
+
+            worklist.insert(worklist.end(), blocks[block].predecessors.begin(), blocks[block].predecessors.end());
+        }
+    }
+
+    std::stable_sort(loops.begin(), loops.end(), [](const natural_loop& lhs, const natural_loop& rhs) {
+        return lhs.size < rhs.size;
+    });
+
+    return loops;
+}
+
+// Block outside loop that only jumps to header and is the only way into loop, or UINT32_MAX
+static uint32_t find_preheader(const ir_function& function, const natural_loop& loop) {
+    uint32_t preheader = UINT32_MAX;
+
+    for (uint32_t predecessor: function.blocks[loop.header].predecessors)
+        if (!loop.body[predecessor]) {
+            if (preheader != UINT32_MAX)
+                return UINT32_MAX;
+
+            preheader = predecessor;
+        }
+
+    if (preheader == UINT32_MAX || function.blocks[preheader].terminator().op != ir_op::JUMP)
+        return UINT32_MAX;
+
+    return preheader;
+}
+
+// New block takes edges that enter loop from outside, phis of header get their
+// values from it, through phis of the new block when there are several
+static void insert_preheader(ir_function& function, const natural_loop& loop) {
+    uint32_t index = (uint32_t) function.blocks.size();
+    function.blocks.emplace_back();
+
+    ir_block& header = function.blocks[loop.header];
+    ir_block& preheader = function.blocks.back();
+
+    std::vector<uint32_t> inside, outside; // Indices of header's predecessors
+    for (uint32_t i = 0; i < header.predecessors.size(); ++ i)
+        (loop.body[header.predecessors[i]] ? inside : outside).push_back(i);
+
+    for (uint32_t i: outside) {
+        uint32_t predecessor = header.predecessors[i];
+        preheader.predecessors.push_back(predecessor);
+
+        ir_instruction& last = function.blocks[predecessor].code.back();
+
+        if (last.b == loop.header)
+            last.b = index;
+        if (last.op == ir_op::BRANCH && last.c == loop.header)
+            last.c = index;
+    }
+
+    for (auto& phi: header.code) {
+        if (phi.op != ir_op::PHI)
+            break;
+
+        const uint32_t* operands = header.operands_of(phi);
+
+        uint32_t incoming = operands[outside[0]];
+        if (outside.size() > 1) {
+            incoming = function.new_value();
+            preheader.code.push_back({ ir_op::PHI, ir_type::INT, incoming,
+                                       (uint32_t) preheader.operands.size(), (uint32_t) outside.size() });
+
+            for (uint32_t i: outside)
+                preheader.operands.push_back(operands[i]);
+        }
+
+        std::vector<uint32_t> kept;
+        for (uint32_t i: inside)
+            kept.push_back(operands[i]);
+        kept.push_back(incoming);
+
+        phi.a = (uint32_t) header.operands.size();
+        phi.b = (uint32_t) kept.size();
+        header.operands.insert(header.operands.end(), kept.begin(), kept.end());
+    }
+
+    std::vector<uint32_t> predecessors;
+    for (uint32_t i: inside)
+        predecessors.push_back(header.predecessors[i]);
+    predecessors.push_back(index);
+
+    header.predecessors = std::move(predecessors);
+    header.compact_operands();
+
+    preheader.code.push_back({ ir_op::JUMP, ir_type::VOID, function.new_value(), 0, loop.header });
+}
+
+class loop_optimizer {
+public:
+    explicit loop_optimizer(ir_function& function) : m_function(function) {}
+
+    void optimize() {
+        for (bool inserted = true; inserted; ) {
+            inserted = false;
+
+            dominator_tree dominators(m_function);
+            for (const natural_loop& loop: find_loops(m_function, dominators))
+                if (find_preheader(m_function, loop) == UINT32_MAX) {
+                    insert_preheader(m_function, loop);
+                    inserted = true;
+                    break; // Loops have to be found again
+                }
+        }
+
+        // Code moves only between blocks from now on, so loops and dominators stay
+        dominator_tree dominators(m_function);
+        std::vector<natural_loop> loops = find_loops(m_function, dominators);
+
+        for (const natural_loop& loop: loops) {
+            uint32_t preheader = find_preheader(m_function, loop);
+
+            hoist_invariants(loop, preheader, dominators);
+            reduce_strength(loop, preheader);
+        }
+
+        grow_replacement();
+        m_function.replace_values(m_replacement);
+        m_function.remove_dead_code();
+    }
+
+private:
+    ir_function& m_function;
+
+    std::vector<uint32_t> m_replacement; // Of multiplications that induction variables replaced
+
+    // Values that passes added are themselves
+    void grow_replacement() {
+        for (uint32_t i = (uint32_t) m_replacement.size(); i < m_function.values; ++ i)
+            m_replacement.push_back(i);
+    }
+
+    std::vector<bool> defined_in(const natural_loop& loop) const {
+        std::vector<bool> defined(m_function.values);
+        for (uint32_t i = 0; i < m_function.blocks.size(); ++ i)
+            if (loop.body[i])
+                for (const auto& instruction: m_function.blocks[i].code)
+                    defined[instruction.id] = true;
+
+        return defined;
+    }
+
+    void hoist_invariants(const natural_loop& loop, uint32_t preheader, const dominator_tree& dominators) {
+        std::vector<bool> nonzero_constant(m_function.values);
+        for (const ir_block& block: m_function.blocks)
+            for (const auto& instruction: block.code)
+                nonzero_constant[instruction.id] = instruction.op == ir_op::CONSTANT && instruction.value != 0;
+
+        // Arithmetic can run even when loop would never have run it, but division may trap,
+        // and comparisons stay with their branches
+        auto movable = [&](const ir_instruction& instruction) -> bool {
+            switch (instruction.op) {
+            case ir_op::CONSTANT: case ir_op::ADD: case ir_op::SUB: case ir_op::MUL: case ir_op::NEG:
+                return true;
+
+            case ir_op::DIV:
+                return nonzero_constant[instruction.b];
+
+            default:
+                return false;
+            }
+        };
+
+        std::vector<bool> varies = defined_in(loop);
+        std::vector<ir_instruction> hoisted;
+
+        // Operands are visited before their users, except for phis, which stay
+        for (uint32_t index: dominators.reverse_postorder()) {
+            if (!loop.body[index])
+                continue;
+
+            ir_block& block = m_function.blocks[index];
+            std::erase_if(block.code, [&](const ir_instruction& instruction) {
+                if (!movable(instruction))
+                    return false;
+
+                bool invariant = true;
+                for_each_operand(block, instruction, [&](uint32_t operand) { invariant = invariant && !varies[operand]; });
+
+                if (!invariant)
+                    return false;
+
+                varies[instruction.id] = false;
+                hoisted.push_back(instruction);
+                return true;
+            });
+        }
+
+        auto& code = m_function.blocks[preheader].code;
+        code.insert(code.end() - 1, hoisted.begin(), hoisted.end());
+    }
+
+    struct induction_variable {
+        uint32_t phi, start, next;
+        int64_t step;
+        bool from_zero = false; // Start is constant 0, so is start of its multiples
+    };
+
+    void reduce_strength(const natural_loop& loop, uint32_t preheader) {
+        ir_block& header = m_function.blocks[loop.header];
+        if (loop.latches.size() != 1 || header.predecessors.size() != 2)
+            return;
+
+        uint32_t from_preheader = header.predecessors[0] == preheader ? 0 : 1;
+
+        std::vector<const ir_instruction*> definitions(m_function.values, nullptr);
+        for (const ir_block& block: m_function.blocks)
+            for (const auto& instruction: block.code)
+                definitions[instruction.id] = &instruction;
+
+        std::vector<bool> varies = defined_in(loop);
+
+        auto constant = [&](uint32_t value, int64_t& result) {
+            if (definitions[value]->op != ir_op::CONSTANT)
+                return false;
+
+            result = definitions[value]->value;
+            return true;
+        };
+
+        // Phis that latch sets to themselves plus or minus constant
+        std::vector<induction_variable> variables;
+        for (const auto& phi: header.code) {
+            if (phi.op != ir_op::PHI)
+                break;
+
+            uint32_t start = header.operands_of(phi)[from_preheader];
+            uint32_t next = header.operands_of(phi)[1 - from_preheader];
+            const ir_instruction& update = *definitions[next];
+
+            int64_t step;
+            if (update.op == ir_op::ADD && update.a == phi.id && constant(update.b, step))
+                variables.push_back({ phi.id, start, next, step });
+            else if (update.op == ir_op::ADD && update.b == phi.id && constant(update.a, step))
+                variables.push_back({ phi.id, start, next, step });
+            else if (update.op == ir_op::SUB && update.a == phi.id && constant(update.b, step))
+                variables.push_back({ phi.id, start, next, neg_wrapping(step) });
+        }
+
+        int64_t start;
+        for (induction_variable& variable: variables)
+            variable.from_zero = constant(variable.start, start) && start == 0;
+
+        struct multiplication { uint32_t id, variable, factor; };
+        std::vector<multiplication> multiplications;
+
+        for (uint32_t i = 0; i < m_function.blocks.size(); ++ i) {
+            if (!loop.body[i])
+                continue;
+
+            for (const auto& instruction: m_function.blocks[i].code) {
+                if (instruction.op != ir_op::MUL)
+                    continue;
+
+                for (uint32_t j = 0; j < variables.size(); ++ j) {
+                    if (instruction.a == variables[j].phi && !varies[instruction.b])
+                        multiplications.push_back({ instruction.id, j, instruction.b });
+                    else if (instruction.b == variables[j].phi && !varies[instruction.a])
+                        multiplications.push_back({ instruction.id, j, instruction.a });
+                    else
+                        continue;
+
+                    break;
+                }
+            }
+        }
+
+        // Code is inserted from here on, definitions are invalid, multiplication may be
+        // start of variable of inner loop, that is newer than replacements
+        grow_replacement();
+
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> reduced; // Variable and factor to new variable
+
+        for (const multiplication& product: multiplications) {
+            auto [found, inserted] = reduced.try_emplace({ product.variable, product.factor }, 0);
+            if (inserted)
+                found->second = add_variable(loop.header, preheader, from_preheader,
+                                             variables[product.variable], product.factor);
+
+            m_replacement[product.id] = found->second;
+        }
+    }
+
+    // Variable that is always /variable/ times /factor/
+    uint32_t add_variable(uint32_t header_index, uint32_t preheader, uint32_t from_preheader,
+                          const induction_variable& variable, uint32_t factor) {
+        uint32_t start = variable.start, increment = factor;
+        uint32_t phi = m_function.new_value(), next = m_function.new_value();
+
+        // Multiples of 0 and 1 are known already, other multiplications go to preheader
+        auto& entry = m_function.blocks[preheader].code;
+
+        if (!variable.from_zero) {
+            start = m_function.new_value();
+            entry.insert(entry.end() - 1, { ir_op::MUL, ir_type::INT, start, variable.start, factor });
+        }
+
+        if (variable.step != 1) {
+            ir_instruction step = { ir_op::CONSTANT, ir_type::INT, m_function.new_value() };
+            step.value = variable.step;
+
+            increment = m_function.new_value();
+            entry.insert(entry.end() - 1, { step, { ir_op::MUL, ir_type::INT, increment, step.id, factor } });
+        }
+
+        ir_block& header = m_function.blocks[header_index];
+
+        uint32_t operands[2];
+        operands[from_preheader] = start;
+        operands[1 - from_preheader] = next;
+
+        header.code.insert(header.code.begin(), { ir_op::PHI, ir_type::INT, phi, (uint32_t) header.operands.size(), 2 });
+        header.operands.insert(header.operands.end(), operands, operands + 2);
+
+        // Steps right where the original variable does, which dominates the latch
+        for (ir_block& block: m_function.blocks) {
+            auto update = std::find_if(block.code.begin(), block.code.end(), [&](const ir_instruction& instruction) {
+                return instruction.id == variable.next;
+            });
+
+            if (update != block.code.end()) {
+                block.code.insert(update + 1, { ir_op::ADD, ir_type::INT, next, phi, increment });
+                break;
+            }
+        }
+
+        return phi;
+    }
+};
+
+void optimize_loops(ir_function& function) {
+    loop_optimizer optimizer(function);
+    optimizer.optimize();
+}
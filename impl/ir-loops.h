@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ir.h"
+
+/**
+ * Loop optimizations of for and while loops, which are natural loops
+ * of SSA form: header that dominates blocks jumping back to it. Every
+ * loop first gets preheader, single block that enters it from outside.
+ *
+ * Loop-invariant code motion moves arithmetic whose operands don't
+ * change in loop to preheader, inner loops first, so that invariants
+ * of nested loops leave all loops they don't depend on. Division is
+ * moved only when divisor is known not to be zero, since loop body
+ * may never run.
+ *
+ * Strength reduction replaces i * k, where i is induction variable
+ * that loop steps by constant and k is invariant, with new induction
+ * variable that starts at start of i times k and steps by step of i
+ * times k, so multiplication in loop becomes addition.
+ */
+void optimize_loops(ir_function& function);
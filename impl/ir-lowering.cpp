@@ -0,0 +1,475 @@
+#include "ir-lowering.h"
+#include "ir-dominance.h"
+#include "program-symbols.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+class ir_lowering {
+public:
+    ir_lowering(const flat_ast& tree, ir_program& program)
+        : m_tree(tree), m_program(program), m_functions(tree) {}
+
+    void lower_program() {
+        for (const auto& symbol: m_functions.functions()) {
+            m_program.functions.emplace_back();
+            lower_function(symbol, m_program.functions.back());
+        }
+    }
+
+private:
+    const flat_ast& m_tree;
+    ir_program& m_program;
+
+    function_table m_functions;
+
+    // State of the function being lowered, variables are slots of m_scopes
+    int32_t m_function_name = 0;
+    ir_function* m_function = nullptr;
+    uint32_t m_block = 0; // Where code goes
+
+    local_scopes m_scopes;
+
+    void lower_function(const function_symbol& symbol, ir_function& function) {
+        m_function_name = symbol.name;
+        m_function = &function;
+        m_scopes = {};
+
+        function.name = std::string(m_tree.name(symbol.name));
+        function.arity = symbol.arity;
+
+        m_block = new_block();
+
+        std::span<const uint32_t> children = m_tree.children_of(symbol.node);
+
+        m_scopes.enter();
+        for (uint32_t i = 0; i < symbol.arity; ++ i) {
+            uint32_t slot = m_scopes.declare(m_tree.nodes[children[i]].value);
+            emit(ir_op::STORE_VARIABLE, ir_type::VOID, slot, emit(ir_op::PARAMETER, ir_type::INT, i));
+        }
+
+        lower_statement(children.back());
+        emit(ir_op::RETURN, ir_type::VOID, constant(0)); // Falling off the end returns 0
+
+        m_scopes.leave();
+
+        function.remove_unreachable_blocks(); // After return statements
+        construct_ssa();
+    }
+
+    uint32_t new_block() {
+        m_function->blocks.emplace_back();
+        return (uint32_t) m_function->blocks.size() - 1;
+    }
+
+    uint32_t emit(ir_op op, ir_type type, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+        uint32_t id = m_function->new_value();
+        m_function->blocks[m_block].code.push_back({ op, type, id, a, b, c });
+
+        return id;
+    }
+
+    uint32_t constant(int64_t value) {
+        uint32_t id = emit(ir_op::CONSTANT, ir_type::INT);
+        m_function->blocks[m_block].code.back().value = value;
+
+        return id;
+    }
+
+    void jump(uint32_t target) {
+        emit(ir_op::JUMP, ir_type::VOID, 0, target);
+        m_function->blocks[target].predecessors.push_back(m_block);
+    }
+
+    void branch(uint32_t condition, uint32_t if_true, uint32_t if_false) {
+        emit(ir_op::BRANCH, ir_type::VOID, condition, if_true, if_false);
+        m_function->blocks[if_true].predecessors.push_back(m_block);
+        m_function->blocks[if_false].predecessors.push_back(m_block);
+    }
+
+    uint32_t variable(int32_t name) const {
+        std::optional<uint32_t> slot = m_scopes.find(name);
+        if (!slot)
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                                                   "undefined variable " + std::string(m_tree.name(name))));
+
+        return *slot;
+    }
+
+    void store(uint32_t slot, uint32_t value) { emit(ir_op::STORE_VARIABLE, ir_type::VOID, slot, value); }
+
+    void lower_statement(uint32_t node) {
+        const flat_node& current = m_tree.nodes[node];
+        std::span<const uint32_t> children = m_tree.children_of(node);
+
+        switch (current.kind) {
+        case ast_kind::BODY:
+            m_scopes.enter();
+            for (uint32_t statement: children)
+                lower_statement(statement);
+            m_scopes.leave();
+            break;
+
+        case ast_kind::ASSIGNMENT: {
+            // Variable can't be referred to in its own initializer
+            uint32_t value = lower_expression(children[0]);
+            store(m_scopes.declare(current.value), value);
+            break;
+        }
+
+        case ast_kind::REASSIGNMENT:
+            store(variable(current.value), lower_expression(children[0]));
+            break;
+
+        case ast_kind::RETURN:
+            emit(ir_op::RETURN, ir_type::VOID, lower_expression(children[0]));
+            m_block = new_block(); // Code after return is unreachable
+            break;
+
+        case ast_kind::IF: {
+            uint32_t then = new_block(), join = new_block();
+            lower_branch(children[0], then, join);
+
+            m_block = then;
+            lower_statement(children[1]);
+            jump(join);
+
+            m_block = join;
+            break;
+        }
+
+        case ast_kind::WHILE: {
+            uint32_t header = new_block(), body = new_block(), exit = new_block();
+            jump(header);
+
+            m_block = header;
+            lower_branch(children[0], body, exit);
+
+            m_block = body;
+            lower_statement(children[1]);
+            jump(header);
+
+            m_block = exit;
+            break;
+        }
+
+        case ast_kind::FOR: {
+            // Bounds are evaluated once, before the variable comes into scope
+            m_scopes.enter();
+
+            uint32_t from = lower_expression(children[0]);
+            uint32_t to = lower_expression(children[1]);
+
+            uint32_t slot = m_scopes.declare(current.value);
+            store(slot, from);
+
+            uint32_t header = new_block(), body = new_block(), exit = new_block();
+            jump(header);
+
+            m_block = header;
+            uint32_t in_range = emit(ir_op::LESS, ir_type::BOOL, emit(ir_op::LOAD_VARIABLE, ir_type::INT, slot), to);
+            branch(in_range, body, exit);
+
+            m_block = body;
+            lower_statement(children[2]);
+
+            uint32_t next = emit(ir_op::ADD, ir_type::INT, emit(ir_op::LOAD_VARIABLE, ir_type::INT, slot), constant(1));
+            store(slot, next);
+            jump(header);
+
+            m_block = exit;
+            m_scopes.leave();
+            break;
+        }
+
+        default:
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                std::string("unexpected ") + ast_kind_name(current.kind) + " in statement position"));
+        }
+    }
+
+    void lower_branch(uint32_t node, uint32_t if_true, uint32_t if_false) {
+        const flat_node& current = m_tree.nodes[node];
+        std::span<const uint32_t> children = m_tree.children_of(node);
+
+        ir_op op;
+        switch (current.kind) {
+        case ast_kind::LESS:             op = ir_op::LESS;             break;
+        case ast_kind::LESS_OR_EQUAL:    op = ir_op::LESS_OR_EQUAL;    break;
+        case ast_kind::GREATER:          op = ir_op::GREATER;          break;
+        case ast_kind::GREATER_OR_EQUAL: op = ir_op::GREATER_OR_EQUAL; break;
+        case ast_kind::EQUALS:           op = ir_op::EQUALS;           break;
+        case ast_kind::NOT_EQUALS:       op = ir_op::NOT_EQUALS;       break;
+
+        default:
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                std::string("unexpected ") + ast_kind_name(current.kind) + " in condition"));
+        }
+
+        uint32_t lhs = lower_expression(children[0]);
+        uint32_t rhs = lower_expression(children[1]);
+
+        branch(emit(op, ir_type::BOOL, lhs, rhs), if_true, if_false);
+    }
+
+    uint32_t lower_expression(uint32_t node) {
+        const flat_node& current = m_tree.nodes[node];
+        std::span<const uint32_t> children = m_tree.children_of(node);
+
+        switch (current.kind) {
+        case ast_kind::NUMBER:
+            return constant(current.value);
+
+        case ast_kind::VAR:
+            return emit(ir_op::LOAD_VARIABLE, ir_type::INT, variable(current.value));
+
+        case ast_kind::FUNCTION_CALL: {
+            uint32_t callee = m_functions.callee(m_tree, node, m_function_name);
+
+            std::vector<uint32_t> arguments;
+            for (uint32_t child: children)
+                arguments.push_back(lower_expression(child));
+
+            ir_block& block = m_function->blocks[m_block];
+            uint32_t first = (uint32_t) block.operands.size();
+            block.operands.insert(block.operands.end(), arguments.begin(), arguments.end());
+
+            return emit(ir_op::CALL, ir_type::INT, first, (uint32_t) arguments.size(), callee);
+        }
+
+        case ast_kind::UNARY_MINUS:
+            return emit(ir_op::NEG, ir_type::INT, lower_expression(children[0]));
+
+        default:
+            break;
+        }
+
+        ir_op op;
+        switch (current.kind) {
+        case ast_kind::ADD: op = ir_op::ADD; break;
+        case ast_kind::SUB: op = ir_op::SUB; break;
+        case ast_kind::MUL: op = ir_op::MUL; break;
+        case ast_kind::DIV: op = ir_op::DIV; break;
+
+        default:
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                std::string("unexpected ") + ast_kind_name(current.kind) + " in expression"));
+        }
+
+        uint32_t lhs = lower_expression(children[0]);
+        uint32_t rhs = lower_expression(children[1]);
+
+        return emit(op, ir_type::INT, lhs, rhs);
+    }
+
+    void construct_ssa() {
+        auto& blocks = m_function->blocks;
+        dominator_tree dominators(*m_function);
+
+        uint32_t variables = m_scopes.slot_count();
+        static const uint32_t no_variable = UINT32_MAX;
+
+        // Phis go on iterated dominance frontiers of blocks that store to variable
+        std::vector<std::vector<uint32_t>> stores(variables);
+        for (uint32_t i = 0; i < blocks.size(); ++ i)
+            for (const auto& instruction: blocks[i].code)
+                if (instruction.op == ir_op::STORE_VARIABLE &&
+                    (stores[instruction.a].empty() || stores[instruction.a].back() != i))
+                    stores[instruction.a].push_back(i);
+
+        std::vector<uint32_t> phi_variable(m_function->values, no_variable); // Grows with phis
+        std::vector<uint32_t> has_phi(blocks.size(), no_variable), queued(blocks.size(), no_variable);
+
+        for (uint32_t variable = 0; variable < variables; ++ variable) {
+            std::vector<uint32_t> worklist = stores[variable];
+            for (uint32_t block: worklist)
+                queued[block] = variable;
+
+            while (!worklist.empty()) {
+                uint32_t block = worklist.back();
+                worklist.pop_back();
+
+                for (uint32_t join: dominators.frontier(block)) {
+                    if (has_phi[join] == variable)
+                        continue;
+
+                    has_phi[join] = variable;
+                    insert_phi(join, variable, phi_variable);
+
+                    if (queued[join] != variable) {
+                        queued[join] = variable;
+                        worklist.push_back(join);
+                    }
+                }
+            }
+        }
+
+        rename_variables(dominators, variables, phi_variable);
+        remove_dead_values();
+    }
+
+    void insert_phi(uint32_t block, uint32_t variable, std::vector<uint32_t>& phi_variable) {
+        ir_block& join = m_function->blocks[block];
+
+        uint32_t id = m_function->new_value();
+        uint32_t count = (uint32_t) join.predecessors.size();
+
+        join.code.insert(join.code.begin(), { ir_op::PHI, ir_type::INT, id, (uint32_t) join.operands.size(), count });
+        join.operands.resize(join.operands.size() + count);
+
+        phi_variable.resize(m_function->values, UINT32_MAX);
+        phi_variable[id] = variable;
+    }
+
+    // Walk dominator tree with the current value of every variable on top of its stack
+    void rename_variables(const dominator_tree& dominators, uint32_t variables,
+                          const std::vector<uint32_t>& phi_variable) {
+        auto& blocks = m_function->blocks;
+
+        // Variable is read before it's written only on paths where it's out of scope
+        m_block = 0;
+        uint32_t undefined = constant(0);
+        std::rotate(blocks[0].code.begin(), blocks[0].code.end() - 1, blocks[0].code.end());
+
+        std::vector<uint32_t> replacement(m_function->values);
+        for (uint32_t i = 0; i < replacement.size(); ++ i)
+            replacement[i] = i;
+
+        std::vector<std::vector<uint32_t>> current(variables);
+        auto value_of = [&](uint32_t variable) {
+            return current[variable].empty() ? undefined : current[variable].back();
+        };
+
+        struct frame {
+            uint32_t block;
+            std::vector<uint32_t> pushed; // Variables to pop when leaving block
+            bool renamed = false;
+        };
+
+        std::vector<frame> stack;
+        stack.push_back({ 0, {} });
+
+        while (!stack.empty()) {
+            frame& top = stack.back();
+
+            if (top.renamed) {
+                for (uint32_t variable: top.pushed)
+                    current[variable].pop_back();
+
+                stack.pop_back();
+                continue;
+            }
+
+            top.renamed = true;
+            uint32_t index = top.block;
+            ir_block& block = blocks[index];
+
+            std::vector<ir_instruction> code;
+            for (auto& instruction: block.code) {
+                switch (instruction.op) {
+                case ir_op::PHI:
+                    if (phi_variable[instruction.id] != UINT32_MAX) {
+                        current[phi_variable[instruction.id]].push_back(instruction.id);
+                        top.pushed.push_back(phi_variable[instruction.id]);
+                    }
+
+                    code.push_back(instruction);
+                    continue;
+
+                case ir_op::LOAD_VARIABLE:
+                    replacement[instruction.id] = value_of(instruction.a);
+                    continue;
+
+                case ir_op::STORE_VARIABLE:
+                    current[instruction.a].push_back(replacement[instruction.b]);
+                    top.pushed.push_back(instruction.a);
+                    continue;
+
+                default:
+                    for_each_operand(block, instruction, [&](uint32_t& operand) { operand = replacement[operand]; });
+                    code.push_back(instruction);
+                    continue;
+                }
+            }
+
+            block.code = std::move(code);
+
+            for (uint32_t successor: block.successors()) {
+                ir_block& target = blocks[successor];
+
+                for (uint32_t i = 0; i < target.predecessors.size(); ++ i) {
+                    if (target.predecessors[i] != index)
+                        continue;
+
+                    for (const auto& instruction: target.code) {
+                        if (instruction.op != ir_op::PHI)
+                            break;
+
+                        target.operands_of(instruction)[i] = value_of(phi_variable[instruction.id]);
+                    }
+                }
+            }
+
+            // Frame reference is invalidated by pushes
+            const std::vector<uint32_t>& children = dominators.children(index);
+            for (auto child = children.rbegin(); child != children.rend(); ++ child)
+                stack.push_back({ *child, {} });
+        }
+    }
+
+    // Phis of variables that are out of scope or never read, and constants only they used
+    void remove_dead_values() {
+        auto& blocks = m_function->blocks;
+
+        std::vector<bool> live(m_function->values);
+        std::vector<std::pair<uint32_t, uint32_t>> phis(m_function->values); // Block, index of phi
+
+        std::vector<uint32_t> worklist;
+        auto mark = [&](uint32_t value) {
+            if (!live[value]) {
+                live[value] = true;
+                worklist.push_back(value);
+            }
+        };
+
+        for (uint32_t i = 0; i < blocks.size(); ++ i)
+            for (uint32_t j = 0; j < blocks[i].code.size(); ++ j) {
+                ir_instruction& instruction = blocks[i].code[j];
+
+                if (instruction.op == ir_op::PHI)
+                    phis[instruction.id] = { i, j };
+                else
+                    for_each_operand(blocks[i], instruction, mark);
+            }
+
+        while (!worklist.empty()) {
+            uint32_t value = worklist.back();
+            worklist.pop_back();
+
+            auto [block, index] = phis[value];
+            ir_instruction& phi = blocks[block].code[index];
+
+            if (phi.op == ir_op::PHI && phi.id == value)
+                for_each_operand(blocks[block], phi, mark);
+        }
+
+        for (ir_block& block: blocks) {
+            std::erase_if(block.code, [&](const ir_instruction& instruction) {
+                return (instruction.op == ir_op::PHI || instruction.op == ir_op::CONSTANT) && !live[instruction.id];
+            });
+
+            block.compact_operands();
+        }
+    }
+};
+
+ir_program lower_to_ir(const flat_ast& tree) {
+    ir_program program;
+
+    ir_lowering lowering(tree, program);
+    lowering.lower_program();
+
+    return program;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "flat-ast.h"
+#include "ir.h"
+
+/**
+ * Translate syntax tree to SSA form. Variables are first lowered to
+ * loads and stores, then phis are placed on iterated dominance
+ * frontiers of blocks that store to a variable, and loads are renamed
+ * to the values that reach them (Cytron et al.). Phis nothing uses
+ * are removed.
+ *
+ * Throws std::runtime_error if program refers to undefined names.
+ */
+ir_program lower_to_ir(const flat_ast& tree);
@@ -0,0 +1,37 @@
+#include "ir-optimizer.h"
+#include "ir-loops.h"
+#include "ir-sccp.h"
+#include "ir-tail-calls.h"
+
+static void verify_pass(const ir_program& program) {
+#ifndef NDEBUG
+    program.verify();
+#else
+    (void) program;
+#endif
+}
+
+static void run_pass(ir_program& program, void (*pass)(ir_function&)) {
+    for (auto& function: program.functions)
+        pass(function);
+
+    verify_pass(program);
+}
+
+void optimize_ir(ir_program& program, const ir_optimizer_options& options) {
+    // Callees are folded before their sizes are judged, and callers after they see through calls
+    run_pass(program, propagate_constants);
+
+    // Function that only recursed in tail position is no longer recursive and can be inlined
+    eliminate_tail_recursion(program);
+    verify_pass(program);
+
+    inline_functions(program, options.inlining);
+    verify_pass(program);
+
+    run_pass(program, propagate_constants);
+
+    // Constant propagation folds starts and steps of new induction variables
+    run_pass(program, optimize_loops);
+    run_pass(program, propagate_constants);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ir.h"
+#include "ir-inliner.h"
+
+struct ir_optimizer_options {
+    ir_inliner_options inlining;
+};
+
+/**
+ * Passes of -O1 over SSA form, run between lowering and register
+ * bytecode generation. Debug builds verify IR after every pass, so
+ * that a broken pass is caught where it breaks it.
+ */
+void optimize_ir(ir_program& program, const ir_optimizer_options& options = {});
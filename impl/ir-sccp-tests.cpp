@@ -0,0 +1,151 @@
+#include "ir-sccp.h"
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <string>
+
+// main() of program as it's lowered, with constants propagated through it and nothing else
+static ir_function propagated(const std::string& source) {
+    ir_program program = lower_program(source);
+    propagate_constants(program.functions[0]);
+    program.verify();
+
+    return program.functions[0];
+}
+
+static int count(const ir_function& function, ir_op op) {
+    int count = 0;
+    for (const auto& block: function.blocks)
+        for (const auto& instruction: block.code)
+            count += instruction.op == op;
+
+    return count;
+}
+
+// Value function returns, when it has one return of constant
+static std::string returned(const ir_function& function) {
+    if (count(function, ir_op::RETURN) != 1)
+        return "more returns";
+
+    uint32_t value = 0;
+    for (const auto& block: function.blocks)
+        if (block.terminator().op == ir_op::RETURN)
+            value = block.terminator().a;
+
+    for (const auto& block: function.blocks)
+        for (const auto& instruction: block.code)
+            if (instruction.id == value && instruction.op == ir_op::CONSTANT)
+                return std::to_string(instruction.value);
+
+    return "not constant";
+}
+
+TEST(constant_branches_become_jumps) {
+    ir_function function = propagated("defun main() {\n"
+                                      "    let x = 2\n"
+                                      "    if (x * 3 < 5) {\n"
+                                      "        return 1;\n"
+                                      "    }\n"
+                                      "    return x + 40;\n"
+                                      "}\n");
+
+    ASSERT_EQUAL(count(function, ir_op::BRANCH), 0);
+    ASSERT_EQUAL(count(function, ir_op::LESS), 0);
+    ASSERT_STRING_EQUAL(returned(function), std::string("42"));
+
+    // Branch on parameter stays
+    ir_program program = lower_program("defun f(a) {\n"
+                                       "    if (a < 5) {\n"
+                                       "        return 1;\n"
+                                       "    }\n"
+                                       "    return 2;\n"
+                                       "}\n");
+    propagate_constants(program.functions[0]);
+
+    ASSERT_EQUAL(count(program.functions[0], ir_op::BRANCH), 1);
+}
+
+TEST(loops_that_never_run_are_removed) {
+    ir_function function = propagated("defun main() {\n"
+                                      "    let x = 3\n"
+                                      "    for (i in 5..5) {\n"
+                                      "        x = x + i\n"
+                                      "    }\n"
+                                      "    return x;\n"
+                                      "}\n");
+
+    ASSERT_EQUAL((int) function.blocks.size(), 1);
+    ASSERT_EQUAL(count(function, ir_op::PHI), 0);
+    ASSERT_STRING_EQUAL(returned(function), std::string("3"));
+}
+
+// Division by constant zero isn't folded, it has to fail when and if it runs
+TEST(division_by_zero_is_left_to_trap) {
+    std::string source = "defun main() {\n"
+                         "    let zero = 0\n"
+                         "    return 7 / zero;\n"
+                         "}\n";
+
+    ir_function function = propagated(source);
+    ASSERT_EQUAL(count(function, ir_op::DIV), 1);
+    ASSERT_STRING_EQUAL(returned(function), std::string("not constant"));
+
+    ASSERT_STRING_EQUAL(run_source(source, 1), std::string("error: division by zero in function main"));
+
+    // Division that's never reached is just removed with its block
+    ir_function unreached = propagated("defun main() {\n"
+                                       "    let zero = 0\n"
+                                       "    if (zero > 0) {\n"
+                                       "        return 7 / zero;\n"
+                                       "    }\n"
+                                       "    return 1;\n"
+                                       "}\n");
+
+    ASSERT_EQUAL(count(unreached, ir_op::DIV), 0);
+    ASSERT_STRING_EQUAL(returned(unreached), std::string("1"));
+
+    // Wrapping division is folded like VMs compute it
+    ir_function wrapping = propagated("defun main() {\n"
+                                      "    let min = 1073741824 * 1073741824 * 8\n"
+                                      "    return min / (0 - 1);\n"
+                                      "}\n");
+
+    ASSERT_STRING_EQUAL(returned(wrapping), std::string("-9223372036854775808"));
+}
+
+// Phi is constant when the only edges that can reach it bring the same constant
+TEST(phis_with_one_feasible_input_are_folded) {
+    ir_function function = propagated("defun main() {\n"
+                                      "    let x = 1\n"
+                                      "    let y = 5\n"
+                                      "    if (x > 3) {\n"
+                                      "        y = 7\n"
+                                      "    }\n"
+                                      "    return y;\n"
+                                      "}\n");
+
+    ASSERT_EQUAL(count(function, ir_op::PHI), 0);
+    ASSERT_STRING_EQUAL(returned(function), std::string("5"));
+
+    // Around loop too: y only ever gets its own value back
+    ir_program program = lower_program("defun f(n) {\n"
+                                       "    let y = 3\n"
+                                       "    let i = 0\n"
+                                       "    while (i < n) {\n"
+                                       "        if (y != 3) {\n"
+                                       "            y = i\n"
+                                       "        }\n"
+                                       "        i = i + 1\n"
+                                       "    }\n"
+                                       "    return y;\n"
+                                       "}\n");
+    propagate_constants(program.functions[0]);
+    program.verify();
+
+    ASSERT_EQUAL(count(program.functions[0], ir_op::PHI), 1); // Counter i
+    ASSERT_STRING_EQUAL(returned(program.functions[0]), std::string("3"));
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
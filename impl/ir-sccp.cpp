@@ -0,0 +1,271 @@
+#include "ir-sccp.h"
+#include "vm-arithmetic.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Point of the lattice: not known yet, one constant, or varies at run time
+struct lattice_value {
+    enum kind_type: uint8_t { UNKNOWN, CONSTANT, VARYING };
+
+    kind_type kind = UNKNOWN;
+    int64_t constant = 0;
+
+    bool operator==(const lattice_value& other) const {
+        return kind == other.kind && (kind != CONSTANT || constant == other.constant);
+    }
+};
+
+static lattice_value meet(lattice_value lhs, lattice_value rhs) {
+    if (lhs.kind == lattice_value::UNKNOWN)
+        return rhs;
+
+    if (rhs.kind == lattice_value::UNKNOWN || lhs == rhs)
+        return lhs;
+
+    return { lattice_value::VARYING };
+}
+
+class constant_propagation {
+public:
+    explicit constant_propagation(ir_function& function)
+        : m_function(function), m_values(function.values), m_users(function.values),
+          m_reachable(function.blocks.size()), m_taken(function.blocks.size()) {
+
+        for (uint32_t i = 0; i < function.blocks.size(); ++ i) {
+            const ir_block& block = function.blocks[i];
+            m_taken[i].resize(block.predecessors.size());
+
+            for (uint32_t j = 0; j < block.code.size(); ++ j)
+                for_each_operand(block, block.code[j], [&](uint32_t operand) {
+                    m_users[operand].push_back({ i, j });
+                });
+        }
+    }
+
+    void analyze() {
+        reach(0);
+
+        while (!m_edges.empty() || !m_changed.empty()) {
+            if (!m_edges.empty()) {
+                auto [from, to] = m_edges.back();
+                m_edges.pop_back();
+
+                take_edge(from, to);
+                continue;
+            }
+
+            uint32_t value = m_changed.back();
+            m_changed.pop_back();
+
+            for (auto [block, index]: m_users[value])
+                if (m_reachable[block])
+                    visit(block, index);
+        }
+    }
+
+    void rewrite() {
+        auto& blocks = m_function.blocks;
+
+        for (uint32_t i = 0; i < blocks.size(); ++ i) {
+            ir_instruction& last = blocks[i].code.back();
+            if (!m_reachable[i] || last.op != ir_op::BRANCH || m_values[last.a].kind != lattice_value::CONSTANT)
+                continue;
+
+            uint32_t taken = m_values[last.a].constant != 0 ? last.b : last.c;
+            uint32_t skipped = taken == last.b ? last.c : last.b;
+
+            last = { ir_op::JUMP, ir_type::VOID, last.id, 0, taken };
+
+            ir_block& target = blocks[skipped];
+            auto edge = std::find(target.predecessors.begin(), target.predecessors.end(), i);
+            target.remove_predecessor((uint32_t) (edge - target.predecessors.begin()));
+        }
+
+        // Constants go to the start of entry, which dominates every use, one per number
+        std::vector<ir_instruction> constants;
+        std::unordered_map<int64_t, uint32_t> constant_ids;
+
+        std::vector<uint32_t> replacement(m_function.values);
+        for (uint32_t i = 0; i < replacement.size(); ++ i)
+            replacement[i] = i;
+
+        for (uint32_t i = 0; i < blocks.size(); ++ i) {
+            if (!m_reachable[i])
+                continue;
+
+            for (const auto& instruction: blocks[i].code) {
+                const lattice_value& value = m_values[instruction.id];
+                if (instruction.type != ir_type::INT || value.kind != lattice_value::CONSTANT)
+                    continue;
+
+                auto [found, inserted] = constant_ids.try_emplace(value.constant, 0);
+                if (inserted) {
+                    found->second = m_function.new_value();
+                    constants.push_back({ ir_op::CONSTANT, ir_type::INT, found->second });
+                    constants.back().value = value.constant;
+                }
+
+                replacement[instruction.id] = found->second;
+            }
+        }
+
+        ir_block& entry = blocks[0];
+        entry.code.insert(entry.code.begin(), constants.begin(), constants.end());
+
+        replacement.resize(m_function.values);
+        for (uint32_t i = (uint32_t) (replacement.size() - constants.size()); i < replacement.size(); ++ i)
+            replacement[i] = i;
+
+        m_function.replace_values(replacement);
+
+        m_function.remove_unreachable_blocks();
+        m_function.remove_dead_code();
+        m_function.simplify_control_flow();
+    }
+
+private:
+    ir_function& m_function;
+
+    struct location { uint32_t block, index; };
+
+    std::vector<lattice_value> m_values;
+    std::vector<std::vector<location>> m_users;
+
+    std::vector<bool> m_reachable;
+    std::vector<std::vector<bool>> m_taken; // Of every block, for every predecessor
+
+    std::vector<std::pair<uint32_t, uint32_t>> m_edges; // From, to, that became reachable
+    std::vector<uint32_t> m_changed;                    // Values whose users have to be revisited
+
+    void reach(uint32_t block) {
+        m_reachable[block] = true;
+
+        for (uint32_t i = 0; i < m_function.blocks[block].code.size(); ++ i)
+            visit(block, i);
+    }
+
+    void take_edge(uint32_t from, uint32_t to) {
+        const ir_block& target = m_function.blocks[to];
+
+        bool taken = false;
+        for (uint32_t i = 0; i < target.predecessors.size(); ++ i)
+            if (target.predecessors[i] == from && !m_taken[to][i])
+                m_taken[to][i] = taken = true;
+
+        if (!taken)
+            return;
+
+        if (!m_reachable[to]) {
+            reach(to);
+            return;
+        }
+
+        // Only phis depend on which edges are taken
+        for (uint32_t i = 0; i < target.code.size() && target.code[i].op == ir_op::PHI; ++ i)
+            visit(to, i);
+    }
+
+    void update(uint32_t value, lattice_value result) {
+        if (!(m_values[value] == result)) {
+            m_values[value] = result;
+            m_changed.push_back(value);
+        }
+    }
+
+    void visit(uint32_t block_index, uint32_t index) {
+        const ir_block& block = m_function.blocks[block_index];
+        const ir_instruction& instruction = block.code[index];
+
+        switch (instruction.op) {
+        case ir_op::CONSTANT:
+            update(instruction.id, { lattice_value::CONSTANT, instruction.value });
+            return;
+
+        case ir_op::PHI: {
+            lattice_value result;
+            for (uint32_t i = 0; i < instruction.b; ++ i)
+                if (m_taken[block_index][i])
+                    result = meet(result, m_values[block.operands_of(instruction)[i]]);
+
+            update(instruction.id, result);
+            return;
+        }
+
+        case ir_op::JUMP:
+            m_edges.push_back({ block_index, instruction.b });
+            return;
+
+        case ir_op::BRANCH: {
+            const lattice_value& condition = m_values[instruction.a];
+
+            if (condition.kind == lattice_value::UNKNOWN)
+                return;
+
+            if (condition.kind == lattice_value::VARYING || condition.constant != 0)
+                m_edges.push_back({ block_index, instruction.b });
+
+            if (condition.kind == lattice_value::VARYING || condition.constant == 0)
+                m_edges.push_back({ block_index, instruction.c });
+
+            return;
+        }
+
+        case ir_op::RETURN:
+            return;
+
+        case ir_op::PARAMETER: case ir_op::CALL:
+            update(instruction.id, { lattice_value::VARYING });
+            return;
+
+        default:
+            update(instruction.id, evaluate(instruction));
+            return;
+        }
+    }
+
+    lattice_value evaluate(const ir_instruction& instruction) const {
+        lattice_value lhs = m_values[instruction.a];
+        lattice_value rhs = instruction.op == ir_op::NEG ? lhs : m_values[instruction.b];
+
+        if (lhs.kind == lattice_value::VARYING || rhs.kind == lattice_value::VARYING)
+            return { lattice_value::VARYING };
+
+        if (lhs.kind == lattice_value::UNKNOWN || rhs.kind == lattice_value::UNKNOWN)
+            return {};
+
+        int64_t a = lhs.constant, b = rhs.constant;
+
+        switch (instruction.op) {
+        case ir_op::ADD: return { lattice_value::CONSTANT, add_wrapping(a, b) };
+        case ir_op::SUB: return { lattice_value::CONSTANT, sub_wrapping(a, b) };
+        case ir_op::MUL: return { lattice_value::CONSTANT, mul_wrapping(a, b) };
+        case ir_op::NEG: return { lattice_value::CONSTANT, neg_wrapping(a) };
+
+        case ir_op::DIV:
+            if (b == 0) // Traps at run time, with the error of the function it's in
+                return { lattice_value::VARYING };
+
+            return { lattice_value::CONSTANT, div_wrapping(a, b) };
+
+        case ir_op::LESS:             return { lattice_value::CONSTANT, a < b };
+        case ir_op::LESS_OR_EQUAL:    return { lattice_value::CONSTANT, a <= b };
+        case ir_op::GREATER:          return { lattice_value::CONSTANT, a > b };
+        case ir_op::GREATER_OR_EQUAL: return { lattice_value::CONSTANT, a >= b };
+        case ir_op::EQUALS:           return { lattice_value::CONSTANT, a == b };
+        case ir_op::NOT_EQUALS:       return { lattice_value::CONSTANT, a != b };
+
+        default:
+            return { lattice_value::VARYING };
+        }
+    }
+};
+
+void propagate_constants(ir_function& function) {
+    constant_propagation propagation(function);
+
+    propagation.analyze();
+    propagation.rewrite();
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ir.h"
+
+/**
+ * Sparse conditional constant propagation (Wegman and Zadeck). Values
+ * are assumed to be constant until shown otherwise, and blocks to be
+ * unreachable until a branch that can go to them is reached, so
+ * constants flow around loops, and branches that are never taken
+ * don't make phis vary.
+ *
+ * Values that turn out to be constant are folded, branches on constant
+ * comparisons become jumps, blocks nothing reaches any more are
+ * removed, together with loops that never run, like for (i in 5..5).
+ */
+void propagate_constants(ir_function& function);
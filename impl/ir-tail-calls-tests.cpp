@@ -0,0 +1,91 @@
+#include "ir-tail-calls.h"
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <string>
+
+static int calls(const ir_program& program, const std::string& function) {
+    int count = 0;
+    for (const auto& block: program.find(function)->blocks)
+        for (const auto& instruction: block.code)
+            count += instruction.op == ir_op::CALL;
+
+    return count;
+}
+
+static const std::string counting =
+    "defun count(n, total) {\n"
+    "    if (n == 0) {\n"
+    "        return total;\n"
+    "    }\n"
+    "    return count(n - 1, total + 2);\n"
+    "}\n";
+
+static const std::string parity =
+    "defun is_even(n) {\n"
+    "    if (n == 0) {\n"
+    "        return 1;\n"
+    "    }\n"
+    "    return is_odd(n - 1);\n"
+    "}\n"
+    "defun is_odd(n) {\n"
+    "    if (n == 0) {\n"
+    "        return 0;\n"
+    "    }\n"
+    "    return is_even(n - 1);\n"
+    "}\n";
+
+static const std::string building =
+    "defun depth(n) {\n"
+    "    if (n == 0) {\n"
+    "        return 0;\n"
+    "    }\n"
+    "    return 1 + depth(n - 1);\n"
+    "}\n";
+
+TEST(self_tail_calls_become_loops) {
+    ir_program program = lower_program(counting);
+    ASSERT_EQUAL(calls(program, "count"), 1);
+
+    eliminate_tail_recursion(program);
+    program.verify();
+    ASSERT_EQUAL(calls(program, "count"), 0);
+
+    // Call whose value is used afterwards stays
+    ir_program not_tail = lower_program(building);
+    eliminate_tail_recursion(not_tail);
+    ASSERT_EQUAL(calls(not_tail, "depth"), 1);
+}
+
+// 10 million frames are far more than any stack holds
+TEST(deep_tail_recursion_runs_in_constant_stack) {
+    struct deep { std::string source, expected; };
+
+    // Self tail calls are loops, tail calls of other functions reuse the frame of caller
+    for (const auto& [source, expected]: { deep { counting + "defun main() { return count(10000000, 1); }\n", "20000001" },
+                                           deep { parity + "defun main() { return is_even(10000000) * 10 + is_odd(9999999); }\n", "11" } }) {
+        register_program program = compile_program(source, 1);
+
+        ASSERT_STRING_EQUAL(run_main(program), expected);
+        ASSERT_STRING_EQUAL(run_main_jit(program, 0), expected);
+        ASSERT_STRING_EQUAL(run_main_jit(program, 1000), expected);
+    }
+}
+
+TEST(calls_not_in_tail_position_still_overflow) {
+    std::string source = building + "defun main() { return depth(10000000); }\n";
+    std::string overflow = "error: stack overflow in function depth";
+
+    for (int optimize: { 0, 1 }) {
+        register_program program = compile_program(source, optimize);
+
+        ASSERT_STRING_EQUAL(run_main(program), overflow);
+        ASSERT_STRING_EQUAL(run_main_jit(program, 0), overflow);
+    }
+
+    ASSERT_STRING_EQUAL(run_source(building + "defun main() { return depth(1000); }\n", 1), std::string("1000"));
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
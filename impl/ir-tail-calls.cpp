@@ -0,0 +1,117 @@
+#include "ir-tail-calls.h"
+
+#include <algorithm>
+#include <vector>
+
+static bool is_tail_call(const ir_block& block, uint32_t function) {
+    if (block.code.size() < 2)
+        return false;
+
+    const ir_instruction& call = block.code[block.code.size() - 2];
+    const ir_instruction& returned = block.code.back();
+
+    return call.op == ir_op::CALL && call.c == function &&
+           returned.op == ir_op::RETURN && returned.a == call.id;
+}
+
+// Entry keeps parameters and constants and jumps to the rest of itself in a new block,
+// the loop header, which tail calls jump to with their arguments as new parameters
+static void eliminate_tail_recursion(ir_function& function, uint32_t index) {
+    auto& blocks = function.blocks;
+
+    // Nothing can jump to entry ahead of parameters, lowering never makes it a loop
+    if (!blocks[0].predecessors.empty())
+        return;
+
+    if (std::none_of(blocks.begin(), blocks.end(), [&](const ir_block& block) { return is_tail_call(block, index); }))
+        return;
+
+    uint32_t header_index = (uint32_t) blocks.size();
+    blocks.emplace_back();
+
+    ir_block& entry = blocks[0];
+    ir_block& header = blocks[header_index];
+
+    auto first = std::find_if(entry.code.begin(), entry.code.end(), [](const ir_instruction& instruction) {
+        return instruction.op != ir_op::PARAMETER && instruction.op != ir_op::CONSTANT;
+    });
+
+    header.code.assign(first, entry.code.end());
+    header.operands = entry.operands;
+    header.compact_operands();
+
+    entry.code.erase(first, entry.code.end());
+    entry.code.push_back({ ir_op::JUMP, ir_type::VOID, function.new_value(), 0, header_index });
+    entry.compact_operands();
+
+    for (uint32_t successor: header.successors()) {
+        auto& predecessors = blocks[successor].predecessors;
+        std::replace(predecessors.begin(), predecessors.end(), 0u, header_index);
+    }
+
+    header.predecessors = { 0 };
+
+    // Parameters that were unused are gone, but phis need them as values on entry
+    static const uint32_t none = UINT32_MAX;
+    std::vector<uint32_t> parameters(function.arity, none);
+    for (const auto& instruction: blocks[0].code)
+        if (instruction.op == ir_op::PARAMETER)
+            parameters[instruction.a] = instruction.id;
+
+    for (uint32_t i = 0; i < function.arity; ++ i)
+        if (parameters[i] == none) {
+            parameters[i] = function.new_value();
+            blocks[0].code.insert(blocks[0].code.begin(), { ir_op::PARAMETER, ir_type::INT, parameters[i], i });
+        }
+
+    std::vector<uint32_t> phis(function.arity);
+    for (uint32_t& phi: phis)
+        phi = function.new_value();
+
+    std::vector<uint32_t> replacement(function.values);
+    for (uint32_t i = 0; i < function.values; ++ i)
+        replacement[i] = i;
+
+    for (uint32_t i = 0; i < function.arity; ++ i)
+        replacement[parameters[i]] = phis[i];
+
+    function.replace_values(replacement);
+
+    // Arguments of every tail call, in order of header's predecessors
+    std::vector<std::vector<uint32_t>> arguments(function.arity);
+
+    for (uint32_t i = 0; i < blocks.size(); ++ i) {
+        ir_block& block = blocks[i];
+        if (!is_tail_call(block, index))
+            continue;
+
+        const ir_instruction& call = block.code[block.code.size() - 2];
+        for (uint32_t j = 0; j < function.arity; ++ j)
+            arguments[j].push_back(block.operands_of(call)[j]);
+
+        uint32_t jump = block.code.back().id;
+        block.code.resize(block.code.size() - 2);
+        block.code.push_back({ ir_op::JUMP, ir_type::VOID, jump, 0, header_index });
+        block.compact_operands();
+
+        blocks[header_index].predecessors.push_back(i);
+    }
+
+    ir_block& loop = blocks[header_index];
+    std::vector<ir_instruction> phi_code;
+
+    for (uint32_t i = 0; i < function.arity; ++ i) {
+        phi_code.push_back({ ir_op::PHI, ir_type::INT, phis[i], (uint32_t) loop.operands.size(),
+                             (uint32_t) loop.predecessors.size() });
+
+        loop.operands.push_back(parameters[i]);
+        loop.operands.insert(loop.operands.end(), arguments[i].begin(), arguments[i].end());
+    }
+
+    loop.code.insert(loop.code.begin(), phi_code.begin(), phi_code.end());
+}
+
+void eliminate_tail_recursion(ir_program& program) {
+    for (uint32_t i = 0; i < program.functions.size(); ++ i)
+        eliminate_tail_recursion(program.functions[i], i);
+}
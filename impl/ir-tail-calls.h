@@ -0,0 +1,14 @@
+#pragma once
+
+#include "ir.h"
+
+/**
+ * Turn calls that function makes to itself and returns the value of
+ * right away into jumps back to its start, where phis take the place
+ * of parameters, so tail recursion runs as loop, in constant stack
+ * and at speed of loop, and loop optimizations see it as one.
+ *
+ * Tail calls of other functions stay calls here, but IR code generator
+ * emits them as tail calls of bytecode, which reuse frame of caller.
+ */
+void eliminate_tail_recursion(ir_program& program);
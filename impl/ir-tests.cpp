@@ -0,0 +1,234 @@
+#include "ir-dominance.h"
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static std::string dump(const ir_program& program) {
+    std::stringstream dump;
+    program.dump(dump);
+    return dump.str();
+}
+
+static uint32_t phis(const ir_block& block) {
+    uint32_t count = 0;
+    for (const auto& instruction: block.code)
+        count += instruction.op == ir_op::PHI;
+
+    return count;
+}
+
+static const std::string partial_sum =
+    "defun main() {\n"
+    "    let x = 1\n"
+    "    let s = 0\n"
+    "    while (x < 10) {\n"
+    "        if (x < 5) {\n"
+    "            s = s + x\n"
+    "        }\n"
+    "        x = x + 1\n"
+    "    }\n"
+    "    return s;\n"
+    "}\n";
+
+TEST(lowering_dump) {
+    ASSERT_STRING_EQUAL(dump(lower_program(partial_sum)), std::string(
+        "function main(0 parameters)\n"
+        "b0:\n"
+        "  %0: int = constant 1\n"
+        "  %2: int = constant 0\n"
+        "  jump b1\n"
+        "b1: ; predecessors b0, b5\n"
+        "  %29: int = phi [%2, b0], [%28, b5]\n"
+        "  %27: int = phi [%0, b0], [%20, b5]\n"
+        "  %6: int = constant 10\n"
+        "  %7: bool = less %27, %6\n"
+        "  branch %7, b2, b3\n"
+        "b2: ; predecessors b1\n"
+        "  %10: int = constant 5\n"
+        "  %11: bool = less %27, %10\n"
+        "  branch %11, b4, b5\n"
+        "b3: ; predecessors b1\n"
+        "  return %29\n"
+        "b4: ; predecessors b2\n"
+        "  %15: int = add %29, %27\n"
+        "  jump b5\n"
+        "b5: ; predecessors b2, b4\n"
+        "  %28: int = phi [%29, b2], [%15, b4]\n"
+        "  %19: int = constant 1\n"
+        "  %20: int = add %27, %19\n"
+        "  jump b1\n"
+        "\n"));
+}
+
+// Phis are only where values of a variable meet, and only for variables that are used there
+TEST(phis_are_at_join_points) {
+    ir_function function = lower_program(partial_sum).functions[0];
+
+    ASSERT_EQUAL((int) function.blocks.size(), 6);
+    ASSERT_EQUAL((int) phis(function.blocks[1]), 2); // Loop header: x and s
+    ASSERT_EQUAL((int) phis(function.blocks[5]), 1); // After if: s only
+    ASSERT_EQUAL((int) (phis(function.blocks[0]) + phis(function.blocks[2]) + phis(function.blocks[3]) + phis(function.blocks[4])), 0);
+
+    // Variable that is never read after the loop needs no phi after it
+    ir_function unused = lower_program("defun main() {\n"
+                                       "    let y = 0\n"
+                                       "    for (i in 0..3) {\n"
+                                       "        y = i\n"
+                                       "    }\n"
+                                       "    return 1;\n"
+                                       "}\n").functions[0];
+
+    uint32_t all_phis = 0;
+    for (const auto& block: unused.blocks)
+        all_phis += phis(block);
+
+    ASSERT_EQUAL((int) all_phis, 1); // Counter i
+}
+
+TEST(loop_header_dominates_loop) {
+    ir_function function = lower_program(partial_sum).functions[0];
+    dominator_tree tree(function);
+
+    ASSERT_EQUAL((int) tree.immediate_dominator(0), 0);
+    ASSERT_EQUAL((int) tree.immediate_dominator(1), 0);
+    ASSERT_EQUAL((int) tree.immediate_dominator(2), 1);
+    ASSERT_EQUAL((int) tree.immediate_dominator(3), 1);
+    ASSERT_EQUAL((int) tree.immediate_dominator(4), 2);
+    ASSERT_EQUAL((int) tree.immediate_dominator(5), 2);
+
+    for (uint32_t block: { 2, 4, 5 })
+        ASSERT_EQUAL(tree.dominates(1, block), true);
+
+    // Back edge doesn't make body dominate the header
+    ASSERT_EQUAL(tree.dominates(5, 1), false);
+    ASSERT_EQUAL(tree.dominates(4, 5), false);
+
+    ASSERT_EQUAL(tree.frontier(4) == std::vector<uint32_t>({ 5 }), true);
+    ASSERT_EQUAL(tree.frontier(5) == std::vector<uint32_t>({ 1 }), true);
+    ASSERT_EQUAL(tree.frontier(2) == std::vector<uint32_t>({ 1 }), true);
+}
+
+TEST(code_after_return_is_unreachable) {
+    ir_function function = lower_program("defun main() {\n"
+                                         "    return 1;\n"
+                                         "    return 2;\n"
+                                         "}\n").functions[0];
+    function.remove_unreachable_blocks();
+
+    ASSERT_EQUAL((int) function.blocks.size(), 1);
+    ASSERT_EQUAL(function.blocks[0].terminator().op == ir_op::RETURN, true);
+}
+
+TEST(verify_finds_broken_phis) {
+    ir_program program = lower_program(partial_sum);
+    ir_block& header = program.functions[0].blocks[1];
+    header.predecessors.push_back(3);
+
+    bool thrown = false;
+    try {
+        program.verify();
+    } catch (const std::logic_error&) {
+        thrown = true;
+    }
+
+    ASSERT_EQUAL(thrown, true);
+}
+
+static std::string run_optimized(const std::string& source, int optimize) {
+    try {
+        return run_source(source, optimize);
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+}
+
+static const std::vector<std::string> programs = {
+    partial_sum,
+
+    "defun main() {\n"
+    "    let sum = 0\n"
+    "    for (i in 1..20) {\n"
+    "        for (j in 0..i) {\n"
+    "            if (j < i / 2) {\n"
+    "                sum = sum + j * i\n"
+    "            }\n"
+    "            if (j == 3) {\n"
+    "                sum = sum - 100\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    "    return sum;\n"
+    "}\n",
+
+    "defun fib(n) {\n"
+    "    if (n < 2) {\n"
+    "        return n;\n"
+    "    }\n"
+    "    return fib(n - 1) + fib(n - 2);\n"
+    "}\n"
+    "defun main() { return fib(20); }\n",
+
+    "defun gcd(a, b) {\n"
+    "    while (b != 0) {\n"
+    "        let t = a - (a / b) * b\n"
+    "        a = b\n"
+    "        b = t\n"
+    "    }\n"
+    "    return a;\n"
+    "}\n"
+    "defun main() { return gcd(1071, 462) * 1000 + gcd(17, 5); }\n",
+
+    // Swap through phis, values of a and b have to be read before either is written
+    "defun main() {\n"
+    "    let a = 1\n"
+    "    let b = 2\n"
+    "    for (i in 0..5) {\n"
+    "        let t = a\n"
+    "        a = b\n"
+    "        b = t\n"
+    "    }\n"
+    "    return a * 10 + b;\n"
+    "}\n",
+
+    "defun main() {\n"
+    "    let x = 5\n"
+    "    if (x < 3) {\n"
+    "        return 1;\n"
+    "    }\n"
+    "    if (x >= 5) {\n"
+    "        x = x * 2\n"
+    "    }\n"
+    "    return x;\n"
+    "}\n",
+
+    "defun main() { return 1000000 * 1000000 * 1000000 * 10; }",
+    "defun main() { return ((0 - 7) / 2) * 1000 + 7 / (0 - 2); }",
+    "defun main() {\n"
+    "    let min = 1073741824 * 1073741824 * 8\n"
+    "    return min / (0 - 1) + (min - 1);\n"
+    "}\n",
+
+    "defun f(n) { return 1 + f(n + 1); }\ndefun main() { return f(0); }",
+    "defun f(a) { return 5 / a; }\ndefun main() { return f(0); }",
+    "defun main() {\n"
+    "    let zero = 0\n"
+    "    return 1 / zero;\n"
+    "}\n"
+};
+
+TEST(results_are_the_same_at_o0_and_o1) {
+    for (const auto& source: programs)
+        ASSERT_STRING_EQUAL(run_optimized(source, 1), run_optimized(source, 0));
+
+    ASSERT_STRING_EQUAL(run_optimized(programs[3], 1), std::string("21001"));
+    ASSERT_STRING_EQUAL(run_optimized(programs[4], 1), std::string("21"));
+    ASSERT_STRING_EQUAL(run_optimized(programs[11], 1), std::string("error: division by zero in function main"));
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,476 @@
+#include "ir.h"
+#include "ir-dominance.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+const char* ir_type_name(ir_type type) {
+    switch (type) {
+    case ir_type::VOID: return "void";
+    case ir_type::BOOL: return "bool";
+    case ir_type::INT:  return "int";
+    }
+
+    return "?";
+}
+
+const char* ir_op_name(ir_op op) {
+    switch (op) {
+    case ir_op::CONSTANT:         return "constant";
+    case ir_op::PARAMETER:        return "parameter";
+    case ir_op::PHI:              return "phi";
+    case ir_op::ADD:              return "add";
+    case ir_op::SUB:              return "sub";
+    case ir_op::MUL:              return "mul";
+    case ir_op::DIV:              return "div";
+    case ir_op::NEG:              return "neg";
+    case ir_op::LESS:             return "less";
+    case ir_op::LESS_OR_EQUAL:    return "less_or_equal";
+    case ir_op::GREATER:          return "greater";
+    case ir_op::GREATER_OR_EQUAL: return "greater_or_equal";
+    case ir_op::EQUALS:           return "equals";
+    case ir_op::NOT_EQUALS:       return "not_equals";
+    case ir_op::CALL:             return "call";
+    case ir_op::LOAD_VARIABLE:    return "load_variable";
+    case ir_op::STORE_VARIABLE:   return "store_variable";
+    case ir_op::JUMP:             return "jump";
+    case ir_op::BRANCH:           return "branch";
+    case ir_op::RETURN:           return "return";
+    }
+
+    return "?";
+}
+
+bool is_comparison(ir_op op) { return op >= ir_op::LESS && op <= ir_op::NOT_EQUALS; }
+bool is_terminator(ir_op op) { return op >= ir_op::JUMP; }
+
+ir_successors ir_block::successors() const {
+    const ir_instruction& last = terminator();
+
+    switch (last.op) {
+    case ir_op::JUMP:   return { { last.b, 0 }, 1 };
+    case ir_op::BRANCH: return { { last.b, last.c }, 2 };
+    default:            return { { 0, 0 }, 0 };
+    }
+}
+
+void ir_block::compact_operands() {
+    std::vector<uint32_t> used;
+
+    for (auto& instruction: code)
+        if (instruction.op == ir_op::PHI || instruction.op == ir_op::CALL) {
+            uint32_t first = (uint32_t) used.size();
+            used.insert(used.end(), operands.begin() + instruction.a, operands.begin() + instruction.a + instruction.b);
+            instruction.a = first;
+        }
+
+    operands = std::move(used);
+}
+
+void ir_block::remove_predecessor(uint32_t index) {
+    predecessors.erase(predecessors.begin() + index);
+
+    for (auto& instruction: code) {
+        if (instruction.op != ir_op::PHI)
+            break;
+
+        // Operand stays in operands until they are compacted
+        uint32_t* phi_operands = operands_of(instruction);
+        std::copy(phi_operands + index + 1, phi_operands + instruction.b, phi_operands + index);
+        -- instruction.b;
+    }
+}
+
+const ir_function* ir_program::find(const std::string& name) const {
+    for (const auto& function: functions)
+        if (function.name == name)
+            return &function;
+
+    return nullptr;
+}
+
+void ir_program::verify() const {
+    for (const auto& function: functions)
+        function.verify();
+}
+
+//------------------------------------------------------------------------------
+
+void ir_function::replace_values(const std::vector<uint32_t>& replacement) {
+    for (ir_block& block: blocks)
+        for (auto& instruction: block.code)
+            for_each_operand(block, instruction, [&](uint32_t& operand) { operand = replacement[operand]; });
+}
+
+void ir_function::remove_unreachable_blocks() {
+    static const uint32_t removed = UINT32_MAX;
+    std::vector<uint32_t> renamed(blocks.size(), removed);
+
+    std::vector<uint32_t> worklist = { 0 };
+    renamed[0] = 0;
+
+    for (size_t i = 0; i < worklist.size(); ++ i)
+        for (uint32_t successor: blocks[worklist[i]].successors())
+            if (renamed[successor] == removed) {
+                renamed[successor] = 0;
+                worklist.push_back(successor);
+            }
+
+    std::vector<ir_block> reachable;
+    for (uint32_t i = 0; i < blocks.size(); ++ i)
+        if (renamed[i] != removed) {
+            renamed[i] = (uint32_t) reachable.size();
+            reachable.push_back(std::move(blocks[i]));
+        }
+
+    for (ir_block& block: reachable) {
+        ir_instruction& last = block.code.back();
+        if (last.op == ir_op::JUMP || last.op == ir_op::BRANCH) {
+            last.b = renamed[last.b];
+            if (last.op == ir_op::BRANCH)
+                last.c = renamed[last.c];
+        }
+
+        for (uint32_t i = (uint32_t) block.predecessors.size(); i -- > 0; )
+            if (renamed[block.predecessors[i]] == removed)
+                block.remove_predecessor(i);
+            else
+                block.predecessors[i] = renamed[block.predecessors[i]];
+
+        block.compact_operands();
+    }
+
+    blocks = std::move(reachable);
+}
+
+void ir_function::remove_dead_code() {
+    std::vector<const ir_instruction*> definitions(values, nullptr);
+    for (const ir_block& block: blocks)
+        for (const auto& instruction: block.code)
+            definitions[instruction.id] = &instruction;
+
+    // Calls may trap or never return, division traps unless divisor is known
+    auto needed = [&](const ir_instruction& instruction) {
+        if (instruction.op == ir_op::CALL || is_terminator(instruction.op))
+            return true;
+
+        if (instruction.op != ir_op::DIV)
+            return false;
+
+        const ir_instruction* divisor = definitions[instruction.b];
+        return divisor->op != ir_op::CONSTANT || divisor->value == 0;
+    };
+
+    std::vector<bool> live(values);
+    std::vector<std::pair<const ir_block*, const ir_instruction*>> worklist;
+
+    auto mark = [&](const ir_block& block, const ir_instruction& instruction) {
+        if (!live[instruction.id]) {
+            live[instruction.id] = true;
+            worklist.push_back({ &block, &instruction });
+        }
+    };
+
+    std::vector<const ir_block*> owners(values, nullptr);
+    for (const ir_block& block: blocks)
+        for (const auto& instruction: block.code) {
+            owners[instruction.id] = &block;
+            if (needed(instruction))
+                mark(block, instruction);
+        }
+
+    while (!worklist.empty()) {
+        auto [block, instruction] = worklist.back();
+        worklist.pop_back();
+
+        for_each_operand(*block, *instruction, [&](uint32_t operand) {
+            mark(*owners[operand], *definitions[operand]);
+        });
+    }
+
+    for (ir_block& block: blocks) {
+        std::erase_if(block.code, [&](const ir_instruction& instruction) { return !live[instruction.id]; });
+        block.compact_operands();
+    }
+}
+
+void ir_function::simplify_control_flow() {
+    std::vector<uint32_t> replacement(values);
+    for (uint32_t i = 0; i < values; ++ i)
+        replacement[i] = i;
+
+    auto resolve = [&](uint32_t value) {
+        while (replacement[value] != value)
+            value = replacement[value];
+
+        return value;
+    };
+
+    // Phi is trivial when all operands but itself are one value, which then dominates
+    // the phi, replacing one can make others trivial
+    for (bool changed = true; changed; ) {
+        changed = false;
+
+        for (ir_block& block: blocks)
+            for (const auto& instruction: block.code) {
+                if (instruction.op != ir_op::PHI)
+                    break;
+
+                if (replacement[instruction.id] != instruction.id)
+                    continue;
+
+                uint32_t same = UINT32_MAX;
+                bool trivial = true;
+
+                for (uint32_t i = 0; i < instruction.b && trivial; ++ i) {
+                    uint32_t operand = resolve(block.operands_of(instruction)[i]);
+                    if (operand == instruction.id || operand == same)
+                        continue;
+
+                    trivial = same == UINT32_MAX;
+                    same = operand;
+                }
+
+                if (trivial && same != UINT32_MAX) {
+                    replacement[instruction.id] = same;
+                    changed = true;
+                }
+            }
+    }
+
+    for (uint32_t i = 0; i < values; ++ i)
+        replacement[i] = resolve(i);
+
+    replace_values(replacement);
+
+    for (ir_block& block: blocks) {
+        std::erase_if(block.code, [&](const ir_instruction& instruction) {
+            return instruction.op == ir_op::PHI && replacement[instruction.id] != instruction.id;
+        });
+
+        block.compact_operands();
+    }
+
+    // Block that only its predecessor jumps to has no phis left, its code goes to the
+    // end of the predecessor, and what it jumped to is jumped to from the predecessor
+    for (uint32_t i = 0; i < blocks.size(); ++ i)
+        while (blocks[i].terminator().op == ir_op::JUMP) {
+            uint32_t next = blocks[i].terminator().b;
+            if (next == 0 || next == i || blocks[next].predecessors.size() != 1)
+                break;
+
+            ir_block& block = blocks[i];
+            ir_block& absorbed = blocks[next];
+
+            block.code.pop_back();
+
+            uint32_t offset = (uint32_t) block.operands.size();
+            for (auto instruction: absorbed.code) {
+                if (instruction.op == ir_op::CALL)
+                    instruction.a += offset;
+
+                block.code.push_back(instruction);
+            }
+
+            block.operands.insert(block.operands.end(), absorbed.operands.begin(), absorbed.operands.end());
+
+            for (uint32_t successor: absorbed.successors())
+                std::replace(blocks[successor].predecessors.begin(), blocks[successor].predecessors.end(),
+                             next, i);
+
+            // Nothing reaches it now, it's left for remove_unreachable_blocks()
+            absorbed.code = { { ir_op::JUMP, ir_type::VOID, 0, 0, next } };
+            absorbed.operands.clear();
+            absorbed.predecessors.clear();
+        }
+
+    remove_unreachable_blocks();
+}
+
+static void dump_instruction(std::ostream& os, const ir_program& program, const ir_block& block,
+                             const ir_instruction& instruction) {
+    os << "  ";
+    if (instruction.type != ir_type::VOID)
+        os << "%" << instruction.id << ": " << ir_type_name(instruction.type) << " = ";
+
+    os << ir_op_name(instruction.op);
+
+    switch (instruction.op) {
+    case ir_op::CONSTANT:
+        os << " " << instruction.value;
+        break;
+
+    case ir_op::PARAMETER:
+        os << " " << instruction.a;
+        break;
+
+    case ir_op::PHI:
+        for (uint32_t i = 0; i < instruction.b; ++ i)
+            os << (i == 0 ? " " : ", ") << "[%" << block.operands_of(instruction)[i]
+               << ", b" << block.predecessors[i] << "]";
+        break;
+
+    case ir_op::CALL:
+        os << " " << program.functions[instruction.c].name << "(";
+        for (uint32_t i = 0; i < instruction.b; ++ i)
+            os << (i == 0 ? "%" : ", %") << block.operands_of(instruction)[i];
+        os << ")";
+        break;
+
+    case ir_op::LOAD_VARIABLE:
+        os << " v" << instruction.a;
+        break;
+
+    case ir_op::STORE_VARIABLE:
+        os << " v" << instruction.a << ", %" << instruction.b;
+        break;
+
+    case ir_op::JUMP:
+        os << " b" << instruction.b;
+        break;
+
+    case ir_op::BRANCH:
+        os << " %" << instruction.a << ", b" << instruction.b << ", b" << instruction.c;
+        break;
+
+    case ir_op::NEG: case ir_op::RETURN:
+        os << " %" << instruction.a;
+        break;
+
+    default:
+        os << " %" << instruction.a << ", %" << instruction.b;
+        break;
+    }
+
+    os << "\n";
+}
+
+void ir_program::dump(std::ostream& os) const {
+    for (const auto& function: functions) {
+        os << "function " << function.name << "(" << function.arity << " parameters)\n";
+
+        for (size_t i = 0; i < function.blocks.size(); ++ i) {
+            const ir_block& block = function.blocks[i];
+
+            os << "b" << i << ":";
+            for (size_t j = 0; j < block.predecessors.size(); ++ j)
+                os << (j == 0 ? " ; predecessors b" : ", b") << block.predecessors[j];
+            os << "\n";
+
+            for (const auto& instruction: block.code)
+                dump_instruction(os, *this, block, instruction);
+        }
+
+        os << "\n";
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void ir_function::verify() const {
+    auto fail = [&](const std::string& message) {
+        return std::logic_error("ir: " + message + " in function " + name);
+    };
+
+    static const uint32_t undefined = UINT32_MAX;
+
+    struct definition { uint32_t block, index; ir_type type; };
+    std::vector<definition> definitions(values, { undefined, 0, ir_type::VOID });
+
+    std::vector<std::vector<uint32_t>> incoming(blocks.size());
+
+    for (uint32_t i = 0; i < blocks.size(); ++ i) {
+        const ir_block& block = blocks[i];
+        if (block.code.empty() || !is_terminator(block.terminator().op))
+            throw fail("b" + std::to_string(i) + " doesn't end with terminator");
+
+        bool phis = true;
+        for (uint32_t j = 0; j < block.code.size(); ++ j) {
+            const ir_instruction& current = block.code[j];
+
+            if (current.id >= values || definitions[current.id].block != undefined)
+                throw fail("%" + std::to_string(current.id) + " is defined twice or has invalid id");
+
+            definitions[current.id] = { i, j, current.type };
+
+            if (current.op == ir_op::PHI) {
+                if (!phis)
+                    throw fail("phi %" + std::to_string(current.id) + " after other instructions");
+
+                if (current.b != block.predecessors.size())
+                    throw fail("phi %" + std::to_string(current.id) + " doesn't have operand for every predecessor");
+            } else
+                phis = false;
+
+            if (is_terminator(current.op) && j + 1 != block.code.size())
+                throw fail("terminator in the middle of b" + std::to_string(i));
+
+            if (current.op == ir_op::PARAMETER && i != 0)
+                throw fail("parameter outside of entry block");
+
+            if (current.op == ir_op::LOAD_VARIABLE || current.op == ir_op::STORE_VARIABLE)
+                throw fail("variable is left after lowering");
+        }
+
+        for (uint32_t successor: block.successors()) {
+            if (successor >= blocks.size())
+                throw fail("b" + std::to_string(i) + " jumps to nonexistent block");
+
+            incoming[successor].push_back(i);
+        }
+    }
+
+    for (uint32_t i = 0; i < blocks.size(); ++ i) {
+        std::vector<uint32_t> expected = incoming[i], actual = blocks[i].predecessors;
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+
+        if (expected != actual)
+            throw fail("predecessors of b" + std::to_string(i) + " don't match jumps to it");
+    }
+
+    dominator_tree dominators(*this);
+
+    for (uint32_t i = 0; i < blocks.size(); ++ i) {
+        if (!dominators.reachable(i))
+            throw fail("b" + std::to_string(i) + " is unreachable");
+
+        const ir_block& block = blocks[i];
+        for (uint32_t j = 0; j < block.code.size(); ++ j) {
+            const ir_instruction& current = block.code[j];
+
+            ir_type expected = is_comparison(current.op) ? ir_type::BOOL :
+                               is_terminator(current.op) ? ir_type::VOID : ir_type::INT;
+            if (current.type != expected)
+                throw fail("%" + std::to_string(current.id) + " has type " + ir_type_name(current.type));
+
+            uint32_t operand_index = 0;
+            for_each_operand(block, current, [&](uint32_t operand) {
+                uint32_t position = operand_index ++;
+
+                if (operand >= values || definitions[operand].block == undefined)
+                    throw fail("%" + std::to_string(current.id) + " uses undefined value");
+
+                const definition& defined = definitions[operand];
+
+                // Phi operand has to be available at the end of its predecessor
+                bool available = current.op == ir_op::PHI
+                    ? dominators.dominates(defined.block, block.predecessors[position])
+                    : defined.block == i ? defined.index < j : dominators.dominates(defined.block, i);
+
+                if (!available)
+                    throw fail("%" + std::to_string(operand) + " doesn't dominate its use in %" +
+                               std::to_string(current.id));
+
+                ir_type type = defined.type;
+                if (current.op == ir_op::BRANCH) {
+                    if (type != ir_type::BOOL || defined.block != i || defined.index + 2 != block.code.size())
+                        throw fail("branch of b" + std::to_string(i) + " has to test comparison right before it");
+                } else if (type != ir_type::INT)
+                    throw fail("%" + std::to_string(current.id) + " takes " + ir_type_name(type) + " operand");
+            });
+        }
+    }
+}
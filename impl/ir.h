@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+enum class ir_type: uint8_t { VOID, BOOL, INT }; // INT is 64-bit
+
+const char* ir_type_name(ir_type type);
+
+enum class ir_op: uint8_t {
+    CONSTANT,               // value
+    PARAMETER,              // Parameter a, only in entry block
+    PHI,                    // Operands a..a+b in ir_block::operands, one per predecessor in order
+
+    ADD, SUB, MUL, DIV,     // a op b, same wrapping arithmetic as VMs
+    NEG,                    // -a
+
+    // Compare a with b, BOOL result only ever feeds BRANCH right after it
+    LESS, LESS_OR_EQUAL, GREATER, GREATER_OR_EQUAL, EQUALS, NOT_EQUALS,
+
+    CALL,                   // Function c with arguments a..a+b in ir_block::operands
+
+    // Only while lowering from syntax tree, before variables become values
+    LOAD_VARIABLE,          // Variable a
+    STORE_VARIABLE,         // Variable a = b
+
+    // Terminators, every block ends with exactly one
+    JUMP,                   // To block b
+    BRANCH,                 // To block b if a, to block c otherwise
+    RETURN                  // Return a
+};
+
+const char* ir_op_name(ir_op op);
+
+bool is_comparison(ir_op op);
+bool is_terminator(ir_op op);
+
+/**
+ * Instruction defines value /id/, which is what operands refer to,
+ * ids are unique in function. Operands that don't fit in a and b are
+ * in operands of the instruction's block.
+ */
+struct ir_instruction {
+    ir_op op;
+    ir_type type;
+    uint32_t id;
+    uint32_t a = 0, b = 0, c = 0;
+    int64_t value = 0; //!< Of CONSTANT
+};
+
+// Blocks a terminator goes to, at most two
+struct ir_successors {
+    uint32_t blocks[2];
+    uint32_t count;
+
+    const uint32_t* begin() const { return blocks; }
+    const uint32_t* end() const { return blocks + count; }
+};
+
+/**
+ * Straight-line code, instructions are stored in the block itself:
+ * phis come first, terminator is the last.
+ */
+struct ir_block {
+    std::vector<ir_instruction> code;
+    std::vector<uint32_t> operands;     //!< Of PHI and CALL instructions
+    std::vector<uint32_t> predecessors; //!< In order of phi operands
+
+    const ir_instruction& terminator() const { return code.back(); }
+    ir_successors successors() const;
+
+    // Operands of PHI or CALL
+    const uint32_t* operands_of(const ir_instruction& instruction) const { return operands.data() + instruction.a; }
+    uint32_t* operands_of(const ir_instruction& instruction) { return operands.data() + instruction.a; }
+
+    // Drop operands of instructions that were removed
+    void compact_operands();
+
+    // Forget edge from predecessors[index], and operands of phis that came along it
+    void remove_predecessor(uint32_t index);
+};
+
+struct ir_function {
+    std::string name;
+    uint32_t arity = 0;
+
+    std::vector<ir_block> blocks; // blocks[0] is the entry
+    uint32_t values = 0;          // Ids are below
+
+    uint32_t new_value() { return values ++; }
+
+    // Make every operand /value/ refer to replacement[value] instead
+    void replace_values(const std::vector<uint32_t>& replacement);
+
+    // Blocks that entry doesn't reach, e.g. after return statements or after branches were folded
+    void remove_unreachable_blocks();
+
+    // Instructions whose values are unused and that can't trap or call anything
+    void remove_dead_code();
+
+    // Replace phis that only ever see one value with the value, and merge block that
+    // jumps to block nobody else goes to with it
+    void simplify_control_flow();
+
+    // Throws std::logic_error if function isn't well formed SSA, e.g. after a broken pass
+    void verify() const;
+};
+
+struct ir_program {
+    std::vector<ir_function> functions; // In the order every backend numbers them in
+
+    const ir_function* find(const std::string& name) const;
+
+    void verify() const; // Every function
+
+    void dump(std::ostream& os) const;
+};
+
+// Call /visit/ with every value operand of /instruction/ of /block/, operands are
+// passed by reference, so that visitor can replace them when neither is const
+template <typename block_type, typename instruction_type, typename visitor>
+void for_each_operand(block_type& block, instruction_type& instruction, visitor&& visit) {
+    switch (instruction.op) {
+    case ir_op::CONSTANT: case ir_op::PARAMETER: case ir_op::LOAD_VARIABLE: case ir_op::JUMP:
+        break;
+
+    case ir_op::PHI: case ir_op::CALL:
+        for (uint32_t i = 0; i < instruction.b; ++ i)
+            visit(block.operands[instruction.a + i]);
+        break;
+
+    case ir_op::NEG: case ir_op::BRANCH: case ir_op::RETURN:
+        visit(instruction.a);
+        break;
+
+    case ir_op::STORE_VARIABLE:
+        visit(instruction.b);
+        break;
+
+    default: // Binary operations and comparisons
+        visit(instruction.a);
+        visit(instruction.b);
+        break;
+    }
+}
@@ -0,0 +1,168 @@
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <string>
+#include <vector>
+
+static const std::string digits =
+    "defun digits(a, b, c, d, e, f, g, h) {\n"
+    "    return a * 10000000 + b * 1000000 + c * 100000 + d * 10000 + e * 1000 + f * 100 + g * 10 + h;\n"
+    "}\n";
+
+static const std::vector<std::string> programs = {
+    "defun add(a, b) {\n"
+    "    return a + b;\n"
+    "}\n"
+    "defun main() {\n"
+    "    let x = add(1, 2)\n"
+    "    while (x < 10) {\n"
+    "        x = x * 2\n"
+    "    }\n"
+    "    return x;\n"
+    "}\n",
+
+    "defun main() {\n"
+    "    let sum = 0\n"
+    "    for (i in 1..50) {\n"
+    "        for (j in 0..i) {\n"
+    "            sum = sum + j * i - (j / 3)\n"
+    "        }\n"
+    "    }\n"
+    "    return sum;\n"
+    "}\n",
+
+    "defun fib(n) {\n"
+    "    if (n < 2) {\n"
+    "        return n;\n"
+    "    }\n"
+    "    return fib(n - 1) + fib(n - 2);\n"
+    "}\n"
+    "defun main() { return fib(20); }\n",
+
+    "defun main() { return 1000000 * 1000000 * 1000000 * 10; }",
+    "defun main() { return ((0 - 7) / 2) * 1000 + 7 / (0 - 2); }",
+    "defun main() {\n"
+    "    let min = 1073741824 * 1073741824 * 8\n"
+    "    return min / (0 - 1) + (min - 1);\n"
+    "}\n",
+
+    // More arguments than go in registers, from interpreter and from native code
+    digits + "defun main() { return digits(1, 2, 3, 4, 5, 6, 7, 8); }",
+    digits + "defun shifted(x) {\n"
+             "    return digits(x, x + 1, x + 2, x + 3, x + 4, x + 5, x + 6, x + 7) - digits(x + 7, x + 6, x + 5, x + 4, x + 3, x + 2, x + 1, x);\n"
+             "}\n"
+             "defun main() { return shifted(1) * 10 + shifted(2); }",
+
+    "defun count(n, a, b, c, d, e, f, g) {\n"
+    "    if (n < 1) {\n"
+    "        return a + b + c + d + e + f + g;\n"
+    "    }\n"
+    "    return 1 + count(n - 1, g, a, b, c, d, e, f);\n"
+    "}\n"
+    "defun main() { return count(100, 1, 2, 3, 4, 5, 6, 7); }",
+
+    "defun main() { return g(1); }",
+    "defun f(a) { return a; }\ndefun main() { return f(1, 2); }",
+    "defun f(n) { return 1 + f(n + 1); }\ndefun main() { return f(0); }",
+    "defun f(a) { return 5 / a; }\ndefun main() { return f(0); }",
+    "defun f(a) {\n"
+    "    let x = 0\n"
+    "    for (i in 0..10) {\n"
+    "        x = x + 100 / (a - i)\n"
+    "    }\n"
+    "    return x;\n"
+    "}\n"
+    "defun main() { return f(5); }"
+};
+
+TEST(results_are_the_same_as_in_interpreter) {
+    for (int optimize: { 0, 1 }) {
+        for (const auto& source: programs) {
+            register_program program;
+            try {
+                program = compile_program(source, optimize);
+            } catch (const std::runtime_error&) {
+                continue; // Compiler finds calls of undefined functions before running
+            }
+
+            std::string interpreted = run_main(program);
+
+            ASSERT_STRING_EQUAL(run_main_jit(program, 0), interpreted);
+            ASSERT_STRING_EQUAL(run_main_jit(program, 1), interpreted);
+            ASSERT_STRING_EQUAL(run_main_jit(program, 5), interpreted);
+        }
+    }
+}
+
+TEST(arguments_and_errors) {
+    for (int optimize: { 0, 1 }) {
+        ASSERT_STRING_EQUAL(run_main_jit(compile_program(programs[6], optimize)), std::string("12345678"));
+        ASSERT_STRING_EQUAL(run_main_jit(compile_program(programs[7], optimize)), std::string("-828395073"));
+        ASSERT_STRING_EQUAL(run_main_jit(compile_program(programs[8], optimize)), std::string("128"));
+
+        ASSERT_STRING_EQUAL(run_main_jit(compile_program(programs[11], optimize)),
+                            std::string("error: stack overflow in function f"));
+        ASSERT_STRING_EQUAL(run_main_jit(compile_program(programs[12], optimize)),
+                            std::string("error: division by zero in function f"));
+        ASSERT_STRING_EQUAL(run_main_jit(compile_program(programs[13], optimize), 1),
+                            std::string("error: division by zero in function f"));
+    }
+}
+
+// Functions compiled after running main() with /threshold/
+static std::vector<bool> compiled_functions(const register_program& program, uint32_t threshold) {
+    jit_compiler jit(program, threshold);
+    run_main(program, &jit);
+
+    std::vector<bool> compiled;
+    for (uint32_t function = 0; function < program.functions.size(); function ++)
+        compiled.push_back(jit.compiled(function));
+
+    return compiled;
+}
+
+TEST(calls_tier_up_at_threshold) {
+    if (!jit_compiler::supported())
+        return;
+
+    register_program program = compile_program("defun f(a) { return a + 1; }\n"
+                                               "defun main() { return f(f(f(0))); }\n");
+
+    // main() is called by the driver, not by bytecode, so it doesn't count
+    ASSERT_EQUAL(compiled_functions(program, 3) == std::vector<bool>({ true, false }), true);
+    ASSERT_EQUAL(compiled_functions(program, 4) == std::vector<bool>({ false, false }), true);
+}
+
+TEST(loops_tier_up_at_threshold) {
+    if (!jit_compiler::supported())
+        return;
+
+    // Condition is checked at the bottom, so loop jumps back after each of 5 iterations
+    register_program program = compile_program("defun main() {\n"
+                                               "    let x = 0\n"
+                                               "    for (i in 0..5) {\n"
+                                               "        x = x + i\n"
+                                               "    }\n"
+                                               "    return x;\n"
+                                               "}\n");
+
+    ASSERT_EQUAL(compiled_functions(program, 5) == std::vector<bool>({ true }), true);
+    ASSERT_EQUAL(compiled_functions(program, 6) == std::vector<bool>({ false }), true);
+
+    // Function is compiled with everything it calls, even what's called only once
+    register_program calling = compile_program("defun f(a) { return a; }\n"
+                                               "defun main() {\n"
+                                               "    let x = f(0)\n"
+                                               "    while (x < 3) {\n"
+                                               "        x = x + 1\n"
+                                               "    }\n"
+                                               "    return x;\n"
+                                               "}\n");
+
+    ASSERT_EQUAL(compiled_functions(calling, 3) == std::vector<bool>({ true, true }), true);
+    ASSERT_EQUAL(compiled_functions(calling, 4) == std::vector<bool>({ false, false }), true);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,207 @@
+#include "jit.h"
+#include "trace-events.h"
+#include "x86-codegen.h"
+
+#include <csetjmp>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) && defined(__linux__)
+    #define JIT_SUPPORTED 1
+
+    #include <pthread.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+static const size_t region_size = 64 << 20;
+
+// Native code can't throw through its frames, so traps jump back to jit_compiler::run
+static thread_local std::jmp_buf* trap_target = nullptr;
+static thread_local uint32_t trapped, trapped_function;
+
+[[noreturn]] static void trap_handler(uint32_t trap, uint32_t function) {
+    trapped = trap;
+    trapped_function = function;
+
+    std::longjmp(*trap_target, 1);
+}
+
+bool jit_compiler::supported() {
+#ifdef JIT_SUPPORTED
+    return true;
+#else
+    return false;
+#endif
+}
+
+jit_compiler::jit_compiler(const register_program& program, uint32_t threshold)
+    : m_program(program), m_threshold(threshold),
+      m_code(program.functions.size()), m_entries(program.functions.size()),
+      m_loop_entries(program.functions.size()),
+      m_runtime { &m_stack_limit, trap_handler } {
+
+#ifdef JIT_SUPPORTED
+    void* region = mmap(nullptr, region_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED)
+        throw std::runtime_error("error: can't reserve memory for JIT");
+
+    m_region = static_cast<uint8_t*>(region);
+    m_region_size = region_size;
+
+    // Leave room below the limit for trap handler and whatever it calls
+    pthread_attr_t attributes;
+    pthread_getattr_np(pthread_self(), &attributes);
+
+    void* stack_low = nullptr;
+    size_t stack_size = 0;
+    pthread_attr_getstack(&attributes, &stack_low, &stack_size);
+    pthread_attr_destroy(&attributes);
+
+    m_stack_limit = reinterpret_cast<uintptr_t>(stack_low) + 256 * 1024;
+#else
+    throw std::logic_error("JIT isn't supported on this platform");
+#endif
+}
+
+jit_compiler::~jit_compiler() {
+#ifdef JIT_SUPPORTED
+    if (m_region != nullptr)
+        munmap(m_region, m_region_size);
+#endif
+}
+
+void jit_compiler::compile(uint32_t function) {
+#ifdef JIT_SUPPORTED
+    // Everything function can call, that isn't compiled yet, goes into the same batch
+    static const uint32_t not_in_batch = UINT32_MAX;
+
+    std::vector<uint32_t> batch;
+    std::vector<uint32_t> position(m_program.functions.size(), not_in_batch); // In batch
+
+    auto add = [&](uint32_t callee) {
+        if (m_code[callee] == 0 && position[callee] == not_in_batch) {
+            position[callee] = (uint32_t) batch.size();
+            batch.push_back(callee);
+        }
+    };
+
+    add(function);
+    for (size_t i = 0; i < batch.size(); ++ i)
+        for (uint32_t j = m_program.functions[batch[i]].entry; j < m_program.end_of(batch[i]); ++ j)
+            if (m_program.code[j].op == register_op::CALL || m_program.code[j].op == register_op::TAIL_CALL)
+                add(m_program.code[j].c);
+
+    trace_span span("jit", tracing() ? "jit " + m_program.functions[function].name : "");
+
+    x86_encoder encoder(&m_runtime);
+    x86_codegen_options options = { .runtime_checks = true, .loop_entries = true };
+
+    struct placed_function {
+        uint32_t code, entry;
+        std::vector<std::pair<uint32_t, uint32_t>> loop_entries; // Head -> offset
+    };
+
+    std::vector<placed_function> placed;
+    for (uint32_t index: batch) {
+        encoder.align(16);
+        placed_function current = { (uint32_t) encoder.bytes().size(), 0, {} };
+
+        x86_function lowered = lower_to_x86(m_program, index, options);
+        std::vector<uint32_t> labels = encoder.encode(lowered);
+
+        for (const auto& [head, label]: lowered.loop_entries)
+            current.loop_entries.emplace_back(head, labels[label]);
+
+        encoder.align(16);
+        current.entry = (uint32_t) encoder.bytes().size();
+        encoder.encode(lower_entry_thunk(m_program, index));
+
+        placed.push_back(std::move(current));
+    }
+
+    // Batch starts on its own page, so pages of running code are never writable
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    size_t start = (m_used + page_size - 1) / page_size * page_size;
+    size_t size = (encoder.bytes().size() + page_size - 1) / page_size * page_size;
+
+    if (start + size > m_region_size)
+        throw std::runtime_error("error: JIT ran out of memory for code");
+
+    uint8_t* base = m_region + start;
+
+    std::vector<uint8_t> bytes = encoder.bytes();
+    for (const auto& call: encoder.calls()) {
+        uint32_t in_batch = position[call.function];
+        uintptr_t callee = in_batch == not_in_batch ? m_code[call.function] :
+                           reinterpret_cast<uintptr_t>(base + placed[in_batch].code);
+
+        int32_t displacement = (int32_t) (callee - reinterpret_cast<uintptr_t>(base + call.offset + 4));
+        std::memcpy(&bytes[call.offset], &displacement, sizeof(displacement));
+    }
+
+    if (mprotect(base, size, PROT_READ | PROT_WRITE) != 0)
+        throw std::runtime_error("error: can't make JIT memory writable");
+
+    std::memcpy(base, bytes.data(), bytes.size());
+
+    if (mprotect(base, size, PROT_READ | PROT_EXEC) != 0)
+        throw std::runtime_error("error: can't make JIT memory executable");
+
+    m_used = start + size;
+
+    for (size_t i = 0; i < batch.size(); ++ i) {
+        uint32_t index = batch[i];
+
+        m_code[index] = reinterpret_cast<uintptr_t>(base + placed[i].code);
+        m_entries[index] = reinterpret_cast<native_entry>(base + placed[i].entry);
+
+        for (const auto& [head, offset]: placed[i].loop_entries)
+            m_loop_entries[index].emplace_back(head, reinterpret_cast<native_entry>(base + offset));
+    }
+#else
+    (void) function;
+    throw std::logic_error("JIT isn't supported on this platform");
+#endif
+}
+
+int64_t jit_compiler::run(native_entry entry, const int64_t* input) {
+    std::jmp_buf target;
+    std::jmp_buf* saved_target = trap_target;
+
+    trap_target = &target;
+    if (setjmp(target) != 0) {
+        trap_target = saved_target;
+
+        const char* message = trapped == (uint32_t) x86_trap::DIVISION_BY_ZERO ? "division by zero" : "stack overflow";
+        throw std::runtime_error(std::string("error: ") + message + " in function " +
+                                 m_program.functions[trapped_function].name);
+    }
+
+    int64_t result = entry(input);
+
+    trap_target = saved_target;
+    return result;
+}
+
+int64_t jit_compiler::call(uint32_t function, const int64_t* arguments) {
+    return run(m_entries[function], arguments);
+}
+
+bool jit_compiler::has_loop_entry(uint32_t function, uint32_t head) const {
+    for (const auto& entry: m_loop_entries[function])
+        if (entry.first == head)
+            return true;
+
+    return false;
+}
+
+int64_t jit_compiler::enter_loop(uint32_t function, uint32_t head, const int64_t* registers) {
+    for (const auto& [entry_head, entry]: m_loop_entries[function])
+        if (entry_head == head)
+            return run(entry, registers);
+
+    throw std::logic_error("function " + m_program.functions[function].name + " has no entry at loop " +
+                           std::to_string(head));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "register-bytecode.h"
+#include "x86-encoder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Tier above register_vm: functions of register_program that get hot
+ * are compiled to x86-64 machine code (see lower_to_x86) in executable
+ * memory. Function is compiled along with every function it can call,
+ * so native code only calls native code, and does it directly.
+ *
+ * Division by zero and stack overflow in native code are reported with
+ * std::runtime_error, just like interpreter reports them. Native code
+ * runs on the stack of the thread that created compiler.
+ *
+ * Only x86-64 Linux is supported, see supported().
+ */
+class jit_compiler {
+public:
+    jit_compiler(const register_program& program, uint32_t threshold = 1000);
+    ~jit_compiler();
+
+    jit_compiler(const jit_compiler&) = delete;
+    jit_compiler& operator=(const jit_compiler&) = delete;
+
+    static bool supported();
+
+    // How many calls and loop iterations interpreter runs function for, before it's compiled
+    uint32_t threshold() const { return m_threshold; }
+
+    bool compiled(uint32_t function) const { return m_entries[function] != nullptr; }
+    void compile(uint32_t function);
+
+    int64_t call(uint32_t function, const int64_t* arguments);
+
+    // Continue running /function/ natively from loop at bytecode index /head/,
+    // with registers of interpreter's frame, returns what function returns
+    bool has_loop_entry(uint32_t function, uint32_t head) const;
+    int64_t enter_loop(uint32_t function, uint32_t head, const int64_t* registers);
+
+    size_t code_size() const { return m_used; }
+
+private:
+    using native_entry = int64_t (*)(const int64_t*);
+
+    const register_program& m_program;
+    uint32_t m_threshold;
+
+    std::vector<uintptr_t> m_code;       // Address of function, 0 if it isn't compiled
+    std::vector<native_entry> m_entries; // Thunks that take arguments from array
+    std::vector<std::vector<std::pair<uint32_t, native_entry>>> m_loop_entries; // Loop head -> entry
+
+    // Code goes to one reserved region, so calls between functions always reach with 32-bit offset
+    uint8_t* m_region = nullptr;
+    size_t m_region_size = 0, m_used = 0;
+
+    uintptr_t m_stack_limit = 0;
+    x86_runtime m_runtime;
+
+    int64_t run(native_entry entry, const int64_t* input);
+};
@@ -1,15 +1,63 @@
 #include "graphviz.h"
 #include "parser.h"
+#include "parse-profiler.h"
+#include "table-parser.h"
 #include "lexer.h"
 
 #include "ast.h"
+#include "arena.h"
 #include "definitions.h"
-
+#include "elf-object.h"
+#include "flat-ast.h"
+#include "function-purity.h"
+#include "grammar.h"
+#include "incremental-parse.h"
+#include "ir-codegen.h"
+#include "ir-lowering.h"
+#include "ir-optimizer.h"
+#include "memory-report.h"
+#include "parallel-parse.h"
+#include "register-bytecode.h"
+#include "register-vm.h"
+#include "stack-bytecode.h"
+#include "stack-vm.h"
+#include "time-report.h"
+#include "trace-events.h"
+#include "x86-assembly.h"
+#include "x86-codegen.h"
+
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <span>
 #include <variant>
 #include <chrono>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+// Every C++ allocation goes to allocation_tracker too, see -fmem-report
+void* operator new(size_t size) {
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+
+    track_allocation(memory);
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    track_free(memory);
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    operator delete(memory);
+}
 
 static std::string read_whole_file(std::string file_name) {
     std::ifstream file(file_name);
@@ -25,188 +73,505 @@ static std::string read_whole_file(std::string file_name) {
     return file_contents;
 }
 
-void create_program_parser() {
-    using namespace lang;
-    using enum language_lexem;
+enum class native_output { NONE, ASSEMBLY, OBJECT };
+
+struct driver_options {
+    std::string file_name = "res/test.prog";
+
+    bool dump_flat_ast = false;
+    bool dump_tokens = false;
+    bool time_report = false; // Print time spent in each phase
+    bool memory_report = false; // Print memory taken by each phase
+    std::string trace_file;   // Chrome trace of phases and functions, if not empty
+    bool analyse_grammar = false;
+    bool profile_parser = false;
+    bool table_parse = false; // Use LL(1) table instead of combinators if possible
+    bool recover = false;     // Report all syntax errors instead of the first one
+    bool left_factor = true;  // Parse common prefixes of alternatives once
+
+    bool parallel_parse = false;
+    size_t parse_threads = 0; // All cores by default
+
+    bool watch = false; // Reparse file on every change
+
+    bool dump_bytecode = false;
+    bool run = false;   // Compile program and print what its main() returns
+    bool register_vm = true; // Run in register_vm or in stack_vm
+
+    bool jit = true; // Compile hot functions of register_vm, where JIT is supported
+    uint32_t jit_threshold = 1000;
+
+    bool memoize = false; // Cache results of pure recursive functions in register_vm
+
+    int optimize = 0;     // -O1 compiles register bytecode through SSA form
+    bool dump_ir = false;
+    ir_optimizer_options optimizer;
+
+    native_output native = native_output::NONE; // Whole program compiled with -S or -c
+    std::string output_file; // Of -S and -c, named after the source file if empty
+};
+
+static driver_options parse_options(int argc, char* argv[]) {
+    driver_options options;
+
+    for (int i = 1; i < argc; ++ i) {
+        std::string_view option = argv[i];
+
+        if (option == "-fdump-flat-ast")
+            options.dump_flat_ast = true;
+        else if (option == "-fdump-tokens")
+            options.dump_tokens = true;
+        else if (option == "-ftime-report")
+            options.time_report = true;
+        else if (option == "-fmem-report")
+            options.memory_report = true;
+        else if (option == "-ftime-trace")
+            options.trace_file = "trace.json";
+        else if (option.starts_with("-ftime-trace="))
+            options.trace_file = option.substr(option.find('=') + 1);
+        else if (option == "-fparallel-parse")
+            options.parallel_parse = true;
+        else if (option.starts_with("-fparallel-parse=")) {
+            options.parallel_parse = true;
+            options.parse_threads = std::stoul(std::string(option.substr(option.find('=') + 1)));
+        }
+        else if (option == "-fanalyze-grammar")
+            options.analyse_grammar = true;
+        else if (option == "-fprofile-parser")
+            options.profile_parser = true;
+        else if (option == "-ftable-parse")
+            options.table_parse = true;
+        else if (option == "-frecover")
+            options.recover = true;
+        else if (option == "-fno-left-factor")
+            options.left_factor = false;
+        else if (option == "-fwatch")
+            options.watch = true;
+        else if (option == "-fdump-bytecode")
+            options.dump_bytecode = true;
+        else if (option == "-frun")
+            options.run = true;
+        else if (option == "-fvm=register")
+            options.register_vm = true;
+        else if (option == "-fvm=stack")
+            options.register_vm = false;
+        else if (option == "-fjit")
+            options.jit = true;
+        else if (option == "-fno-jit")
+            options.jit = false;
+        else if (option.starts_with("-fjit-threshold="))
+            options.jit_threshold = (uint32_t) std::stoul(std::string(option.substr(option.find('=') + 1)));
+        else if (option == "-fmemoize")
+            options.memoize = true;
+        else if (option == "-O0")
+            options.optimize = 0;
+        else if (option == "-O1" || option == "-O")
+            options.optimize = 1;
+        else if (option == "-fdump-ir")
+            options.dump_ir = true;
+        else if (option == "-fno-inline")
+            options.optimizer.inlining.growth_budget = 0;
+        else if (option.starts_with("-finline-limit="))
+            options.optimizer.inlining.size_limit = (uint32_t) std::stoul(std::string(option.substr(option.find('=') + 1)));
+        else if (option.starts_with("-finline-budget="))
+            options.optimizer.inlining.growth_budget = (uint32_t) std::stoul(std::string(option.substr(option.find('=') + 1)));
+        else if (option == "-S")
+            options.native = native_output::ASSEMBLY;
+        else if (option == "-c")
+            options.native = native_output::OBJECT;
+        else if (option == "-o") {
+            if (++ i == argc)
+                throw std::runtime_error("error: -o needs a file name");
+
+            options.output_file = argv[i];
+        }
+        else if (option.starts_with("-"))
+            throw std::runtime_error("error: unknown option " + std::string(option));
+        else
+            options.file_name = option;
+    }
+
+    if (options.profile_parser && options.parallel_parse)
+        throw std::runtime_error("error: -fprofile-parser can't be used with -fparallel-parse");
+
+    if (options.recover && options.parallel_parse)
+        throw std::runtime_error("error: -frecover can't be used with -fparallel-parse");
+
+    if (options.memoize && !options.register_vm)
+        throw std::runtime_error("error: -fmemoize can't be used with -fvm=stack");
+
+    return options;
+}
 
-    // ----------------------------------------- PRIMITIVES ----------------------------------------
-    auto name                  = transform(static_p(NAME), [](auto tree) { return tree.value; });
-    alloc_p<ast_number> number = 
-        transform(static_p(NUMBER), [](auto tree) { return std::stoi(tree.value); });
+static language_grammar create_optimized_grammar(const driver_options& options) {
+    phase_timer timer("grammar");
 
-    // ========================================= ARITHMETIC ========================================
+    language_grammar grammar = create_language_grammar();
+    if (options.left_factor)
+        lang::left_factor(grammar.program.node());
 
-    // -------------------------------------------- BASIC ------------------------------------------
+    return grammar;
+}
 
-    lazy_w<std::shared_ptr<ast_term>> factor;
-    lazy_w<std::shared_ptr<ast_term>> term;
-    lazy_w<std::shared_ptr<ast_expression>> expression;
+static std::string read_phase(const std::string& file_name) {
+    phase_timer timer("read");
+    return read_whole_file(file_name);
+}
 
-    // --------------------------------------- 1ST PRECEDENCE --------------------------------------
-    alloc_p<ast_var> var = name;
+static lang::lexer lexer_phase() {
+    phase_timer timer("lexer");
 
-    alloc_p<ast_mul> mul = factor & ignore_p(MUL) & term;
-    alloc_p<ast_div> div = factor & ignore_p(DIV) & term;
+    lang::lexer lexer = create_language_lexer();
+    lexer.compile(); // Otherwise it's compiled during the first lex
 
-    term = variant_upcast<ast_term>(mul | div | factor);
+    return lexer;
+}
 
-    // --------------------------------------- 2ND PRECEDENCE --------------------------------------
-    alloc_p<ast_add> add = term & ignore_p(PLUS)  & expression;
-    alloc_p<ast_sub> sub = term & ignore_p(MINUS) & expression;
+static std::vector<lang::lexem> lex_phase(lang::lexer& lexer, const std::string& program_str,
+                                          const std::string& file_name) {
+    phase_timer timer("lex");
+    return lexer.analyse(program_str, file_name);
+}
 
-    expression = variant_upcast<ast_expression>(add | sub | term);
+static void write_trace(const trace_events& trace, const std::string& trace_file) {
+    std::ofstream file(trace_file);
+    if (!file)
+        throw std::runtime_error("error: can't write trace to " + trace_file);
 
-    // ----------------------------------------- COMPARISON ----------------------------------------
-    auto named_comparison = [&](named_lexem lexem) { return expression & ignore_parser(lexem) & expression; };
-    #define comparison(id) named_comparison(named_lexem { id, #id })
+    trace.write(file);
+}
 
-    alloc_p<ast_less>             less             = comparison(LESS);
-    alloc_p<ast_less_or_equal>    less_or_equal    = comparison(LESS_OR_EQUAL);
-    alloc_p<ast_greater>          greater          = comparison(GREATER);
-    alloc_p<ast_greater_or_equal> greater_or_equal = comparison(GREATER_OR_EQUAL);
-    alloc_p<ast_equals>           equals           = comparison(EQUALS);
-    alloc_p<ast_not_equals>       not_equal        = comparison(NOT_EQUAL);
+static int64_t run_main(const flat_ast&, const stack_program& program, uint32_t main_function, const driver_options&) {
+    stack_vm vm(program);
+    return vm.call(main_function, {});
+}
 
-    #undef comparison
+static int64_t run_main(const flat_ast& tree, const register_program& program, uint32_t main_function,
+                        const driver_options& options) {
+    // Native code calls memoized functions past their caches
+    std::optional<jit_compiler> jit;
+    if (options.jit && !options.memoize && jit_compiler::supported())
+        jit.emplace(program, options.jit_threshold);
 
-    auto cond = variant_upcast<ast_cond>(less | less_or_equal | greater | greater_or_equal | equals | not_equal);
+    register_vm vm(program, jit ? &*jit : nullptr);
 
-    // ---------------------------------------- ASSIGNMENT -----------------------------------------
-    auto assignment = name & ignore_p(EQUAL) & expression;
+    if (options.memoize) {
+        std::vector<function_purity> purity = analyze_purity(tree);
+        for (uint32_t i = 0; i < purity.size(); ++ i)
+            if (purity[i].pure && purity[i].recursive)
+                vm.memoize(i);
+    }
 
-    alloc_p<ast_assignment>   assignment_p   = ignore_p(LET) & assignment;
-    alloc_p<ast_reassignment> reassignment_p = assignment;
+    return vm.call(main_function, {});
+}
 
-    // ------------------------------------------ TERMS --------------------------------------------
-    alloc_p<ast_unary_minus> unary_minus = ignore_p(MINUS) & factor;
+// Register bytecode, compiled through SSA form with -O1
+static register_program compile_register(const flat_ast& tree, const driver_options& options) {
+    if (options.optimize == 0 && !options.dump_ir) {
+        phase_timer timer("codegen");
+        return compile_register_program(tree);
+    }
 
-    auto arguments = ignore_p(LRB) & separated_by(expression, ignore_p(COMMA)) & ignore_p(RRB);
-    alloc_p<ast_function_call> function_call = name & arguments;
+    ir_program ir;
+    {
+        phase_timer timer("ir");
+        ir = lower_to_ir(tree);
 
-    alloc_p<ast_wrapped_expression> wrapped_expression = ignore_p(LRB) & expression & ignore_p(RRB);
+#ifndef NDEBUG
+        ir.verify();
+#endif
+    }
 
-    // <== Term declaration (see forward declaration in "arithmetic" section)
-    factor = variant_upcast<ast_term>(wrapped_expression | function_call | number | var); // TODO: unary minus
+    if (options.optimize > 0) {
+        phase_timer timer("optimize");
+        optimize_ir(ir, options.optimizer);
+    }
 
-    // ========================================= STATMENTS =========================================
+    if (options.dump_ir)
+        ir.dump(std::cout);
 
-    lazy_w<std::shared_ptr<ast_body>> body; // Forward declared (recursive declaration)
+    phase_timer timer("codegen");
+    return options.optimize == 0 ? compile_register_program(tree) : compile_ir_program(ir);
+}
 
-    // ---------------------------------------- CONDITIONAL ----------------------------------------
-    auto condition_and_body = ignore_p(LRB) & cond & ignore_p(RRB) & body;
+static stack_program compile_stack(const flat_ast& tree) {
+    phase_timer timer("codegen");
+    return compile_stack_program(tree);
+}
 
-    alloc_p<ast_if> if_p = ignore_p(IF) & condition_and_body;
-    alloc_p<ast_while> while_p = ignore_p(WHILE) & condition_and_body;
+// Print what main() of program returns
+template <typename program_type>
+static void run_bytecode(const flat_ast& tree, const program_type& bytecode, const driver_options& options) {
+    if (options.dump_bytecode)
+        bytecode.dump(std::cout);
 
-    // ---------------------------------------------------------------------------------------------
-    alloc_p<ast_for> for_p = ignore_p(FOR) & ignore_p(LRB) & name &
-        ignore_p(IN) & factor & ignore_p(ELLIPSIS) & factor & ignore_p(RRB) & body;
+    if (!options.run)
+        return;
 
-    alloc_p<ast_return> return_p = ignore_p(RETURN) & expression;
+    const auto* main_function = bytecode.find("main");
+    if (main_function == nullptr)
+        throw std::runtime_error("error: program has no main() to run");
 
-    // ---------------------------------------------------------------------------------------------
-    auto statement_without_semicolon = variant_upcast<ast_statement>(if_p | while_p | for_p);
-    auto statement_with_semicolon    = variant_upcast<ast_statement>(
-        assignment_p | reassignment_p | return_p & ignore_p(SEMICOLON));
+    if (main_function->arity != 0)
+        throw std::runtime_error("error: main() can't take arguments");
 
-    auto statement = variant_upcast<ast_statement>(statement_with_semicolon | statement_without_semicolon);
+    phase_timer timer("run");
 
-    // <== Body declaration (see forward declaration in "statements" section)
-    body = construct<ast_body>(ignore_p(LCB) & many(statement) & ignore_p(RCB));
+    std::cout << run_main(tree, bytecode, (uint32_t) (main_function - bytecode.functions.data()), options) << "\n";
+}
 
-    // ---------------------------------------- TOP LEVEL ------------------------------------------
-    auto argument_declaration = ignore_p(LRB) & separated_by(name, ignore_p(COMMA)) & ignore_p(RRB);
-    alloc_p<ast_function> function = ignore_p(DEFUN) & name & argument_declaration & body;
+// Whole program as x86-64 assembly or object, that cc links without any runtime
+static void write_native(const register_program& bytecode, const driver_options& options) {
+    phase_timer timer("native");
 
-    auto program = construct<ast_program>(many(function)); // <== Topmost parser
-    // ---------------------------------------------------------------------------------------------
+    std::vector<x86_function> functions;
+    for (uint32_t i = 0; i < bytecode.functions.size(); ++ i)
+        functions.push_back(lower_to_x86(bytecode, i, { .runtime_checks = false }));
 
-    std::string file_name = "res/test.prog";
-    std::string program_str = read_whole_file(file_name);
+    bool assembly = options.native == native_output::ASSEMBLY;
 
-    lang::lexer lexer;
+    std::string output_file = options.output_file;
+    if (output_file.empty())
+        output_file = std::filesystem::path(options.file_name).filename().replace_extension(assembly ? ".s" : ".o");
 
-    // Whitespace rule
-    lexer.ignore_rule("[\n \t]([\n \t])");
+    std::ofstream file(output_file, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("error: can't write " + output_file);
 
-    lexer.add_rules({
-        { named(ARROW),            "->"                        },
-        { named(COLON),            ":"                         },
-        { named(COMMA),            ","                         },
-        { named(ELLIPSIS),         ".."                        },
+    if (assembly)
+        print_x86_assembly(file, functions);
+    else
+        write_elf_object(file, functions);
+}
 
-        { named(EQUAL),            "="                         },
+// Whether driver does anything with program after parsing it
+static bool compiles_program(const driver_options& options) {
+    return options.run || options.dump_bytecode || options.dump_ir || options.native != native_output::NONE;
+}
 
-        { named(EQUALS),           "=="                        },
-        { named(NOT_EQUAL),        "!="                        },
-        { named(GREATER),          ">"                         },
-        { named(GREATER_OR_EQUAL), ">="                        },
-        { named(LESS),             "<"                         },
-        { named(LESS_OR_EQUAL),    "<="                        },
+static void run_program(ast_program* program, const driver_options& options) {
+    flat_ast tree = flatten(program);
 
-        { named(MINUS),            "-"                         },
-        { named(MUL),              "*"                         },
-        { named(PLUS),             "+"                         },
-        { named(DIV),              "/"                         },
-        { named(SEMICOLON),        ";"                         },
+    // Native code is compiled from register bytecode as well
+    std::optional<register_program> bytecode;
+    if (options.register_vm || options.dump_ir || options.native != native_output::NONE)
+        bytecode = compile_register(tree, options);
 
-        { named(LCB),              "{"                         },
-        { named(RCB),              "}"                         },
+    if (options.native != native_output::NONE)
+        write_native(*bytecode, options);
 
-        { named(LRB),              "[(]"                       },
-        { named(RRB),              "[)]"                       },
+    if (!options.run && !options.dump_bytecode)
+        return;
 
-        { named(DEFUN),            "defun"                     },
-        { named(RETURN),           "return"                    },
+    if (options.register_vm)
+        run_bytecode(tree, *bytecode, options);
+    else
+        run_bytecode(tree, compile_stack(tree), options);
+}
 
-        { named(IF),               "if"                        },
-        { named(ELSE),             "else"                      },
+void create_program_parser(const driver_options& options) {
+    time_report report(options.file_name);
+    time_report_scope report_scope(options.time_report ? &report : nullptr);
 
-        { named(LET),              "let"                       },
+    ::memory_report memory;
+    memory_report_scope memory_scope(options.memory_report ? &memory : nullptr);
 
-        { named(WHILE),            "while"                     },
+    trace_events trace;
+    trace_events_scope trace_scope(!options.trace_file.empty() ? &trace : nullptr);
 
-        { named(FOR),              "for"                       },
-        { named(IN),               "in"                        },
+    std::optional<trace_span> compile_span;
+    compile_span.emplace("file", tracing() ? "compile " + options.file_name : "");
 
-        { named(INT),              "int"                       },
+    language_grammar grammar = create_optimized_grammar(options);
+    auto& program = grammar.program;
 
-        { named(NAME),             "[A-Za-z_]([A-Za-z0-9_])"   },
-        { named(NUMBER),           "[0-9]([0-9])"              }
-    });
+    std::string file_name = options.file_name;
+    std::string program_str = read_phase(file_name);
 
-    std::vector<lang::lexem> lexems = lexer.analyse(program_str, file_name);
-    for (auto el: lexems) {
-        std::cout << "note: detected lexem: <"<< lexer.get_token_name(el.id) << ">\n";
-        std::cout << el.location.underlined_location(&program_str) << "\n\n";
-    }
+    lang::lexer lexer = lexer_phase();
 
-    lexems.push_back(lang::END_LEXEM);
+    lang::token_buffer tokens(lex_phase(lexer, program_str, file_name));
+    lang::token_cursor cursor(tokens.span());
 
-    auto start = std::chrono::high_resolution_clock::now();
-    auto lexem_iterator = lexems.begin();
-    auto finish = std::chrono::high_resolution_clock::now();
-    std::cout << "lexical analysis: " << (double) std::chrono::duration_cast<std::chrono::nanoseconds>(finish-start).count() / 1e9 << "s\n";
+    if (options.dump_tokens)
+        for (const lang::lexem& el: std::span(tokens.span().lexems, tokens.span().size)) {
+            std::cout << "note: detected lexem: <"<< lexer.get_token_name(el.id) << ">\n";
+            std::cout << el.location.underlined_location(&program_str) << "\n\n";
+        }
 
     auto show_graph = [](auto&& graph) { digraph_render_and_destory(&graph); };
     show_graph(program.graph());
 
-    start = std::chrono::high_resolution_clock::now();
+    // All the nodes of the tree are freed at once with the arena
+    arena ast_arena = {};
+    TRY arena_create(&ast_arena)
+        THROW("Failed to create arena for syntax tree!");
+
+    lang::arena_scope ast_arena_scope(&ast_arena);
 
-    auto parsed = program.parse(lexem_iterator);
+    std::vector<arena> worker_arenas; // Used for functions parsed in parallel
+
+    lang::parse_profiler profiler; // Only installed with -fprofile-parser
+    std::vector<lang::parse_error> diagnostics; // Collected with -frecover
+
+    std::optional<lang::compiled_parser<ast_program*>> table;
+    if (options.table_parse) {
+        table.emplace(program, grammar.names);
+
+        for (const auto& conflict: table->conflicts())
+            std::cout << "note: " << conflict << "\n";
+
+        if (!table->conflicts().empty()) {
+            std::cout << "note: grammar isn't LL(1), parsing with combinators\n";
+            table.reset();
+        }
+    }
 
-    finish = std::chrono::high_resolution_clock::now();
-    std::cout << "         parsing: " << (double) std::chrono::duration_cast<std::chrono::nanoseconds>(finish-start).count() / 1e9 << "s\n";
+    std::optional<ast_program*> parsed;
 
-    if (parsed)
+    std::optional<phase_timer> parse_timer;
+    parse_timer.emplace("parse");
+
+    if (options.parallel_parse)
+        parsed = parse_in_parallel(grammar.function, tokens.span(), options.parse_threads, worker_arenas);
+    else if (table)
+        parsed = table->parse(cursor);
+    else {
+        lang::profiler_scope profiler_scope(options.profile_parser ? &profiler : nullptr);
+        lang::diagnostics_scope diagnostics_scope(options.recover ? &diagnostics : nullptr);
+
+        parsed = program.parse(cursor);
+    }
+
+    // Program parser stops before what isn't a function, it's an error too
+    if (parsed && !options.parallel_parse && !cursor.at_end())
+        throw lang::parse_error(lang::unparsed_input_error(cursor));
+
+    parse_timer.reset();
+
+    if (options.profile_parser) {
+        profiler.report(std::cout, grammar.names);
+
+        lang::profiler_scope profiler_scope(&profiler);
+        show_graph(program.graph()); // Colored by time spent in each parser
+    }
+
+    for (const auto& diagnostic: diagnostics)
+        std::cerr << diagnostic.what() << "\n";
+
+    if (parsed && diagnostics.empty()) {
+        phase_timer timer("dump");
         (*parsed)->show();
 
+        if (options.dump_flat_ast)
+            flatten(*parsed).dump(std::cout);
+    }
+
+    if (parsed && diagnostics.empty() && compiles_program(options))
+        run_program(*parsed, options);
+
+    for (auto& worker_arena: worker_arenas)
+        arena_destroy(&worker_arena);
+
+    arena_destroy(&ast_arena);
+
+    compile_span.reset();
 
-    // return program.own(function, body, statement, expression, term, arg, cond);
+    if (options.time_report)
+        report.print(std::cout);
+
+    if (options.memory_report)
+        memory.print(std::cout);
+
+    if (!options.trace_file.empty())
+        write_trace(trace, options.trace_file);
+
+    if (!diagnostics.empty())
+        throw std::runtime_error(std::to_string(diagnostics.size()) +
+                                 (diagnostics.size() == 1 ? " syntax error found" : " syntax errors found"));
 }
 
+// Parse file again whenever it changes, only edited functions are reparsed
+void watch_program(const driver_options& options) {
+    time_report report(options.file_name); // Of all parses together
+    time_report_scope report_scope(options.time_report ? &report : nullptr);
+
+    ::memory_report memory;
+    memory_report_scope memory_scope(options.memory_report ? &memory : nullptr);
+
+    trace_events trace; // Written after every parse
+    trace_events_scope trace_scope(!options.trace_file.empty() ? &trace : nullptr);
 
+    language_grammar grammar = create_optimized_grammar(options);
+    lang::lexer lexer = lexer_phase();
+
+    incremental_parser parser(grammar.function, options.parallel_parse ? options.parse_threads : 1);
+
+    std::filesystem::file_time_type last_change = {};
+    while (true) {
+        std::filesystem::file_time_type change = std::filesystem::last_write_time(options.file_name);
+        if (change == last_change) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        last_change = change;
+
+        std::string program_str = read_phase(options.file_name);
+
+        try {
+            lang::token_buffer tokens(lex_phase(lexer, program_str, options.file_name));
+
+            auto start = std::chrono::high_resolution_clock::now();
+            ast_program* parsed = nullptr;
+            {
+                phase_timer timer("parse");
+                parsed = parser.parse(tokens.span());
+            }
+            auto finish = std::chrono::high_resolution_clock::now();
+
+            std::cout << "parsed " << parsed->m_functions.size() << " functions: "
+                      << parser.reparsed_functions() << " reparsed, "
+                      << parser.reused_functions() << " reused in "
+                      << (double) std::chrono::duration_cast<std::chrono::nanoseconds>(finish-start).count() / 1e9 << "s\n";
+
+            if (options.dump_flat_ast)
+                flatten(parsed).dump(std::cout);
+
+            if (compiles_program(options))
+                run_program(parsed, options);
+        } catch (const std::exception& error) {
+            std::cout << error.what() << "\n";
+        }
+
+        if (options.time_report)
+            report.print(std::cout);
+
+        if (options.memory_report)
+            memory.print(std::cout);
+
+        if (!options.trace_file.empty())
+            write_trace(trace, options.trace_file);
+    }
+}
+
+int main(int argc, char* argv[]) try {
+    driver_options options = parse_options(argc, argv);
+
+    if (options.analyse_grammar) {
+        language_grammar grammar = create_language_grammar();
+
+        lang::grammar_report report = lang::analyse_grammar(grammar.program.node(), grammar.names);
+        report.print(std::cout);
+
+        return report.has_errors() ? 1 : 0;
+    }
 
-int main(void) {
-    create_program_parser();
+    if (options.watch)
+        watch_program(options);
+    else
+        create_program_parser(options);
+} catch (const std::runtime_error& error) {
+    std::cerr << error.what() << "\n";
+    return 1;
 }
@@ -0,0 +1,90 @@
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Grammar the driver builds with -fno-left-factor
+static language_grammar& unfactored_grammar() {
+    static language_grammar grammar = create_language_grammar();
+    return grammar;
+}
+
+// Dump of flat tree of the program, or its syntax error
+static std::string parse_with(const std::string& source, language_grammar& grammar) {
+    lang::token_buffer tokens(test_lexer().analyse(source, "test.prog"));
+    lang::token_cursor cursor(tokens.span());
+
+    arena ast_arena = {};
+    TRY arena_create(&ast_arena)
+        THROW("Failed to create arena for syntax tree!");
+
+    std::string result;
+    try {
+        lang::arena_scope ast_arena_scope(&ast_arena);
+
+        lang::furthest_failure = { cursor, {} };
+
+        std::optional<ast_program*> parsed = grammar.program.parse(cursor);
+        if (!parsed || !cursor.at_end())
+            throw lang::unparsed_input_error(cursor);
+
+        std::stringstream dump;
+        flatten(*parsed).dump(dump);
+        result = dump.str();
+    } catch (const lang::parse_error& error) {
+        result = error.what();
+    }
+
+    arena_destroy(&ast_arena);
+    return result;
+}
+
+static const std::vector<std::string> sources = {
+    "defun main() {\n"
+    "    let total = 0\n"
+    "    for (i in 0..10) {\n"
+    "        total = add(total, i * 2) - (total + 1) / 3\n"
+    "    }\n"
+    "    if (total > 5) { return total; }\n"
+    "    while (total < 100) { total = total * 2 }\n"
+    "    return f(g(1), h());\n"
+    "}\n",
+
+    "defun add(a, b) { return a + b; }\n"
+    "defun main() { return add(1, add(2, 3)) + x; }\n"
+};
+
+static const std::vector<std::string> broken_sources = {
+    "defun main() { return add(1, ; }\n",
+    "defun main() { return add(1 2); }\n",
+    "defun main() { let x = }\n",
+    "defun main() { x = 1 + ; return x; }\n",
+    "defun main() { if (x > ) { return 1; } }\n",
+    "defun main() { for (i in 0..) { } }\n",
+    "defun main( { return 1; }\n",
+    "defun main() { return 1; }\nreturn 2;\n"
+};
+
+TEST(factored_grammar_builds_the_same_trees) {
+    for (const auto& source: sources) {
+        std::string expected = parse_with(source, unfactored_grammar());
+        ASSERT_EQUAL(expected.starts_with("error: "), false);
+
+        ASSERT_STRING_EQUAL(parse_with(source, test_grammar()), expected);
+    }
+}
+
+TEST(factored_grammar_reports_the_same_errors) {
+    for (const auto& source: broken_sources) {
+        std::string expected = parse_with(source, unfactored_grammar());
+        ASSERT_EQUAL(expected.find("error: ") != std::string::npos, true);
+
+        ASSERT_STRING_EQUAL(parse_with(source, test_grammar()), expected);
+    }
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
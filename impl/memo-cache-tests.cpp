@@ -0,0 +1,82 @@
+#include "memo-cache.h"
+#include "test-framework.h"
+
+#include <cstdint>
+#include <vector>
+
+TEST(results_are_found_by_arguments) {
+    memo_cache cache(2);
+
+    int64_t key[] = { 1, 2 }, swapped[] = { 2, 1 };
+    ASSERT_EQUAL(cache.find(key) == nullptr, true);
+
+    cache.insert(key, 3);
+    ASSERT_EQUAL((int) *cache.find(key), 3);
+    ASSERT_EQUAL(cache.find(swapped) == nullptr, true);
+
+    // The same arguments replace their result
+    cache.insert(key, 4);
+    ASSERT_EQUAL((int) *cache.find(key), 4);
+    ASSERT_EQUAL((int) cache.size(), 1);
+}
+
+TEST(table_grows_and_keeps_every_result) {
+    memo_cache cache(1);
+
+    // Far past the 16 rows table starts with, so it doubles many times
+    for (int64_t i = 0; i < 10000; ++ i)
+        cache.insert(&i, i * 3);
+
+    ASSERT_EQUAL((int) cache.size(), 10000);
+
+    for (int64_t i = 0; i < 10000; ++ i) {
+        const int64_t* found = cache.find(&i);
+        ASSERT_EQUAL(found != nullptr && *found == i * 3, true);
+    }
+
+    int64_t missing = 10000;
+    ASSERT_EQUAL(cache.find(&missing) == nullptr, true);
+}
+
+// Table is at most half full, so many keys share their first row and are found by probing
+TEST(colliding_keys_are_told_apart) {
+    memo_cache cache(2);
+
+    std::vector<int64_t> keys;
+    for (int64_t a = -20; a < 20; ++ a)
+        for (int64_t b = -20; b < 20; ++ b)
+            keys.insert(keys.end(), { a, b });
+
+    for (size_t i = 0; i < keys.size(); i += 2)
+        cache.insert(&keys[i], keys[i] * 100 + keys[i + 1]);
+
+    ASSERT_EQUAL((int) cache.size(), 1600);
+
+    for (size_t i = 0; i < keys.size(); i += 2)
+        ASSERT_EQUAL((int) *cache.find(&keys[i]), (int) (keys[i] * 100 + keys[i + 1]));
+
+    // Extremes of the range differ in the bits hash mixes last
+    int64_t extremes[] = { INT64_MIN, INT64_MAX };
+    cache.insert(extremes, 1);
+    ASSERT_EQUAL((int) *cache.find(extremes), 1);
+
+    int64_t reversed[] = { INT64_MAX, INT64_MIN };
+    ASSERT_EQUAL(cache.find(reversed) == nullptr, true);
+}
+
+// Function without arguments has one result, key is empty
+TEST(arity_zero_has_one_entry) {
+    memo_cache cache(0);
+    ASSERT_EQUAL(cache.find(nullptr) == nullptr, true);
+
+    cache.insert(nullptr, 42);
+    ASSERT_EQUAL((int) *cache.find(nullptr), 42);
+
+    cache.insert(nullptr, 7);
+    ASSERT_EQUAL((int) *cache.find(nullptr), 7);
+    ASSERT_EQUAL((int) cache.size(), 1);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
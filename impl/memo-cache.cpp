@@ -0,0 +1,59 @@
+#include "memo-cache.h"
+
+#include <algorithm>
+#include <utility>
+
+memo_cache::memo_cache(uint32_t arity)
+    : m_arity(arity), m_rows(16 * row_size()), m_used(16) {}
+
+// Multiply and fold of splitmix64 on every argument, small consecutive integers spread over the table
+uint64_t memo_cache::hash(const int64_t* arguments) const {
+    uint64_t hash = m_arity;
+    for (uint32_t i = 0; i < m_arity; ++ i) {
+        hash = (hash ^ (uint64_t) arguments[i]) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 31;
+    }
+
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    return hash ^ (hash >> 27);
+}
+
+size_t memo_cache::find_row(const int64_t* arguments) const {
+    size_t mask = capacity() - 1;
+
+    for (size_t row = hash(arguments) & mask; ; row = (row + 1) & mask)
+        if (!m_used[row] || std::equal(arguments, arguments + m_arity, &m_rows[row * row_size()]))
+            return row;
+}
+
+const int64_t* memo_cache::find(const int64_t* arguments) const {
+    size_t row = find_row(arguments);
+    return m_used[row] ? &m_rows[row * row_size() + m_arity] : nullptr;
+}
+
+void memo_cache::insert(const int64_t* arguments, int64_t result) {
+    if (2 * (m_size + 1) > capacity())
+        grow();
+
+    size_t row = find_row(arguments);
+    if (!m_used[row]) {
+        m_used[row] = true;
+        ++ m_size;
+    }
+
+    std::copy(arguments, arguments + m_arity, &m_rows[row * row_size()]);
+    m_rows[row * row_size() + m_arity] = result;
+}
+
+void memo_cache::grow() {
+    std::vector<int64_t> rows = std::move(m_rows);
+    std::vector<bool> used = std::move(m_used);
+
+    m_rows.assign(2 * rows.size(), 0);
+    m_used.assign(2 * used.size(), false);
+    m_size = 0;
+
+    for (size_t row = 0; row < used.size(); ++ row)
+        if (used[row])
+            insert(&rows[row * row_size()], rows[row * row_size() + m_arity]);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Results of pure function by tuple of its arguments. Hash table with
+ * open addressing and linear probing, arguments and result of entry
+ * are stored in one row of flat array, so lookup allocates nothing.
+ * Entries are never removed, table doubles when it's half full.
+ */
+class memo_cache {
+public:
+    explicit memo_cache(uint32_t arity);
+
+    // Result for /arity/ arguments, nullptr if it's not cached
+    const int64_t* find(const int64_t* arguments) const;
+
+    void insert(const int64_t* arguments, int64_t result);
+
+    size_t size() const { return m_size; }
+
+private:
+    uint32_t m_arity;
+    size_t m_size = 0;
+
+    std::vector<int64_t> m_rows; // Arguments then result, capacity() of them
+    std::vector<bool> m_used;
+
+    size_t capacity() const { return m_used.size(); }
+    size_t row_size() const { return m_arity + 1; }
+
+    uint64_t hash(const int64_t* arguments) const;
+    size_t find_row(const int64_t* arguments) const; // Of entry for arguments or free one
+
+    void grow();
+};
@@ -0,0 +1,113 @@
+#include "arena.h"
+#include "memory-report.h"
+#include "time-report.h"
+#include "test-framework.h"
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The same calls track_allocation and track_free make, with exact sizes
+static void allocated(size_t bytes) {
+    current_allocation_tracker->allocated(current_allocation_tracker->context, bytes);
+}
+
+static void freed(size_t bytes) {
+    current_allocation_tracker->freed(current_allocation_tracker->context, bytes);
+}
+
+static std::vector<std::string> printed_lines(const memory_report& report) {
+    std::stringstream printed;
+    report.print(printed);
+
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(printed, line); )
+        lines.push_back(line);
+
+    return lines;
+}
+
+TEST(allocations_go_to_the_running_phase) {
+    memory_report report;
+
+    {
+        memory_report_scope scope(&report);
+        allocated(100);
+
+        {
+            phase_timer parse("parse");
+            allocated(1000);
+            allocated(24);
+            freed(1000);
+
+            phase_timer lex("lex"); // Nested phase takes over until it ends
+            allocated(10);
+        }
+
+        phase_timer parse("parse");
+        allocated(6);
+    }
+
+    std::vector<std::string> lines = printed_lines(report);
+    ASSERT_EQUAL((int) lines.size(), 7);
+
+    ASSERT_STRING_EQUAL(lines[0], std::string("memory report:"));
+    ASSERT_STRING_EQUAL(lines[2], std::string("  other                       1            100            100"));
+    ASSERT_STRING_EQUAL(lines[3], std::string("  parse                       3           1030           1124"));
+    ASSERT_STRING_EQUAL(lines[4], std::string("  lex                         1             10            134"));
+    ASSERT_STRING_EQUAL(lines[5], std::string("  total                       5           1140           1124"));
+    ASSERT_STRING_EQUAL(lines[6], std::string("  peak in use is reached during parse"));
+}
+
+TEST(phases_without_allocations_are_left_out) {
+    memory_report report;
+
+    {
+        memory_report_scope scope(&report);
+        phase_timer read("read");
+    }
+
+    std::vector<std::string> lines = printed_lines(report);
+    ASSERT_EQUAL((int) lines.size(), 3);
+    ASSERT_EQUAL(lines[2].starts_with("  total                       0"), true);
+}
+
+TEST(arenas_are_tracked_only_while_report_is_installed) {
+    memory_report report;
+
+    arena untracked = {};
+    TRY arena_create(&untracked)
+        THROW("Failed to create arena!");
+
+    {
+        memory_report_scope scope(&report);
+        ASSERT_EQUAL(current_allocation_tracker == report.tracker(), true);
+
+        phase_timer parse("parse");
+
+        arena tracked = {};
+        TRY arena_create(&tracked)
+            THROW("Failed to create arena!");
+
+        arena_destroy(&tracked);
+    }
+
+    arena_destroy(&untracked);
+    ASSERT_EQUAL(current_allocation_tracker == nullptr, true);
+
+    std::vector<std::string> lines = printed_lines(report);
+    ASSERT_EQUAL(lines[2].starts_with("  parse "), true);
+
+    // Blocks of the arena created in parse are counted there
+    std::stringstream parse_row(lines[2]);
+    std::string phase;
+    size_t allocations = 0, bytes = 0;
+    parse_row >> phase >> allocations >> bytes;
+
+    ASSERT_EQUAL(allocations > 0 && bytes > 0, true);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
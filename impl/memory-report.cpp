@@ -0,0 +1,83 @@
+#include "memory-report.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+
+memory_report::memory_report()
+    : m_tracker({
+          .allocated = [](void* report, size_t bytes) { ((memory_report*) report)->allocated(bytes); },
+          .freed     = [](void* report, size_t bytes) { ((memory_report*) report)->freed(bytes); },
+          .context   = this
+      }),
+      m_current(nullptr) {
+
+    m_current = &m_phases.emplace_back("other"); // Outside of any phase
+}
+
+memory_report::phase_memory* memory_report::enter(const char* phase) {
+    std::lock_guard lock(m_phases_mutex);
+
+    phase_memory* entered = nullptr;
+    for (auto& current: m_phases)
+        if (std::strcmp(current.phase, phase) == 0)
+            entered = &current;
+
+    if (entered == nullptr)
+        entered = &m_phases.emplace_back(phase);
+
+    return m_current.exchange(entered);
+}
+
+void memory_report::allocated(size_t bytes) {
+    phase_memory* phase = m_current;
+
+    phase->allocations += 1;
+    phase->bytes += bytes;
+
+    int64_t in_use = m_in_use += (int64_t) bytes;
+
+    auto raise = [](std::atomic<int64_t>& peak, int64_t value) {
+        int64_t current = peak;
+        while (value > current && !peak.compare_exchange_weak(current, value));
+
+        return value > current;
+    };
+
+    raise(phase->peak, in_use);
+    if (raise(m_peak, in_use))
+        m_peak_phase = phase->phase;
+}
+
+void memory_report::freed(size_t bytes) {
+    m_in_use -= (int64_t) bytes;
+}
+
+void memory_report::print(std::ostream& os) const {
+    char line[256];
+
+    os << "memory report:\n";
+    snprintf(line, sizeof(line), "  %-16s %12s %14s %14s\n", "phase", "allocations", "bytes", "peak in use");
+    os << line;
+
+    size_t total_allocations = 0, total_bytes = 0;
+    for (const auto& current: m_phases) {
+        if (current.allocations == 0)
+            continue;
+
+        snprintf(line, sizeof(line), "  %-16s %12zu %14zu %14lld\n", current.phase,
+                 current.allocations.load(), current.bytes.load(), (long long) current.peak.load());
+        os << line;
+
+        total_allocations += current.allocations;
+        total_bytes += current.bytes;
+    }
+
+    snprintf(line, sizeof(line), "  %-16s %12zu %14zu %14lld\n", "total",
+             total_allocations, total_bytes, (long long) m_peak.load());
+    os << line;
+
+    const char* peak_phase = m_peak_phase;
+    if (peak_phase != nullptr)
+        os << "  peak in use is reached during " << peak_phase << "\n";
+}
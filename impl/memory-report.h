@@ -0,0 +1,85 @@
+#pragma once
+
+#include "safe-alloc.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <mutex>
+
+/**
+ * Memory taken in every driver phase (see phase_timer): number of
+ * allocations, their bytes and peak of memory in use while the phase
+ * ran. Allocations come through allocation_tracker, from operator new
+ * (replaced by the driver) and from c-lib's safe_* functions and arenas.
+ *
+ * Sizes are the ones malloc reserved, so same input gives the same
+ * report, as long as parsing isn't parallel.
+ */
+class memory_report {
+public:
+    memory_report();
+
+    memory_report(const memory_report&) = delete;
+    memory_report& operator=(const memory_report&) = delete;
+
+    allocation_tracker* tracker() { return &m_tracker; }
+
+    struct phase_memory;
+
+    // Attribute following allocations to /phase/, returns phase to restore
+    phase_memory* enter(const char* phase);
+    void leave(phase_memory* previous) { m_current = previous; }
+
+    void print(std::ostream& os) const;
+
+    struct phase_memory {
+        const char* phase;
+
+        std::atomic<size_t> allocations = 0, bytes = 0;
+        std::atomic<int64_t> peak = 0; // Of memory in use
+    };
+
+private:
+    allocation_tracker m_tracker;
+
+    std::mutex m_phases_mutex;
+    std::deque<phase_memory> m_phases; // Never moved, so they can be referenced
+    std::atomic<phase_memory*> m_current;
+
+    // Memory allocated before report was installed may be freed while it is,
+    // so use can go below zero
+    std::atomic<int64_t> m_in_use = 0, m_peak = 0;
+    std::atomic<const char*> m_peak_phase = nullptr;
+
+    void allocated(size_t bytes);
+    void freed(size_t bytes);
+};
+
+// Global like allocation_tracker, since worker threads allocate too
+inline std::atomic<memory_report*> current_memory_report = nullptr;
+
+class memory_report_scope {
+public:
+    memory_report_scope(memory_report* new_report)
+        : m_saved_report(current_memory_report.exchange(new_report)),
+          m_saved_tracker(current_allocation_tracker) {
+
+        if (new_report != nullptr)
+            current_allocation_tracker = new_report->tracker();
+    }
+
+    ~memory_report_scope() {
+        current_allocation_tracker = m_saved_tracker;
+        current_memory_report = m_saved_report;
+    }
+
+    memory_report_scope(const memory_report_scope&) = delete;
+    memory_report_scope& operator=(const memory_report_scope&) = delete;
+
+private:
+    memory_report* m_saved_report;
+    allocation_tracker* m_saved_tracker;
+};
@@ -0,0 +1,219 @@
+#include "elf-object.h"
+#include "test-programs.h"
+#include "test-framework.h"
+#include "x86-assembly.h"
+#include "x86-codegen.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Functions lowered the way -S and -c lower them
+static std::vector<x86_function> native_functions(const register_program& program) {
+    std::vector<x86_function> functions;
+    for (uint32_t i = 0; i < program.functions.size(); ++ i)
+        functions.push_back(lower_to_x86(program, i, { .runtime_checks = false }));
+
+    return functions;
+}
+
+// Standard output of /command/, or "failed" if it doesn't exit with 0
+static std::string output_of(const std::string& command) {
+    FILE* pipe = popen((command + " 2>&1").c_str(), "r");
+    if (pipe == nullptr)
+        return "failed";
+
+    std::string output;
+    char buffer[4096];
+    while (size_t read = fread(buffer, 1, sizeof(buffer), pipe))
+        output.append(buffer, read);
+
+    return pclose(pipe) == 0 ? output : "failed";
+}
+
+static bool can_link() {
+    return jit_compiler::supported() && std::system("cc --version > /dev/null 2>&1") == 0;
+}
+
+// Temporary directory with the program written both as object and as assembly,
+// each linked with C driver that prints what /call/ returns
+class native_build {
+public:
+    native_build(const std::string& source, const std::string& declarations, const std::string& call, int optimize) {
+        char directory[] = "/tmp/native-output-XXXXXX";
+        m_directory = mkdtemp(directory);
+
+        std::vector<x86_function> functions = native_functions(compile_program(source, optimize));
+
+        std::ofstream object(path("program.o"), std::ios::binary);
+        write_elf_object(object, functions);
+        object.close();
+
+        std::ofstream assembly(path("program.s"));
+        print_x86_assembly(assembly, functions);
+        assembly.close();
+
+        std::ofstream driver(path("driver.c"));
+        driver << "#include <stdio.h>\n"
+               << declarations << "\n"
+               << "int main(void) {\n"
+               << "    printf(\"%ld\", (long) " << call << ");\n"
+               << "    return 0;\n"
+               << "}\n";
+        driver.close();
+
+        m_assembled = output_of("cc -c -o " + path("assembled.o") + " " + path("program.s")) != "failed";
+        m_linked = output_of("cc -o " + path("object") + " " + path("driver.c") + " " + path("program.o")) != "failed" &&
+                   output_of("cc -o " + path("assembly") + " " + path("driver.c") + " " + path("assembled.o")) != "failed";
+    }
+
+    ~native_build() {
+        std::filesystem::remove_all(m_directory);
+    }
+
+    bool built() const { return m_assembled && m_linked; }
+
+    std::string path(const std::string& file) const { return (m_directory / file).string(); }
+
+    std::string run(const std::string& executable) const { return output_of(path(executable)); }
+
+private:
+    std::filesystem::path m_directory;
+    bool m_assembled = false, m_linked = false;
+};
+
+static const std::string fib =
+    "defun fib(n) {\n"
+    "    if (n < 2) {\n"
+    "        return n;\n"
+    "    }\n"
+    "    return fib(n - 1) + fib(n - 2);\n"
+    "}\n";
+
+static const std::string digits =
+    "defun digits(a, b, c, d, e, f, g, h) {\n"
+    "    return a * 10000000 + b * 1000000 + c * 100000 + d * 10000 + e * 1000 + f * 100 + g * 10 + h;\n"
+    "}\n"
+    "defun reversed(x) {\n"
+    "    return digits(x + 7, x + 6, x + 5, x + 4, x + 3, x + 2, x + 1, x);\n"
+    "}\n";
+
+static const std::string loops =
+    "defun divisions(n, d) {\n"
+    "    let sum = 0\n"
+    "    for (i in 0..n) {\n"
+    "        sum = sum + (i * 1000000007) / d\n"
+    "    }\n"
+    "    return sum;\n"
+    "}\n"
+    "defun is_even(n) {\n"
+    "    if (n == 0) {\n"
+    "        return 1;\n"
+    "    }\n"
+    "    return is_odd(n - 1);\n"
+    "}\n"
+    "defun is_odd(n) {\n"
+    "    if (n == 0) {\n"
+    "        return 0;\n"
+    "    }\n"
+    "    return is_even(n - 1);\n"
+    "}\n";
+
+TEST(linked_programs_return_what_interpreter_does) {
+    if (!can_link())
+        return;
+
+    for (int optimize: { 0, 1 }) {
+        native_build fibs(fib, "long fib(long);", "fib(25)", optimize);
+        ASSERT_EQUAL(fibs.built(), true);
+        ASSERT_STRING_EQUAL(fibs.run("object"), std::string("75025"));
+        ASSERT_STRING_EQUAL(fibs.run("assembly"), std::string("75025"));
+
+        // C passes the last two arguments on stack, just like native code does
+        native_build arguments(digits, "long digits(long, long, long, long, long, long, long, long); long reversed(long);",
+                               "digits(1, 2, 3, 4, 5, 6, 7, 8) - reversed(1)", optimize);
+        ASSERT_EQUAL(arguments.built(), true);
+        ASSERT_STRING_EQUAL(arguments.run("object"), std::string("-75308643"));
+        ASSERT_STRING_EQUAL(arguments.run("assembly"), std::string("-75308643"));
+
+        native_build loop(loops, "long divisions(long, long); long is_even(long);",
+                          "divisions(1000, 0 - 7) * 10 + is_even(1001)", optimize);
+        ASSERT_EQUAL(loop.built(), true);
+
+        std::string expected = run_source(loops + "defun main() { return divisions(1000, 0 - 7) * 10 + is_even(1001); }");
+        ASSERT_STRING_EQUAL(loop.run("object"), expected);
+        ASSERT_STRING_EQUAL(loop.run("assembly"), expected);
+    }
+}
+
+// Without runtime checks stack would just overflow, if tail calls used it
+TEST(deep_tail_recursion_runs_in_constant_stack) {
+    if (!can_link())
+        return;
+
+    std::string source = "defun count(n, total) {\n"
+                         "    if (n == 0) {\n"
+                         "        return total;\n"
+                         "    }\n"
+                         "    return count(n - 1, total + 2);\n"
+                         "}\n" + loops;
+
+    native_build build(source, "long count(long, long); long is_even(long);",
+                       "count(10000000, 1) * 10 + is_even(10000000)", 1);
+    ASSERT_EQUAL(build.built(), true);
+
+    ASSERT_STRING_EQUAL(build.run("object"), std::string("200000011"));
+    ASSERT_STRING_EQUAL(build.run("assembly"), std::string("200000011"));
+}
+
+// Global symbols defined by object file, as their names and types
+static std::string symbols(const std::string& object) {
+    return output_of("nm --defined-only --format=posix " + object + " | cut -d ' ' -f 1,2");
+}
+
+// Functions that every function of linked executable calls or jumps to, in order
+static std::map<std::string, std::string> calls(const std::string& executable, const std::vector<x86_function>& functions) {
+    std::map<std::string, std::string> targets;
+    for (const auto& function: functions)
+        targets[function.name] = output_of("objdump -d --no-show-raw-insn --disassemble=" + function.name + " " + executable +
+                                           " | grep -oE '(call|jmp) +[0-9a-f]+ <[A-Za-z_0-9]+>' | grep -oE '<.*>' || true");
+
+    return targets;
+}
+
+TEST(object_and_assembly_agree) {
+    if (!can_link())
+        return;
+
+    for (int optimize: { 0, 1 }) {
+        std::string source = fib + digits + loops;
+        native_build build(source, "long fib(long);", "fib(10)", optimize);
+        ASSERT_EQUAL(build.built(), true);
+
+        std::string defined = symbols(build.path("program.o"));
+        ASSERT_STRING_EQUAL(defined, symbols(build.path("assembled.o")));
+        ASSERT_STRING_EQUAL(defined, std::string("digits T\ndivisions T\nfib T\nis_even T\nis_odd T\nreversed T\n"));
+
+        // Calls are resolved when object is written, assembler leaves them to linker
+        ASSERT_STRING_EQUAL(output_of("objdump -r " + build.path("program.o") + " | grep -c R_X86_64 || true"), std::string("0\n"));
+
+        std::vector<x86_function> functions = native_functions(compile_program(source, optimize));
+        std::map<std::string, std::string> object_calls = calls(build.path("object"), functions);
+
+        ASSERT_EQUAL(object_calls == calls(build.path("assembly"), functions), true);
+        ASSERT_STRING_EQUAL(object_calls["fib"], std::string("<fib>\n<fib>\n"));
+        ASSERT_STRING_EQUAL(object_calls["is_even"], std::string("<is_odd>\n"));
+
+        // -O1 inlines the call, and makes mutual recursion a jump
+        ASSERT_STRING_EQUAL(object_calls["reversed"], std::string(optimize ? "" : "<digits>\n"));
+    }
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,115 @@
+#include "parallel-parse.h"
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Dump of flat tree of the program parsed on /threads/, or its syntax error
+static std::string parse_on(const std::string& source, size_t threads) {
+    lang::token_buffer tokens(test_lexer().analyse(source, "test.prog"));
+
+    arena program_arena = {};
+    TRY arena_create(&program_arena)
+        THROW("Failed to create arena for syntax tree!");
+
+    std::vector<arena> worker_arenas;
+
+    std::string result;
+    try {
+        lang::arena_scope scope(&program_arena);
+
+        std::stringstream dump;
+        flatten(parse_in_parallel(test_grammar().function, tokens.span(), threads, worker_arenas)).dump(dump);
+        result = dump.str();
+    } catch (const lang::parse_error& error) {
+        result = error.what();
+    }
+
+    for (auto& worker_arena: worker_arenas)
+        arena_destroy(&worker_arena);
+
+    arena_destroy(&program_arena);
+    return result;
+}
+
+// The same as parse_on, but parsed the way the driver parses without -fparallel-parse
+static std::string parse_sequentially(const std::string& source) {
+    try {
+        std::stringstream dump;
+        parse_program(source).dump(dump);
+        return dump.str();
+    } catch (const lang::parse_error& error) {
+        return error.what();
+    }
+}
+
+static const std::string functions =
+    "defun first(a) {\n"
+    "    return a + 1;\n"
+    "}\n"
+    "defun second(b) {\n"
+    "    return b * 2;\n"
+    "}\n";
+
+// Program of /count/ functions, each calling the one before it, body of
+// function listed in /broken/ is replaced with the given text
+static std::string many_functions(size_t count, const std::vector<std::pair<size_t, std::string>>& broken = {}) {
+    std::string source;
+    for (size_t i = 0; i < count; ++ i) {
+        std::string body = i == 0 ? "    return a;\n"
+                                  : "    let b = f" + std::to_string(i - 1) + "(a) + " + std::to_string(i) + "\n"
+                                    "    while (b > 100) { b = b - 100 }\n"
+                                    "    return b;\n";
+
+        for (const auto& [index, replacement]: broken)
+            if (index == i)
+                body = replacement;
+
+        source += "defun f" + std::to_string(i) + "(a) {\n" + body + "}\n";
+    }
+
+    return source;
+}
+
+TEST(parallel_tree_is_the_same_as_sequential) {
+    std::string source = many_functions(24);
+
+    std::string expected = parse_sequentially(source);
+    ASSERT_EQUAL(expected.starts_with("error: "), false);
+
+    for (size_t threads: { 1, 2, 8, 0 })
+        ASSERT_STRING_EQUAL(parse_on(source, threads), expected);
+}
+
+TEST(first_error_by_position_is_reported) {
+    // Neither error is in the first chunk, and workers may meet the later one first
+    std::string first = "    let b = a +\n    return b;\n", second = "    return ;\n";
+    std::string source = many_functions(24, { { 7, first }, { 19, second } });
+
+    std::string expected = parse_sequentially(source);
+    ASSERT_EQUAL(expected.starts_with("error: "), true);
+
+    ASSERT_STRING_EQUAL(parse_sequentially(many_functions(24, { { 7, first } })), expected);
+    ASSERT_EQUAL(parse_sequentially(many_functions(24, { { 19, second } })) != expected, true);
+
+    for (int repeat = 0; repeat < 10; ++ repeat)
+        for (size_t threads: { 1, 2, 8, 0 })
+            ASSERT_STRING_EQUAL(parse_on(source, threads), expected);
+}
+
+TEST(input_outside_functions_is_an_error) {
+    for (const std::string& source: { functions + "return 2;\n", "return 2;\n" + functions }) {
+        std::string expected = parse_sequentially(source);
+        ASSERT_EQUAL(expected.starts_with("error: "), true);
+
+        ASSERT_STRING_EQUAL(parse_on(source, 1), expected);
+        ASSERT_STRING_EQUAL(parse_on(source, 2), expected);
+    }
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
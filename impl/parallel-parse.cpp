@@ -0,0 +1,145 @@
+#include "parallel-parse.h"
+#include "definitions.h"
+#include "trace-events.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <new>
+#include <thread>
+
+std::vector<token_range> split_top_level_functions(const lang::token_span& tokens) {
+    using enum language_lexem;
+
+    size_t end = tokens.size;
+    std::vector<token_range> ranges;
+
+    int depth = 0;
+    size_t begin = 0;
+    for (size_t i = 0; i < end; ++ i) {
+        switch (tokens.ids[i]) {
+        case LCB: ++ depth; break;
+        case RCB: -- depth; break;
+
+        case DEFUN:
+            if (depth == 0 && i != begin) {
+                ranges.push_back({ begin, i });
+                begin = i;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (begin != end)
+        ranges.push_back({ begin, end });
+
+    return ranges;
+}
+
+std::string defined_function_name(const lang::token_span& tokens, token_range range) {
+    if (range.end - range.begin < 2 || tokens.ids[range.begin + 1] != language_lexem::NAME)
+        return "<unnamed>";
+
+    return tokens.lexems[range.begin + 1].value;
+}
+
+void run_on_workers(size_t task_count, size_t thread_count,
+                    const std::function<void(size_t worker, size_t task)>& run_task) {
+
+    std::atomic<size_t> next_task = 0;
+
+    std::vector<std::thread> workers;
+    for (size_t worker = 0; worker < thread_count; ++ worker)
+        workers.emplace_back([&, worker]() {
+            for (size_t task; (task = next_task ++) < task_count; )
+                run_task(worker, task);
+        });
+
+    for (auto& worker: workers)
+        worker.join();
+}
+
+struct parsed_function {
+    ast_function* function = nullptr;
+    size_t end = 0; // Index of the first lexem after function
+
+    std::exception_ptr error;
+};
+
+ast_program* parse_in_parallel(lang::parser_w<ast_function*>& function,
+                               const lang::token_span& tokens, size_t thread_count,
+                               std::vector<arena>& worker_arenas) {
+
+    std::vector<token_range> ranges = split_top_level_functions(tokens);
+
+    if (thread_count == 0)
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    thread_count = std::max<size_t>(std::min(thread_count, ranges.size()), 1);
+
+    // Arenas are created upfront, so vector isn't reallocated under workers
+    size_t first_arena = worker_arenas.size();
+    for (size_t i = 0; i < thread_count; ++ i) {
+        arena worker_arena = {};
+        TRY arena_create(&worker_arena)
+            CATCH({ trace_destruct(__trace); throw std::bad_alloc(); });
+
+        worker_arenas.push_back(worker_arena);
+    }
+
+    // Functions after the first failed one won't make it into program
+    std::atomic<size_t> first_failed = ranges.size();
+
+    std::vector<parsed_function> parsed(ranges.size());
+    run_on_workers(ranges.size(), thread_count, [&](size_t worker, size_t task) {
+        if (task > first_failed)
+            return;
+
+        lang::arena_scope scope(&worker_arenas[first_arena + worker]);
+        trace_span span("parse", tracing() ? "parse " + defined_function_name(tokens, ranges[task]) : "");
+
+        try {
+            // Other functions don't need to be cut off, function's grammar
+            // stops right before the next DEFUN anyway
+            lang::token_cursor position(tokens, ranges[task].begin);
+            lang::furthest_failure = { position, {} }; // Left by the previous task otherwise
+
+            auto result = function.parse(position);
+            if (result) {
+                parsed[task].function = *result;
+                parsed[task].end = position.index();
+            }
+
+            // Sequential parser would try to parse a function right after
+            // this one and fail, so expected lexems are noted the same way
+            if (result && parsed[task].end != ranges[task].end) {
+                lang::token_cursor next = position;
+                function.parse(next);
+            }
+
+            if (!result || parsed[task].end != ranges[task].end)
+                throw lang::unparsed_input_error(position);
+        } catch (...) {
+            parsed[task].error = std::current_exception();
+        }
+
+        if (parsed[task].error) {
+            size_t failed = first_failed;
+            while (task < failed && !first_failed.compare_exchange_weak(failed, task));
+        }
+    });
+
+    // Ranges are in source order, so the first error is the first one in the file
+    std::vector<ast_function*> functions;
+    for (size_t i = 0; i < ranges.size(); ++ i) {
+        if (parsed[i].error)
+            std::rethrow_exception(parsed[i].error);
+
+        functions.push_back(parsed[i].function);
+    }
+
+    return lang::allocate_node<ast_program>(functions);
+}
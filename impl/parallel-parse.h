@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ast.h"
+#include "arena.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct token_range {
+    size_t begin, end; // Half-open range of indices in lexems
+};
+
+// Split lexems before every DEFUN that isn't nested in braces,
+// each range is a candidate for a single function definition
+std::vector<token_range> split_top_level_functions(const lang::token_span& tokens);
+
+// Name after DEFUN that starts the range, used to label trace spans
+std::string defined_function_name(const lang::token_span& tokens, token_range range);
+
+// Run tasks on /thread_count/ threads, each task is taken by the first free worker
+void run_on_workers(size_t task_count, size_t thread_count,
+                    const std::function<void(size_t worker, size_t task)>& run_task);
+
+/**
+ * Parse top-level functions concurrently and assemble program in source
+ * order. Result is the same as the one of many(function) that has to
+ * parse all tokens: the first function that fails to parse or doesn't
+ * end where the next one starts throws lang::parse_error.
+ *
+ * Functions are allocated in per-worker arenas that are appended to
+ * @arg worker_arenas and owned by caller, program node itself is placed
+ * in lang::current_arena.
+ *
+ * @arg thread_count 0 to use all available cores
+ */
+ast_program* parse_in_parallel(lang::parser_w<ast_function*>& function,
+                               const lang::token_span& tokens, size_t thread_count,
+                               std::vector<arena>& worker_arenas);
@@ -0,0 +1,117 @@
+#include "parse-error.h"
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <string>
+#include <vector>
+
+// Error as line:column and the message, without the underlined source
+static std::string describe(const lang::parse_error& error) {
+    std::string message = error.what();
+    return std::to_string(error.location.position.line) + ":" +
+           std::to_string(error.location.position.column) + " " + message.substr(0, message.find(":\n"));
+}
+
+// Errors collected in recovery mode (-frecover), or only the first one without it
+static std::vector<std::string> syntax_errors(const std::string& source, bool recover) {
+    lang::token_buffer tokens(test_lexer().analyse(source, "test.prog"));
+    lang::token_cursor cursor(tokens.span());
+
+    arena ast_arena = {};
+    TRY arena_create(&ast_arena)
+        THROW("Failed to create arena for syntax tree!");
+
+    std::vector<lang::parse_error> diagnostics;
+    std::vector<std::string> errors;
+
+    try {
+        lang::arena_scope ast_arena_scope(&ast_arena);
+        lang::diagnostics_scope diagnostics_scope(recover ? &diagnostics : nullptr);
+
+        lang::furthest_failure = { cursor, {} }; // Other tokens may have been at the same address
+
+        if (test_grammar().program.parse(cursor) && !cursor.at_end())
+            throw lang::unparsed_input_error(cursor);
+    } catch (const lang::parse_error& error) {
+        errors.push_back(describe(error));
+    }
+
+    arena_destroy(&ast_arena);
+
+    for (const auto& diagnostic: diagnostics)
+        errors.push_back(describe(diagnostic));
+
+    return errors;
+}
+
+static const std::string broken_functions =
+    "defun broken(a) {\n"
+    "    let x = + 1\n"
+    "    return x;\n"
+    "}\n"
+    "\n"
+    "defun fine(b) {\n"
+    "    return b;\n"
+    "}\n"
+    "\n"
+    "defun also_broken(c) {\n"
+    "    return c +;\n"
+    "    return c;\n"
+    "}\n"
+    "\n"
+    "defun main() {\n"
+    "    let y = (1\n"
+    "    return y;\n"
+    "}\n";
+
+TEST(every_broken_function_is_reported) {
+    std::vector<std::string> errors = syntax_errors(broken_functions, true);
+
+    ASSERT_EQUAL((int) errors.size(), 3);
+    ASSERT_STRING_EQUAL(errors[0], std::string("2:13 error: expected LRB, NUMBER or NAME, but got '+'"));
+    ASSERT_STRING_EQUAL(errors[1], std::string("11:15 error: expected LRB, NUMBER or NAME, but got ';'"));
+    ASSERT_STRING_EQUAL(errors[2], std::string("17:5 error: expected MUL, DIV, PLUS, MINUS or RRB, but got 'return'"));
+}
+
+TEST(only_first_error_is_reported_without_recovery) {
+    std::vector<std::string> errors = syntax_errors(broken_functions, false);
+
+    ASSERT_EQUAL((int) errors.size(), 1);
+    ASSERT_STRING_EQUAL(errors[0], std::string("2:13 error: expected LRB, NUMBER or NAME, but got '+'"));
+}
+
+// 'let x = 1' is a complete statement, so the error is found
+// trying to continue it, not where the next one fails to start
+TEST(first_error_is_the_same_with_recovery) {
+    std::string source = "defun main() {\n    let x = 1 +\n    return x;\n}\n";
+    std::string expected = "3:5 error: expected LRB, NUMBER or NAME, but got 'return'";
+
+    std::vector<std::string> recovered = syntax_errors(source, true);
+    ASSERT_EQUAL((int) recovered.size(), 1);
+    ASSERT_STRING_EQUAL(recovered[0], expected);
+
+    std::vector<std::string> first = syntax_errors(source, false);
+    ASSERT_EQUAL((int) first.size(), 1);
+    ASSERT_STRING_EQUAL(first[0], expected);
+}
+
+// Program parser stops at what doesn't start a function, driver reports what's left
+TEST(input_after_the_last_function_is_an_error) {
+    std::string source = "defun main() {\n    return 1;\n}\nreturn 2;\n";
+
+    std::vector<std::string> errors = syntax_errors(source, false);
+    ASSERT_EQUAL((int) errors.size(), 1);
+    ASSERT_STRING_EQUAL(errors[0], std::string("4:1 error: expected DEFUN, but got 'return'"));
+
+    errors = syntax_errors("return 2;\n" + source, false);
+    ASSERT_EQUAL((int) errors.size(), 1);
+    ASSERT_STRING_EQUAL(errors[0], std::string("1:1 error: expected DEFUN, but got 'return'"));
+}
+
+TEST(valid_program_has_no_errors_with_recovery) {
+    ASSERT_EQUAL((int) syntax_errors("defun main() {\n    return 1;\n}\n", true).size(), 0);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,62 @@
+#include "program-symbols.h"
+
+#include <stdexcept>
+
+function_table::function_table(const flat_ast& tree) {
+    for (uint32_t function: tree.children_of(tree.root())) {
+        const flat_node& node = tree.nodes[function];
+
+        auto [position, inserted] = m_indices.try_emplace(node.value, (uint32_t) m_functions.size());
+        if (!inserted)
+            throw std::runtime_error(compile_error(tree, node.value, "function is defined twice"));
+
+        // Every child but the body is a parameter
+        m_functions.push_back({ function, node.value, node.child_count - 1 });
+    }
+}
+
+std::optional<uint32_t> function_table::find(int32_t name) const {
+    auto position = m_indices.find(name);
+    if (position == m_indices.end())
+        return std::nullopt;
+
+    return position->second;
+}
+
+uint32_t function_table::callee(const flat_ast& tree, uint32_t node, int32_t caller) const {
+    const flat_node& call = tree.nodes[node];
+
+    std::optional<uint32_t> index = find(call.value);
+    if (!index)
+        throw std::runtime_error(compile_error(tree, caller,
+            "call of undefined function " + std::string(tree.name(call.value))));
+
+    if (m_functions[*index].arity != call.child_count)
+        throw std::runtime_error(compile_error(tree, caller,
+            std::string(tree.name(call.value)) + " takes " + std::to_string(m_functions[*index].arity) +
+            " arguments, but is called with " + std::to_string(call.child_count)));
+
+    return *index;
+}
+
+void local_scopes::leave() {
+    m_bindings.resize(m_scope_starts.back());
+    m_scope_starts.pop_back();
+}
+
+uint32_t local_scopes::declare(int32_t name) {
+    m_bindings.emplace_back(name, m_slot_count);
+    return m_slot_count ++;
+}
+
+std::optional<uint32_t> local_scopes::find(int32_t name) const {
+    for (auto binding = m_bindings.rbegin(); binding != m_bindings.rend(); ++ binding)
+        if (binding->first == name)
+            return binding->second;
+
+    return std::nullopt;
+}
+
+std::string compile_error(const flat_ast& tree, int32_t function, const std::string& message) {
+    return "error: " + message + " in function " + std::string(tree.name(function));
+}
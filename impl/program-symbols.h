@@ -0,0 +1,63 @@
+#pragma once
+
+#include "flat-ast.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct function_symbol {
+    uint32_t node;  // FUNCTION node in flat_ast
+    int32_t  name;  // Name id
+    uint32_t arity;
+};
+
+/**
+ * Functions of a flattened program, indexed in definition order, which
+ * is also the order every backend numbers them in.
+ */
+class function_table {
+public:
+    explicit function_table(const flat_ast& tree); // Throws if function is defined twice
+
+    const std::vector<function_symbol>& functions() const { return m_functions; }
+
+    std::optional<uint32_t> find(int32_t name) const;
+
+    // Index of callee of FUNCTION_CALL /node/, throws if it's undefined or arity differs
+    uint32_t callee(const flat_ast& tree, uint32_t node, int32_t caller) const;
+
+private:
+    std::vector<function_symbol> m_functions;
+    std::unordered_map<int32_t, uint32_t> m_indices; // Name id -> index
+};
+
+/**
+ * Lexical scopes of a function body: names are mapped to slots, inner
+ * declarations shadow outer ones until their scope is left. Slots are
+ * never reused, so every declaration gets its own.
+ */
+class local_scopes {
+public:
+    void enter() { m_scope_starts.push_back(m_bindings.size()); }
+    void leave();
+
+    uint32_t declare(int32_t name);
+    uint32_t temporary() { return m_slot_count ++; } // Slot without name, e.g. bound of a loop
+
+    std::optional<uint32_t> find(int32_t name) const;
+
+    uint32_t slot_count() const { return m_slot_count; }
+
+private:
+    std::vector<std::pair<int32_t, uint32_t>> m_bindings; // Name id -> slot, innermost last
+    std::vector<size_t> m_scope_starts;
+
+    uint32_t m_slot_count = 0;
+};
+
+// Message of error found while compiling /function/
+std::string compile_error(const flat_ast& tree, int32_t function, const std::string& message);
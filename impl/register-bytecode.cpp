@@ -0,0 +1,415 @@
+#include "register-bytecode.h"
+#include "program-symbols.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <unordered_map>
+
+const char* register_op_name(register_op op) {
+    switch (op) {
+    case register_op::MOVE:                     return "move";
+    case register_op::ADD:                      return "add";
+    case register_op::SUB:                      return "sub";
+    case register_op::MUL:                      return "mul";
+    case register_op::DIV:                      return "div";
+    case register_op::NEG:                      return "neg";
+    case register_op::JUMP:                     return "jump";
+    case register_op::JUMP_IF_LESS:             return "jump_if_less";
+    case register_op::JUMP_IF_LESS_OR_EQUAL:    return "jump_if_less_or_equal";
+    case register_op::JUMP_IF_GREATER:          return "jump_if_greater";
+    case register_op::JUMP_IF_GREATER_OR_EQUAL: return "jump_if_greater_or_equal";
+    case register_op::JUMP_IF_EQUALS:           return "jump_if_equals";
+    case register_op::JUMP_IF_NOT_EQUALS:       return "jump_if_not_equals";
+    case register_op::CALL:                     return "call";
+    case register_op::TAIL_CALL:                return "tail_call";
+    case register_op::RETURN:                   return "return";
+    }
+
+    return "?";
+}
+
+register_op inverted_branch(register_op op) {
+    switch (op) {
+    case register_op::JUMP_IF_LESS:             return register_op::JUMP_IF_GREATER_OR_EQUAL;
+    case register_op::JUMP_IF_LESS_OR_EQUAL:    return register_op::JUMP_IF_GREATER;
+    case register_op::JUMP_IF_GREATER:          return register_op::JUMP_IF_LESS_OR_EQUAL;
+    case register_op::JUMP_IF_GREATER_OR_EQUAL: return register_op::JUMP_IF_LESS;
+    case register_op::JUMP_IF_EQUALS:           return register_op::JUMP_IF_NOT_EQUALS;
+    case register_op::JUMP_IF_NOT_EQUALS:       return register_op::JUMP_IF_EQUALS;
+
+    default:
+        throw std::logic_error(std::string(register_op_name(op)) + " isn't a conditional branch");
+    }
+}
+
+const register_function* register_program::find(const std::string& name) const {
+    for (const auto& function: functions)
+        if (function.name == name)
+            return &function;
+
+    return nullptr;
+}
+
+uint32_t register_program::end_of(uint32_t index) const {
+    return index + 1 < functions.size() ? functions[index + 1].entry : (uint32_t) code.size();
+}
+
+void register_program::dump(std::ostream& os) const {
+    char line[128];
+
+    for (uint32_t i = 0; i < functions.size(); ++ i) {
+        const register_function& function = functions[i];
+
+        os << function.name << ": " << function.arity << " arguments, " << function.registers << " registers";
+        for (size_t j = 0; j < function.constants.size(); ++ j)
+            os << (j == 0 ? ", constants " : ", ") << "r" << function.arity + j << " = " << function.constants[j];
+        os << "\n";
+
+        for (uint32_t j = function.entry; j < end_of(i); ++ j) {
+            const register_instruction& current = code[j];
+            const char* name = register_op_name(current.op);
+
+            switch (current.op) {
+            case register_op::MOVE: case register_op::NEG:
+                snprintf(line, sizeof(line), "  %6u  %-26s r%u, r%u\n", j, name, current.a, current.b);
+                break;
+
+            case register_op::JUMP:
+                snprintf(line, sizeof(line), "  %6u  %-26s %u\n", j, name, current.a);
+                break;
+
+            case register_op::CALL:
+                snprintf(line, sizeof(line), "  %6u  %-26s r%u, %s(r%u...)\n", j, name,
+                         current.a, functions[current.c].name.c_str(), current.b);
+                break;
+
+            case register_op::TAIL_CALL:
+                snprintf(line, sizeof(line), "  %6u  %-26s %s(r%u...)\n", j, name,
+                         functions[current.c].name.c_str(), current.b);
+                break;
+
+            case register_op::RETURN:
+                snprintf(line, sizeof(line), "  %6u  %-26s r%u\n", j, name, current.a);
+                break;
+
+            case register_op::ADD: case register_op::SUB: case register_op::MUL: case register_op::DIV:
+                snprintf(line, sizeof(line), "  %6u  %-26s r%u, r%u, r%u\n", j, name, current.a, current.b, current.c);
+                break;
+
+            default: // Conditional branches
+                snprintf(line, sizeof(line), "  %6u  %-26s r%u, r%u, %u\n", j, name, current.b, current.c, current.a);
+                break;
+            }
+
+            os << line;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+class register_compiler {
+public:
+    register_compiler(const flat_ast& tree, register_program& program)
+        : m_tree(tree), m_program(program), m_functions(tree) {}
+
+    void compile_program() {
+        uint32_t first_node = 0; // Of subtree of the function, nodes are in post-order
+        for (const auto& symbol: m_functions.functions()) {
+            compile_function(symbol, first_node);
+            first_node = symbol.node + 1;
+        }
+    }
+
+private:
+    const flat_ast& m_tree;
+    register_program& m_program;
+
+    function_table m_functions;
+
+    // State of the function being compiled, registers are laid out as
+    // arguments, constants, variables (slots of m_scopes past arguments), temporaries
+    int32_t m_function_name = 0;
+    uint32_t m_arity = 0;
+
+    std::vector<int64_t> m_constants;
+    std::unordered_map<int64_t, uint32_t> m_constant_registers;
+
+    local_scopes m_scopes;
+    uint32_t m_first_temporary = 0, m_next_temporary = 0, m_registers = 0;
+
+    void compile_function(const function_symbol& symbol, uint32_t first_node) {
+        m_function_name = symbol.name;
+        m_arity = symbol.arity;
+
+        m_constants.clear();
+        m_constant_registers.clear();
+        m_scopes = {};
+
+        // Constants and variables are counted ahead, so temporaries can go after them
+        uint32_t slots = symbol.arity;
+        for (uint32_t node = first_node; node < symbol.node; ++ node)
+            switch (m_tree.nodes[node].kind) {
+            case ast_kind::NUMBER:     add_constant(m_tree.nodes[node].value);   break;
+            case ast_kind::ASSIGNMENT: slots += 1;                               break;
+            case ast_kind::FOR:        slots += 2; add_constant(1);              break; // Bound and variable
+            default:                                                            break;
+            }
+
+        add_constant(0); // Returned by falling off the end
+
+        m_first_temporary = m_next_temporary = m_registers = (uint32_t) m_constants.size() + slots;
+
+        uint32_t entry = (uint32_t) m_program.code.size();
+        std::span<const uint32_t> children = m_tree.children_of(symbol.node);
+
+        m_scopes.enter();
+        for (uint32_t i = 0; i < symbol.arity; ++ i)
+            m_scopes.declare(m_tree.nodes[children[i]].value);
+
+        compile_statement(children.back());
+        emit(register_op::RETURN, constant(0));
+
+        m_scopes.leave();
+
+        m_program.functions.push_back({
+            .name = std::string(m_tree.name(symbol.name)),
+            .arity = symbol.arity, .registers = m_registers, .constants = m_constants,
+            .entry = entry
+        });
+    }
+
+    void add_constant(int64_t value) {
+        auto [position, inserted] =
+            m_constant_registers.try_emplace(value, m_arity + (uint32_t) m_constants.size());
+
+        if (inserted)
+            m_constants.push_back(value);
+    }
+
+    uint32_t constant(int64_t value) const { return m_constant_registers.at(value); }
+
+    // Register of slot of m_scopes, constants are placed between arguments and variables
+    uint32_t register_of(uint32_t slot) const {
+        return slot < m_arity ? slot : slot + (uint32_t) m_constants.size();
+    }
+
+    uint32_t variable(int32_t name) const {
+        std::optional<uint32_t> slot = m_scopes.find(name);
+        if (!slot)
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                                                   "undefined variable " + std::string(m_tree.name(name))));
+
+        return register_of(*slot);
+    }
+
+    uint32_t temporary() {
+        m_registers = std::max(m_registers, m_next_temporary + 1);
+        return m_next_temporary ++;
+    }
+
+    uint32_t emit(register_op op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+        m_program.code.push_back({ op, a, b, c });
+        return (uint32_t) m_program.code.size() - 1;
+    }
+
+    uint32_t here() const { return (uint32_t) m_program.code.size(); }
+    void patch(uint32_t jump, uint32_t target) { m_program.code[jump].a = target; }
+
+    void compile_statement(uint32_t node) {
+        const flat_node& current = m_tree.nodes[node];
+        std::span<const uint32_t> children = m_tree.children_of(node);
+
+        m_next_temporary = m_first_temporary; // Values of temporaries don't outlive a statement
+
+        switch (current.kind) {
+        case ast_kind::BODY:
+            m_scopes.enter();
+            for (uint32_t statement: children)
+                compile_statement(statement);
+            m_scopes.leave();
+            break;
+
+        case ast_kind::ASSIGNMENT: {
+            // Variable gets the next slot, but can't be referred to in its own initializer
+            uint32_t slot = m_scopes.slot_count();
+            compile_into(children[0], register_of(slot));
+
+            m_scopes.declare(current.value);
+            break;
+        }
+
+        case ast_kind::REASSIGNMENT:
+            compile_into(children[0], variable(current.value));
+            break;
+
+        case ast_kind::RETURN:
+            emit(register_op::RETURN, compile_expression(children[0]));
+            break;
+
+        case ast_kind::IF: {
+            uint32_t skip = compile_branch(children[0], false);
+
+            compile_statement(children[1]);
+            patch(skip, here());
+            break;
+        }
+
+        case ast_kind::WHILE: {
+            // Condition is placed after the body, so every iteration takes one jump
+            uint32_t to_condition = emit(register_op::JUMP);
+
+            uint32_t body = here();
+            compile_statement(children[1]);
+
+            patch(to_condition, here());
+            patch(compile_branch(children[0], true), body);
+            break;
+        }
+
+        case ast_kind::FOR: {
+            // Bounds are evaluated once, before the variable comes into scope
+            m_scopes.enter();
+
+            uint32_t bound = register_of(m_scopes.temporary());
+            uint32_t variable = register_of(m_scopes.slot_count());
+
+            compile_into(children[0], variable);
+            compile_into(children[1], bound);
+
+            m_scopes.declare(current.value);
+
+            uint32_t to_condition = emit(register_op::JUMP);
+
+            uint32_t body = here();
+            compile_statement(children[2]);
+
+            emit(register_op::ADD, variable, variable, constant(1));
+
+            patch(to_condition, here());
+            emit(register_op::JUMP_IF_LESS, body, variable, bound);
+
+            m_scopes.leave();
+            break;
+        }
+
+        default:
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                std::string("unexpected ") + ast_kind_name(current.kind) + " in statement position"));
+        }
+    }
+
+    // Emit jump that is taken when comparison /node/ is /when/, returns it to be patched
+    uint32_t compile_branch(uint32_t node, bool when) {
+        const flat_node& current = m_tree.nodes[node];
+        std::span<const uint32_t> children = m_tree.children_of(node);
+
+        register_op op;
+        switch (current.kind) {
+        case ast_kind::LESS:             op = register_op::JUMP_IF_LESS;             break;
+        case ast_kind::LESS_OR_EQUAL:    op = register_op::JUMP_IF_LESS_OR_EQUAL;    break;
+        case ast_kind::GREATER:          op = register_op::JUMP_IF_GREATER;          break;
+        case ast_kind::GREATER_OR_EQUAL: op = register_op::JUMP_IF_GREATER_OR_EQUAL; break;
+        case ast_kind::EQUALS:           op = register_op::JUMP_IF_EQUALS;           break;
+        case ast_kind::NOT_EQUALS:       op = register_op::JUMP_IF_NOT_EQUALS;       break;
+
+        default:
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                std::string("unexpected ") + ast_kind_name(current.kind) + " in condition"));
+        }
+
+        uint32_t mark = m_next_temporary;
+        uint32_t lhs = compile_expression(children[0]);
+        uint32_t rhs = compile_expression(children[1]);
+        m_next_temporary = mark;
+
+        return emit(when ? op : inverted_branch(op), 0, lhs, rhs);
+    }
+
+    void compile_into(uint32_t node, uint32_t target) {
+        uint32_t result = compile_expression(node, target);
+        if (result != target)
+            emit(register_op::MOVE, target, result);
+    }
+
+    // Register that holds value of expression, which is /target/ if it's computed
+    // by an instruction, variables and constants are used where they are
+    uint32_t compile_expression(uint32_t node, std::optional<uint32_t> target = std::nullopt) {
+        const flat_node& current = m_tree.nodes[node];
+        std::span<const uint32_t> children = m_tree.children_of(node);
+
+        // Temporaries of operands are free once the instruction that reads them is emitted,
+        // result may reuse one of them, since operands are read before result is written
+        uint32_t mark = m_next_temporary;
+        auto result = [&] {
+            m_next_temporary = mark;
+            return target ? *target : temporary();
+        };
+
+        switch (current.kind) {
+        case ast_kind::NUMBER:
+            return constant(current.value);
+
+        case ast_kind::VAR:
+            return variable(current.value);
+
+        case ast_kind::FUNCTION_CALL: {
+            uint32_t callee = m_functions.callee(m_tree, node, m_function_name);
+
+            // Arguments go to consecutive registers
+            uint32_t first = m_next_temporary;
+            for (size_t i = 0; i < children.size(); ++ i)
+                temporary();
+
+            for (size_t i = 0; i < children.size(); ++ i)
+                compile_into(children[i], first + (uint32_t) i);
+
+            uint32_t value = result();
+            emit(register_op::CALL, value, first, callee);
+            return value;
+        }
+
+        case ast_kind::UNARY_MINUS: {
+            uint32_t operand = compile_expression(children[0]);
+
+            uint32_t value = result();
+            emit(register_op::NEG, value, operand);
+            return value;
+        }
+
+        default:
+            break;
+        }
+
+        register_op op;
+        switch (current.kind) {
+        case ast_kind::ADD: op = register_op::ADD; break;
+        case ast_kind::SUB: op = register_op::SUB; break;
+        case ast_kind::MUL: op = register_op::MUL; break;
+        case ast_kind::DIV: op = register_op::DIV; break;
+
+        default:
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                std::string("unexpected ") + ast_kind_name(current.kind) + " in expression"));
+        }
+
+        uint32_t lhs = compile_expression(children[0]);
+        uint32_t rhs = compile_expression(children[1]);
+
+        uint32_t value = result();
+        emit(op, value, lhs, rhs);
+        return value;
+    }
+};
+
+register_program compile_register_program(const flat_ast& tree) {
+    register_program program;
+
+    register_compiler compiler(tree, program);
+    compiler.compile_program();
+
+    return program;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "flat-ast.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+enum class register_op: uint8_t {
+    MOVE,                   // a = b
+
+    ADD, SUB, MUL, DIV,     // a = b op c
+    NEG,                    // a = -b
+
+    JUMP,                   // Goto a
+
+    // Goto a if b compares to c so, comparisons only ever feed branches
+    JUMP_IF_LESS, JUMP_IF_LESS_OR_EQUAL, JUMP_IF_GREATER, JUMP_IF_GREATER_OR_EQUAL,
+    JUMP_IF_EQUALS, JUMP_IF_NOT_EQUALS,
+
+    CALL,                   // a = function c with arguments in registers starting at b
+    TAIL_CALL,              // Return what function c returns for arguments starting at b, callee takes frame over
+    RETURN                  // Return a
+};
+
+const char* register_op_name(register_op op);
+
+// Branch that is taken exactly when /op/ isn't, e.g. >= for <
+register_op inverted_branch(register_op op);
+
+struct register_instruction {
+    register_op op;
+    uint32_t a, b, c; //!< Registers, except jump targets and callees
+};
+
+/**
+ * Frame is a file of registers: arguments come first, then constants,
+ * which are copied in on every call, so that instructions only refer to
+ * registers, then variables and temporaries.
+ */
+struct register_function {
+    std::string name;
+
+    uint32_t arity;
+    uint32_t registers;              //!< Size of frame
+    std::vector<int64_t> constants;  //!< Values of registers right after arguments
+
+    uint32_t entry;                  //!< Index of the first instruction in register_program::code
+};
+
+// Code of every function is in one dense array, just like in stack_program
+struct register_program {
+    std::vector<register_instruction> code;
+    std::vector<register_function> functions;
+
+    const register_function* find(const std::string& name) const;
+
+    // Instructions of functions[index], which are followed by the next function's
+    uint32_t end_of(uint32_t index) const;
+
+    void dump(std::ostream& os) const;
+};
+
+/**
+ * Translate syntax tree to three-address code, variables declared with
+ * let and loop variables are mapped to fixed registers, temporaries are
+ * reused as soon as expression that needed them is computed.
+ *
+ * Throws std::runtime_error if program refers to undefined names.
+ */
+register_program compile_register_program(const flat_ast& tree);
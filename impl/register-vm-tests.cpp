@@ -0,0 +1,250 @@
+#include "function-purity.h"
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string run_stack(const std::string& source) {
+    try {
+        return run_main(compile_stack_program(parse_program(source)));
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+}
+
+static std::string run_register(const std::string& source) {
+    try {
+        return run_main(compile_register_program(parse_program(source)));
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+}
+
+static std::string dump(const std::string& source) {
+    std::stringstream dump;
+    compile_register_program(parse_program(source)).dump(dump);
+    return dump.str();
+}
+
+static const std::string doubling =
+    "defun add(a, b) {\n"
+    "    return a + b;\n"
+    "}\n"
+    "\n"
+    "defun main() {\n"
+    "    let x = add(1, 2)\n"
+    "    while (x < 10) {\n"
+    "        x = x * 2\n"
+    "    }\n"
+    "    return x;\n"
+    "}\n";
+
+TEST(bytecode_dump) {
+    ASSERT_STRING_EQUAL(dump(doubling), std::string(
+        "add: 2 arguments, 4 registers, constants r2 = 0\n"
+        "       0  add                        r3, r0, r1\n"
+        "       1  return                     r3\n"
+        "       2  return                     r2\n"
+        "main: 0 arguments, 7 registers, constants r0 = 1, r1 = 2, r2 = 10, r3 = 0\n"
+        "       3  move                       r5, r0\n"
+        "       4  move                       r6, r1\n"
+        "       5  call                       r4, add(r5...)\n"
+        "       6  jump                       8\n"
+        "       7  mul                        r4, r4, r1\n"
+        "       8  jump_if_less               r4, r2, 7\n"
+        "       9  return                     r4\n"
+        "      10  return                     r3\n"));
+}
+
+// Temporaries of a statement are free once it's done, and
+// operands of an expression once it's computed
+TEST(temporaries_are_reused) {
+    std::string once = "defun main() {\n"
+                       "    let x = 1\n"
+                       "    x = (x + 1) * (x + 2)\n"
+                       "    return x;\n"
+                       "}\n";
+
+    std::string repeated = "defun main() {\n"
+                           "    let x = 1\n"
+                           "    x = (x + 1) * (x + 2)\n"
+                           "    x = (x + 1) * (x + 2)\n"
+                           "    x = (x + 1) * (x + 2)\n"
+                           "    return x;\n"
+                           "}\n";
+
+    // 3 constants, x and 2 temporaries
+    ASSERT_EQUAL((int) compile_register_program(parse_program(once)).functions[0].registers, 6);
+    ASSERT_EQUAL((int) compile_register_program(parse_program(repeated)).functions[0].registers, 6);
+
+    std::string wide = "defun main() {\n"
+                       "    let x = 1\n"
+                       "    return (x + 1) * (x + 1) + (x + 1) * (x + 1) + (x + 1) * (x + 1);\n"
+                       "}\n";
+
+    // 2 constants, x and 4 temporaries: every product goes to the register
+    // of its left operand, the right one is free for the next product
+    ASSERT_EQUAL((int) compile_register_program(parse_program(wide)).functions[0].registers, 7);
+}
+
+static const std::vector<std::string> programs = {
+    doubling,
+
+    "defun main() {\n"
+    "    let sum = 0\n"
+    "    for (i in 1..5) {\n"
+    "        for (j in 0..i) {\n"
+    "            sum = sum + j\n"
+    "        }\n"
+    "    }\n"
+    "    return sum;\n"
+    "}\n",
+
+    "defun fib(n) {\n"
+    "    if (n < 2) {\n"
+    "        return n;\n"
+    "    }\n"
+    "    return fib(n - 1) + fib(n - 2);\n"
+    "}\n"
+    "defun main() { return fib(20); }\n",
+
+    "defun main() { return 1000000 * 1000000 * 1000000 * 10; }",
+    "defun main() { return ((0 - 7) / 2) * 1000 + 7 / (0 - 2); }",
+    "defun main() {\n"
+    "    let min = 1073741824 * 1073741824 * 8\n"
+    "    return min / (0 - 1) + (min - 1);\n"
+    "}\n",
+
+    "defun main() { return g(1); }",
+    "defun f(a) { return a; }\ndefun main() { return f(1, 2); }",
+    "defun f(n) { return 1 + f(n + 1); }\ndefun main() { return f(0); }",
+    "defun f(a) { return 5 / a; }\ndefun main() { return f(0); }"
+};
+
+TEST(results_are_the_same_as_in_stack_vm) {
+    for (const auto& program: programs)
+        ASSERT_STRING_EQUAL(run_register(program), run_stack(program));
+}
+
+TEST(arithmetic_and_errors) {
+    ASSERT_STRING_EQUAL(run_register(programs[2]), std::string("6765"));
+    ASSERT_STRING_EQUAL(run_register(programs[4]), std::string("-3003"));
+    ASSERT_STRING_EQUAL(run_register(programs[5]), std::string("-1"));
+
+    ASSERT_STRING_EQUAL(run_register(programs[6]), std::string("error: call of undefined function g in function main"));
+    ASSERT_STRING_EQUAL(run_register(programs[8]), std::string("error: stack overflow in function f"));
+    ASSERT_STRING_EQUAL(run_register(programs[9]), std::string("error: division by zero in function f"));
+}
+
+// Like run_main, with pure recursive functions memoized the way -fmemoize does it
+static std::string run_memoized(const std::string& source, int optimize) {
+    try {
+        register_program program = compile_program(source, optimize);
+        std::vector<function_purity> purity = analyze_purity(parse_program(source));
+
+        register_vm vm(program);
+        for (uint32_t i = 0; i < purity.size(); ++ i)
+            if (purity[i].pure && purity[i].recursive)
+                vm.memoize(i);
+
+        return std::to_string(vm.call(main_index(program), {}));
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+}
+
+static const std::string parity =
+    "defun is_even(n) {\n"
+    "    if (n == 0) {\n"
+    "        return 1;\n"
+    "    }\n"
+    "    return is_odd(n - 1);\n"
+    "}\n"
+    "defun is_odd(n) {\n"
+    "    if (n == 0) {\n"
+    "        return 0;\n"
+    "    }\n"
+    "    return is_even(n - 1);\n"
+    "}\n";
+
+static const std::vector<std::string> memoized_programs = {
+    programs[2],
+    "defun fib(n) {\n"
+    "    if (n < 2) {\n"
+    "        return n;\n"
+    "    }\n"
+    "    return fib(n - 1) + fib(n - 2);\n"
+    "}\n"
+    "defun main() { return fib(30) - fib(29) * 2; }\n",
+
+    // At -O1 these are chains of tail calls, memo of the first call is completed by the last one's return
+    parity + "defun main() { return is_even(1000) * 10 + is_odd(1001); }\n",
+    parity + "defun main() { return is_odd(77) * 100 + is_even(78) * 10 + is_even(77); }\n",
+    "defun count(n, total) {\n"
+    "    if (n == 0) {\n"
+    "        return total;\n"
+    "    }\n"
+    "    return count(n - 1, total + 2);\n"
+    "}\n"
+    "defun main() { return count(1000, 1) + count(999, 3); }\n",
+
+    programs[8],
+    programs[9]
+};
+
+TEST(memoized_results_are_the_same) {
+    for (int optimize: { 0, 1 })
+        for (const auto& program: memoized_programs)
+            ASSERT_STRING_EQUAL(run_memoized(program, optimize), run_source(program, optimize));
+
+    ASSERT_STRING_EQUAL(run_memoized(memoized_programs[2], 1), std::string("11"));
+    ASSERT_STRING_EQUAL(run_memoized(memoized_programs[3], 1), std::string("110"));
+}
+
+TEST(tail_calls_of_memoized_functions_are_compiled) {
+    std::stringstream dump;
+    compile_program(memoized_programs[2], 1).dump(dump);
+
+    ASSERT_EQUAL(dump.str().find("tail_call") != std::string::npos, true);
+}
+
+// Result of failed call is never complete, so neither it nor calls it was made from are cached
+TEST(failed_calls_store_nothing) {
+    std::string source = "defun f(n) {\n"
+                         "    if (n < 2) {\n"
+                         "        return n;\n"
+                         "    }\n"
+                         "    if (n == 5) {\n"
+                         "        return f(n - 1) / 0;\n"
+                         "    }\n"
+                         "    return f(n - 1) + f(n - 2);\n"
+                         "}\n"
+                         "defun main() { return f(7); }\n";
+
+    register_program program = compile_program(source);
+
+    register_vm vm(program);
+    vm.memoize(0);
+
+    for (int attempt = 0; attempt < 2; ++ attempt) {
+        std::string error;
+        try {
+            vm.call(main_index(program), {});
+        } catch (const std::runtime_error& thrown) {
+            error = thrown.what();
+        }
+
+        // Only f(0) to f(4) returned, f(5), f(6) and f(7) failed
+        ASSERT_STRING_EQUAL(error, std::string("error: division by zero in function f"));
+        ASSERT_EQUAL((int) vm.memoized_results(0), 5);
+    }
+
+    int64_t argument = 4;
+    ASSERT_EQUAL((int) vm.call(0, { &argument, 1 }), 3);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
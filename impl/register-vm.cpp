@@ -0,0 +1,241 @@
+#include "register-vm.h"
+#include "vm-arithmetic.h"
+#include "vm-dispatch.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+register_vm::register_vm(const register_program& program, jit_compiler* jit, size_t stack_size)
+    : m_program(program), m_stack(stack_size), m_jit(jit), m_hotness(program.functions.size()),
+      m_memo(program.functions.size()) {}
+
+void register_vm::memoize(uint32_t function) {
+    if (m_memo[function] == nullptr)
+        m_memo[function] = std::make_unique<memo_cache>(m_program.functions[function].arity);
+}
+
+bool register_vm::tier_up(uint32_t function) {
+    if (m_jit->compiled(function))
+        return true;
+
+    if (++ m_hotness[function] < m_jit->threshold())
+        return false;
+
+    m_jit->compile(function);
+    return true;
+}
+
+struct register_frame {
+    const register_instruction* return_to; // nullptr for the frame call() started with
+    int64_t* base;                         // Of caller
+    uint32_t frame_size;                   // Of caller
+    uint32_t result;                       // Register of caller to return to
+    uint32_t function;                     // Callee, for errors
+    uint32_t memos;                        // Pending memos from here on are completed by its return
+};
+
+// Call of memoized function that missed its cache, result goes there when the call returns
+struct pending_memo {
+    memo_cache* cache;
+    size_t arguments; // Offset in keys of pending memos
+};
+
+int64_t register_vm::call(uint32_t function, std::span<const int64_t> arguments) {
+    const register_instruction* code = m_program.code.data();
+    const register_function* functions = m_program.functions.data();
+
+    int64_t* const stack_end = m_stack.data() + m_stack.size();
+
+    std::vector<register_frame> frames;
+
+    const std::unique_ptr<memo_cache>* memo = m_memo.data();
+    std::vector<pending_memo> memos;
+    std::vector<int64_t> memo_keys;
+
+    // Arguments are in registers of callee by now, it can change them before it returns
+    auto remember = [&](uint32_t callee, const int64_t* callee_base) {
+        memos.push_back({ memo[callee].get(), memo_keys.size() });
+        memo_keys.insert(memo_keys.end(), callee_base, callee_base + functions[callee].arity);
+    };
+
+    auto error = [&](const std::string& message) {
+        return std::runtime_error("error: " + message + " in function " + functions[frames.back().function].name);
+    };
+
+    // Constants are in registers, so they are copied along with arguments
+    auto enter = [&](int64_t* callee_base, uint32_t callee, const int64_t* callee_arguments) {
+        const register_function& target = functions[callee];
+        if (callee_base + target.registers > stack_end)
+            throw error("stack overflow");
+
+        for (uint32_t i = 0; i < target.arity; ++ i)
+            callee_base[i] = callee_arguments[i];
+
+        const int64_t* constants = target.constants.data();
+        for (size_t i = 0, count = target.constants.size(); i < count; ++ i)
+            callee_base[target.arity + i] = constants[i];
+    };
+
+    frames.push_back({ nullptr, nullptr, 0, 0, function, 0 });
+
+    int64_t* base = m_stack.data();
+    enter(base, function, arguments.data());
+
+    uint32_t frame_size = functions[function].registers; // Of the running function
+
+    const register_instruction* ip = code + functions[function].entry;
+    int64_t result = 0; // Returned by current frame
+
+#ifdef VM_COMPUTED_GOTO
+    static const void* const handlers[] = {
+        VM_LABEL(MOVE),
+        VM_LABEL(ADD), VM_LABEL(SUB), VM_LABEL(MUL), VM_LABEL(DIV), VM_LABEL(NEG),
+        VM_LABEL(JUMP),
+        VM_LABEL(JUMP_IF_LESS), VM_LABEL(JUMP_IF_LESS_OR_EQUAL), VM_LABEL(JUMP_IF_GREATER),
+        VM_LABEL(JUMP_IF_GREATER_OR_EQUAL), VM_LABEL(JUMP_IF_EQUALS), VM_LABEL(JUMP_IF_NOT_EQUALS),
+        VM_LABEL(CALL), VM_LABEL(TAIL_CALL), VM_LABEL(RETURN)
+    };
+#endif
+
+    #define VM_NEXT_OP ip->op
+
+    #define BINARY(name, function)                                     \
+        VM_HANDLER(register_op, name) {                                \
+            base[ip->a] = function(base[ip->b], base[ip->c]);          \
+            ++ ip; VM_DISPATCH();                                      \
+        }
+
+    #define BRANCH(name, comparison)                                   \
+        VM_HANDLER(register_op, name) {                                \
+            if (!(base[ip->b] comparison base[ip->c])) {               \
+                ++ ip; VM_DISPATCH();                                  \
+            }                                                          \
+                                                                       \
+            goto jump;                                                 \
+        }
+
+    VM_DISPATCH_LOOP
+        VM_HANDLER(register_op, MOVE) { base[ip->a] = base[ip->b]; ++ ip; VM_DISPATCH(); }
+
+        BINARY(ADD, add_wrapping)
+        BINARY(SUB, sub_wrapping)
+        BINARY(MUL, mul_wrapping)
+
+        VM_HANDLER(register_op, DIV) {
+            int64_t rhs = base[ip->c];
+            if (rhs == 0)
+                throw error("division by zero");
+
+            base[ip->a] = div_wrapping(base[ip->b], rhs);
+            ++ ip; VM_DISPATCH();
+        }
+
+        VM_HANDLER(register_op, NEG) { base[ip->a] = neg_wrapping(base[ip->b]); ++ ip; VM_DISPATCH(); }
+
+        VM_HANDLER(register_op, JUMP) {
+        jump: // To ip->a, backward jumps count as iterations of loop
+            if (m_jit != nullptr && code + ip->a <= ip) {
+                uint32_t running = frames.back().function;
+
+                if (tier_up(running) && m_jit->has_loop_entry(running, ip->a)) {
+                    result = m_jit->enter_loop(running, ip->a, base);
+                    goto return_result;
+                }
+            }
+
+            ip = code + ip->a;
+            VM_DISPATCH();
+        }
+
+        BRANCH(JUMP_IF_LESS,             <)
+        BRANCH(JUMP_IF_LESS_OR_EQUAL,    <=)
+        BRANCH(JUMP_IF_GREATER,          >)
+        BRANCH(JUMP_IF_GREATER_OR_EQUAL, >=)
+        BRANCH(JUMP_IF_EQUALS,           ==)
+        BRANCH(JUMP_IF_NOT_EQUALS,       !=)
+
+        VM_HANDLER(register_op, CALL) {
+            if (memo[ip->c] != nullptr)
+                if (const int64_t* cached = memo[ip->c]->find(base + ip->b)) {
+                    base[ip->a] = *cached;
+                    ++ ip; VM_DISPATCH();
+                }
+
+            if (m_jit != nullptr && tier_up(ip->c)) {
+                base[ip->a] = m_jit->call(ip->c, base + ip->b);
+                ++ ip; VM_DISPATCH();
+            }
+
+            // Callee's registers go right after the caller's
+            int64_t* callee_base = base + frame_size;
+            enter(callee_base, ip->c, base + ip->b);
+
+            frames.push_back({ ip + 1, base, frame_size, ip->a, ip->c, (uint32_t) memos.size() });
+            if (memo[ip->c] != nullptr)
+                remember(ip->c, callee_base);
+
+            base = callee_base;
+            frame_size = functions[ip->c].registers;
+            ip = code + functions[ip->c].entry;
+            VM_DISPATCH();
+        }
+
+        VM_HANDLER(register_op, TAIL_CALL) {
+            if (memo[ip->c] != nullptr)
+                if (const int64_t* cached = memo[ip->c]->find(base + ip->b)) {
+                    result = *cached;
+                    goto return_result;
+                }
+
+            if (m_jit != nullptr && tier_up(ip->c)) {
+                result = m_jit->call(ip->c, base + ip->b);
+                goto return_result;
+            }
+
+            // Arguments are above where they go, so copying them up front doesn't overwrite any
+            enter(base, ip->c, base + ip->b);
+            frames.back().function = ip->c;
+
+            // Returns what this frame returns, so the frame completes its memo as well
+            if (memo[ip->c] != nullptr)
+                remember(ip->c, base);
+
+            frame_size = functions[ip->c].registers;
+            ip = code + functions[ip->c].entry;
+            VM_DISPATCH();
+        }
+
+        VM_HANDLER(register_op, RETURN) {
+            result = base[ip->a];
+            goto return_result;
+        }
+
+        return_result: {
+            register_frame returned = frames.back();
+            frames.pop_back();
+
+            while (memos.size() > returned.memos) {
+                memos.back().cache->insert(memo_keys.data() + memos.back().arguments, result);
+                memo_keys.resize(memos.back().arguments);
+                memos.pop_back();
+            }
+
+            if (returned.return_to == nullptr)
+                return result;
+
+            base = returned.base;
+            base[returned.result] = result;
+            frame_size = returned.frame_size;
+
+            ip = returned.return_to;
+            VM_DISPATCH();
+        }
+    VM_DISPATCH_LOOP_END
+
+    #undef BRANCH
+    #undef BINARY
+    #undef VM_NEXT_OP
+
+    throw error("bytecode ended without return"); // Unreachable, handlers never fall through
+}
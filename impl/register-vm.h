@@ -0,0 +1,50 @@
+#pragma once
+
+#include "jit.h"
+#include "memo-cache.h"
+#include "register-bytecode.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+/**
+ * Interpreter of register_program, register files of calls are stacked
+ * in one fixed size array, the same way stack_vm stacks its frames.
+ *
+ * With JIT, function that is called or loops more times than JIT's
+ * threshold is compiled and runs natively from then on, including the
+ * loop it's stuck in.
+ *
+ * Memoized function looks up its arguments in its cache before it's
+ * called, and result of call that misses goes to the cache when the
+ * call returns, so exponential recursion of pure function becomes
+ * linear. Native code calls its callees directly, past the caches.
+ */
+class register_vm {
+public:
+    register_vm(const register_program& program, jit_compiler* jit = nullptr, size_t stack_size = 1 << 20);
+
+    // Throws std::runtime_error on division by zero and stack overflow
+    int64_t call(uint32_t function, std::span<const int64_t> arguments);
+
+    // Only pure functions can be memoized, see analyze_purity
+    void memoize(uint32_t function);
+
+    // Results in cache of function, 0 if it isn't memoized
+    size_t memoized_results(uint32_t function) const { return m_memo[function] ? m_memo[function]->size() : 0; }
+
+private:
+    const register_program& m_program;
+    std::vector<int64_t> m_stack;
+
+    jit_compiler* m_jit;
+    std::vector<uint32_t> m_hotness; // Calls and loop iterations of every function
+
+    std::vector<std::unique_ptr<memo_cache>> m_memo; // By function, nullptr unless it's memoized
+
+    // Whether function runs natively, compiles it if it just got hot
+    bool tier_up(uint32_t function);
+};
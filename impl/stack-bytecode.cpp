@@ -0,0 +1,311 @@
+#include "stack-bytecode.h"
+#include "program-symbols.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+
+const char* stack_op_name(stack_op op) {
+    switch (op) {
+    case stack_op::PUSH:             return "push";
+    case stack_op::LOAD:             return "load";
+    case stack_op::STORE:            return "store";
+    case stack_op::ADD:              return "add";
+    case stack_op::SUB:              return "sub";
+    case stack_op::MUL:              return "mul";
+    case stack_op::DIV:              return "div";
+    case stack_op::NEG:              return "neg";
+    case stack_op::LESS:             return "less";
+    case stack_op::LESS_OR_EQUAL:    return "less_or_equal";
+    case stack_op::GREATER:          return "greater";
+    case stack_op::GREATER_OR_EQUAL: return "greater_or_equal";
+    case stack_op::EQUALS:           return "equals";
+    case stack_op::NOT_EQUALS:       return "not_equals";
+    case stack_op::JUMP:             return "jump";
+    case stack_op::JUMP_IF_FALSE:    return "jump_if_false";
+    case stack_op::JUMP_IF_TRUE:     return "jump_if_true";
+    case stack_op::CALL:             return "call";
+    case stack_op::RETURN:           return "return";
+    }
+
+    return "?";
+}
+
+static bool has_operand(stack_op op) {
+    switch (op) {
+    case stack_op::PUSH: case stack_op::LOAD:          case stack_op::STORE:
+    case stack_op::JUMP: case stack_op::JUMP_IF_FALSE: case stack_op::JUMP_IF_TRUE:
+    case stack_op::CALL:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+const stack_function* stack_program::find(const std::string& name) const {
+    for (const auto& function: functions)
+        if (function.name == name)
+            return &function;
+
+    return nullptr;
+}
+
+void stack_program::dump(std::ostream& os) const {
+    char line[128];
+
+    for (size_t i = 0; i < functions.size(); ++ i) {
+        const stack_function& function = functions[i];
+        uint32_t end = i + 1 < functions.size() ? functions[i + 1].entry : (uint32_t) code.size();
+
+        os << function.name << ": " << function.arity << " arguments, " << function.slots
+           << " slots, stack of " << function.max_depth << "\n";
+
+        for (uint32_t j = function.entry; j < end; ++ j) {
+            if (has_operand(code[j].op))
+                snprintf(line, sizeof(line), "  %6u  %-18s %d\n", j, stack_op_name(code[j].op), code[j].operand);
+            else
+                snprintf(line, sizeof(line), "  %6u  %s\n", j, stack_op_name(code[j].op));
+
+            os << line;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+class stack_compiler {
+public:
+    stack_compiler(const flat_ast& tree, stack_program& program)
+        : m_tree(tree), m_program(program), m_functions(tree) {}
+
+    void compile_program() {
+        for (const auto& symbol: m_functions.functions())
+            compile_function(symbol);
+    }
+
+private:
+    const flat_ast& m_tree;
+    stack_program& m_program;
+
+    function_table m_functions;
+
+    // State of the function being compiled
+    int32_t m_function_name = 0;
+    local_scopes m_scopes;
+    uint32_t m_depth = 0, m_max_depth = 0;
+
+    void compile_function(const function_symbol& symbol) {
+        m_function_name = symbol.name;
+        m_scopes = {};
+        m_depth = m_max_depth = 0;
+
+        uint32_t entry = (uint32_t) m_program.code.size();
+        std::span<const uint32_t> children = m_tree.children_of(symbol.node);
+
+        m_scopes.enter();
+        for (uint32_t i = 0; i < symbol.arity; ++ i)
+            m_scopes.declare(m_tree.nodes[children[i]].value);
+
+        compile_statement(children.back());
+
+        // Falling off the end returns 0
+        emit(stack_op::PUSH, 0);
+        emit(stack_op::RETURN);
+
+        m_scopes.leave();
+
+        m_program.functions.push_back({
+            .name = std::string(m_tree.name(symbol.name)),
+            .arity = symbol.arity, .slots = m_scopes.slot_count(), .max_depth = m_max_depth,
+            .entry = entry
+        });
+    }
+
+    uint32_t emit(stack_op op, int32_t operand = 0) {
+        m_depth += stack_effect(op, operand);
+        m_max_depth = std::max(m_max_depth, m_depth);
+
+        m_program.code.push_back({ op, operand });
+        return (uint32_t) m_program.code.size() - 1;
+    }
+
+    int32_t stack_effect(stack_op op, int32_t operand) const {
+        switch (op) {
+        case stack_op::PUSH: case stack_op::LOAD:
+            return 1;
+
+        case stack_op::NEG: case stack_op::JUMP:
+            return 0;
+
+        case stack_op::CALL:
+            return 1 - (int32_t) m_functions.functions()[operand].arity;
+
+        default: // Binary operations, stores, conditional jumps and returns pop one value
+            return -1;
+        }
+    }
+
+    uint32_t here() const { return (uint32_t) m_program.code.size(); }
+    void patch(uint32_t jump, uint32_t target) { m_program.code[jump].operand = (int32_t) target; }
+
+    uint32_t slot_of(int32_t name) const {
+        std::optional<uint32_t> slot = m_scopes.find(name);
+        if (!slot)
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                                                   "undefined variable " + std::string(m_tree.name(name))));
+
+        return *slot;
+    }
+
+    void compile_statement(uint32_t node) {
+        const flat_node& current = m_tree.nodes[node];
+        std::span<const uint32_t> children = m_tree.children_of(node);
+
+        switch (current.kind) {
+        case ast_kind::BODY:
+            m_scopes.enter();
+            for (uint32_t statement: children)
+                compile_statement(statement);
+            m_scopes.leave();
+            break;
+
+        case ast_kind::ASSIGNMENT:
+            compile_expression(children[0]); // Before declaration, so it can't see the new variable
+            emit(stack_op::STORE, (int32_t) m_scopes.declare(current.value));
+            break;
+
+        case ast_kind::REASSIGNMENT:
+            compile_expression(children[0]);
+            emit(stack_op::STORE, (int32_t) slot_of(current.value));
+            break;
+
+        case ast_kind::RETURN:
+            compile_expression(children[0]);
+            emit(stack_op::RETURN);
+            break;
+
+        case ast_kind::IF: {
+            compile_expression(children[0]);
+            uint32_t skip = emit(stack_op::JUMP_IF_FALSE);
+
+            compile_statement(children[1]);
+            patch(skip, here());
+            break;
+        }
+
+        case ast_kind::WHILE: {
+            // Condition is placed after the body, so every iteration takes one jump
+            uint32_t to_condition = emit(stack_op::JUMP);
+
+            uint32_t body = here();
+            compile_statement(children[1]);
+
+            patch(to_condition, here());
+            compile_expression(children[0]);
+            emit(stack_op::JUMP_IF_TRUE, (int32_t) body);
+            break;
+        }
+
+        case ast_kind::FOR: {
+            // Bounds are evaluated once, before the variable comes into scope
+            compile_expression(children[0]);
+            compile_expression(children[1]);
+
+            m_scopes.enter();
+
+            uint32_t bound = m_scopes.temporary();
+            emit(stack_op::STORE, (int32_t) bound);
+
+            uint32_t variable = m_scopes.declare(current.value);
+            emit(stack_op::STORE, (int32_t) variable);
+
+            uint32_t to_condition = emit(stack_op::JUMP);
+
+            uint32_t body = here();
+            compile_statement(children[2]);
+
+            emit(stack_op::LOAD, (int32_t) variable);
+            emit(stack_op::PUSH, 1);
+            emit(stack_op::ADD);
+            emit(stack_op::STORE, (int32_t) variable);
+
+            patch(to_condition, here());
+            emit(stack_op::LOAD, (int32_t) variable);
+            emit(stack_op::LOAD, (int32_t) bound);
+            emit(stack_op::LESS);
+            emit(stack_op::JUMP_IF_TRUE, (int32_t) body);
+
+            m_scopes.leave();
+            break;
+        }
+
+        default:
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                std::string("unexpected ") + ast_kind_name(current.kind) + " in statement position"));
+        }
+    }
+
+    void compile_expression(uint32_t node) {
+        const flat_node& current = m_tree.nodes[node];
+        std::span<const uint32_t> children = m_tree.children_of(node);
+
+        switch (current.kind) {
+        case ast_kind::NUMBER:
+            emit(stack_op::PUSH, current.value);
+            return;
+
+        case ast_kind::VAR:
+            emit(stack_op::LOAD, (int32_t) slot_of(current.value));
+            return;
+
+        case ast_kind::FUNCTION_CALL: {
+            uint32_t callee = m_functions.callee(m_tree, node, m_function_name);
+
+            for (uint32_t argument: children)
+                compile_expression(argument);
+
+            emit(stack_op::CALL, (int32_t) callee);
+            return;
+        }
+
+        case ast_kind::UNARY_MINUS:
+            compile_expression(children[0]);
+            emit(stack_op::NEG);
+            return;
+
+        default:
+            break;
+        }
+
+        compile_expression(children[0]);
+        compile_expression(children[1]);
+
+        switch (current.kind) {
+        case ast_kind::ADD:              emit(stack_op::ADD);              break;
+        case ast_kind::SUB:              emit(stack_op::SUB);              break;
+        case ast_kind::MUL:              emit(stack_op::MUL);              break;
+        case ast_kind::DIV:              emit(stack_op::DIV);              break;
+        case ast_kind::LESS:             emit(stack_op::LESS);             break;
+        case ast_kind::LESS_OR_EQUAL:    emit(stack_op::LESS_OR_EQUAL);    break;
+        case ast_kind::GREATER:          emit(stack_op::GREATER);          break;
+        case ast_kind::GREATER_OR_EQUAL: emit(stack_op::GREATER_OR_EQUAL); break;
+        case ast_kind::EQUALS:           emit(stack_op::EQUALS);           break;
+        case ast_kind::NOT_EQUALS:       emit(stack_op::NOT_EQUALS);       break;
+
+        default:
+            throw std::runtime_error(compile_error(m_tree, m_function_name,
+                std::string("unexpected ") + ast_kind_name(current.kind) + " in expression"));
+        }
+    }
+};
+
+stack_program compile_stack_program(const flat_ast& tree) {
+    stack_program program;
+
+    stack_compiler compiler(tree, program);
+    compiler.compile_program();
+
+    return program;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "flat-ast.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+enum class stack_op: uint8_t {
+    PUSH,          // Push operand
+    LOAD, STORE,   // Push slot /operand/ of frame, pop into it
+
+    ADD, SUB, MUL, DIV, NEG,
+
+    LESS, LESS_OR_EQUAL, GREATER, GREATER_OR_EQUAL, EQUALS, NOT_EQUALS, // Push 1 or 0
+
+    JUMP, JUMP_IF_FALSE, JUMP_IF_TRUE, // Operand is index of target in stack_program::code
+
+    CALL,          // Arguments are on top of stack, operand is index of function
+    RETURN         // Value is on top of stack
+};
+
+const char* stack_op_name(stack_op op);
+
+struct stack_instruction {
+    stack_op op;
+    int32_t  operand; //!< 0 for instructions that take none
+};
+
+struct stack_function {
+    std::string name;
+
+    uint32_t arity;
+    uint32_t slots;       //!< Arguments come first, then locals
+    uint32_t max_depth;   //!< Of operand stack above the slots
+
+    uint32_t entry;       //!< Index of the first instruction in stack_program::code
+};
+
+/**
+ * Code of every function is in one dense array, frame of a call holds
+ * function's slots followed by its operand stack. Values are 64-bit,
+ * arithmetic wraps around, comparison results are 1 or 0.
+ */
+struct stack_program {
+    std::vector<stack_instruction> code;
+    std::vector<stack_function> functions;
+
+    const stack_function* find(const std::string& name) const;
+
+    void dump(std::ostream& os) const;
+};
+
+// Throws std::runtime_error if program refers to undefined names
+stack_program compile_stack_program(const flat_ast& tree);
@@ -0,0 +1,123 @@
+#include "test-programs.h"
+#include "test-framework.h"
+
+#include <sstream>
+#include <string>
+
+static std::string run_stack(const std::string& source) {
+    try {
+        return run_main(compile_stack_program(parse_program(source)));
+    } catch (const std::runtime_error& error) {
+        return error.what(); // Compile errors
+    }
+}
+
+static const std::string doubling =
+    "defun add(a, b) {\n"
+    "    return a + b;\n"
+    "}\n"
+    "\n"
+    "defun main() {\n"
+    "    let x = add(1, 2)\n"
+    "    while (x < 10) {\n"
+    "        x = x * 2\n"
+    "    }\n"
+    "    return x;\n"
+    "}\n";
+
+TEST(bytecode_dump) {
+    std::stringstream dump;
+    compile_stack_program(parse_program(doubling)).dump(dump);
+
+    ASSERT_STRING_EQUAL(dump.str(), std::string(
+        "add: 2 arguments, 2 slots, stack of 2\n"
+        "       0  load               0\n"
+        "       1  load               1\n"
+        "       2  add\n"
+        "       3  return\n"
+        "       4  push               0\n"
+        "       5  return\n"
+        "main: 0 arguments, 1 slots, stack of 2\n"
+        "       6  push               1\n"
+        "       7  push               2\n"
+        "       8  call               0\n"
+        "       9  store              0\n"
+        "      10  jump               15\n"
+        "      11  load               0\n"
+        "      12  push               2\n"
+        "      13  mul\n"
+        "      14  store              0\n"
+        "      15  load               0\n"
+        "      16  push               10\n"
+        "      17  less\n"
+        "      18  jump_if_true       11\n"
+        "      19  load               0\n"
+        "      20  return\n"
+        "      21  push               0\n"
+        "      22  return\n"));
+}
+
+TEST(calls_and_loops) {
+    ASSERT_STRING_EQUAL(run_stack(doubling), std::string("12"));
+
+    // Upper bound of for isn't included
+    ASSERT_STRING_EQUAL(run_stack("defun main() {\n"
+                                  "    let sum = 0\n"
+                                  "    for (i in 1..5) {\n"
+                                  "        for (j in 0..i) {\n"
+                                  "            sum = sum + j\n"
+                                  "        }\n"
+                                  "    }\n"
+                                  "    return sum;\n"
+                                  "}\n"), std::string("10"));
+
+    ASSERT_STRING_EQUAL(run_stack("defun main() {\n"
+                                  "    for (i in 5..1) {\n"
+                                  "        return 1;\n"
+                                  "    }\n"
+                                  "    return 0;\n"
+                                  "}\n"), std::string("0"));
+}
+
+TEST(arithmetic_wraps_around) {
+    ASSERT_STRING_EQUAL(run_stack("defun main() { return 1000000 * 1000000 * 1000000 * 10; }"),
+                        std::string("-8446744073709551616"));
+
+    // 2^63 wraps to the smallest value, and one less than it to the largest
+    ASSERT_STRING_EQUAL(run_stack("defun main() { return 1073741824 * 1073741824 * 8; }"),
+                        std::string("-9223372036854775808"));
+    ASSERT_STRING_EQUAL(run_stack("defun main() {\n"
+                                  "    let min = 1073741824 * 1073741824 * 8\n"
+                                  "    return min - 1;\n"
+                                  "}\n"), std::string("9223372036854775807"));
+}
+
+TEST(division_rounds_to_zero) {
+    ASSERT_STRING_EQUAL(run_stack("defun main() { return (0 - 7) / 2; }"), std::string("-3"));
+    ASSERT_STRING_EQUAL(run_stack("defun main() { return 7 / (0 - 2); }"), std::string("-3"));
+    ASSERT_STRING_EQUAL(run_stack("defun main() { return (0 - 7) / (0 - 2); }"), std::string("3"));
+
+    // Quotient doesn't fit, so it wraps too instead of trapping
+    ASSERT_STRING_EQUAL(run_stack("defun main() {\n"
+                                  "    let min = 1073741824 * 1073741824 * 8\n"
+                                  "    return min / (0 - 1);\n"
+                                  "}\n"), std::string("-9223372036854775808"));
+}
+
+TEST(errors_name_the_function) {
+    ASSERT_STRING_EQUAL(run_stack("defun main() { return g(1); }"),
+                        std::string("error: call of undefined function g in function main"));
+
+    ASSERT_STRING_EQUAL(run_stack("defun f(a) { return a; }\ndefun main() { return f(1, 2); }"),
+                        std::string("error: f takes 1 arguments, but is called with 2 in function main"));
+
+    ASSERT_STRING_EQUAL(run_stack("defun f(n) { return 1 + f(n + 1); }\ndefun main() { return f(0); }"),
+                        std::string("error: stack overflow in function f"));
+
+    ASSERT_STRING_EQUAL(run_stack("defun f(a) { return 5 / a; }\ndefun main() { return f(0); }"),
+                        std::string("error: division by zero in function f"));
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,143 @@
+#include "stack-vm.h"
+#include "vm-arithmetic.h"
+#include "vm-dispatch.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+stack_vm::stack_vm(const stack_program& program, size_t stack_size)
+    : m_program(program), m_stack(stack_size) {}
+
+struct stack_frame {
+    const stack_instruction* return_to; // nullptr for the frame call() started with
+    int64_t* base;                      // Of caller
+    uint32_t function;                  // Callee, for errors
+};
+
+int64_t stack_vm::call(uint32_t function, std::span<const int64_t> arguments) {
+    const stack_instruction* code = m_program.code.data();
+    const stack_function* functions = m_program.functions.data();
+
+    int64_t* const stack_end = m_stack.data() + m_stack.size();
+
+    std::vector<stack_frame> frames;
+
+    auto error = [&](const std::string& message) {
+        return std::runtime_error("error: " + message + " in function " + functions[frames.back().function].name);
+    };
+
+    // Frame of callee starts at its first argument, that is already in place
+    auto check_frame = [&](int64_t* callee_base, uint32_t callee) {
+        if (callee_base + functions[callee].slots + functions[callee].max_depth > stack_end)
+            throw error("stack overflow");
+    };
+
+    frames.push_back({ nullptr, nullptr, function });
+
+    int64_t* base = m_stack.data();
+    check_frame(base, function);
+
+    std::copy(arguments.begin(), arguments.end(), base);
+    std::fill(base + arguments.size(), base + functions[function].slots, 0);
+
+    int64_t* sp = base + functions[function].slots; // Next free value
+    const stack_instruction* ip = code + functions[function].entry;
+
+#ifdef VM_COMPUTED_GOTO
+    static const void* const handlers[] = {
+        VM_LABEL(PUSH), VM_LABEL(LOAD), VM_LABEL(STORE),
+        VM_LABEL(ADD), VM_LABEL(SUB), VM_LABEL(MUL), VM_LABEL(DIV), VM_LABEL(NEG),
+        VM_LABEL(LESS), VM_LABEL(LESS_OR_EQUAL), VM_LABEL(GREATER), VM_LABEL(GREATER_OR_EQUAL),
+        VM_LABEL(EQUALS), VM_LABEL(NOT_EQUALS),
+        VM_LABEL(JUMP), VM_LABEL(JUMP_IF_FALSE), VM_LABEL(JUMP_IF_TRUE),
+        VM_LABEL(CALL), VM_LABEL(RETURN)
+    };
+#endif
+
+    #define VM_NEXT_OP ip->op
+
+    #define BINARY(name, expression)                                   \
+        VM_HANDLER(stack_op, name) {                                   \
+            int64_t rhs = *-- sp, lhs = sp[-1];                        \
+            sp[-1] = (expression);                                     \
+            ++ ip; VM_DISPATCH();                                      \
+        }
+
+    VM_DISPATCH_LOOP
+        VM_HANDLER(stack_op, PUSH)  { *sp ++ = ip->operand;        ++ ip; VM_DISPATCH(); }
+        VM_HANDLER(stack_op, LOAD)  { *sp ++ = base[ip->operand];  ++ ip; VM_DISPATCH(); }
+        VM_HANDLER(stack_op, STORE) { base[ip->operand] = *-- sp;  ++ ip; VM_DISPATCH(); }
+
+        BINARY(ADD, add_wrapping(lhs, rhs))
+        BINARY(SUB, sub_wrapping(lhs, rhs))
+        BINARY(MUL, mul_wrapping(lhs, rhs))
+
+        VM_HANDLER(stack_op, DIV) {
+            int64_t rhs = *-- sp;
+            if (rhs == 0)
+                throw error("division by zero");
+
+            sp[-1] = div_wrapping(sp[-1], rhs);
+            ++ ip; VM_DISPATCH();
+        }
+
+        VM_HANDLER(stack_op, NEG) { sp[-1] = neg_wrapping(sp[-1]); ++ ip; VM_DISPATCH(); }
+
+        BINARY(LESS,             lhs <  rhs)
+        BINARY(LESS_OR_EQUAL,    lhs <= rhs)
+        BINARY(GREATER,          lhs >  rhs)
+        BINARY(GREATER_OR_EQUAL, lhs >= rhs)
+        BINARY(EQUALS,           lhs == rhs)
+        BINARY(NOT_EQUALS,       lhs != rhs)
+
+        VM_HANDLER(stack_op, JUMP) { ip = code + ip->operand; VM_DISPATCH(); }
+
+        VM_HANDLER(stack_op, JUMP_IF_FALSE) {
+            ip = *-- sp == 0 ? code + ip->operand : ip + 1;
+            VM_DISPATCH();
+        }
+
+        VM_HANDLER(stack_op, JUMP_IF_TRUE) {
+            ip = *-- sp != 0 ? code + ip->operand : ip + 1;
+            VM_DISPATCH();
+        }
+
+        VM_HANDLER(stack_op, CALL) {
+            uint32_t callee = (uint32_t) ip->operand;
+            const stack_function& target = functions[callee];
+
+            int64_t* callee_base = sp - target.arity;
+            check_frame(callee_base, callee);
+
+            frames.push_back({ ip + 1, base, callee });
+
+            base = callee_base;
+            sp = std::fill_n(sp, target.slots - target.arity, 0);
+            ip = code + target.entry;
+            VM_DISPATCH();
+        }
+
+        VM_HANDLER(stack_op, RETURN) {
+            int64_t result = sp[-1];
+
+            stack_frame returned = frames.back();
+            frames.pop_back();
+
+            if (returned.return_to == nullptr)
+                return result;
+
+            sp = base; // Arguments of callee are dropped with its frame
+            *sp ++ = result;
+
+            base = returned.base;
+            ip = returned.return_to;
+            VM_DISPATCH();
+        }
+    VM_DISPATCH_LOOP_END
+
+    #undef BINARY
+    #undef VM_NEXT_OP
+
+    throw error("bytecode ended without return"); // Unreachable, handlers never fall through
+}
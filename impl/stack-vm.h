@@ -0,0 +1,28 @@
+#pragma once
+
+#include "stack-bytecode.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * Interpreter of stack_program. Frames of all calls share one value
+ * stack of fixed size, so pointers into it stay valid, and recursion
+ * that doesn't fit is reported as stack overflow.
+ *
+ * Dispatch uses computed goto where compiler supports it, and switch
+ * everywhere else.
+ */
+class stack_vm {
+public:
+    stack_vm(const stack_program& program, size_t stack_size = 1 << 20);
+
+    // Throws std::runtime_error on division by zero and stack overflow
+    int64_t call(uint32_t function, std::span<const int64_t> arguments);
+
+private:
+    const stack_program& m_program;
+    std::vector<int64_t> m_stack;
+};
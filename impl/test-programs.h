@@ -0,0 +1,137 @@
+#pragma once
+
+// Programs from source text for tests of the frontend: they are parsed the way the driver
+// parses files, compiled the way -O0 and -O1 compile them, and run to a value or an error
+
+#include "flat-ast.h"
+#include "grammar.h"
+#include "ir-codegen.h"
+#include "ir-lowering.h"
+#include "ir-optimizer.h"
+#include "jit.h"
+#include "left-factoring.h"
+#include "node-allocator.h"
+#include "register-bytecode.h"
+#include "register-vm.h"
+#include "stack-bytecode.h"
+#include "stack-vm.h"
+#include "token-cursor.h"
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+// Building grammar and lexer takes longer than parsing test programs, so they are shared
+inline language_grammar& test_grammar() {
+    static language_grammar grammar = [] {
+        language_grammar created = create_language_grammar();
+        lang::left_factor(created.program.node());
+        return created;
+    }();
+
+    return grammar;
+}
+
+inline lang::lexer& test_lexer() {
+    static lang::lexer lexer = create_language_lexer();
+    return lexer;
+}
+
+inline flat_ast parse_program(const std::string& source) {
+    language_grammar& grammar = test_grammar();
+    lang::lexer& lexer = test_lexer();
+
+    lang::token_buffer tokens(lexer.analyse(source, "test.prog"));
+    lang::token_cursor cursor(tokens.span());
+
+    arena ast_arena = {};
+    TRY arena_create(&ast_arena)
+        THROW("Failed to create arena for syntax tree!");
+
+    std::optional<flat_ast> tree;
+    try {
+        lang::arena_scope ast_arena_scope(&ast_arena);
+
+        lang::furthest_failure = { cursor, {} }; // Other tokens may have been at the same address
+
+        std::optional<ast_program*> parsed = grammar.program.parse(cursor);
+        if (parsed && !cursor.at_end())
+            throw lang::unparsed_input_error(cursor);
+
+        if (parsed)
+            tree = flatten(*parsed);
+    } catch (...) {
+        arena_destroy(&ast_arena);
+        throw;
+    }
+
+    arena_destroy(&ast_arena);
+
+    if (!tree)
+        throw std::runtime_error("error: test program doesn't parse");
+
+    return std::move(*tree);
+}
+
+// SSA form of program, with -O1 passes run over it when /optimize/ is set
+inline ir_program lower_program(const std::string& source, bool optimize = false,
+                                const ir_optimizer_options& options = {}) {
+    ir_program ir = lower_to_ir(parse_program(source));
+    ir.verify();
+
+    if (optimize) {
+        optimize_ir(ir, options);
+        ir.verify();
+    }
+
+    return ir;
+}
+
+inline register_program compile_program(const std::string& source, int optimize = 0,
+                                        const ir_optimizer_options& options = {}) {
+    if (optimize == 0)
+        return compile_register_program(parse_program(source));
+
+    return compile_ir_program(lower_program(source, true, options));
+}
+
+template <typename program_type>
+uint32_t main_index(const program_type& program) {
+    const auto* main_function = program.find("main");
+    if (main_function == nullptr)
+        throw std::runtime_error("error: program has no main() to run");
+
+    return (uint32_t) (main_function - program.functions.data());
+}
+
+// What main() returns, or what error it fails with, either way as the driver prints it
+inline std::string run_main(const register_program& program, jit_compiler* jit = nullptr) {
+    try {
+        register_vm vm(program, jit);
+        return std::to_string(vm.call(main_index(program), {}));
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+}
+
+inline std::string run_main(const stack_program& program) {
+    try {
+        stack_vm vm(program);
+        return std::to_string(vm.call(main_index(program), {}));
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+}
+
+// With every function compiled as soon as it's called or loops /threshold/ times
+inline std::string run_main_jit(const register_program& program, uint32_t threshold = 0) {
+    if (!jit_compiler::supported())
+        return run_main(program);
+
+    jit_compiler jit(program, threshold);
+    return run_main(program, &jit);
+}
+
+inline std::string run_source(const std::string& source, int optimize = 0) {
+    return run_main(compile_program(source, optimize));
+}
@@ -0,0 +1,72 @@
+#include "time-report.h"
+#include "test-framework.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// Lines of printed report, without the title and the column header
+static std::vector<std::string> report_rows(const time_report& report) {
+    std::stringstream printed;
+    report.print(printed);
+
+    std::vector<std::string> rows;
+    for (std::string line; std::getline(printed, line); )
+        rows.push_back(line);
+
+    return std::vector<std::string>(rows.begin() + 2, rows.end());
+}
+
+TEST(phases_are_summed_in_order_they_first_ran) {
+    time_report report("test.prog");
+    report.add("lex", 1ms);
+    report.add("parse", 3ms);
+    report.add("lex", 1ms);
+
+    std::vector<std::string> rows = report_rows(report);
+    ASSERT_EQUAL((int) rows.size(), 3);
+
+    ASSERT_STRING_EQUAL(rows[0], std::string("  lex                     2    0.002000s  40.00%"));
+    ASSERT_STRING_EQUAL(rows[1], std::string("  parse                   1    0.003000s  60.00%"));
+    ASSERT_STRING_EQUAL(rows[2], std::string("  total                        0.005000s"));
+}
+
+TEST(report_names_the_file) {
+    time_report report("test.prog");
+
+    std::stringstream printed;
+    report.print(printed);
+
+    ASSERT_EQUAL(printed.str().starts_with("time report for test.prog:\n"), true);
+}
+
+TEST(zero_time_has_zero_share) {
+    time_report report("test.prog");
+    report.add("read", 0ns);
+
+    ASSERT_STRING_EQUAL(report_rows(report)[0], std::string("  read                    1    0.000000s   0.00%"));
+}
+
+TEST(phases_are_timed_only_with_report_installed) {
+    time_report report("test.prog");
+
+    { phase_timer timer("lex"); }
+    {
+        time_report_scope scope(&report);
+        { phase_timer timer("parse"); }
+        { phase_timer timer("parse"); }
+    }
+    { phase_timer timer("run"); }
+
+    std::vector<std::string> rows = report_rows(report);
+    ASSERT_EQUAL((int) rows.size(), 2);
+    ASSERT_EQUAL(rows[0].starts_with("  parse                   2 "), true);
+    ASSERT_EQUAL(current_time_report == nullptr, true);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
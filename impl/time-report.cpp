@@ -0,0 +1,43 @@
+#include "time-report.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+
+void time_report::add(const char* phase, std::chrono::nanoseconds time) {
+    for (auto& current: m_phases)
+        if (std::strcmp(current.phase, phase) == 0) {
+            ++ current.runs;
+            current.time += time;
+            return;
+        }
+
+    m_phases.push_back({ phase, 1, time });
+}
+
+void time_report::print(std::ostream& os) const {
+    std::chrono::nanoseconds total {};
+    for (const auto& current: m_phases)
+        total += current.time;
+
+    auto seconds = [](std::chrono::nanoseconds time) {
+        return std::chrono::duration<double>(time).count();
+    };
+
+    char line[256];
+
+    os << "time report for " << m_file_name << ":\n";
+    snprintf(line, sizeof(line), "  %-16s %8s %12s %7s\n", "phase", "runs", "wall", "share");
+    os << line;
+
+    for (const auto& current: m_phases) {
+        double share = total.count() == 0 ? 0.0 : 100.0 * current.time.count() / total.count();
+
+        snprintf(line, sizeof(line), "  %-16s %8zu %11.6fs %6.2f%%\n",
+                 current.phase, current.runs, seconds(current.time), share);
+        os << line;
+    }
+
+    snprintf(line, sizeof(line), "  %-16s %8s %11.6fs\n", "total", "", seconds(total));
+    os << line;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "memory-report.h"
+#include "trace-events.h"
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+ * Wall time of driver phases (read, lex, parse, ...) for one file,
+ * phase that runs several times, like parse in watch mode, is summed up.
+ */
+class time_report {
+public:
+    time_report(std::string file_name): m_file_name(std::move(file_name)) {}
+
+    void add(const char* phase, std::chrono::nanoseconds time);
+
+    // Phases in order they first ran, with share of the total
+    void print(std::ostream& os) const;
+
+private:
+    struct phase_time {
+        const char* phase;
+
+        size_t runs;
+        std::chrono::nanoseconds time;
+    };
+
+    std::string m_file_name;
+    std::vector<phase_time> m_phases;
+};
+
+// Phases are timed only while report is installed, see time_report_scope
+inline thread_local time_report* current_time_report = nullptr;
+
+class time_report_scope {
+public:
+    time_report_scope(time_report* new_report): m_saved_report(current_time_report) {
+        current_time_report = new_report;
+    }
+
+    ~time_report_scope() { current_time_report = m_saved_report; }
+
+    time_report_scope(const time_report_scope&) = delete;
+    time_report_scope& operator=(const time_report_scope&) = delete;
+
+private:
+    time_report* m_saved_report;
+};
+
+// Adds time from construction to destruction to /phase/ of current
+// report, and to trace as a span, allocations made meanwhile go to
+// memory report, if any of them is installed
+class phase_timer {
+public:
+    phase_timer(const char* phase)
+        : m_report(current_time_report), m_phase(phase), m_span("phase", phase),
+          m_memory(current_memory_report), m_outer_phase(nullptr), m_start() {
+
+        if (m_memory != nullptr)
+            m_outer_phase = m_memory->enter(phase);
+
+        if (m_report != nullptr)
+            m_start = std::chrono::steady_clock::now();
+    }
+
+    ~phase_timer() {
+        if (m_report != nullptr)
+            m_report->add(m_phase, std::chrono::steady_clock::now() - m_start);
+
+        if (m_memory != nullptr)
+            m_memory->leave(m_outer_phase);
+    }
+
+    phase_timer(const phase_timer&) = delete;
+    phase_timer& operator=(const phase_timer&) = delete;
+
+private:
+    time_report* m_report;
+    const char* m_phase;
+
+    trace_span m_span;
+
+    memory_report* m_memory;
+    memory_report::phase_memory* m_outer_phase;
+
+    std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,284 @@
+#include "time-report.h"
+#include "trace-events.h"
+#include "test-framework.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Just enough of JSON to read traces back: every value is checked to be
+ * well-formed, objects and arrays are kept, numbers are read as integers.
+ */
+struct json_value {
+    enum { OBJECT, ARRAY, STRING, NUMBER, LITERAL } kind;
+
+    std::map<std::string, json_value> members;
+    std::vector<json_value> elements;
+
+    std::string text;
+    int64_t number = 0;
+
+    const json_value& at(const std::string& key) const {
+        auto found = members.find(key);
+        if (kind != OBJECT || found == members.end())
+            throw std::runtime_error("no member " + key);
+
+        return found->second;
+    }
+};
+
+class json_reader {
+public:
+    json_reader(const std::string& text): m_text(text), m_position(0) {}
+
+    json_value read_document() {
+        json_value value = read_value();
+
+        skip_spaces();
+        if (m_position != m_text.size())
+            fail("text after the value");
+
+        return value;
+    }
+
+private:
+    const std::string& m_text;
+    size_t m_position;
+
+    [[noreturn]] void fail(const std::string& reason) {
+        throw std::runtime_error("invalid JSON at " + std::to_string(m_position) + ": " + reason);
+    }
+
+    void skip_spaces() {
+        while (m_position < m_text.size() && std::isspace((unsigned char) m_text[m_position]))
+            ++ m_position;
+    }
+
+    char next() {
+        if (m_position == m_text.size())
+            fail("unexpected end");
+
+        return m_text[m_position ++];
+    }
+
+    void expect(char symbol) {
+        skip_spaces();
+        if (next() != symbol)
+            fail(std::string("expected ") + symbol);
+    }
+
+    bool skip_if(char symbol) {
+        skip_spaces();
+        if (m_position < m_text.size() && m_text[m_position] == symbol) {
+            ++ m_position;
+            return true;
+        }
+
+        return false;
+    }
+
+    std::string read_string() {
+        expect('"');
+
+        std::string text;
+        for (char symbol = next(); symbol != '"'; symbol = next()) {
+            if ((unsigned char) symbol < 0x20)
+                fail("unescaped control character");
+
+            if (symbol != '\\') {
+                text += symbol;
+                continue;
+            }
+
+            char escaped = next();
+            if (escaped == 'u') {
+                std::string digits;
+                for (int i = 0; i < 4; ++ i)
+                    digits += next();
+
+                if (!std::all_of(digits.begin(), digits.end(), [](char digit) { return std::isxdigit(digit); }))
+                    fail("bad \\u escape");
+
+                text += (char) std::stoi(digits, nullptr, 16); // Only control characters are escaped
+            } else if (std::string("\"\\/").find(escaped) != std::string::npos)
+                text += escaped;
+            else if (escaped == 'n')
+                text += '\n';
+            else if (std::string("bfrt").find(escaped) == std::string::npos)
+                fail("bad escape");
+        }
+
+        return text;
+    }
+
+    json_value read_value() {
+        skip_spaces();
+        if (m_position == m_text.size())
+            fail("missing value");
+
+        json_value value = { .kind = json_value::LITERAL };
+
+        char symbol = m_text[m_position];
+        if (symbol == '{') {
+            value.kind = json_value::OBJECT;
+
+            ++ m_position;
+            if (!skip_if('}')) {
+                do {
+                    std::string key = read_string();
+                    expect(':');
+                    value.members[key] = read_value();
+                } while (skip_if(','));
+
+                expect('}');
+            }
+        } else if (symbol == '[') {
+            value.kind = json_value::ARRAY;
+
+            ++ m_position;
+            if (!skip_if(']')) {
+                do
+                    value.elements.push_back(read_value());
+                while (skip_if(','));
+
+                expect(']');
+            }
+        } else if (symbol == '"') {
+            value.kind = json_value::STRING;
+            value.text = read_string();
+        } else if (symbol == '-' || std::isdigit((unsigned char) symbol)) {
+            value.kind = json_value::NUMBER;
+
+            size_t length = 0;
+            value.number = std::stoll(m_text.substr(m_position), &length);
+            m_position += length;
+        } else {
+            for (const char* literal: { "true", "false", "null" })
+                if (m_text.compare(m_position, std::strlen(literal), literal) == 0) {
+                    m_position += std::strlen(literal);
+                    return value;
+                }
+
+            fail("unknown value");
+        }
+
+        return value;
+    }
+};
+
+static json_value written_trace(const trace_events& trace) {
+    std::stringstream written;
+    trace.write(written);
+
+    return json_reader(written.str()).read_document();
+}
+
+struct span {
+    std::string name;
+    int64_t start, finish;
+};
+
+// Spans of every thread, checking that each is a complete event
+static std::map<int64_t, std::vector<span>> spans_by_thread(const json_value& trace) {
+    std::map<int64_t, std::vector<span>> threads;
+    for (const json_value& event: trace.at("traceEvents").elements) {
+        if (event.at("ph").text != "X" || event.at("dur").number < 0)
+            throw std::runtime_error("not a complete event");
+
+        int64_t start = event.at("ts").number;
+        threads[event.at("tid").number].push_back({ event.at("name").text, start, start + event.at("dur").number });
+    }
+
+    return threads;
+}
+
+// Spans of a thread have to nest as begin and end events would: each one
+// either ends before the next one begins or contains it
+static bool spans_nest(std::vector<span> spans) {
+    std::stable_sort(spans.begin(), spans.end(), [](const span& lhs, const span& rhs) {
+        return lhs.start < rhs.start || (lhs.start == rhs.start && lhs.finish > rhs.finish);
+    });
+
+    std::vector<int64_t> open;
+    for (const span& current: spans) {
+        while (!open.empty() && open.back() <= current.start)
+            open.pop_back();
+
+        if (!open.empty() && current.finish > open.back())
+            return false;
+
+        open.push_back(current.finish);
+    }
+
+    return true;
+}
+
+TEST(empty_trace_is_valid_json) {
+    trace_events trace;
+    json_value written = written_trace(trace);
+
+    ASSERT_EQUAL((int) written.at("traceEvents").elements.size(), 0);
+    ASSERT_STRING_EQUAL(written.at("displayTimeUnit").text, std::string("ms"));
+}
+
+TEST(names_are_escaped) {
+    trace_events trace;
+    auto now = trace_events::clock::now();
+    trace.add("say \"hi\"\\\n\tnow", "function", now, now);
+
+    json_value written = written_trace(trace);
+    ASSERT_STRING_EQUAL(written.at("traceEvents").elements[0].at("name").text, std::string("say \"hi\"\\\n\tnow"));
+    ASSERT_STRING_EQUAL(written.at("traceEvents").elements[0].at("cat").text, std::string("function"));
+}
+
+TEST(spans_nest_on_every_thread) {
+    trace_events trace;
+
+    {
+        trace_events_scope scope(&trace);
+
+        phase_timer compile("compile");
+        for (int i = 0; i < 50; ++ i) {
+            phase_timer parse("parse");
+            trace_span function("function", "f" + std::to_string(i));
+            { trace_span statement("statement", "return"); }
+        }
+
+        std::vector<std::thread> workers;
+        for (int worker = 0; worker < 3; ++ worker)
+            workers.emplace_back([] {
+                for (int i = 0; i < 20; ++ i) {
+                    trace_span outer("function", "outer");
+                    trace_span inner("function", "inner");
+                }
+            });
+
+        for (auto& worker: workers)
+            worker.join();
+    }
+
+    { trace_span ignored("function", "not traced"); }
+
+    auto threads = spans_by_thread(written_trace(trace));
+    ASSERT_EQUAL((int) threads.size(), 4);
+
+    size_t spans = 0;
+    for (const auto& [thread, thread_spans]: threads) {
+        ASSERT_EQUAL(spans_nest(thread_spans), true);
+        spans += thread_spans.size();
+    }
+
+    ASSERT_EQUAL((int) spans, 1 + 50 * 3 + 3 * 20 * 2);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,60 @@
+#include "trace-events.h"
+
+#include <cstdio>
+#include <ostream>
+
+// Small sequential ids read better in trace viewers than native thread ids
+static uint32_t current_thread_id() {
+    static std::atomic<uint32_t> next_id = 0;
+    thread_local uint32_t id = next_id ++;
+
+    return id;
+}
+
+void trace_events::add(std::string name, const char* category, clock::time_point start, clock::time_point finish) {
+    using std::chrono::duration_cast, std::chrono::microseconds;
+
+    // Both ends are rounded from the origin, so nested spans stay nested
+    int64_t start_time  = duration_cast<microseconds>(start  - m_origin).count();
+    int64_t finish_time = duration_cast<microseconds>(finish - m_origin).count();
+
+    event new_event = {
+        .name = std::move(name), .category = category,
+        .start = start_time, .duration = finish_time - start_time,
+        .thread = current_thread_id()
+    };
+
+    std::lock_guard lock(m_mutex);
+    m_events.push_back(std::move(new_event));
+}
+
+static void write_escaped(std::ostream& os, const std::string& text) {
+    for (char symbol: text) {
+        if (symbol == '"' || symbol == '\\')
+            os << '\\' << symbol;
+        else if ((unsigned char) symbol < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", symbol);
+            os << escaped;
+        } else
+            os << symbol;
+    }
+}
+
+void trace_events::write(std::ostream& os) const {
+    std::lock_guard lock(m_mutex);
+
+    os << "{\"traceEvents\": [\n";
+    for (size_t i = 0; i < m_events.size(); ++ i) {
+        const event& current = m_events[i];
+
+        os << "  {\"name\": \"";
+        write_escaped(os, current.name);
+        os << "\", \"cat\": \"" << current.category << "\", \"ph\": \"X\", "
+           << "\"ts\": " << current.start << ", \"dur\": " << current.duration << ", "
+           << "\"pid\": 1, \"tid\": " << current.thread << "}"
+           << (i + 1 == m_events.size() ? "\n" : ",\n");
+    }
+
+    os << "], \"displayTimeUnit\": \"ms\"}\n";
+}
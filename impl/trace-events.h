@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Spans in Chrome trace_event JSON format, file can be opened in
+ * Perfetto or about:tracing. Spans of the same thread nest by time,
+ * so there's no need to keep track of parents.
+ */
+class trace_events {
+public:
+    using clock = std::chrono::steady_clock;
+
+    void add(std::string name, const char* category, clock::time_point start, clock::time_point finish);
+
+    void write(std::ostream& os) const;
+
+private:
+    struct event {
+        std::string name;
+        const char* category;
+
+        int64_t start, duration; // Microseconds since m_origin
+        uint32_t thread;
+    };
+
+    clock::time_point m_origin = clock::now();
+
+    mutable std::mutex m_mutex; // Spans come from worker threads as well
+    std::vector<event> m_events;
+};
+
+// Unlike time report, trace is global, so worker threads add to it too
+inline std::atomic<trace_events*> current_trace = nullptr;
+
+class trace_events_scope {
+public:
+    trace_events_scope(trace_events* new_trace): m_saved_trace(current_trace.exchange(new_trace)) {}
+    ~trace_events_scope() { current_trace = m_saved_trace; }
+
+    trace_events_scope(const trace_events_scope&) = delete;
+    trace_events_scope& operator=(const trace_events_scope&) = delete;
+
+private:
+    trace_events* m_saved_trace;
+};
+
+inline bool tracing() { return current_trace.load(std::memory_order_relaxed) != nullptr; }
+
+// Span from construction to destruction, does nothing if trace isn't installed
+class trace_span {
+public:
+    trace_span(const char* category, std::string name)
+        : m_trace(current_trace.load(std::memory_order_relaxed)), m_category(category), m_start() {
+
+        if (m_trace != nullptr) {
+            m_name = std::move(name);
+            m_start = trace_events::clock::now();
+        }
+    }
+
+    ~trace_span() {
+        if (m_trace != nullptr)
+            m_trace->add(std::move(m_name), m_category, m_start, trace_events::clock::now());
+    }
+
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+
+private:
+    trace_events* m_trace;
+
+    std::string m_name;
+    const char* m_category;
+
+    trace_events::clock::time_point m_start;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// Arithmetic of the language: 64-bit and wrapping around on overflow,
+// it is shared by interpreters and constant folding, so they agree
+
+inline int64_t add_wrapping(int64_t lhs, int64_t rhs) { return (int64_t) ((uint64_t) lhs + (uint64_t) rhs); }
+inline int64_t sub_wrapping(int64_t lhs, int64_t rhs) { return (int64_t) ((uint64_t) lhs - (uint64_t) rhs); }
+inline int64_t mul_wrapping(int64_t lhs, int64_t rhs) { return (int64_t) ((uint64_t) lhs * (uint64_t) rhs); }
+inline int64_t neg_wrapping(int64_t value)            { return (int64_t) (0 - (uint64_t) value); }
+
+// Rounds towards zero, /rhs/ must not be zero
+inline int64_t div_wrapping(int64_t lhs, int64_t rhs) {
+    if (rhs == -1) // Only overflow is min / -1, which wraps to min
+        return neg_wrapping(lhs);
+
+    return lhs / rhs;
+}
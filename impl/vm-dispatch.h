@@ -0,0 +1,34 @@
+#pragma once
+
+// Dispatch loop of interpreters. With computed goto every handler jumps
+// straight to the next one through table /handlers/, that interpreter
+// declares with VM_LABEL of every handler in the order of opcodes,
+// otherwise it's a switch. VM_NEXT_OP has to be defined as opcode of
+// the instruction to run next:
+//
+//     #define VM_NEXT_OP ip->op
+//
+//     VM_DISPATCH_LOOP
+//         VM_HANDLER(stack_op, PUSH) { ...; VM_DISPATCH(); }
+//     VM_DISPATCH_LOOP_END
+//
+// Handlers must end with VM_DISPATCH(), return or throw.
+
+#if defined(__GNUC__) && !defined(VM_NO_COMPUTED_GOTO)
+    #define VM_COMPUTED_GOTO 1
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+    #define VM_DISPATCH()           goto *handlers[(unsigned) (VM_NEXT_OP)]
+    #define VM_DISPATCH_LOOP        VM_DISPATCH();
+    #define VM_DISPATCH_LOOP_END
+
+    #define VM_HANDLER(type, name)  vm_handler_##name:
+    #define VM_LABEL(name)          &&vm_handler_##name
+#else
+    #define VM_DISPATCH()           continue
+    #define VM_DISPATCH_LOOP        for (;;) switch (VM_NEXT_OP) {
+    #define VM_DISPATCH_LOOP_END    }
+
+    #define VM_HANDLER(type, name)  case type::name:
+#endif
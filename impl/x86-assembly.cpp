@@ -0,0 +1,116 @@
+#include "x86-assembly.h"
+
+#include <ostream>
+#include <stdexcept>
+
+static void print_operand(std::ostream& os, const x86_operand& operand) {
+    switch (operand.type) {
+    case x86_operand::kind::REGISTER:
+        os << "%" << x86_register_name(operand.reg);
+        break;
+
+    case x86_operand::kind::MEMORY:
+        if (operand.value != 0)
+            os << operand.value;
+        os << "(%" << x86_register_name(operand.reg) << ")";
+        break;
+
+    case x86_operand::kind::IMMEDIATE:
+        os << "$" << operand.value;
+        break;
+
+    case x86_operand::kind::NONE:
+        throw std::logic_error("x86: instruction is missing an operand");
+    }
+}
+
+static void print_label(std::ostream& os, const x86_function& function, uint32_t label) {
+    os << ".L" << function.index << "_" << label;
+}
+
+static void print_instruction(std::ostream& os, const x86_instruction& instruction,
+                              const x86_function& function, const std::vector<x86_function>& functions) {
+    // AT&T order is source first
+    auto binary = [&](const char* mnemonic) {
+        os << "\t" << mnemonic << "\t";
+        print_operand(os, instruction.src);
+        os << ", ";
+        print_operand(os, instruction.dst);
+        os << "\n";
+    };
+
+    auto unary = [&](const char* mnemonic) {
+        os << "\t" << mnemonic << "\t";
+        print_operand(os, instruction.dst);
+        os << "\n";
+    };
+
+    switch (instruction.op) {
+    case x86_op::LABEL:
+        print_label(os, function, instruction.target);
+        os << ":\n";
+        break;
+
+    case x86_op::MOV:    binary("movq");    break;
+    case x86_op::ADD:    binary("addq");    break;
+    case x86_op::SUB:    binary("subq");    break;
+    case x86_op::IMUL:   binary("imulq");   break;
+    case x86_op::CMP:    binary("cmpq");    break;
+    case x86_op::TEST:   binary("testq");   break;
+    case x86_op::LEA:    binary("leaq");    break;
+    case x86_op::MOVABS: binary("movabsq"); break;
+
+    case x86_op::NEG:  unary("negq");  break;
+    case x86_op::IDIV: unary("idivq"); break;
+    case x86_op::PUSH: unary("pushq"); break;
+    case x86_op::POP:  unary("popq");  break;
+
+    case x86_op::CQO: os << "\tcqto\n"; break;
+    case x86_op::RET: os << "\tret\n";  break;
+
+    case x86_op::JMP:
+        os << "\tjmp\t";
+        print_label(os, function, instruction.target);
+        os << "\n";
+        break;
+
+    case x86_op::JCC:
+        os << "\tj" << x86_condition_name(instruction.condition) << "\t";
+        print_label(os, function, instruction.target);
+        os << "\n";
+        break;
+
+    case x86_op::CALL:
+        os << "\tcall\t" << functions[instruction.target].name << "\n";
+        break;
+
+    case x86_op::TAIL_JUMP:
+        os << "\tjmp\t" << functions[instruction.target].name << "\n";
+        break;
+
+    case x86_op::LOAD_STACK_LIMIT:
+    case x86_op::TRAP:
+        throw std::logic_error("x86: code with runtime checks can only be encoded for JIT");
+    }
+}
+
+void print_x86_assembly(std::ostream& os, const std::vector<x86_function>& functions) {
+    os << "\t.text\n";
+
+    for (const auto& function: functions) {
+        const std::string& name = function.name;
+
+        os << "\n\t.globl\t" << name << "\n";
+        os << "\t.type\t" << name << ", @function\n";
+        os << "\t.p2align\t4, 0xcc\n";
+        os << name << ":\n";
+
+        for (const auto& instruction: function.code)
+            print_instruction(os, instruction, function, functions);
+
+        os << "\t.size\t" << name << ", .-" << name << "\n";
+    }
+
+    // Code doesn't need executable stack
+    os << "\n\t.section\t.note.GNU-stack,\"\",@progbits\n";
+}
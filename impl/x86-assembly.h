@@ -0,0 +1,16 @@
+#pragma once
+
+#include "x86.h"
+
+#include <iosfwd>
+#include <vector>
+
+/**
+ * Print functions as GNU assembler source in AT&T syntax, every
+ * function is a global symbol. /functions/ are all functions of the
+ * program in order of their indices, which is what calls refer to.
+ *
+ * Code has to be lowered without runtime checks, there's no runtime
+ * to report them to.
+ */
+void print_x86_assembly(std::ostream& os, const std::vector<x86_function>& functions);
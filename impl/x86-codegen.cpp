@@ -0,0 +1,525 @@
+#include "x86-codegen.h"
+
+#include <algorithm>
+#include <limits>
+
+using enum x86_register;
+
+static const x86_register argument_registers[] = { RDI, RSI, RDX, RCX, R8, R9 };
+static const x86_register allocatable_registers[] = { RBX, R12, R13, R14, R15 }; // Callee-saved
+
+static const uint32_t no_label = std::numeric_limits<uint32_t>::max();
+
+static bool fits_in_32_bits(int64_t value) {
+    return value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max();
+}
+
+static bool is_jump(register_op op) {
+    return op >= register_op::JUMP && op <= register_op::JUMP_IF_NOT_EQUALS;
+}
+
+static x86_condition condition_of(register_op op) {
+    switch (op) {
+    case register_op::JUMP_IF_LESS:             return x86_condition::L;
+    case register_op::JUMP_IF_LESS_OR_EQUAL:    return x86_condition::LE;
+    case register_op::JUMP_IF_GREATER:          return x86_condition::G;
+    case register_op::JUMP_IF_GREATER_OR_EQUAL: return x86_condition::GE;
+    case register_op::JUMP_IF_EQUALS:           return x86_condition::E;
+    default:                                    return x86_condition::NE;
+    }
+}
+
+class x86_lowering {
+public:
+    x86_lowering(const register_program& program, uint32_t index, const x86_codegen_options& options)
+        : m_program(program), m_function(program.functions[index]), m_options(options),
+          m_entry(m_function.entry), m_end(program.end_of(index)) {
+
+        m_result.name = m_function.name;
+        m_result.index = index;
+    }
+
+    x86_function lower() {
+        allocate_registers();
+        create_labels();
+
+        prologue();
+        for (uint32_t i = 0; i < m_function.arity; ++ i) {
+            if (i < std::size(argument_registers))
+                move(m_locations[i], x86_reg(argument_registers[i]));
+            else // Above return address and saved RBP
+                move(m_locations[i], x86_mem(RBP, 16 + 8 * (int32_t) (i - std::size(argument_registers))));
+        }
+
+        for (uint32_t i = m_entry; i < m_end; ++ i) {
+            if (m_labels[i - m_entry] != no_label)
+                emit(x86_op::LABEL, {}, {}, m_labels[i - m_entry]);
+
+            lower_instruction(m_program.code[i]);
+        }
+
+        emit(x86_op::LABEL, {}, {}, m_epilogue);
+        epilogue();
+
+        if (m_options.loop_entries)
+            for (const auto& [head, label]: m_result.loop_entries)
+                loop_entry(head, label);
+
+        if (m_options.runtime_checks) {
+            emit(x86_op::LABEL, {}, {}, m_stack_overflow);
+            emit(x86_op::TRAP, {}, {}, (uint32_t) x86_trap::STACK_OVERFLOW);
+
+            emit(x86_op::LABEL, {}, {}, m_division_by_zero);
+            emit(x86_op::TRAP, {}, {}, (uint32_t) x86_trap::DIVISION_BY_ZERO);
+        }
+
+        return std::move(m_result);
+    }
+
+private:
+    const register_program& m_program;
+    const register_function& m_function;
+    x86_codegen_options m_options;
+
+    uint32_t m_entry, m_end; // Instructions of function in m_program.code
+
+    x86_function m_result;
+
+    std::vector<x86_operand> m_locations;                       // Of every bytecode register
+    std::vector<x86_register> m_saved;                          // Allocated callee-saved registers
+    std::vector<std::pair<x86_operand, int64_t>> m_wide_constants; // Don't fit in immediates, kept in frame
+    int32_t m_frame_size = 0;                                   // Below saved registers
+
+    std::vector<uint32_t> m_labels; // Of jump targets, by index of instruction in function
+    uint32_t m_epilogue = 0, m_stack_overflow = 0, m_division_by_zero = 0;
+
+    uint32_t new_label() { return m_result.labels ++; }
+
+    void emit(x86_op op, x86_operand dst = {}, x86_operand src = {}, uint32_t target = 0,
+              x86_condition condition = x86_condition::O) {
+        m_result.code.push_back({ op, condition, dst, src, target });
+    }
+
+    void move(x86_operand dst, x86_operand src) {
+        if (dst == src)
+            return;
+
+        if (dst.type == x86_operand::kind::MEMORY && src.type == x86_operand::kind::MEMORY) {
+            emit(x86_op::MOV, x86_reg(RAX), src);
+            src = x86_reg(RAX);
+        }
+
+        emit(x86_op::MOV, dst, src);
+    }
+
+    template <typename visitor>
+    void for_each_register(const register_instruction& instruction, visitor&& visit) const {
+        switch (instruction.op) {
+        case register_op::MOVE: case register_op::NEG:
+            visit(instruction.a); visit(instruction.b);
+            break;
+
+        case register_op::ADD: case register_op::SUB: case register_op::MUL: case register_op::DIV:
+            visit(instruction.a); visit(instruction.b); visit(instruction.c);
+            break;
+
+        case register_op::JUMP:
+            break;
+
+        case register_op::CALL:
+            visit(instruction.a);
+            [[fallthrough]];
+
+        case register_op::TAIL_CALL:
+            for (uint32_t i = 0; i < m_program.functions[instruction.c].arity; ++ i)
+                visit(instruction.b + i);
+            break;
+
+        case register_op::RETURN:
+            visit(instruction.a);
+            break;
+
+        default: // Conditional jumps
+            visit(instruction.b); visit(instruction.c);
+            break;
+        }
+    }
+
+    void allocate_registers() {
+        uint32_t registers = m_function.registers;
+
+        // Constant registers that are never written to are replaced with their values
+        std::vector<bool> written(registers);
+        for (uint32_t i = m_entry; i < m_end; ++ i) {
+            const register_instruction& current = m_program.code[i];
+            if (!is_jump(current.op) && current.op != register_op::RETURN && current.op != register_op::TAIL_CALL)
+                written[current.a] = true;
+        }
+
+        auto constant = [&](uint32_t reg) -> const int64_t* {
+            uint32_t first = m_function.arity;
+            if (reg < first || reg >= first + m_function.constants.size() || written[reg])
+                return nullptr;
+
+            return &m_function.constants[reg - first];
+        };
+
+        // Every loop around a reference makes it 8 times heavier
+        std::vector<uint32_t> depth(m_end - m_entry);
+        for (uint32_t i = m_entry; i < m_end; ++ i) {
+            const register_instruction& current = m_program.code[i];
+            if (is_jump(current.op) && current.a <= i)
+                for (uint32_t j = current.a; j <= i; ++ j)
+                    ++ depth[j - m_entry];
+        }
+
+        std::vector<uint64_t> weight(registers);
+        for (uint32_t i = m_entry; i < m_end; ++ i)
+            for_each_register(m_program.code[i], [&](uint32_t reg) {
+                weight[reg] += uint64_t(1) << (3 * std::min(depth[i - m_entry], 6u));
+            });
+
+        std::vector<uint32_t> candidates;
+        for (uint32_t reg = 0; reg < registers; ++ reg)
+            if (constant(reg) == nullptr && weight[reg] != 0)
+                candidates.push_back(reg);
+
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [&](uint32_t lhs, uint32_t rhs) { return weight[lhs] > weight[rhs]; });
+
+        m_locations.resize(registers);
+        candidates.resize(std::min(candidates.size(), std::size(allocatable_registers)));
+
+        for (uint32_t reg: candidates) {
+            x86_register machine = allocatable_registers[m_saved.size()];
+
+            m_locations[reg] = x86_reg(machine);
+            m_saved.push_back(machine);
+        }
+
+        // Everything else that needs a place goes to frame below saved registers
+        int32_t slots = 0;
+        auto next_slot = [&] {
+            ++ slots;
+            return x86_mem(RBP, -8 * (int32_t) (m_saved.size() + slots));
+        };
+
+        for (uint32_t reg = 0; reg < registers; ++ reg) {
+            if (m_locations[reg].type != x86_operand::kind::NONE)
+                continue;
+
+            if (const int64_t* value = constant(reg)) {
+                if (fits_in_32_bits(*value))
+                    m_locations[reg] = x86_imm(*value);
+                else {
+                    m_locations[reg] = next_slot();
+                    m_wide_constants.emplace_back(m_locations[reg], *value);
+                }
+            } else
+                m_locations[reg] = next_slot();
+        }
+
+        // Stack stays aligned to 16 bytes at calls, return address and RBP take 16 bytes
+        m_frame_size = 8 * slots;
+        if ((m_saved.size() * 8 + m_frame_size) % 16 != 0)
+            m_frame_size += 8;
+    }
+
+    void create_labels() {
+        m_labels.assign(m_end - m_entry + 1, no_label);
+
+        for (uint32_t i = m_entry; i < m_end; ++ i) {
+            const register_instruction& current = m_program.code[i];
+            if (!is_jump(current.op))
+                continue;
+
+            uint32_t& label = m_labels[current.a - m_entry];
+            if (label == no_label)
+                label = new_label();
+
+            if (current.a <= i && m_options.loop_entries && !has_loop_entry(current.a))
+                m_result.loop_entries.emplace_back(current.a, new_label());
+        }
+
+        m_epilogue = new_label();
+        m_stack_overflow = new_label();
+        m_division_by_zero = new_label();
+    }
+
+    bool has_loop_entry(uint32_t head) const {
+        for (const auto& entry: m_result.loop_entries)
+            if (entry.first == head)
+                return true;
+
+        return false;
+    }
+
+    void prologue() {
+        emit(x86_op::PUSH, x86_reg(RBP));
+        emit(x86_op::MOV, x86_reg(RBP), x86_reg(RSP));
+
+        for (x86_register saved: m_saved)
+            emit(x86_op::PUSH, x86_reg(saved));
+
+        if (m_frame_size != 0)
+            emit(x86_op::SUB, x86_reg(RSP), x86_imm(m_frame_size));
+
+        if (m_options.runtime_checks) {
+            emit(x86_op::LOAD_STACK_LIMIT, x86_reg(RAX));
+            emit(x86_op::CMP, x86_reg(RSP), x86_reg(RAX));
+            emit(x86_op::JCC, {}, {}, m_stack_overflow, x86_condition::B);
+        }
+
+        for (const auto& [location, value]: m_wide_constants) {
+            emit(x86_op::MOVABS, x86_reg(RAX), x86_imm(value));
+            emit(x86_op::MOV, location, x86_reg(RAX));
+        }
+    }
+
+    void epilogue() { // Result is in RAX
+        leave_frame();
+        emit(x86_op::RET);
+    }
+
+    // Stack is as it was on entry, with return address on top
+    void leave_frame() {
+        if (m_frame_size != 0)
+            emit(x86_op::ADD, x86_reg(RSP), x86_imm(m_frame_size));
+
+        for (auto saved = m_saved.rbegin(); saved != m_saved.rend(); ++ saved)
+            emit(x86_op::POP, x86_reg(*saved));
+
+        emit(x86_op::POP, x86_reg(RBP));
+    }
+
+    // Same frame as the function's, but registers come from interpreter's frame in RDI
+    void loop_entry(uint32_t head, uint32_t label) {
+        emit(x86_op::LABEL, {}, {}, label);
+        prologue();
+
+        for (uint32_t reg = 0; reg < m_function.registers; ++ reg) {
+            const x86_operand& location = m_locations[reg];
+            if (location.type == x86_operand::kind::IMMEDIATE)
+                continue;
+
+            move(location, x86_mem(RDI, 8 * (int32_t) reg));
+        }
+
+        emit(x86_op::JMP, {}, {}, m_labels[head - m_entry]);
+    }
+
+    void lower_instruction(const register_instruction& instruction) {
+        const auto& location = m_locations;
+
+        switch (instruction.op) {
+        case register_op::MOVE:
+            move(location[instruction.a], location[instruction.b]);
+            break;
+
+        case register_op::ADD: case register_op::SUB: case register_op::MUL:
+            lower_arithmetic(instruction);
+            break;
+
+        case register_op::DIV:
+            lower_division(instruction);
+            break;
+
+        case register_op::NEG:
+            move(x86_reg(RAX), location[instruction.b]);
+            emit(x86_op::NEG, x86_reg(RAX));
+            move(location[instruction.a], x86_reg(RAX));
+            break;
+
+        case register_op::JUMP:
+            emit(x86_op::JMP, {}, {}, m_labels[instruction.a - m_entry]);
+            break;
+
+        case register_op::CALL:
+            lower_call(instruction.c, instruction.b);
+            move(location[instruction.a], x86_reg(RAX));
+            break;
+
+        case register_op::TAIL_CALL:
+            lower_tail_call(instruction);
+            break;
+
+        case register_op::RETURN:
+            move(x86_reg(RAX), location[instruction.a]);
+            emit(x86_op::JMP, {}, {}, m_epilogue);
+            break;
+
+        default: { // Conditional jumps
+            x86_operand lhs = location[instruction.b], rhs = location[instruction.c];
+
+            // CMP can't take immediate on the left, nor two memory operands
+            if (lhs.type == x86_operand::kind::IMMEDIATE ||
+                (lhs.type == x86_operand::kind::MEMORY && rhs.type == x86_operand::kind::MEMORY)) {
+                move(x86_reg(RAX), lhs);
+                lhs = x86_reg(RAX);
+            }
+
+            emit(x86_op::CMP, lhs, rhs);
+            emit(x86_op::JCC, {}, {}, m_labels[instruction.a - m_entry], condition_of(instruction.op));
+            break;
+        }
+        }
+    }
+
+    void lower_arithmetic(const register_instruction& instruction) {
+        x86_op op = instruction.op == register_op::ADD ? x86_op::ADD :
+                    instruction.op == register_op::SUB ? x86_op::SUB : x86_op::IMUL;
+
+        x86_operand result = m_locations[instruction.a];
+        x86_operand lhs = m_locations[instruction.b], rhs = m_locations[instruction.c];
+
+        // Register that is updated in place, like loop variables, doesn't need RAX
+        bool commutative = op != x86_op::SUB;
+        if (result.type == x86_operand::kind::REGISTER && commutative && result == rhs && result != lhs)
+            std::swap(lhs, rhs);
+
+        if (result.type == x86_operand::kind::REGISTER && result == lhs) {
+            emit(op, result, rhs);
+            return;
+        }
+
+        move(x86_reg(RAX), lhs);
+        emit(op, x86_reg(RAX), rhs);
+        move(result, x86_reg(RAX));
+    }
+
+    void lower_division(const register_instruction& instruction) {
+        x86_operand result = m_locations[instruction.a];
+        x86_operand lhs = m_locations[instruction.b], rhs = m_locations[instruction.c];
+
+        move(x86_reg(RCX), rhs);
+        move(x86_reg(RAX), lhs);
+
+        bool constant = rhs.type == x86_operand::kind::IMMEDIATE;
+        if (constant && rhs.value == -1) {
+            emit(x86_op::NEG, x86_reg(RAX));
+            move(result, x86_reg(RAX));
+            return;
+        }
+
+        if (constant && rhs.value != 0) {
+            emit(x86_op::CQO);
+            emit(x86_op::IDIV, x86_reg(RCX));
+            move(result, x86_reg(RAX));
+            return;
+        }
+
+        if (m_options.runtime_checks) {
+            emit(x86_op::TEST, x86_reg(RCX), x86_reg(RCX));
+            emit(x86_op::JCC, {}, {}, m_division_by_zero, x86_condition::E);
+        }
+
+        // Division of minimum by -1 faults, while the language wraps it around
+        uint32_t divide = new_label(), done = new_label();
+
+        emit(x86_op::CMP, x86_reg(RCX), x86_imm(-1));
+        emit(x86_op::JCC, {}, {}, divide, x86_condition::NE);
+        emit(x86_op::NEG, x86_reg(RAX));
+        emit(x86_op::JMP, {}, {}, done);
+
+        emit(x86_op::LABEL, {}, {}, divide);
+        emit(x86_op::CQO);
+        emit(x86_op::IDIV, x86_reg(RCX));
+
+        emit(x86_op::LABEL, {}, {}, done);
+        move(result, x86_reg(RAX));
+    }
+
+    // Result is in RAX
+    void lower_call(uint32_t callee, uint32_t arguments) {
+        uint32_t arity = m_program.functions[callee].arity;
+        uint32_t in_registers = std::min<uint32_t>(arity, std::size(argument_registers));
+
+        // The rest of arguments are pushed right to left, with stack aligned after them
+        uint32_t on_stack = arity - in_registers;
+        int32_t padding = on_stack % 2 == 0 ? 0 : 8;
+
+        if (padding != 0)
+            emit(x86_op::SUB, x86_reg(RSP), x86_imm(padding));
+
+        for (uint32_t i = arity; i -- > in_registers; )
+            emit(x86_op::PUSH, m_locations[arguments + i]);
+
+        // Registers of bytecode are never in argument registers, so there are no conflicts
+        for (uint32_t i = 0; i < in_registers; ++ i)
+            move(x86_reg(argument_registers[i]), m_locations[arguments + i]);
+
+        emit(x86_op::CALL, {}, {}, callee);
+
+        if (on_stack != 0)
+            emit(x86_op::ADD, x86_reg(RSP), x86_imm(8 * on_stack + padding));
+    }
+
+    // Arguments that go on stack replace this function's own, which caller pops, so callee
+    // that takes more of them than this function was passed is called as usual instead.
+    // Loop entries are called by interpreter with no arguments on stack at all
+    void lower_tail_call(const register_instruction& instruction) {
+        uint32_t arity = m_program.functions[instruction.c].arity;
+        uint32_t in_registers = std::min<uint32_t>(arity, std::size(argument_registers));
+
+        uint32_t on_stack = arity - in_registers;
+        uint32_t own_on_stack = m_function.arity - std::min<uint32_t>(m_function.arity, std::size(argument_registers));
+        if (!m_result.loop_entries.empty())
+            own_on_stack = 0;
+
+        if (on_stack > own_on_stack) {
+            lower_call(instruction.c, instruction.b);
+            emit(x86_op::JMP, {}, {}, m_epilogue);
+            return;
+        }
+
+        // Own arguments were moved to their registers by prologue, so their slots are free
+        for (uint32_t i = 0; i < on_stack; ++ i)
+            move(x86_mem(RBP, 16 + 8 * (int32_t) i), m_locations[instruction.b + in_registers + i]);
+
+        for (uint32_t i = 0; i < in_registers; ++ i)
+            move(x86_reg(argument_registers[i]), m_locations[instruction.b + i]);
+
+        leave_frame();
+        emit(x86_op::TAIL_JUMP, {}, {}, instruction.c);
+    }
+};
+
+x86_function lower_to_x86(const register_program& program, uint32_t function, const x86_codegen_options& options) {
+    x86_lowering lowering(program, function, options);
+    return lowering.lower();
+}
+
+x86_function lower_entry_thunk(const register_program& program, uint32_t function) {
+    x86_function thunk;
+    thunk.name = program.functions[function].name + ".entry";
+    thunk.index = function;
+
+    auto emit = [&](x86_op op, x86_operand dst = {}, x86_operand src = {}, uint32_t target = 0) {
+        thunk.code.push_back({ op, x86_condition::O, dst, src, target });
+    };
+
+    uint32_t arity = program.functions[function].arity;
+    uint32_t in_registers = std::min<uint32_t>(arity, std::size(argument_registers));
+    uint32_t on_stack = arity - in_registers;
+
+    emit(x86_op::PUSH, x86_reg(RBP));
+    emit(x86_op::MOV, x86_reg(RBP), x86_reg(RSP));
+    emit(x86_op::MOV, x86_reg(R10), x86_reg(RDI));
+
+    if (on_stack % 2 != 0)
+        emit(x86_op::SUB, x86_reg(RSP), x86_imm(8));
+
+    for (uint32_t i = arity; i -- > in_registers; )
+        emit(x86_op::PUSH, x86_mem(R10, 8 * (int32_t) i));
+
+    for (uint32_t i = 0; i < in_registers; ++ i)
+        emit(x86_op::MOV, x86_reg(argument_registers[i]), x86_mem(R10, 8 * (int32_t) i));
+
+    emit(x86_op::CALL, {}, {}, function);
+
+    emit(x86_op::MOV, x86_reg(RSP), x86_reg(RBP));
+    emit(x86_op::POP, x86_reg(RBP));
+    emit(x86_op::RET);
+
+    return thunk;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "register-bytecode.h"
+#include "x86.h"
+
+#include <cstdint>
+
+struct x86_codegen_options {
+    // Trap division by zero and stack overflow (see x86_runtime),
+    // otherwise division by zero faults as native code does
+    bool runtime_checks = true;
+
+    // Add x86_function::loop_entries, to move running loops from interpreter to native code
+    bool loop_entries = false;
+};
+
+/**
+ * Select instructions for function of register_program, with System V
+ * calling convention. Registers of bytecode that are used the most
+ * (references in loops count more) are kept in callee-saved machine
+ * registers, the rest are in frame, constants become immediates.
+ */
+x86_function lower_to_x86(const register_program& program, uint32_t function,
+                          const x86_codegen_options& options = {});
+
+// int64_t thunk(const int64_t* arguments) that calls /function/ with arguments from array
+x86_function lower_entry_thunk(const register_program& program, uint32_t function);
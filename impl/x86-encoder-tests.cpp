@@ -0,0 +1,135 @@
+#include "x86-encoder.h"
+#include "test-framework.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using enum x86_register;
+
+static x86_instruction instruction(x86_op op, x86_operand dst = {}, x86_operand src = {}, uint32_t target = 0,
+                                   x86_condition condition = x86_condition::O) {
+    return { op, condition, dst, src, target };
+}
+
+static std::string hex(const std::vector<uint8_t>& bytes) {
+    std::string text;
+    for (uint8_t byte: bytes) {
+        char digits[4] = {};
+        snprintf(digits, sizeof(digits), "%02X", byte);
+        text += (text.empty() ? "" : " ") + std::string(digits);
+    }
+
+    return text;
+}
+
+// Machine code of function made of /code/, bytes in hex
+static std::string encoded(const std::vector<x86_instruction>& code, uint32_t labels = 0) {
+    x86_function function = { "test", 0, code, labels, {} };
+
+    x86_encoder encoder;
+    encoder.encode(function);
+    return hex(encoder.bytes());
+}
+
+TEST(moves) {
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::MOV, x86_reg(RBP), x86_reg(RSP)) }), std::string("48 8B EC"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::MOV, x86_reg(RAX), x86_mem(RBP, -8)) }), std::string("48 8B 45 F8"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::MOV, x86_mem(RSP, 16), x86_reg(R8)) }), std::string("4C 89 44 24 10"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::MOV, x86_reg(R9), x86_mem(R13, 0)) }), std::string("4D 8B 4D 00"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::MOV, x86_reg(RCX), x86_mem(RAX, 1024)) }),
+                        std::string("48 8B 88 00 04 00 00"));
+
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::MOV, x86_mem(R12, 0), x86_imm(-1)) }),
+                        std::string("49 C7 04 24 FF FF FF FF"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::MOVABS, x86_reg(R10), x86_imm(0x1122334455667788)) }),
+                        std::string("49 BA 88 77 66 55 44 33 22 11"));
+
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::LEA, x86_reg(RDI), x86_mem(RSP, 8)) }), std::string("48 8D 7C 24 08"));
+}
+
+TEST(arithmetic) {
+    // Immediates that fit in a byte take the short form
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::SUB, x86_reg(RSP), x86_imm(8)) }), std::string("48 83 EC 08"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::ADD, x86_reg(RAX), x86_imm(1000)) }), std::string("48 81 C0 E8 03 00 00"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::ADD, x86_reg(R15), x86_mem(RBX, 8)) }), std::string("4C 03 7B 08"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::SUB, x86_mem(RBP, -16), x86_reg(RDX)) }), std::string("48 29 55 F0"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::CMP, x86_reg(RAX), x86_reg(RCX)) }), std::string("48 3B C1"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::TEST, x86_reg(RAX), x86_reg(RAX)) }), std::string("48 85 C0"));
+
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::IMUL, x86_reg(RCX), x86_reg(R11)) }), std::string("49 0F AF CB"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::IMUL, x86_reg(RDX), x86_imm(3)) }), std::string("48 6B D2 03"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::IMUL, x86_reg(R8), x86_imm(100000)) }), std::string("4D 69 C0 A0 86 01 00"));
+
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::CQO), instruction(x86_op::IDIV, x86_reg(RCX)) }),
+                        std::string("48 99 48 F7 F9"));
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::NEG, x86_reg(RAX)) }), std::string("48 F7 D8"));
+}
+
+TEST(stack) {
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::PUSH, x86_reg(RBP)), instruction(x86_op::PUSH, x86_reg(R12)),
+                                  instruction(x86_op::POP, x86_reg(R12)), instruction(x86_op::POP, x86_reg(RBP)),
+                                  instruction(x86_op::RET) }),
+                        std::string("55 41 54 41 5C 5D C3"));
+
+    ASSERT_STRING_EQUAL(encoded({ instruction(x86_op::PUSH, x86_imm(5)), instruction(x86_op::PUSH, x86_imm(1000)),
+                                  instruction(x86_op::PUSH, x86_mem(RBP, 16)) }),
+                        std::string("6A 05 68 E8 03 00 00 FF 75 10"));
+}
+
+TEST(jumps_to_labels) {
+    std::vector<x86_instruction> loop = {
+        instruction(x86_op::LABEL, {}, {}, 0),
+        instruction(x86_op::CMP, x86_reg(RAX), x86_reg(RCX)),
+        instruction(x86_op::JCC, {}, {}, 1, x86_condition::GE),
+        instruction(x86_op::NEG, x86_reg(RAX)),
+        instruction(x86_op::JMP, {}, {}, 0),
+        instruction(x86_op::LABEL, {}, {}, 1),
+        instruction(x86_op::RET)
+    };
+
+    // Displacements are from the end of jump: forward one skips 8 bytes, backward one goes 17 bytes back
+    ASSERT_STRING_EQUAL(encoded(loop, 2), std::string("48 3B C1 0F 8D 08 00 00 00 48 F7 D8 E9 EF FF FF FF C3"));
+
+    x86_function function = { "test", 0, loop, 2, {} };
+
+    x86_encoder encoder;
+    ASSERT_EQUAL(encoder.encode(function) == std::vector<uint32_t>({ 0, 17 }), true);
+}
+
+TEST(calls_are_left_for_the_user) {
+    x86_encoder encoder;
+    encoder.encode({ "first", 0, { instruction(x86_op::RET) }, 0, {} });
+    encoder.align(16);
+
+    std::vector<uint32_t> labels = encoder.encode({ "second", 1, {
+        instruction(x86_op::CALL, {}, {}, 0),
+        instruction(x86_op::TAIL_JUMP, {}, {}, 1)
+    }, 0, {} });
+
+    ASSERT_EQUAL((int) labels.size(), 0);
+    ASSERT_STRING_EQUAL(hex(encoder.bytes()), std::string("C3 CC CC CC CC CC CC CC CC CC CC CC CC CC CC CC "
+                                                          "E8 00 00 00 00 E9 00 00 00 00"));
+
+    ASSERT_EQUAL((int) encoder.calls().size(), 2);
+    ASSERT_EQUAL((int) encoder.calls()[0].offset, 17);
+    ASSERT_EQUAL((int) encoder.calls()[0].function, 0);
+    ASSERT_EQUAL((int) encoder.calls()[1].offset, 22);
+    ASSERT_EQUAL((int) encoder.calls()[1].function, 1);
+}
+
+TEST(runtime_checks_need_runtime) {
+    bool thrown = false;
+    try {
+        encoded({ instruction(x86_op::TRAP, {}, {}, (uint32_t) x86_trap::DIVISION_BY_ZERO) });
+    } catch (const std::logic_error&) {
+        thrown = true;
+    }
+
+    ASSERT_EQUAL(thrown, true);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
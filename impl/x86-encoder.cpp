@@ -0,0 +1,229 @@
+#include "x86-encoder.h"
+
+#include <limits>
+#include <stdexcept>
+
+static unsigned code_of(x86_register reg) { return (unsigned) reg; }
+
+static bool fits_in_8_bits(int64_t value) { return value >= -128 && value <= 127; }
+
+static const uint32_t unresolved = std::numeric_limits<uint32_t>::max();
+
+void x86_encoder::imm32(int64_t value) {
+    uint32_t bits = (uint32_t) (int32_t) value;
+    for (int i = 0; i < 4; ++ i)
+        byte((uint8_t) (bits >> (8 * i)));
+}
+
+void x86_encoder::imm64(int64_t value) {
+    uint64_t bits = (uint64_t) value;
+    for (int i = 0; i < 8; ++ i)
+        byte((uint8_t) (bits >> (8 * i)));
+}
+
+void x86_encoder::align(size_t alignment) {
+    while (m_bytes.size() % alignment != 0)
+        byte(0xCC);
+}
+
+void x86_encoder::encode_rm(std::initializer_list<uint8_t> opcode, unsigned reg, const x86_operand& rm, bool wide) {
+    unsigned base = code_of(rm.reg);
+
+    uint8_t rex = 0x40 | (wide ? 0x08 : 0) | ((reg >> 3) & 1) << 2 | ((base >> 3) & 1);
+    if (rex != 0x40)
+        byte(rex);
+
+    for (uint8_t part: opcode)
+        byte(part);
+
+    if (rm.type == x86_operand::kind::REGISTER) {
+        byte((uint8_t) (0xC0 | (reg & 7) << 3 | (base & 7)));
+        return;
+    }
+
+    if (rm.type != x86_operand::kind::MEMORY)
+        throw std::logic_error("x86: operand has to be register or memory");
+
+    // RBP and R13 without displacement would mean RIP relative, so they always get one
+    int64_t displacement = rm.value;
+    unsigned mod = displacement == 0 && (base & 7) != 5 ? 0 : fits_in_8_bits(displacement) ? 1 : 2;
+
+    byte((uint8_t) (mod << 6 | (reg & 7) << 3 | (base & 7)));
+    if ((base & 7) == 4) // RSP and R12 need SIB byte
+        byte(0x24);
+
+    if (mod == 1)
+        byte((uint8_t) (int8_t) displacement);
+    else if (mod == 2)
+        imm32(displacement);
+}
+
+void x86_encoder::encode_arithmetic(const x86_instruction& instruction, uint8_t extension,
+                                    uint8_t rm_reg, uint8_t reg_rm) {
+    const x86_operand& dst = instruction.dst;
+    const x86_operand& src = instruction.src;
+
+    if (src.type == x86_operand::kind::IMMEDIATE) {
+        if (fits_in_8_bits(src.value)) {
+            encode_rm({ 0x83 }, extension, dst);
+            byte((uint8_t) (int8_t) src.value);
+        } else {
+            encode_rm({ 0x81 }, extension, dst);
+            imm32(src.value);
+        }
+    } else if (dst.type == x86_operand::kind::REGISTER)
+        encode_rm({ reg_rm }, code_of(dst.reg), src);
+    else if (src.type == x86_operand::kind::REGISTER)
+        encode_rm({ rm_reg }, code_of(src.reg), dst);
+    else
+        throw std::logic_error("x86: instruction can't take two memory operands");
+}
+
+void x86_encoder::encode_instruction(const x86_instruction& instruction, uint32_t function,
+                                     std::vector<uint32_t>& labels,
+                                     std::vector<std::pair<uint32_t, uint32_t>>& jumps) {
+    const x86_operand& dst = instruction.dst;
+    const x86_operand& src = instruction.src;
+
+    auto jump_to = [&](uint32_t label) {
+        jumps.emplace_back((uint32_t) m_bytes.size(), label);
+        imm32(0);
+    };
+
+    auto needs_runtime = [&] {
+        if (m_runtime == nullptr)
+            throw std::logic_error("x86: code with runtime checks can only be encoded for JIT");
+    };
+
+    switch (instruction.op) {
+    case x86_op::LABEL:
+        labels[instruction.target] = (uint32_t) m_bytes.size();
+        break;
+
+    case x86_op::MOV:
+        if (src.type == x86_operand::kind::IMMEDIATE) {
+            encode_rm({ 0xC7 }, 0, dst);
+            imm32(src.value);
+        } else if (dst.type == x86_operand::kind::REGISTER)
+            encode_rm({ 0x8B }, code_of(dst.reg), src);
+        else
+            encode_rm({ 0x89 }, code_of(src.reg), dst);
+        break;
+
+    case x86_op::ADD: encode_arithmetic(instruction, 0, 0x01, 0x03); break;
+    case x86_op::SUB: encode_arithmetic(instruction, 5, 0x29, 0x2B); break;
+    case x86_op::CMP: encode_arithmetic(instruction, 7, 0x39, 0x3B); break;
+
+    case x86_op::TEST:
+        encode_rm({ 0x85 }, code_of(src.reg), dst);
+        break;
+
+    case x86_op::IMUL:
+        if (src.type != x86_operand::kind::IMMEDIATE)
+            encode_rm({ 0x0F, 0xAF }, code_of(dst.reg), src);
+        else if (fits_in_8_bits(src.value)) {
+            encode_rm({ 0x6B }, code_of(dst.reg), dst);
+            byte((uint8_t) (int8_t) src.value);
+        } else {
+            encode_rm({ 0x69 }, code_of(dst.reg), dst);
+            imm32(src.value);
+        }
+        break;
+
+    case x86_op::LEA:
+        encode_rm({ 0x8D }, code_of(dst.reg), src);
+        break;
+
+    case x86_op::MOVABS:
+        byte((uint8_t) (0x48 | (code_of(dst.reg) >> 3)));
+        byte((uint8_t) (0xB8 + (code_of(dst.reg) & 7)));
+        imm64(src.value);
+        break;
+
+    case x86_op::NEG:  encode_rm({ 0xF7 }, 3, dst); break;
+    case x86_op::IDIV: encode_rm({ 0xF7 }, 7, dst); break;
+
+    case x86_op::PUSH:
+        if (dst.type == x86_operand::kind::REGISTER) {
+            if (code_of(dst.reg) >= 8)
+                byte(0x41);
+            byte((uint8_t) (0x50 + (code_of(dst.reg) & 7)));
+        } else if (dst.type == x86_operand::kind::MEMORY)
+            encode_rm({ 0xFF }, 6, dst, false);
+        else if (fits_in_8_bits(dst.value)) {
+            byte(0x6A);
+            byte((uint8_t) (int8_t) dst.value);
+        } else {
+            byte(0x68);
+            imm32(dst.value);
+        }
+        break;
+
+    case x86_op::POP:
+        if (code_of(dst.reg) >= 8)
+            byte(0x41);
+        byte((uint8_t) (0x58 + (code_of(dst.reg) & 7)));
+        break;
+
+    case x86_op::CQO: byte(0x48); byte(0x99); break;
+    case x86_op::RET: byte(0xC3);             break;
+
+    case x86_op::JMP:
+        byte(0xE9);
+        jump_to(instruction.target);
+        break;
+
+    case x86_op::JCC:
+        byte(0x0F);
+        byte((uint8_t) (0x80 + (uint8_t) instruction.condition));
+        jump_to(instruction.target);
+        break;
+
+    case x86_op::CALL: case x86_op::TAIL_JUMP:
+        byte(instruction.op == x86_op::CALL ? 0xE8 : 0xE9);
+        m_calls.push_back({ (uint32_t) m_bytes.size(), instruction.target });
+        imm32(0);
+        break;
+
+    case x86_op::LOAD_STACK_LIMIT:
+        needs_runtime();
+
+        encode_instruction({ x86_op::MOVABS, {}, dst, x86_imm((int64_t) m_runtime->stack_limit), 0 },
+                           function, labels, jumps);
+        encode_rm({ 0x8B }, code_of(dst.reg), x86_mem(dst.reg, 0));
+        break;
+
+    case x86_op::TRAP:
+        needs_runtime();
+
+        // handler(trap, function), stack is aligned wherever trap is taken
+        encode_rm({ 0xC7 }, 0, x86_reg(x86_register::RDI));
+        imm32(instruction.target);
+        encode_rm({ 0xC7 }, 0, x86_reg(x86_register::RSI));
+        imm32(function);
+
+        encode_instruction({ x86_op::MOVABS, {}, x86_reg(x86_register::RAX),
+                             x86_imm((int64_t) m_runtime->trap_handler), 0 }, function, labels, jumps);
+        encode_rm({ 0xFF }, 2, x86_reg(x86_register::RAX), false); // CALL RAX
+        break;
+    }
+}
+
+std::vector<uint32_t> x86_encoder::encode(const x86_function& function) {
+    std::vector<uint32_t> labels(function.labels, unresolved);
+    std::vector<std::pair<uint32_t, uint32_t>> jumps; // Offset of displacement, label
+
+    for (const auto& instruction: function.code)
+        encode_instruction(instruction, function.index, labels, jumps);
+
+    for (const auto& [offset, label]: jumps) {
+        if (labels[label] == unresolved)
+            throw std::logic_error("x86: jump to undefined label in " + function.name);
+
+        int32_t displacement = (int32_t) (labels[label] - (offset + 4));
+        for (int i = 0; i < 4; ++ i)
+            m_bytes[offset + i] = (uint8_t) ((uint32_t) displacement >> (8 * i));
+    }
+
+    return labels;
+}
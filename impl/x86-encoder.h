@@ -0,0 +1,56 @@
+#pragma once
+
+#include "x86.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What code compiled with runtime checks refers to, only JIT provides it
+struct x86_runtime {
+    const uintptr_t* stack_limit; //!< Read by LOAD_STACK_LIMIT
+
+    // Called by TRAP as handler(trap, function index), must not return
+    void (*trap_handler)(uint32_t trap, uint32_t function);
+};
+
+// Displacement of CALL or TAIL_JUMP
+struct x86_call_fixup {
+    uint32_t offset;   //!< Of 32-bit displacement, relative to the end of it
+    uint32_t function; //!< Callee, index of function in program
+};
+
+/**
+ * Encoder of x86_function to machine code, functions are appended to
+ * one buffer. Calls are left for the user to resolve, since only the
+ * user knows where functions end up.
+ */
+class x86_encoder {
+public:
+    explicit x86_encoder(const x86_runtime* runtime = nullptr): m_runtime(runtime) {}
+
+    // Returns offsets of function's labels in bytes(), function itself starts at the current size
+    std::vector<uint32_t> encode(const x86_function& function);
+
+    void align(size_t alignment); // Pad with INT3
+
+    const std::vector<uint8_t>& bytes() const { return m_bytes; }
+    const std::vector<x86_call_fixup>& calls() const { return m_calls; }
+
+private:
+    const x86_runtime* m_runtime;
+
+    std::vector<uint8_t> m_bytes;
+    std::vector<x86_call_fixup> m_calls;
+
+    void byte(uint8_t value) { m_bytes.push_back(value); }
+    void imm32(int64_t value);
+    void imm64(int64_t value);
+
+    // Instruction with ModRM byte, /reg/ is register or opcode extension, /rm/ is register or memory
+    void encode_rm(std::initializer_list<uint8_t> opcode, unsigned reg, const x86_operand& rm, bool wide = true);
+
+    void encode_arithmetic(const x86_instruction& instruction, uint8_t extension, uint8_t rm_reg, uint8_t reg_rm);
+    void encode_instruction(const x86_instruction& instruction, uint32_t function,
+                            std::vector<uint32_t>& labels, std::vector<std::pair<uint32_t, uint32_t>>& jumps);
+};
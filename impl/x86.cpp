@@ -0,0 +1,18 @@
+#include "x86.h"
+
+const char* x86_register_name(x86_register reg) {
+    static const char* const names[] = {
+        "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+        "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15"
+    };
+
+    return names[(size_t) reg];
+}
+
+const char* x86_condition_name(x86_condition condition) {
+    static const char* const names[] = {
+        "o", "no", "b", "ae", "e", "ne", "be", "a", "s", "ns", "p", "np", "l", "ge", "le", "g"
+    };
+
+    return names[(size_t) condition];
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Machine code of x86-64 between instruction selection and encoding,
+// so that the same code can be encoded to bytes or printed as assembly
+
+enum class x86_register: uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+const char* x86_register_name(x86_register reg);
+
+// Condition codes in the order of their encoding
+enum class x86_condition: uint8_t { O, NO, B, AE, E, NE, BE, A, S, NS, P, NP, L, GE, LE, G };
+
+const char* x86_condition_name(x86_condition condition);
+
+struct x86_operand {
+    enum class kind: uint8_t { NONE, REGISTER, MEMORY, IMMEDIATE };
+
+    kind type = kind::NONE;
+    x86_register reg = x86_register::RAX; //!< Register or base of memory
+    int64_t value = 0;                    //!< Displacement of memory or immediate
+
+    bool operator==(const x86_operand&) const = default;
+};
+
+inline x86_operand x86_reg(x86_register reg) { return { x86_operand::kind::REGISTER, reg, 0 }; }
+inline x86_operand x86_mem(x86_register base, int32_t displacement) { return { x86_operand::kind::MEMORY, base, displacement }; }
+inline x86_operand x86_imm(int64_t value) { return { x86_operand::kind::IMMEDIATE, x86_register::RAX, value }; }
+
+// All operations are on 64-bit values, immediates are 32-bit sign extended except for MOVABS
+enum class x86_op: uint8_t {
+    LABEL,                          // Position of label /target/
+
+    MOV, ADD, SUB, IMUL, CMP, TEST, // dst, src
+    LEA,                            // dst register, src memory
+    MOVABS,                         // dst register, src 64-bit immediate
+
+    NEG, IDIV, PUSH, POP,           // dst
+    CQO, RET,
+
+    JMP, JCC,                       // To label /target/, JCC if /condition/ holds
+    CALL,                           // Function /target/ of program
+    TAIL_JUMP,                      // To function /target/, which returns to caller of this one
+
+    // Only in code compiled for JIT, see x86_runtime
+    LOAD_STACK_LIMIT,               // dst = lowest address stack may grow down to
+    TRAP                            // Report x86_trap /target/ of this function, doesn't return
+};
+
+enum class x86_trap: uint32_t { DIVISION_BY_ZERO, STACK_OVERFLOW };
+
+struct x86_instruction {
+    x86_op op;
+    x86_condition condition;
+    x86_operand dst, src;
+    uint32_t target;
+};
+
+struct x86_function {
+    std::string name;
+    uint32_t index = 0;  //!< Of function in its program, which is what CALL refers to
+
+    std::vector<x86_instruction> code;
+    uint32_t labels = 0; //!< Count, labels are numbered from 0
+
+    // Bytecode index of loop head -> label of code that enters function at it,
+    // taking registers of interpreter's frame in RDI
+    std::vector<std::pair<uint32_t, uint32_t>> loop_entries;
+};
@@ -42,8 +42,6 @@ namespace lang {
         lexem(language_lexem new_id, std::string value, continuous_location location);
     };
 
-    const lexem END_LEXEM = lexem(language_lexem::END, "", { "", 0, {} });
-
     std::ostream& operator<<(std::ostream& os, const lexem& lexem);
 
 
@@ -0,0 +1,89 @@
+#include "grammar-analysis.h"
+#include "test-framework.h"
+
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+using namespace lang;
+using enum language_lexem;
+
+// Diagnostics of /level/ that mention every one of /parts/
+static int count_diagnostics(const grammar_report& report, grammar_diagnostic_level level,
+                             const std::vector<std::string>& parts) {
+    int count = 0;
+    for (const auto& diagnostic: report.diagnostics) {
+        bool mentions_all = diagnostic.level == level;
+        for (const auto& part: parts)
+            mentions_all = mentions_all && diagnostic.message.find(part) != std::string::npos;
+
+        count += mentions_all;
+    }
+
+    return count;
+}
+
+static std::string sum_text(std::tuple<std::string, lexem> parsed) {
+    return std::get<0>(parsed) + " + " + std::get<1>(parsed).value;
+}
+
+static std::string first(std::variant<std::string> parsed) { return std::get<0>(parsed); }
+
+TEST(left_recursion_is_an_error) {
+    lazy_w<std::string> sum;
+
+    auto number = transform(static_p(NUMBER), [](lexem token) { return token.value; });
+    sum = transform(transform(sum & ignore_p(PLUS) & static_p(NUMBER), sum_text) | number, first);
+
+    parser_w<std::string> root = sum;
+    share_ownership(root, number);
+
+    grammar_report report = analyse_grammar(node_of(root), { { &node_of(root), "sum" } });
+
+    ASSERT_EQUAL(report.has_errors(), true);
+    ASSERT_EQUAL(count_diagnostics(report, grammar_diagnostic_level::ERROR, { "left recursion", "sum" }), 1);
+}
+
+TEST(many_over_nullable_parser_is_an_error) {
+    auto numbers = many(optional(static_p(NUMBER)));
+    grammar_report report = analyse_grammar(node_of(numbers));
+
+    ASSERT_EQUAL(report.has_errors(), true);
+    ASSERT_EQUAL(count_diagnostics(report, grammar_diagnostic_level::ERROR, { "many will spin forever" }), 1);
+    ASSERT_EQUAL(count_diagnostics(report, grammar_diagnostic_level::ERROR, { "left recursion" }), 0);
+}
+
+TEST(repetition_that_consumes_is_fine) {
+    auto number = transform(static_p(NUMBER), [](lexem token) { return token.value; });
+    auto sums = transform(number & many(ignore_p(PLUS) & number), [](auto parsed) {
+        std::string text = std::get<0>(parsed);
+        for (const auto& operand: std::get<1>(parsed))
+            text += " + " + operand;
+
+        return text;
+    });
+
+    grammar_report report = analyse_grammar(node_of(sums));
+
+    ASSERT_EQUAL(report.has_errors(), false);
+    ASSERT_EQUAL((int) report.diagnostics.size(), 0);
+}
+
+TEST(alternative_after_its_prefix_is_shadowed) {
+    auto name = transform(static_p(NAME), [](lexem token) { return token.value; });
+    auto call = transform(static_p(NAME) & ignore_p(LRB) & ignore_p(RRB),
+                          [](lexem token) { return token.value + "()"; });
+
+    parser_w<std::string> root = transform(name | call, first);
+    share_ownership(root, name, call);
+
+    grammar_report report = analyse_grammar(node_of(root));
+
+    ASSERT_EQUAL(report.has_errors(), false);
+    ASSERT_EQUAL(count_diagnostics(report, grammar_diagnostic_level::WARNING, { "is shadowed by" }), 1);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,580 @@
+#include "grammar-analysis.h"
+
+#include <algorithm>
+#include <functional>
+#include <ostream>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace lang {
+
+    using enum grammar_node_kind;
+
+    //------------------------------------------------------------------------------
+
+    // Skip nodes that don't change language, unless they are named
+    static grammar_node* strip_wrappers(grammar_node* node, const rule_names& names) {
+        while (!names.contains(node) && node->kind() == WRAPPER && node->children().size() == 1)
+            node = node->children()[0];
+
+        return node;
+    }
+
+    // Operands of chain of binary parsers, like a, b and c in a | b | c
+    static std::vector<grammar_node*> chain_operands(grammar_node* node, const rule_names& names) {
+        std::vector<grammar_node*> result;
+
+        for (grammar_node* child: node->children()) {
+            grammar_node* stripped = strip_wrappers(child, names);
+            if (stripped->kind() != node->kind() || names.contains(stripped)) {
+                result.push_back(stripped);
+                continue;
+            }
+
+            auto nested = chain_operands(stripped, names);
+            result.insert(result.end(), nested.begin(), nested.end());
+        }
+
+        return result;
+    }
+
+    static std::string describe_node(grammar_node* node, const rule_names& names, int depth) {
+        node = strip_wrappers(node, names);
+
+        if (names.contains(node))
+            return names.at(node);
+
+        if (depth == 0)
+            return "...";
+
+        switch (node->kind()) {
+        case TOKEN:    return node->node_name();
+        case EMPTY:    return "<empty>";
+        case MANY:     return describe_node(node->children()[0], names, depth - 1) + "*";
+        case OPTIONAL: return describe_node(node->children()[0], names, depth - 1) + "?";
+        case WRAPPER:  return "<unassigned lazy>";
+
+        case SEQUENCE:
+        case CHOICE: {
+            std::string separator = node->kind() == SEQUENCE ? " & " : " | ";
+
+            std::string description;
+            for (grammar_node* operand: chain_operands(node, names))
+                description += (description.empty() ? "" : separator) + describe_node(operand, names, depth - 1);
+
+            return "(" + description + ")";
+        }
+        }
+
+        return node->node_name();
+    }
+
+    //------------------------------------------------------------------------------
+
+    // Grammar is recursive, so properties are computed by iterating
+    // until they stop changing, starting from "false" everywhere
+    static void fixed_point(const std::vector<grammar_node*>& nodes,
+                            std::unordered_map<grammar_node*, bool>& property,
+                            const std::function<bool(grammar_node*)>& compute) {
+        for (bool changed = true; changed; ) {
+            changed = false;
+
+            for (grammar_node* node: nodes) {
+                bool value = compute(node);
+                if (value != property[node]) {
+                    property[node] = value;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // Same, but for sets that only grow
+    static void fixed_point(const std::vector<grammar_node*>& nodes,
+                            const std::function<bool(grammar_node*)>& grow) {
+        for (bool changed = true; changed; ) {
+            changed = false;
+
+            for (grammar_node* node: nodes)
+                changed |= grow(node);
+        }
+    }
+
+    static bool insert_all(token_set& destination, const token_set& source) {
+        size_t size = destination.size();
+        destination.insert(source.begin(), source.end());
+
+        return destination.size() != size;
+    }
+
+    std::vector<grammar_node*> grammar_sets::leftmost_children(grammar_node* node) const {
+        const auto& nested = children.at(node);
+        if (node->kind() != SEQUENCE)
+            return nested;
+
+        std::vector<grammar_node*> leftmost;
+        for (grammar_node* child: nested) {
+            leftmost.push_back(child);
+            if (!nullable.at(child))
+                break;
+        }
+
+        return leftmost;
+    }
+
+    grammar_sets compute_grammar_sets(grammar_node& root) {
+        grammar_sets sets;
+
+        std::vector<grammar_node*> stack = { &root };
+        while (!stack.empty()) {
+            grammar_node* current = stack.back();
+            stack.pop_back();
+
+            if (sets.children.contains(current))
+                continue;
+
+            sets.nodes.push_back(current);
+            sets.children[current] = current->children();
+
+            sets.nullable[current] = false;
+            sets.first[current] = sets.follow[current] = {};
+
+            for (grammar_node* child: sets.children[current])
+                stack.push_back(child);
+        }
+
+        fixed_point(sets.nodes, sets.nullable, [&](grammar_node* node) {
+            auto nullable = [&](grammar_node* child) { return sets.nullable[child]; };
+            const auto& nested = sets.children[node];
+
+            switch (node->kind()) {
+            case TOKEN:    return false;
+            case EMPTY:    return true;
+            case MANY:     return true;
+            case OPTIONAL: return true;
+
+            case SEQUENCE: return std::all_of(nested.begin(), nested.end(), nullable);
+            case CHOICE:   return std::any_of(nested.begin(), nested.end(), nullable);
+            case WRAPPER:  return !nested.empty() && nullable(nested[0]);
+            }
+
+            return false;
+        });
+
+        fixed_point(sets.nodes, [&](grammar_node* node) {
+            bool changed = false;
+            if (node->kind() == TOKEN)
+                changed |= sets.first[node].insert(node->token()).second;
+
+            for (grammar_node* child: sets.leftmost_children(node))
+                changed |= insert_all(sets.first[node], sets.first[child]);
+
+            return changed;
+        });
+
+        sets.follow[&root].insert(language_lexem::END);
+
+        fixed_point(sets.nodes, [&](grammar_node* node) {
+            const auto& nested = sets.children[node];
+            const token_set& follow = sets.follow[node];
+
+            bool changed = false;
+            switch (node->kind()) {
+            case SEQUENCE: {
+                // Each child is followed by whatever can start the rest of sequence
+                token_set rest_first = follow;
+                for (size_t i = nested.size(); i -- > 0; ) {
+                    changed |= insert_all(sets.follow[nested[i]], rest_first);
+
+                    if (!sets.nullable[nested[i]])
+                        rest_first.clear();
+
+                    rest_first.insert(sets.first[nested[i]].begin(), sets.first[nested[i]].end());
+                }
+
+                break;
+            }
+
+            case MANY: // Repeated parser can be followed by itself
+                changed |= insert_all(sets.follow[nested[0]], sets.first[nested[0]]);
+                [[fallthrough]];
+
+            default:
+                for (grammar_node* child: nested)
+                    changed |= insert_all(sets.follow[child], follow);
+                break;
+            }
+
+            return changed;
+        });
+
+        return sets;
+    }
+
+    //------------------------------------------------------------------------------
+
+    class grammar_analyser {
+    public:
+        grammar_analyser(grammar_node& root, const rule_names& names)
+            : m_names(names), m_sets(compute_grammar_sets(root)) {
+
+            for (grammar_node* node: m_nodes)
+                if (node->kind() == TOKEN)
+                    m_token_names[node->token()] = node->node_name();
+
+            compute_infallible();
+        }
+
+        grammar_report analyse() {
+            find_unassigned();
+            find_left_recursion();
+            find_spinning_many();
+            analyse_choices();
+
+            std::stable_sort(m_report.choices.begin(), m_report.choices.end(),
+                             [](const choice_cost& lhs, const choice_cost& rhs) {
+                                 return lhs.worst_tests > rhs.worst_tests;
+                             });
+
+            return std::move(m_report);
+        }
+
+    private:
+        const rule_names& m_names;
+
+        grammar_sets m_sets;
+        std::vector<grammar_node*>& m_nodes = m_sets.nodes;
+        std::unordered_map<grammar_node*, bool>& m_nullable = m_sets.nullable;
+        std::unordered_map<grammar_node*, token_set>& m_first = m_sets.first;
+
+        std::unordered_map<grammar_node*, bool> m_infallible;
+        std::map<language_lexem, std::string> m_token_names;
+
+        grammar_report m_report;
+
+        //------------------------------------------------------------------------------
+
+        const std::vector<grammar_node*>& children(grammar_node* node) {
+            return m_sets.children[node];
+        }
+
+        std::vector<grammar_node*> leftmost_children(grammar_node* node) {
+            return m_sets.leftmost_children(node);
+        }
+
+        void report(grammar_diagnostic_level level, std::string message) {
+            m_report.diagnostics.push_back({ level, std::move(message) });
+        }
+
+        //------------------------------------------------------------------------------
+
+        // Node that never fails, so alternatives after it are never tried
+        void compute_infallible() {
+            fixed_point(m_nodes, m_infallible, [&](grammar_node* node) {
+                auto infallible = [&](grammar_node* child) { return m_infallible[child]; };
+                const auto& nested = children(node);
+
+                switch (node->kind()) {
+                case TOKEN:    return false;
+                case EMPTY:    return true;
+                case MANY:     return true;
+                case OPTIONAL: return true;
+
+                case SEQUENCE: return std::all_of(nested.begin(), nested.end(), infallible);
+                case CHOICE:   return std::any_of(nested.begin(), nested.end(), infallible);
+                case WRAPPER:  return !nested.empty() && infallible(nested[0]);
+                }
+
+                return false;
+            });
+        }
+
+        //------------------------------------------------------------------------------
+
+        std::string token_name(language_lexem token) {
+            return m_token_names[token];
+        }
+
+        std::string token_list(const token_set& tokens) {
+            std::string list;
+            for (language_lexem token: tokens)
+                list += (list.empty() ? "" : ", ") + token_name(token);
+
+            return list;
+        }
+
+        // Skip all nodes that don't change language, even named ones
+        grammar_node* canonical(grammar_node* node) {
+            while (node->kind() == WRAPPER && children(node).size() == 1)
+                node = children(node)[0];
+
+            return node;
+        }
+
+        grammar_node* strip(grammar_node* node) { return strip_wrappers(node, m_names); }
+
+        std::vector<grammar_node*> operands(grammar_node* node) { return chain_operands(node, m_names); }
+
+        std::string describe(grammar_node* node, int depth = 2) { return describe_node(node, m_names, depth); }
+
+        //------------------------------------------------------------------------------
+
+        void find_unassigned() {
+            for (grammar_node* node: m_nodes)
+                if (node->kind() == WRAPPER && children(node).empty())
+                    report(grammar_diagnostic_level::ERROR,
+                           "lazy parser is never assigned, it will crash when used");
+        }
+
+        // Nodes that can reach themselves without consuming anything loop forever,
+        // they are found as strongly connected components (Tarjan's algorithm)
+        void find_left_recursion() {
+            std::unordered_map<grammar_node*, size_t> index, low;
+            std::unordered_set<grammar_node*> on_stack;
+            std::vector<grammar_node*> stack;
+
+            std::function<void(grammar_node*)> connect = [&](grammar_node* node) {
+                index[node] = low[node] = index.size();
+                stack.push_back(node);
+                on_stack.insert(node);
+
+                for (grammar_node* child: leftmost_children(node)) {
+                    if (!index.contains(child)) {
+                        connect(child);
+                        low[node] = std::min(low[node], low[child]);
+                    } else if (on_stack.contains(child))
+                        low[node] = std::min(low[node], index[child]);
+                }
+
+                if (low[node] != index[node])
+                    return;
+
+                std::vector<grammar_node*> component;
+                grammar_node* member = nullptr;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    on_stack.erase(member);
+
+                    component.push_back(member);
+                } while (member != node);
+
+                auto leftmost = leftmost_children(node);
+                bool self_loop = std::find(leftmost.begin(), leftmost.end(), node) != leftmost.end();
+
+                if (component.size() > 1 || self_loop)
+                    report_left_recursion(component);
+            };
+
+            for (grammar_node* node: m_nodes)
+                if (!index.contains(node))
+                    connect(node);
+        }
+
+        void report_left_recursion(const std::vector<grammar_node*>& component) {
+            std::vector<std::string> rules;
+            for (grammar_node* node: component)
+                if (m_names.contains(node))
+                    rules.push_back(m_names.at(node));
+
+            std::sort(rules.begin(), rules.end());
+
+            std::string cycle;
+            for (const auto& rule: rules)
+                cycle += (cycle.empty() ? "" : ", ") + rule;
+
+            if (cycle.empty())
+                cycle = describe(component.front());
+
+            report(grammar_diagnostic_level::ERROR,
+                   "left recursion through " + cycle + ", parser will loop forever");
+        }
+
+        void find_spinning_many() {
+            for (grammar_node* node: m_nodes)
+                if (node->kind() == MANY && m_nullable[children(node)[0]])
+                    report(grammar_diagnostic_level::ERROR,
+                           "repeated parser " + describe(children(node)[0]) +
+                           " can succeed without consuming anything, many will spin forever");
+        }
+
+        //------------------------------------------------------------------------------
+
+        // Language of /prefix/ starts every string of /node/, so if /node/
+        // succeeds, /prefix/ would've succeeded at the same position too
+        bool starts_with(grammar_node* node, grammar_node* prefix) {
+            prefix = canonical(prefix);
+
+            for (node = canonical(node); ; node = canonical(children(node)[0])) {
+                if (node == prefix)
+                    return true;
+
+                if (node->kind() == TOKEN && prefix->kind() == TOKEN && node->token() == prefix->token())
+                    return true;
+
+                if (node->kind() != SEQUENCE)
+                    return false;
+            }
+        }
+
+        void analyse_choices() {
+            std::unordered_set<grammar_node*> nested_choices; // Parts of longer chains
+            for (grammar_node* node: m_nodes)
+                if (node->kind() == CHOICE)
+                    for (grammar_node* child: children(node))
+                        if (strip(child)->kind() == CHOICE && !m_names.contains(strip(child)))
+                            nested_choices.insert(strip(child));
+
+            for (grammar_node* node: m_nodes)
+                if (node->kind() == CHOICE && !nested_choices.contains(node))
+                    analyse_choice(node);
+        }
+
+        void analyse_choice(grammar_node* choice) {
+            std::vector<grammar_node*> alternatives = operands(choice);
+            std::string name = describe(choice);
+
+            auto alternative_name = [&](size_t i) {
+                return "alternative " + std::to_string(i + 1) + " (" + describe(alternatives[i], 1) + ")";
+            };
+
+            std::vector<bool> shadowed(alternatives.size());
+            for (size_t i = 0; i < alternatives.size(); ++ i) {
+                if (shadowed[i])
+                    continue;
+
+                if (m_infallible[alternatives[i]] && i + 1 != alternatives.size()) {
+                    report(grammar_diagnostic_level::WARNING,
+                           "in " + name + ": " + alternative_name(i) + " never fails, " +
+                           "alternatives after it are never tried");
+
+                    std::fill(shadowed.begin() + i + 1, shadowed.end(), true);
+                    break;
+                }
+
+                for (size_t j = i + 1; j < alternatives.size(); ++ j)
+                    if (!shadowed[j] && starts_with(alternatives[j], alternatives[i])) {
+                        report(grammar_diagnostic_level::WARNING,
+                               "in " + name + ": " + alternative_name(j) + " is shadowed by " +
+                               alternative_name(i) + ", which always succeeds before it");
+
+                        shadowed[j] = true;
+                    }
+            }
+
+            // Group tokens by alternatives that start with them
+            std::map<std::vector<size_t>, token_set> ambiguous;
+            for (language_lexem token: m_first[choice]) {
+                std::vector<size_t> starting;
+                for (size_t i = 0; i < alternatives.size(); ++ i)
+                    if (!shadowed[i] && m_first[alternatives[i]].contains(token))
+                        starting.push_back(i);
+
+                if (starting.size() > 1)
+                    ambiguous[starting].insert(token);
+            }
+
+            for (const auto& [starting, tokens]: ambiguous) {
+                std::string list;
+                for (size_t i: starting)
+                    list += (list.empty() ? "" : ", ") + std::to_string(i + 1);
+
+                report(grammar_diagnostic_level::NOTE,
+                       "in " + name + ": alternatives " + list + " start with " +
+                       token_list(tokens) + ", parser backtracks between them");
+            }
+
+            choice_cost cost = { .choice = name, .alternatives = alternatives.size(),
+                                 .worst_tests = 0, .worst_token = "" };
+
+            for (language_lexem token: m_first[choice]) {
+                std::unordered_map<grammar_node*, size_t> memo;
+                size_t tests = token_tests(choice, token, memo);
+
+                if (tests > cost.worst_tests) {
+                    cost.worst_tests = tests;
+                    cost.worst_token = token_name(token);
+                }
+            }
+
+            m_report.choices.push_back(cost);
+        }
+
+        // Worst number of token tests /node/ makes at it's starting position,
+        // when it starts with /token/, nodes that fail right away cost 1
+        size_t token_tests(grammar_node* node, language_lexem token,
+                           std::unordered_map<grammar_node*, size_t>& memo) {
+
+            if (!m_first[node].contains(token) && !m_nullable[node])
+                return 1;
+
+            if (memo.contains(node))
+                return memo[node]; // Also breaks cycles, they are reported separately
+
+            memo[node] = 1;
+
+            size_t tests = 0;
+            switch (node->kind()) {
+            case TOKEN: tests = 1; break;
+            case EMPTY: tests = 0; break;
+
+            case CHOICE: {
+                // Every alternative before the last one starting with token may fail
+                std::vector<grammar_node*> alternatives = operands(node);
+
+                size_t last = 0;
+                for (size_t i = 0; i < alternatives.size(); ++ i)
+                    if (m_first[alternatives[i]].contains(token) || m_nullable[alternatives[i]])
+                        last = i;
+
+                for (size_t i = 0; i <= last; ++ i)
+                    tests += token_tests(alternatives[i], token, memo);
+
+                break;
+            }
+
+            default:
+                for (grammar_node* child: leftmost_children(node))
+                    tests += token_tests(child, token, memo);
+                break;
+            }
+
+            return memo[node] = tests;
+        }
+    };
+
+    //------------------------------------------------------------------------------
+
+    std::string describe_rule(grammar_node* node, const rule_names& names) {
+        return describe_node(node, names, 2);
+    }
+
+    grammar_report analyse_grammar(grammar_node& root, const rule_names& names) {
+        return grammar_analyser(root, names).analyse();
+    }
+
+    bool grammar_report::has_errors() const {
+        return std::any_of(diagnostics.begin(), diagnostics.end(), [](const auto& diagnostic) {
+            return diagnostic.level == grammar_diagnostic_level::ERROR;
+        });
+    }
+
+    void grammar_report::print(std::ostream& os) const {
+        for (const auto& diagnostic: diagnostics) {
+            switch (diagnostic.level) {
+            case grammar_diagnostic_level::ERROR:   os << "error: ";   break;
+            case grammar_diagnostic_level::WARNING: os << "warning: "; break;
+            case grammar_diagnostic_level::NOTE:    os << "note: ";    break;
+            }
+
+            os << diagnostic.message << "\n";
+        }
+
+        os << "\nbacktracking cost (token tests at the first token, worst case):\n";
+        for (const auto& cost: choices)
+            os << "  " << cost.worst_tests << "\ton " << cost.worst_token << "\tin "
+               << cost.choice << " (" << cost.alternatives << " alternatives)\n";
+    }
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "parser.h"
+
+#include <iosfwd>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lang {
+
+    //------------------------------------------------------------------------------
+
+    enum class grammar_diagnostic_level { ERROR, WARNING, NOTE };
+
+    struct grammar_diagnostic {
+        grammar_diagnostic_level level;
+        std::string message;
+    };
+
+    struct choice_cost {
+        std::string choice;         // Description of or_p chain
+        size_t alternatives;
+
+        size_t worst_tests;         // Token tests made at the starting position
+        std::string worst_token;    // Lookahead that costs /worst_tests/
+    };
+
+    struct grammar_report {
+        std::vector<grammar_diagnostic> diagnostics;
+        std::vector<choice_cost> choices; // Most expensive first
+
+        bool has_errors() const;
+        void print(std::ostream& os) const;
+    };
+
+    using token_set = std::set<language_lexem>;
+
+    // Properties of every parser reachable from root, END in follow
+    // sets stands for the end of input
+    struct grammar_sets {
+        std::vector<grammar_node*> nodes; // Root is the first one
+        std::unordered_map<grammar_node*, std::vector<grammar_node*>> children;
+
+        std::unordered_map<grammar_node*, bool> nullable;
+        std::unordered_map<grammar_node*, token_set> first, follow;
+
+        // Children that are tried at the same position as their parent
+        std::vector<grammar_node*> leftmost_children(grammar_node* node) const;
+    };
+
+    grammar_sets compute_grammar_sets(grammar_node& root);
+
+    // Short description of rule, like (factor & MUL & term), named
+    // rules are referenced by their names
+    std::string describe_rule(grammar_node* node, const rule_names& names = {});
+
+    /**
+     * Find grammar problems statically: left recursion and many_p over
+     * nullable parsers (both never terminate), alternatives of or_p that
+     * can't ever succeed because of earlier ones, and alternatives with
+     * common first tokens, which make or_p backtrack.
+     *
+     * Backtracking cost of or_p is estimated as the number of token tests
+     * made at position where it starts in the worst case, counting tests
+     * repeated by every nested or_p on the way.
+     */
+    grammar_report analyse_grammar(grammar_node& root, const rule_names& names = {});
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../impl/definitions.h"
+
+#include <any>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lang {
+
+    class token_cursor;
+
+    enum class grammar_node_kind {
+        TOKEN,    // Single lexem
+        SEQUENCE, // Children one after another
+        CHOICE,   // First child that succeeds
+        MANY,     // Child repeated zero or more times
+        OPTIONAL, // Child or nothing
+        WRAPPER,  // Same language as the only child's
+        EMPTY     // Always succeeds without consuming anything
+    };
+
+    // Structure of parser regardless of it's result type, so grammar
+    // can be walked as a whole (see grammar-analysis.h)
+    class grammar_node {
+    public:
+        virtual grammar_node_kind kind() = 0;
+        virtual std::vector<grammar_node*> children() = 0;
+
+        virtual language_lexem token() { return language_lexem::END; } // Only for TOKEN
+
+        // Semantic action: make parser's result from results of it's children
+        // (all parsed repetitions for MANY, lexem itself for TOKEN), for CHOICE
+        // /alternative/ is index of the child that matched
+        virtual std::any build(std::vector<std::any>& parts, size_t alternative) = 0;
+
+        virtual std::string node_name() = 0; // Define name for the parser
+
+        // Parse with result type erased, it's what build expects for parts
+        virtual std::optional<std::any> parse_any(token_cursor& lexems) = 0;
+
+        // Parsing is the same as parsing children one after another and calling
+        // build, so optimizations may do it themselves (see left-factoring.h)
+        virtual bool transparent() { return true; }
+
+        virtual ~grammar_node() = default;
+    };
+
+    // Names of rules, used in reports instead of their structure
+    using rule_names = std::map<grammar_node*, std::string>;
+
+}
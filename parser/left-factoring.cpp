@@ -0,0 +1,198 @@
+#include "left-factoring.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+namespace lang {
+
+    using enum grammar_node_kind;
+
+    using factoring_step = factored_choice::step;
+
+    // Parse the rest of alternative after prefix, /value/ becomes alternative's result
+    static bool complete_alternative(const std::vector<factoring_step>& steps,
+                                     std::any& value, token_cursor& lexems) {
+        std::vector<std::any> parts;
+        for (const auto& step: steps) {
+            parts.clear();
+            parts.push_back(std::move(value));
+
+            for (grammar_node* next: step.rest) {
+                auto parsed = next->parse_any(lexems);
+                if (!parsed)
+                    return false;
+
+                parts.push_back(std::move(*parsed));
+            }
+
+            value = step.node->build(parts, step.alternative);
+        }
+
+        return true;
+    }
+
+    std::optional<std::any> parse_factored(const factored_choice& choice, token_cursor& lexems) {
+        token_cursor start = lexems;
+
+        for (const auto& group: choice.groups) {
+            auto prefix = group.prefix->parse_any(lexems);
+            if (!prefix) {
+                rewind(lexems, start);
+                continue;
+            }
+
+            token_cursor after_prefix = lexems;
+            for (const auto& steps: group.alternatives) {
+                std::any value = *prefix; // Every alternative builds from it's own copy
+                if (complete_alternative(steps, value, lexems))
+                    return value;
+
+                rewind(lexems, after_prefix);
+            }
+
+            rewind(lexems, start);
+        }
+
+        return std::nullopt;
+    }
+
+    //------------------------------------------------------------------------------
+
+    struct chain_alternative {
+        grammar_node* operand;
+        std::vector<std::pair<grammar_node*, size_t>> choices; // Taken from the chain's root down
+    };
+
+    static void flatten_chain(grammar_node* choice, std::vector<std::pair<grammar_node*, size_t>>& path,
+                              std::vector<chain_alternative>& alternatives) {
+
+        std::vector<grammar_node*> children = choice->children();
+        for (size_t i = 0; i < children.size(); ++ i) {
+            path.emplace_back(choice, i);
+
+            if (children[i]->kind() == CHOICE)
+                flatten_chain(children[i], path, alternatives);
+            else
+                alternatives.push_back({ children[i], path });
+
+            path.pop_back();
+        }
+    }
+
+    // Parsers that start parsing at the same position as /node/, /node/ first,
+    // only those that can be replaced by their children and build are descended
+    static std::vector<grammar_node*> leftmost_chain(grammar_node* node) {
+        std::vector<grammar_node*> chain;
+        while (std::find(chain.begin(), chain.end(), node) == chain.end()) { // Left recursion
+            chain.push_back(node);
+
+            grammar_node_kind kind = node->kind();
+            if ((kind != WRAPPER && kind != SEQUENCE) || !node->transparent())
+                break;
+
+            std::vector<grammar_node*> children = node->children();
+            if (children.empty())
+                break; // Unassigned lazy_p
+
+            node = children[0];
+        }
+
+        return chain;
+    }
+
+    static size_t position_in(const std::vector<grammar_node*>& chain, grammar_node* node) {
+        return std::find(chain.begin(), chain.end(), node) - chain.begin();
+    }
+
+    static std::vector<factoring_step> steps_from(const std::vector<grammar_node*>& chain, size_t prefix,
+                                                  const chain_alternative& alternative) {
+        std::vector<factoring_step> steps;
+        for (size_t i = prefix; i -- > 0; ) {
+            std::vector<grammar_node*> children = chain[i]->children();
+            steps.push_back({ chain[i], 0, { children.begin() + 1, children.end() } });
+        }
+
+        for (auto choice = alternative.choices.rbegin(); choice != alternative.choices.rend(); ++ choice)
+            steps.push_back({ choice->first, choice->second, {} });
+
+        return steps;
+    }
+
+    static std::optional<factored_choice> factor_chain(grammar_node* root) {
+        std::vector<std::pair<grammar_node*, size_t>> path;
+        std::vector<chain_alternative> alternatives;
+        flatten_chain(root, path, alternatives);
+
+        std::vector<std::vector<grammar_node*>> chains;
+        for (const auto& alternative: alternatives)
+            chains.push_back(leftmost_chain(alternative.operand));
+
+        factored_choice factored;
+        bool any_shared = false;
+
+        for (size_t first = 0; first < alternatives.size(); ) {
+            size_t last = first + 1;
+            grammar_node* prefix = alternatives[first].operand;
+
+            // Only consecutive alternatives are grouped, ordered choice can't be reordered
+            if (last < alternatives.size())
+                for (grammar_node* node: chains[first])
+                    if (position_in(chains[last], node) != chains[last].size()) {
+                        prefix = node; // Topmost common one
+                        break;
+                    }
+
+            while (last < alternatives.size() && position_in(chains[last], prefix) != chains[last].size())
+                ++ last;
+
+            factored_choice::group group = { prefix, {} };
+            for (size_t i = first; i < last; ++ i)
+                group.alternatives.push_back(steps_from(chains[i], position_in(chains[i], prefix), alternatives[i]));
+
+            any_shared |= last - first > 1;
+
+            factored.groups.push_back(std::move(group));
+            first = last;
+        }
+
+        if (!any_shared)
+            return std::nullopt;
+
+        return factored;
+    }
+
+    size_t left_factor(grammar_node& root) {
+        std::vector<grammar_node*> nodes = { &root };
+        std::unordered_set<grammar_node*> visited = { &root };
+        std::unordered_set<grammar_node*> nested_choices; // Handled by chain's root
+
+        for (size_t i = 0; i < nodes.size(); ++ i)
+            for (grammar_node* child: nodes[i]->children()) {
+                if (nodes[i]->kind() == CHOICE && child->kind() == CHOICE)
+                    nested_choices.insert(child);
+
+                if (visited.insert(child).second)
+                    nodes.push_back(child);
+            }
+
+        size_t factored_chains = 0;
+        for (grammar_node* node: nodes) {
+            if (node->kind() != CHOICE || nested_choices.contains(node))
+                continue;
+
+            auto* target = dynamic_cast<factorable_choice*>(node);
+            if (target == nullptr)
+                continue;
+
+            if (auto factored = factor_chain(node)) {
+                target->factor(std::make_shared<const factored_choice>(std::move(*factored)));
+                ++ factored_chains;
+            }
+        }
+
+        return factored_chains;
+    }
+
+}
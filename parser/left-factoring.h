@@ -0,0 +1,66 @@
+#pragma once
+
+#include "grammar-node.h"
+#include "token-cursor.h"
+
+#include <any>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace lang {
+
+    //------------------------------------------------------------------------------
+
+    /**
+     * How to parse or_p chain with common left prefixes: consecutive
+     * alternatives that start with the same parser make a group, prefix
+     * is parsed once for the whole group, and then only the rest of each
+     * alternative is tried.
+     *
+     * Alternative's result is made by the same build callbacks as the
+     * combinators use, going from prefix up to the chain's root, so the
+     * result is exactly the same as without factoring.
+     */
+    struct factored_choice {
+        struct step {
+            grammar_node* node;              // Built from the value so far and /rest/
+            size_t alternative;              // For CHOICE
+            std::vector<grammar_node*> rest; // For SEQUENCE, children after the leftmost one
+        };
+
+        struct group {
+            grammar_node* prefix;
+            std::vector<std::vector<step>> alternatives; // Steps from prefix up, in order of choice
+        };
+
+        std::vector<group> groups;
+    };
+
+    std::optional<std::any> parse_factored(const factored_choice& choice, token_cursor& lexems);
+
+    // Part of or_p that left_factor installs factored_choice into
+    class factorable_choice {
+    public:
+        void factor(std::shared_ptr<const factored_choice> factored) { m_factored = std::move(factored); }
+
+        // Plan installed by left_factor, if any, used by table_parser too
+        const factored_choice* factored() const { return m_factored.get(); }
+
+    protected:
+        std::shared_ptr<const factored_choice> m_factored;
+    };
+
+    /**
+     * Find or_p chains reachable from /root/ whose consecutive alternatives
+     * start with the same parser (by identity, like in (term & PLUS & expression
+     * | term & MINUS & expression | term)), and make them parse the prefix once.
+     * Combinator graph itself isn't changed, so analysis and drawing see the
+     * grammar as written.
+     *
+     * @return number of factored chains
+     */
+    size_t left_factor(grammar_node& root);
+
+}
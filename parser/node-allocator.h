@@ -0,0 +1,90 @@
+#pragma once
+
+#include "arena.h"
+
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lang {
+
+    //------------------------------------------------------------------------------
+
+    // Arena nodes built by construct<> are placed in, see arena_scope
+    inline thread_local arena* current_arena = nullptr;
+
+    class arena_scope {
+    public:
+        arena_scope(arena* new_arena): m_saved_arena(current_arena) {
+            current_arena = new_arena;
+        }
+
+        ~arena_scope() { current_arena = m_saved_arena; }
+
+        arena_scope(const arena_scope&) = delete;
+        arena_scope& operator=(const arena_scope&) = delete;
+
+    private:
+        arena* m_saved_arena;
+    };
+
+    //------------------------------------------------------------------------------
+
+    inline void* arena_allocate_or_throw(size_t size, size_t alignment) {
+        if (current_arena == nullptr)
+            throw std::logic_error("error: node allocated without arena, see lang::arena_scope");
+
+        void* allocated_space = nullptr;
+        TRY arena_allocate(current_arena, size, alignment, &allocated_space)
+            CATCH({ trace_destruct(__trace); throw std::bad_alloc(); });
+
+        return allocated_space;
+    }
+
+    //------------------------------------------------------------------------------
+
+    // Move constructor's arguments into arena, so nodes don't own anything
+    // and never need their destructors to be called
+
+    template <typename type>
+    type arena_copy(const type& value) { return value; }
+
+    inline std::string_view arena_copy(const std::string& value) {
+        char* copy = static_cast<char*>(arena_allocate_or_throw(value.size() + 1, 1));
+        std::memcpy(copy, value.c_str(), value.size() + 1); // Keep it null terminated
+
+        return std::string_view(copy, value.size());
+    }
+
+    template <typename type>
+    auto arena_copy(const std::vector<type>& values) {
+        using copied_type = decltype(arena_copy(std::declval<const type&>()));
+
+        void* memory = arena_allocate_or_throw(values.size() * sizeof(copied_type),
+                                               alignof(copied_type));
+
+        copied_type* copy = static_cast<copied_type*>(memory);
+        for (size_t i = 0; i < values.size(); ++ i)
+            new (copy + i) copied_type(arena_copy(values[i]));
+
+        return std::span<copied_type>(copy, values.size());
+    }
+
+    //------------------------------------------------------------------------------
+
+    template <typename node_type, typename... arg_types>
+    node_type* allocate_node(arg_types&&... args) {
+        static_assert(std::is_trivially_destructible_v<node_type>,
+                      "Arena never calls destructors, node can't own resources!");
+
+        void* memory = arena_allocate_or_throw(sizeof(node_type), alignof(node_type));
+        return new (memory) node_type(arena_copy(args)...);
+    }
+
+}
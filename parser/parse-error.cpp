@@ -0,0 +1,58 @@
+#include "parse-error.h"
+
+namespace lang {
+
+    // Lexem to point at when failure is at the end of tokens
+    static const lexem* last_lexem(const parse_failure& failure) {
+        const token_cursor& at = *failure.at;
+        if (!at.at_end() || at.index() == 0)
+            return nullptr;
+
+        return &at.tokens().lexems[at.index() - 1];
+    }
+
+    static std::string describe_failure(const parse_failure& failure) {
+        std::string expected;
+        for (size_t i = 0; i < failure.expected.size(); ++ i) {
+            if (i != 0)
+                expected += i + 1 == failure.expected.size() ? " or " : ", ";
+
+            expected += *failure.expected[i];
+        }
+
+        std::string message = expected.empty() ? "error: unexpected" : "error: expected " + expected;
+        if (failure.at->at_end()) {
+            const lexem* previous = last_lexem(failure);
+            if (previous == nullptr)
+                return message + (expected.empty() ? " " : " in ") + "empty file";
+
+            return message + (expected.empty() ? " " : " before ") + "end of file:\n" +
+                   previous->location.underlined_location();
+        }
+
+        const lexem& at = **failure.at;
+        return message + (expected.empty() ? " '" : ", but got '") + at.value + "':\n" +
+               at.location.underlined_location();
+    }
+
+    static continuous_location failure_location(const parse_failure& failure) {
+        if (!failure.at->at_end())
+            return (*failure.at)->location;
+
+        const lexem* previous = last_lexem(failure);
+        return previous != nullptr ? previous->location : continuous_location("", 0, {});
+    }
+
+    parse_error::parse_error(const parse_failure& failure)
+        : std::runtime_error(describe_failure(failure)),
+          location(failure_location(failure)), at(*failure.at) {}
+
+    parse_error unparsed_input_error(const token_cursor& end) {
+        const parse_failure& failure = furthest_failure;
+        if (!failure.at || &failure.at->tokens() != &end.tokens() || *failure.at < end)
+            return parse_error({ end, {} });
+
+        return parse_error(failure);
+    }
+
+}
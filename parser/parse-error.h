@@ -0,0 +1,79 @@
+#pragma once
+
+#include "lexer.h"
+#include "token-cursor.h"
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace lang {
+
+    //------------------------------------------------------------------------------
+
+    // The furthest lexem parsers failed to match, and names of lexems that
+    // were expected there, it's where syntax error most likely is
+    struct parse_failure {
+        std::optional<token_cursor> at;
+        std::vector<const std::string*> expected;
+    };
+
+    inline thread_local parse_failure furthest_failure;
+
+    // Called on every lexem mismatch, so it has to be cheap. Names of the same lexem
+    // are the same string (see lexem_parser_p), so they are compared by address
+    inline void note_failure(token_cursor at, const std::string* expected) {
+        // Failure left from parse of other tokens is stale
+        bool same_tokens = furthest_failure.at && &furthest_failure.at->tokens() == &at.tokens();
+        if (same_tokens && at < *furthest_failure.at)
+            return; // Backtracking makes most failures, they are behind the furthest one
+
+        if (!same_tokens || at > *furthest_failure.at) {
+            furthest_failure.at = at;
+            furthest_failure.expected.clear();
+        }
+
+        for (const std::string* name: furthest_failure.expected)
+            if (name == expected)
+                return;
+
+        furthest_failure.expected.push_back(expected);
+    }
+
+    //------------------------------------------------------------------------------
+
+    class parse_error: public std::runtime_error {
+    public:
+        parse_error(const parse_failure& failure);
+
+        const continuous_location location;
+        const token_cursor at; // Only valid while parsed tokens are
+    };
+
+    // Parse stopped at /end/ before the end of tokens: the error is at the furthest
+    // failure, or at the first lexem left if no failure was noted past it in these tokens
+    parse_error unparsed_input_error(const token_cursor& end);
+
+    //------------------------------------------------------------------------------
+
+    // Errors recovered from are collected here, see recovering_many_p
+    inline thread_local std::vector<parse_error>* current_diagnostics = nullptr;
+
+    class diagnostics_scope {
+    public:
+        diagnostics_scope(std::vector<parse_error>* new_diagnostics)
+            : m_saved_diagnostics(current_diagnostics) {
+            current_diagnostics = new_diagnostics;
+        }
+
+        ~diagnostics_scope() { current_diagnostics = m_saved_diagnostics; }
+
+        diagnostics_scope(const diagnostics_scope&) = delete;
+        diagnostics_scope& operator=(const diagnostics_scope&) = delete;
+
+    private:
+        std::vector<parse_error>* m_saved_diagnostics;
+    };
+
+}
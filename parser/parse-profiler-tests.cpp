@@ -0,0 +1,136 @@
+#include "parse-profiler.h"
+#include "parser.h"
+#include "token-cursor.h"
+#include "test-framework.h"
+
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace lang;
+using enum language_lexem;
+
+static lexer& test_lexer() {
+    static lexer lexer = [] {
+        lang::lexer created;
+        created.ignore_rule("[\n \t]([\n \t])");
+
+        created.add_rules({
+            { named(PLUS),   "+"            },
+            { named(NUMBER), "[0-9]([0-9])" }
+        });
+
+        return created;
+    }();
+
+    return lexer;
+}
+
+// Sums like 1 + 2 + 3, with handles on parsers to look up their stats
+struct sum_grammar {
+    parser_w<lexem> number = static_p(NUMBER);
+    parser_w<ignore> plus = ignore_p(PLUS);
+
+    parser_w<std::tuple<lexem, std::vector<lexem>>> sum = number & many(plus & number);
+};
+
+static std::string profiled_report(sum_grammar& grammar, parse_profiler& profiler, const std::string& source) {
+    token_buffer tokens(test_lexer().analyse(source, "test.prog"));
+    token_cursor cursor(tokens.span());
+
+    {
+        profiler_scope scope(&profiler);
+        if (!grammar.sum.parse(cursor) || !cursor.at_end())
+            throw std::logic_error("test sum doesn't parse");
+    }
+
+    std::stringstream report;
+    profiler.report(report, { { &node_of(grammar.sum), "sum" } });
+    return report.str();
+}
+
+TEST(every_call_is_counted) {
+    sum_grammar grammar;
+    parse_profiler profiler;
+    profiled_report(grammar, profiler, "1 + 2 + 3");
+
+    const parser_stats& number = profiler.stats().at(&node_of(grammar.number));
+    ASSERT_EQUAL((int) number.calls, 3);
+    ASSERT_EQUAL((int) number.successes, 3);
+    ASSERT_EQUAL((int) number.failures, 0);
+    ASSERT_EQUAL((int) number.consumed, 3);
+
+    // The last try finds the end of input
+    const parser_stats& plus = profiler.stats().at(&node_of(grammar.plus));
+    ASSERT_EQUAL((int) plus.calls, 3);
+    ASSERT_EQUAL((int) plus.successes, 2);
+    ASSERT_EQUAL((int) plus.failures, 1);
+    ASSERT_EQUAL((int) plus.consumed, 2);
+
+    const parser_stats& sum = profiler.stats().at(&node_of(grammar.sum));
+    ASSERT_EQUAL((int) sum.calls, 1);
+    ASSERT_EQUAL((int) sum.consumed, 5);
+    ASSERT_EQUAL(sum.inclusive >= sum.exclusive, true);
+}
+
+TEST(calls_add_up_over_parses) {
+    sum_grammar grammar;
+    parse_profiler profiler;
+    profiled_report(grammar, profiler, "1 + 2");
+    profiled_report(grammar, profiler, "3");
+
+    ASSERT_EQUAL((int) profiler.stats().at(&node_of(grammar.number)).calls, 3);
+    ASSERT_EQUAL((int) profiler.stats().at(&node_of(grammar.plus)).failures, 2);
+}
+
+TEST(report_has_a_row_per_parser) {
+    sum_grammar grammar;
+    parse_profiler profiler;
+    std::string report = profiled_report(grammar, profiler, "1 + 2 + 3");
+
+    std::stringstream lines(report);
+    std::string header, line, sum_row;
+    std::getline(lines, header);
+
+    int rows = 0;
+    while (std::getline(lines, line)) {
+        ++ rows;
+        if (line.ends_with("  sum"))
+            sum_row = line;
+    }
+
+    ASSERT_EQUAL(header.find("calls") != std::string::npos, true);
+    ASSERT_EQUAL(rows, (int) profiler.stats().size());
+
+    // Calls, successes, failures, consumed and rewound lexems
+    std::stringstream counts(sum_row);
+    std::vector<int> columns(5);
+    for (int& column: columns)
+        counts >> column;
+
+    ASSERT_EQUAL(columns == std::vector<int>({ 1, 1, 0, 5, 0 }), true);
+}
+
+TEST(graph_labels_show_calls) {
+    sum_grammar grammar;
+    parse_profiler profiler;
+    profiled_report(grammar, profiler, "1 + 2 + 3");
+
+    std::string label = profiler.label(&node_of(grammar.number), "NUMBER");
+    ASSERT_EQUAL(label.starts_with("NUMBER\\n"), true);
+    ASSERT_EQUAL(label.ends_with("%, 3 calls"), true);
+
+    parser_w<lexem> unused = static_p(NUMBER);
+    ASSERT_STRING_EQUAL(profiler.label(&node_of(unused), "NUMBER"), std::string("NUMBER"));
+
+    node drawn = {};
+    profiler.style(&node_of(unused), drawn);
+    ASSERT_EQUAL(drawn.color == GRAPHVIZ_BLACK, true);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,159 @@
+#include "parse-profiler.h"
+#include "grammar-analysis.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <ostream>
+#include <unordered_set>
+
+namespace lang {
+
+    void parse_profiler::enter(grammar_node* parser) {
+        m_running.push_back({ parser, std::chrono::steady_clock::now() });
+    }
+
+    void parse_profiler::leave(bool success, size_t consumed) {
+        frame finished = m_running.back();
+        m_running.pop_back();
+
+        auto inclusive = std::chrono::steady_clock::now() - finished.start;
+
+        parser_stats& stats = m_stats[finished.parser];
+        ++ stats.calls;
+        ++ (success ? stats.successes : stats.failures);
+
+        if (success)
+            stats.consumed += consumed;
+
+        stats.inclusive += inclusive;
+        stats.exclusive += inclusive - finished.children;
+
+        if (!m_running.empty())
+            m_running.back().children += inclusive;
+    }
+
+    void parse_profiler::rewind(size_t lexems) {
+        if (!m_running.empty())
+            m_stats[m_running.back().parser].rewound += lexems;
+    }
+
+    std::chrono::nanoseconds parse_profiler::total_time() const {
+        std::chrono::nanoseconds total {};
+        for (const auto& [parser, stats]: m_stats)
+            total += stats.exclusive;
+
+        return total;
+    }
+
+    // Rule each unnamed parser belongs to, in the order they are met walking
+    // that rule. Parser shared by several rules goes to the first of them
+    static void find_enclosing_rules(grammar_node* node, const std::string& rule, const rule_names& names,
+                                     std::unordered_set<grammar_node*>& visited,
+                                     std::vector<std::pair<grammar_node*, std::string>>& enclosing) {
+        for (grammar_node* child: node->children()) {
+            if (names.contains(child) || !visited.insert(child).second)
+                continue;
+
+            enclosing.emplace_back(child, rule);
+            find_enclosing_rules(child, rule, names, visited, enclosing);
+        }
+    }
+
+    // Wrappers are described as the parser they wrap, so they are marked with their
+    // own name. Rows that still share a label get the enclosing rule, and then
+    // a number in the walk order of it, as parsers with the same structure
+    // are described the same way
+    static std::unordered_map<grammar_node*, std::string>
+    row_labels(const std::vector<std::pair<grammar_node*, parser_stats>>& rows, const rule_names& names) {
+        std::unordered_set<grammar_node*> visited;
+        std::vector<std::pair<grammar_node*, std::string>> enclosing;
+        for (const auto& [rule, name]: names)
+            find_enclosing_rules(rule, name, names, visited, enclosing);
+
+        std::unordered_map<grammar_node*, std::string> labels;
+        std::map<std::string, std::vector<grammar_node*>> by_label;
+        for (const auto& [parser, stats]: rows) {
+            std::string label = describe_rule(parser, names);
+            if (parser->kind() == grammar_node_kind::WRAPPER && !names.contains(parser))
+                label = parser->node_name() + " " + label;
+
+            by_label[labels[parser] = label].push_back(parser);
+        }
+
+        std::map<std::string, size_t> repeats;
+        for (const auto& [parser, rule]: enclosing)
+            if (labels.contains(parser) && by_label[labels[parser]].size() > 1)
+                ++ repeats[labels[parser] + " in " + rule];
+
+        std::map<std::string, size_t> numbered;
+        for (const auto& [parser, rule]: enclosing) {
+            if (!labels.contains(parser) || by_label[labels[parser]].size() == 1)
+                continue;
+
+            std::string label = labels[parser] + " in " + rule;
+            if (repeats[label] > 1)
+                label += " #" + std::to_string(++ numbered[label]);
+
+            labels[parser] = label;
+        }
+
+        return labels;
+    }
+
+    void parse_profiler::report(std::ostream& os, const rule_names& names) const {
+        std::vector<std::pair<grammar_node*, parser_stats>> sorted(m_stats.begin(), m_stats.end());
+        std::sort(sorted.begin(), sorted.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second.exclusive > rhs.second.exclusive;
+        });
+
+        auto labels = row_labels(sorted, names);
+        double total = (double) total_time().count();
+
+        char line[256] = {};
+        snprintf(line, sizeof(line), "%10s %10s %10s %10s %10s %12s %12s %7s  %s\n",
+                 "calls", "success", "fail", "consumed", "rewound",
+                 "inclusive", "exclusive", "share", "parser");
+        os << line;
+
+        for (const auto& [parser, stats]: sorted) {
+            snprintf(line, sizeof(line), "%10zu %10zu %10zu %10zu %10zu %10.3fms %10.3fms %6.2f%%  ",
+                     stats.calls, stats.successes, stats.failures, stats.consumed, stats.rewound,
+                     (double) stats.inclusive.count() / 1e6, (double) stats.exclusive.count() / 1e6,
+                     total == 0 ? 0.0 : 100.0 * (double) stats.exclusive.count() / total);
+
+            os << line << labels.at(parser) << "\n";
+        }
+    }
+
+    void parse_profiler::style(grammar_node* parser, node& default_node) const {
+        auto stats = m_stats.find(parser);
+        if (stats == m_stats.end()) {
+            default_node.color = GRAPHVIZ_BLACK; // Never called
+            return;
+        }
+
+        double total = (double) total_time().count();
+        double share = total == 0 ? 0.0 : (double) stats->second.exclusive.count() / total;
+
+        default_node.style = STYLE_FILLED;
+        default_node.color = share < 0.01 ? GRAPHVIZ_GREEN  :
+                             share < 0.05 ? GRAPHVIZ_YELLOW :
+                             share < 0.20 ? GRAPHVIZ_ORANGE : GRAPHVIZ_RED;
+    }
+
+    std::string parse_profiler::label(grammar_node* parser, const std::string& name) const {
+        auto stats = m_stats.find(parser);
+        if (stats == m_stats.end())
+            return name;
+
+        double total = (double) total_time().count();
+        double share = total == 0 ? 0.0 : (double) stats->second.exclusive.count() / total;
+
+        char line[64] = {};
+        snprintf(line, sizeof(line), "\\n%.1f%%, %zu calls", 100.0 * share, stats->second.calls);
+
+        return name + line;
+    }
+
+}
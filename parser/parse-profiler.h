@@ -0,0 +1,80 @@
+#pragma once
+
+#include "grammar-node.h"
+#include "graphviz.h"
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lang {
+
+    //------------------------------------------------------------------------------
+
+    struct parser_stats {
+        size_t calls = 0, successes = 0, failures = 0;
+
+        size_t consumed = 0; // Lexems consumed by successful calls
+        size_t rewound  = 0; // Lexems given back by this parser to backtrack
+
+        std::chrono::nanoseconds inclusive {}, exclusive {};
+    };
+
+    /**
+     * Collects stats for every parser called while profiler is installed
+     * with profiler_scope. Inclusive time of recursive rules counts each
+     * nested call separately, so only exclusive time adds up to total.
+     */
+    class parse_profiler {
+    public:
+        void enter(grammar_node* parser);
+        void leave(bool success, size_t consumed);
+
+        void rewind(size_t lexems); // Attributed to innermost running parser
+
+        const std::unordered_map<grammar_node*, parser_stats>& stats() const { return m_stats; }
+        std::chrono::nanoseconds total_time() const;
+
+        // Table of called parsers, the slowest (by exclusive time) first
+        void report(std::ostream& os, const rule_names& names = {}) const;
+
+        // Color parser by it's share of total time, used by parser::draw_graph
+        void style(grammar_node* parser, node& default_node) const;
+        std::string label(grammar_node* parser, const std::string& name) const;
+
+    private:
+        struct frame {
+            grammar_node* parser;
+
+            std::chrono::steady_clock::time_point start;
+            std::chrono::nanoseconds children {};
+        };
+
+        std::vector<frame> m_running;
+        std::unordered_map<grammar_node*, parser_stats> m_stats;
+    };
+
+    //------------------------------------------------------------------------------
+
+    // Profiler parsers on this thread report to, see profiler_scope
+    inline thread_local parse_profiler* current_profiler = nullptr;
+
+    class profiler_scope {
+    public:
+        profiler_scope(parse_profiler* new_profiler): m_saved_profiler(current_profiler) {
+            current_profiler = new_profiler;
+        }
+
+        ~profiler_scope() { current_profiler = m_saved_profiler; }
+
+        profiler_scope(const profiler_scope&) = delete;
+        profiler_scope& operator=(const profiler_scope&) = delete;
+
+    private:
+        parse_profiler* m_saved_profiler;
+    };
+
+}
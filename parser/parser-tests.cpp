@@ -0,0 +1,154 @@
+#include "parse-error.h"
+#include "parser.h"
+#include "token-cursor.h"
+#include "test-framework.h"
+
+#include <optional>
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+using namespace lang;
+using enum language_lexem;
+
+static lexer& test_lexer() {
+    static lexer lexer = [] {
+        lang::lexer created;
+        created.ignore_rule("[\n \t]([\n \t])");
+
+        created.add_rules({
+            { named(COMMA),  ","                       },
+            { named(PLUS),   "+"                       },
+            { named(LRB),    "[(]"                     },
+            { named(RRB),    "[)]"                     },
+            { named(NAME),   "[A-Za-z_]([A-Za-z0-9_])" },
+            { named(NUMBER), "[0-9]([0-9])"            }
+        });
+
+        return created;
+    }();
+
+    return lexer;
+}
+
+TEST(cursor_reports_end_past_the_last_lexem) {
+    token_buffer tokens(test_lexer().analyse("f(1)", "test.prog"));
+    token_cursor cursor(tokens.span());
+
+    ASSERT_EQUAL((int) tokens.span().size, 4);
+    for (size_t i = 0; i < tokens.span().size; ++ i)
+        ASSERT_EQUAL(tokens.span().ids[i] == tokens.span().lexems[i].id, true);
+
+    ASSERT_EQUAL(cursor.id() == NAME, true);
+    ASSERT_STRING_EQUAL(cursor->value, std::string("f"));
+
+    token_cursor end = cursor + 4;
+    ASSERT_EQUAL(end.at_end(), true);
+    ASSERT_EQUAL(end.id() == END, true);
+    ASSERT_EQUAL((end + 10).id() == END, true);
+
+    ++ cursor;
+    ASSERT_EQUAL(cursor.id() == LRB, true);
+    ASSERT_EQUAL((int) cursor.index(), 1);
+    ASSERT_EQUAL((int) (end - cursor), 3);
+    ASSERT_EQUAL(cursor < end && cursor + 3 == end, true);
+}
+
+TEST(failures_keep_the_furthest_position) {
+    token_buffer tokens(test_lexer().analyse("f(1)", "test.prog"));
+    token_cursor cursor(tokens.span());
+
+    std::string comma = "COMMA", plus = "PLUS", rrb = "RRB";
+
+    furthest_failure = { cursor, {} };
+    note_failure(cursor + 2, &comma);
+    note_failure(cursor + 1, &plus); // Behind, ignored
+    note_failure(cursor + 2, &rrb);
+    note_failure(cursor + 2, &comma);
+
+    ASSERT_EQUAL((int) furthest_failure.at->index(), 2);
+    ASSERT_EQUAL((int) furthest_failure.expected.size(), 2);
+    ASSERT_EQUAL(furthest_failure.expected[0] == &comma && furthest_failure.expected[1] == &rrb, true);
+
+    note_failure(cursor + 3, &plus);
+    ASSERT_EQUAL((int) furthest_failure.at->index(), 3);
+    ASSERT_EQUAL(furthest_failure.expected.size() == 1 && furthest_failure.expected[0] == &plus, true);
+
+    // Failure in other tokens is stale, even if it's further
+    token_buffer other_tokens(test_lexer().analyse("x", "test.prog"));
+    note_failure(token_cursor(other_tokens.span()), &comma);
+    ASSERT_EQUAL(&furthest_failure.at->tokens() == &other_tokens.span(), true);
+    ASSERT_EQUAL(furthest_failure.expected.size() == 1 && furthest_failure.expected[0] == &comma, true);
+}
+
+/**
+ * Calls like f(1, 2) or sums like x + 1. Once call's bracket is open,
+ * the call has to be finished, it's committed.
+ */
+struct statement_grammar {
+    parser_w<std::string> root;
+
+    statement_grammar() : root(build()) {}
+
+    static parser_w<std::string> build() {
+        auto call = transform(static_p(NAME) & ignore_p(LRB) &
+                              commit(separated_by(static_p(NUMBER), ignore_p(COMMA)) & ignore_p(RRB)),
+                              [](std::tuple<lexem, std::vector<lexem>> parsed) {
+            return std::get<0>(parsed).value + "(" + std::to_string(std::get<1>(parsed).size()) + ")";
+        });
+
+        auto sum = transform(static_p(NAME) & ignore_p(PLUS) & static_p(NUMBER),
+                             [](std::tuple<lexem, lexem> parsed) {
+            return std::get<0>(parsed).value + " + " + std::get<1>(parsed).value;
+        });
+
+        parser_w<std::string> root = transform(call | sum, [](std::variant<std::string> parsed) {
+            return std::get<0>(parsed);
+        });
+
+        share_ownership(root, call, sum);
+        return root;
+    }
+};
+
+// Parsed statement, or its syntax error with index of lexem it points at
+static std::string parse_statement(const std::string& source) {
+    static statement_grammar grammar;
+
+    token_buffer tokens(test_lexer().analyse(source, "test.prog"));
+    token_cursor cursor(tokens.span());
+
+    furthest_failure = { cursor, {} };
+
+    try {
+        std::optional<std::string> parsed = grammar.root.parse(cursor);
+        if (!parsed || !cursor.at_end())
+            throw unparsed_input_error(cursor);
+
+        return *parsed;
+    } catch (const parse_error& error) {
+        std::string message = error.what();
+        return std::to_string(error.at.index()) + " " + message.substr(0, message.find(":\n"));
+    }
+}
+
+TEST(committed_parser_fails_right_away) {
+    ASSERT_STRING_EQUAL(parse_statement("f(1, 2)"), std::string("f(2)"));
+    ASSERT_STRING_EQUAL(parse_statement("f + 1"), std::string("f + 1"));
+
+    // Thrown from the committed part, other alternatives aren't tried
+    ASSERT_STRING_EQUAL(parse_statement("f(1 2)"), std::string("3 error: expected COMMA or RRB, but got '2'"));
+    ASSERT_STRING_EQUAL(parse_statement("f(1, )"), std::string("4 error: expected NUMBER, but got ')'"));
+    ASSERT_STRING_EQUAL(parse_statement("f(1,"), std::string("4 error: expected NUMBER before end of file"));
+}
+
+TEST(uncommitted_failure_lists_every_expected_lexem) {
+    ASSERT_STRING_EQUAL(parse_statement("f 1"), std::string("1 error: expected LRB or PLUS, but got '1'"));
+    ASSERT_STRING_EQUAL(parse_statement("f + x"), std::string("2 error: expected NUMBER, but got 'x'"));
+    ASSERT_STRING_EQUAL(parse_statement("f + 1 x"), std::string("3 error: unexpected 'x'"));
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
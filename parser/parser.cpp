@@ -1,11 +1,24 @@
 #include "parser.h"
 #include "graphviz.h"
+#include <algorithm>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <unordered_set>
 
 namespace lang {
 
-    lexem_parser_p::lexem_parser_p(named_lexem named_token): m_named_token(named_token) {}
+    // The same string for every parser of lexem, so failures can be told apart by address
+    static const std::string* interned_name(const std::string& name) {
+        static std::mutex mutex;
+        static std::unordered_set<std::string> names;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return &*names.insert(name).first;
+    }
+
+    lexem_parser_p::lexem_parser_p(named_lexem named_token)
+        : m_named_token(named_token), m_expected(interned_name(m_named_token.name)) {}
         
     void lexem_parser_p::style(node& default_node) {
         default_node.color = GRAPHVIZ_BLUE;
@@ -19,21 +32,72 @@ namespace lang {
         return;
     }
 
-    std::optional<lang::lexem> lexem_parser_p::parse(lexem_iterator& lexems) {
-        // EMPTY_TOKEN_ID is used as EOF marker
-        if (lexems->id == language_lexem::END)
+    std::optional<lang::lexem> lexem_parser_p::do_parse(token_cursor& lexems) {
+        if (lexems.at_end()) {
+            note_failure(lexems, m_expected);
             return std::nullopt;
+        }
 
-        if (lexems->id == m_named_token.id) {
+        if (lexems.id() == m_named_token.id) {
             lang::lexem current = *lexems;
 
             ++ lexems; // Advance to the next token
             return current;
         }
 
+        note_failure(lexems, m_expected);
         return std::nullopt;
     }
 
+    bool recovery_tokens::ends_list(language_lexem id) const {
+        if (id == language_lexem::END || (nested && id == nested->second))
+            return true;
+
+        return std::find(stop_at.begin(), stop_at.end(), id) != stop_at.end();
+    }
+
+    void skip_to_recovery_point(token_cursor& lexems, const recovery_tokens& tokens) {
+        auto contains = [](const std::vector<language_lexem>& ids, language_lexem id) {
+            return std::find(ids.begin(), ids.end(), id) != ids.end();
+        };
+
+        int depth = 0;
+        for (; !lexems.at_end(); ++ lexems) {
+            language_lexem id = lexems.id();
+
+            if (contains(tokens.stop_at, id))
+                return;
+
+            if (tokens.nested && id == tokens.nested->first) {
+                ++ depth;
+                continue;
+            }
+
+            if (tokens.nested && id == tokens.nested->second) {
+                if (depth == 0)
+                    return; // Closes enclosing block
+
+                if (-- depth == 0) {
+                    ++ lexems; // Skipped block ends element
+                    return;
+                }
+
+                continue;
+            }
+
+            if (depth != 0)
+                continue;
+
+            if (contains(tokens.resume_at, id))
+                return;
+
+            if (contains(tokens.skip_past, id)) {
+                ++ lexems;
+                return;
+            }
+        }
+    }
+
     parser_w<lexem> static_parser(named_lexem lexem) {
         auto&& new_parser = std::make_shared<lexem_parser_p>(lexem);
         return parser_w(*new_parser).own(new_parser);
@@ -1,8 +1,17 @@
+#pragma once
+
 #include "lexer.h"
+#include "grammar-node.h"
+#include "left-factoring.h"
+#include "node-allocator.h"
+#include "parse-error.h"
+#include "parse-profiler.h"
+#include "token-cursor.h"
 #include "../impl/definitions.h"
 
 #include "graphviz.h"
 
+#include <any>
 #include <utility>
 #include <iterator>
 #include <memory>
@@ -19,18 +28,29 @@ namespace lang {
 
     //------------------------------------------------------------------------------
 
-    using lexem_iterator = std::vector<lang::lexem>::iterator;
-
-    //------------------------------------------------------------------------------
-
     static constexpr bool show_utility_nodes = false;
 
     //------------------------------------------------------------------------------
 
     template <typename result_type>
-    class parser {
+    class parser: public grammar_node {
     public:
-        virtual std::optional<result_type> parse(lexem_iterator& lexems) = 0;
+        std::optional<result_type> parse(token_cursor& lexems) {
+            if (current_profiler == nullptr)
+                return do_parse(lexems);
+
+            return profiled_parse(lexems);
+        }
+
+        virtual std::optional<result_type> do_parse(token_cursor& lexems) = 0;
+
+        std::optional<std::any> parse_any(token_cursor& lexems) override {
+            auto parsed = parse(lexems);
+            if (!parsed)
+                return std::nullopt;
+
+            return std::any(std::move(*parsed));
+        }
 
         virtual node_id connect_node(SUBGRAPH_CONTEXT, std::map<void*, node_id>& graphed) {
             node_id this_node = 0;
@@ -40,7 +60,13 @@ namespace lang {
                 node saved_node = DEFAULT_NODE;
                 style(DEFAULT_NODE);
 
-                this_node = NODE("%s", node_name().c_str());
+                std::string label = node_name();
+                if (current_profiler != nullptr) { // Draw heat map instead
+                    current_profiler->style(this, DEFAULT_NODE);
+                    label = current_profiler->label(this, label);
+                }
+
+                this_node = NODE("%s", label.c_str());
                 graphed[this] = this_node;
 
                 DEFAULT_NODE = saved_node; // Restore style before
@@ -71,21 +97,46 @@ namespace lang {
             });
         }
 
-        virtual ~parser() = default;
-
-        virtual std::string node_name() = 0; // Define name for the parser
         virtual void style(node& default_node) {}
 
         virtual void connect_children(SUBGRAPH_CONTEXT, std::map<void*, node_id>& graphed, node_id current) = 0;
+
+    private:
+        std::optional<result_type> profiled_parse(token_cursor& lexems) {
+            token_cursor start = lexems;
+            current_profiler->enter(this);
+
+            try {
+                auto result = do_parse(lexems);
+                current_profiler->leave(result.has_value(), lexems - start);
+
+                return result;
+            } catch (...) {
+                current_profiler->leave(false, 0);
+                throw;
+            }
+        }
     };
 
     //------------------------------------------------------------------------------
 
+    // Move back to /saved/ position, every rewind is reported to profiler
+    inline void rewind(token_cursor& lexems, token_cursor saved) {
+        if (current_profiler != nullptr)
+            current_profiler->rewind(lexems - saved);
+
+        lexems = saved;
+    }
+
+    //------------------------------------------------------------------------------
+
     template <typename input_type, typename result_type>
     class unary_parser: public parser<result_type> {
     public:
         unary_parser(parser<input_type>& parser): m_parser(parser) {};
 
+        std::vector<grammar_node*> children() override { return { &m_parser }; }
+
         void connect_children(SUBGRAPH_CONTEXT, std::map<void*, node_id>& graphed, node_id current) override {
             EDGE(current, m_parser.connect_node(CURRENT_SUBGRAPH_CONTEXT, graphed));
         }
@@ -103,7 +154,7 @@ namespace lang {
     public:
         using unary_parser<type, ignore>::unary_parser;
 
-        std::optional<ignore> parse(lexem_iterator &lexems) override {
+        std::optional<ignore> do_parse(token_cursor& lexems) override {
             if (this->m_parser.parse(lexems))
                 return ignore {};
             else
@@ -122,6 +173,9 @@ namespace lang {
         };
 
         std::string node_name() override { return "(ignore)"; }
+
+        std::any build(std::vector<std::any>&, size_t) override { return ignore {}; }
+        grammar_node_kind kind() override { return grammar_node_kind::WRAPPER; }
     };
 
     //------------------------------------------------------------------------------
@@ -131,7 +185,7 @@ namespace lang {
     public:
         using unary_parser<repeated_type, std::vector<repeated_type>>::unary_parser;
 
-        std::optional<std::vector<repeated_type>> parse(lexem_iterator& lexems) override {
+        std::optional<std::vector<repeated_type>> do_parse(token_cursor& lexems) override {
             std::vector<repeated_type> parsed_values;
             while (true) {
                 auto parsed_value = this->m_parser.parse(lexems);
@@ -145,6 +199,109 @@ namespace lang {
         }
 
         std::string node_name() override { return "*"; }
+
+        std::any build(std::vector<std::any>& parts, size_t) override {
+            std::vector<repeated_type> parsed_values;
+            for (auto& part: parts)
+                parsed_values.push_back(std::any_cast<repeated_type>(std::move(part)));
+
+            return parsed_values;
+        }
+        grammar_node_kind kind() override { return grammar_node_kind::MANY; }
+    };
+
+    //------------------------------------------------------------------------------
+
+    // Lexems that error recovery skips to, see recovering_many_p
+    struct recovery_tokens {
+        std::vector<language_lexem> skip_past; // Consumed, parsing resumes after them
+        std::vector<language_lexem> resume_at; // Parsing resumes right at them
+        std::vector<language_lexem> stop_at;   // End of the list, left for enclosing parser
+
+        // Blocks between these are skipped as a whole, unmatched closing one ends the list
+        std::optional<std::pair<language_lexem, language_lexem>> nested;
+
+        bool ends_list(language_lexem id) const;
+    };
+
+    // Skip lexems until the next point parsing can resume from
+    void skip_to_recovery_point(token_cursor& lexems, const recovery_tokens& tokens);
+
+    // Same as many_p, but when diagnostics are collected (see diagnostics_scope),
+    // element that fails to parse is reported and skipped, and parsing goes on
+    template <typename repeated_type>
+    class recovering_many_p: public many_p<repeated_type> {
+    public:
+        recovering_many_p(parser<repeated_type>& parser, recovery_tokens tokens)
+            : many_p<repeated_type>(parser), m_tokens(std::move(tokens)) {}
+
+        std::optional<std::vector<repeated_type>> do_parse(token_cursor& lexems) override {
+            if (current_diagnostics == nullptr)
+                return many_p<repeated_type>::do_parse(lexems);
+
+            std::vector<repeated_type> parsed_values;
+            parse_failure trailing_failure; // Past the end of the last parsed element
+
+            while (true) {
+                token_cursor start = lexems;
+
+                // Like in commit_p, only failures of this element are relevant, and those
+                // the previous element made trying to go on, as without recovery they
+                // would be reported too (e.g. 'let x = 1 +' fails at what follows '+')
+                parse_failure saved_failure = std::move(furthest_failure);
+                furthest_failure = { start, {} };
+                if (trailing_failure.at && *trailing_failure.at >= start)
+                    furthest_failure = std::move(trailing_failure);
+
+                trailing_failure = {};
+
+                auto restore_failure = [&]() {
+                    if (saved_failure.at && *saved_failure.at > *furthest_failure.at)
+                        furthest_failure = std::move(saved_failure);
+                };
+
+                std::optional<parse_error> error;
+                try {
+                    auto parsed_value = this->m_parser.parse(lexems);
+                    if (parsed_value) {
+                        parsed_values.push_back(*parsed_value);
+
+                        trailing_failure = furthest_failure;
+                        restore_failure();
+                        continue;
+                    }
+                } catch (const parse_error& thrown) {
+                    error.emplace(thrown);
+                }
+
+                if (!error) {
+                    if (m_tokens.ends_list(lexems.id())) {
+                        restore_failure();
+                        break;
+                    }
+
+                    error.emplace(furthest_failure);
+                }
+
+                // Unclosed block fails every enclosing one at the same lexem
+                if (current_diagnostics->empty() || current_diagnostics->back().at != error->at)
+                    current_diagnostics->push_back(*error);
+
+                if (error->at > start)
+                    lexems = error->at; // Skip from the error
+
+                skip_to_recovery_point(lexems, m_tokens);
+                if (lexems == start && !m_tokens.ends_list(lexems.id()))
+                    ++ lexems; // Always make progress
+
+                restore_failure();
+            }
+
+            return parsed_values;
+        }
+
+    private:
+        recovery_tokens m_tokens;
     };
 
     //------------------------------------------------------------------------------
@@ -154,7 +311,7 @@ namespace lang {
     public:
         using unary_parser<type, std::optional<type>>::unary_parser;
 
-        std::optional<std::optional<type>> parse(lexem_iterator& lexems) override {
+        std::optional<std::optional<type>> do_parse(token_cursor& lexems) override {
             auto&& parsed_value = this->m_parser.parse(lexems);
             if (!parsed_value) {
                 std::optional<type> result = std::nullopt;
@@ -165,6 +322,51 @@ namespace lang {
         }
 
         std::string node_name() override { return "?"; }
+
+        std::any build(std::vector<std::any>& parts, size_t) override {
+            if (parts.empty())
+                return std::optional<type>(std::nullopt);
+
+            return std::optional<type>(std::any_cast<type>(std::move(parts[0])));
+        }
+        grammar_node_kind kind() override { return grammar_node_kind::OPTIONAL; }
+    };
+
+    //------------------------------------------------------------------------------
+
+    // Once parsing gets here, there's no other way to parse the input,
+    // so failure is reported as parse_error right away, instead of
+    // backtracking and trying other alternatives
+    template <typename type>
+    class commit_p: public unary_parser<type, type> {
+    public:
+        using unary_parser<type, type>::unary_parser;
+
+        std::optional<type> do_parse(token_cursor& lexems) override {
+            // Failures before commit point don't tell anything about this error
+            parse_failure saved_failure = std::move(furthest_failure);
+            furthest_failure = { lexems, {} };
+
+            auto parsed_value = this->m_parser.parse(lexems);
+            if (!parsed_value)
+                throw parse_error(furthest_failure);
+
+            if (saved_failure.at && *saved_failure.at > *furthest_failure.at)
+                furthest_failure = std::move(saved_failure);
+
+            return parsed_value;
+        }
+
+        std::string node_name() override { return "commit"; }
+        grammar_node_kind kind() override { return grammar_node_kind::WRAPPER; }
+
+        bool transparent() override { return false; } // Throws on failure
+
+        std::any build(std::vector<std::any>& parts, size_t) override { return parts[0]; }
+
+        void style(node& default_node) override {
+            default_node.color = GRAPHVIZ_GREEN;
+        }
     };
 
     //------------------------------------------------------------------------------
@@ -174,7 +376,7 @@ namespace lang {
     public:
         lazy_p(): m_parser(nullptr) {};
 
-        std::optional<type> parse(lexem_iterator& lexems) override {
+        std::optional<type> do_parse(token_cursor& lexems) override {
             return m_parser->parse(lexems);
         }
 
@@ -187,6 +389,17 @@ namespace lang {
         }
 
         std::string node_name() override { return "(lazy)"; }
+
+        std::any build(std::vector<std::any>& parts, size_t) override { return parts[0]; }
+        grammar_node_kind kind() override { return grammar_node_kind::WRAPPER; }
+
+        std::vector<grammar_node*> children() override {
+            if (m_parser == nullptr)
+                return {}; // Never assigned
+
+            return { m_parser };
+        }
+
         node_id connect_node(SUBGRAPH_CONTEXT, std::map<void*, node_id>& graphed) override {
             if (!show_utility_nodes)
                 return m_parser->connect_node(CURRENT_SUBGRAPH_CONTEXT, graphed);
@@ -210,7 +423,7 @@ namespace lang {
         transform_p(parser<original_type>& parser, transformed_type (*transform)(original_type))
             : m_parser(parser), m_transform(transform) {};
 
-        std::optional<transformed_type> parse(lexem_iterator& lexems) override {
+        std::optional<transformed_type> do_parse(token_cursor& lexems) override {
             auto parsed_value = m_parser.parse(lexems);
             if (!parsed_value)
                 return std::nullopt;
@@ -231,6 +444,13 @@ namespace lang {
 
         std::string node_name() override { return "(transform)"; }
 
+        std::any build(std::vector<std::any>& parts, size_t) override {
+            return m_transform(std::any_cast<original_type>(std::move(parts[0])));
+        }
+        grammar_node_kind kind() override { return grammar_node_kind::WRAPPER; }
+
+        std::vector<grammar_node*> children() override { return { &m_parser }; }
+
     private:
         parser<original_type>& m_parser;
         transformed_type (*m_transform)(original_type);
@@ -244,6 +464,8 @@ namespace lang {
         binary_parser(parser<type_0>& first_parser, parser<type_1>& second_parser)
             : m_parser_0(first_parser), m_parser_1(second_parser) {};
 
+        std::vector<grammar_node*> children() override { return { &m_parser_0, &m_parser_1 }; }
+
         void connect_children(SUBGRAPH_CONTEXT, std::map<void*, node_id>& graphed, node_id current) override {
             LABELED_EDGE(current, m_parser_0.connect_node(CURRENT_SUBGRAPH_CONTEXT, graphed), "LHS");
             LABELED_EDGE(current, m_parser_1.connect_node(CURRENT_SUBGRAPH_CONTEXT, graphed), "RHS");
@@ -259,19 +481,19 @@ namespace lang {
     template <typename left_type, typename right_type>
     static std::optional<std::tuple<left_type, right_type>>
         parser_and(parser<left_type>&   left_parser,
-                   parser<right_type>& right_parser, lexem_iterator& lexems) {
+                   parser<right_type>& right_parser, token_cursor& lexems) {
 
-        lexem_iterator saved_iterator = lexems;
+        token_cursor saved_iterator = lexems;
 
         auto try_to_parse_fst = left_parser.parse(lexems);
         if (!try_to_parse_fst) {
-            lexems = saved_iterator;
+            rewind(lexems, saved_iterator);
             return std::nullopt;
         }
 
         auto try_to_parse_snd = right_parser.parse(lexems);
         if (!try_to_parse_snd) {
-            lexems = saved_iterator;
+            rewind(lexems, saved_iterator);
             return std::nullopt;
         }
 
@@ -313,6 +535,7 @@ namespace lang {
         using binary_parser<type_0, type_1, result_type>::binary_parser;
 
         std::string node_name() override { return "&"; }
+        grammar_node_kind kind() override { return grammar_node_kind::SEQUENCE; }
 
         void style(node& default_node) override {
             default_node.color = GRAPHVIZ_RED;
@@ -327,13 +550,18 @@ namespace lang {
     public:
         using base_and_p<type_0, type_1, and_return_t<type_0, type_1>>::base_and_p;
 
-        std::optional<and_return_t<type_0, type_1>> parse(lexem_iterator& lexems) override {
+        std::optional<and_return_t<type_0, type_1>> do_parse(token_cursor& lexems) override {
             auto try_to_parse = parser_and(this->m_parser_0, this->m_parser_1, lexems);
             if (!try_to_parse)
                 return std::nullopt;
 
             return and_combined_tuple(*try_to_parse);
         }
+
+        std::any build(std::vector<std::any>& parts, size_t) override {
+            return and_combined_tuple(std::tuple(std::any_cast<type_0>(std::move(parts[0])),
+                                                 std::any_cast<type_1>(std::move(parts[1]))));
+        }
     };
 
     //------------------------------------------------------------------------------
@@ -355,35 +583,46 @@ namespace lang {
     template <typename left_type, typename right_type>
     static std::optional<unique_variant<left_type, right_type>>
         parser_or(parser<left_type>&   left_parser,
-                  parser<right_type>& right_parser, lexem_iterator& lexems) {
+                  parser<right_type>& right_parser, token_cursor& lexems) {
 
-        lexem_iterator saved_iterator = lexems;
+        token_cursor saved_iterator = lexems;
 
         auto try_to_parse_fst = left_parser.parse(lexems);
         if (try_to_parse_fst)
             return *try_to_parse_fst;
 
-        lexems = saved_iterator;
+        rewind(lexems, saved_iterator);
         auto try_to_parse_snd = right_parser.parse(lexems);
         if (try_to_parse_snd)
             return *try_to_parse_snd;
 
-        lexems = saved_iterator;
+        rewind(lexems, saved_iterator);
         return std::nullopt;
     }
 
     //------------------------------------------------------------------------------
 
     template <typename type_0, typename type_1, typename result_type>
-    class base_or_p: public binary_parser<type_0, type_1, result_type> {
+    class base_or_p: public binary_parser<type_0, type_1, result_type>, public factorable_choice {
     public:
         using binary_parser<type_0, type_1, result_type>::binary_parser;
 
         std::string node_name() override { return "|"; }
+        grammar_node_kind kind() override { return grammar_node_kind::CHOICE; }
 
         void style(node& default_node) override {
             default_node.color = GRAPHVIZ_ORANGE;
         }
+
+    protected:
+        // Used instead of parser_or once chain is factored, see left_factor
+        std::optional<result_type> factored_parse(token_cursor& lexems) {
+            auto parsed = parse_factored(*m_factored, lexems);
+            if (!parsed)
+                return std::nullopt;
+
+            return std::any_cast<result_type>(std::move(*parsed));
+        }
     };
 
     template <typename type_0, typename type_1>
@@ -391,10 +630,22 @@ namespace lang {
     public:
         using base_or_p<type_0, type_1, unique_variant<type_0, type_1>>::base_or_p;
 
-        std::optional<unique_variant<type_0, type_1>> parse(lexem_iterator& lexems) override {
+        std::optional<unique_variant<type_0, type_1>> do_parse(token_cursor& lexems) override {
+            if (this->m_factored)
+                return this->factored_parse(lexems);
+
             return parser_or(this->m_parser_0, this->m_parser_1, lexems);
         }
 
+        std::any build(std::vector<std::any>& parts, size_t alternative) override {
+            using result_type = unique_variant<type_0, type_1>;
+
+            if (alternative == 0)
+                return result_type(std::any_cast<type_0>(std::move(parts[0])));
+
+            return result_type(std::any_cast<type_1>(std::move(parts[0])));
+        }
+
         std::string node_name() override { return "|"; }
     };
 
@@ -425,7 +676,10 @@ namespace lang {
     public:
         using flatten_variant_parser<type_1, type_0s...>::flatten_variant_parser;
 
-        std::optional<unique_variant<type_0s..., type_1>> parse(lexem_iterator& lexems) override {
+        std::optional<unique_variant<type_0s..., type_1>> do_parse(token_cursor& lexems) override {
+            if (this->m_factored)
+                return this->factored_parse(lexems);
+
             auto parser_result = parser_or(this->m_parser_0, this->m_parser_1, lexems);
             if (!parser_result)
                 return std::nullopt;
@@ -436,6 +690,15 @@ namespace lang {
             return variant_cast(std::get<0>(*parser_result));
         }
 
+        std::any build(std::vector<std::any>& parts, size_t alternative) override {
+            using result_type = unique_variant<type_0s..., type_1>;
+
+            if (alternative == 1)
+                return result_type(std::any_cast<type_1>(std::move(parts[0])));
+
+            return result_type(variant_cast(std::any_cast<std::variant<type_0s...>>(std::move(parts[0]))));
+        }
+
         std::string node_name() override { return "|"; }
     };
 
@@ -470,7 +733,7 @@ namespace lang {
             return *this;
         }
 
-        std::optional<return_value> parse(lexem_iterator& lexems) {
+        std::optional<return_value> parse(token_cursor& lexems) {
             return m_parser.parse(lexems);
         }
 
@@ -478,6 +741,8 @@ namespace lang {
             return m_parser.draw_graph();
         }
 
+        grammar_node& node() { return m_parser; }
+
         parser<return_value>& raw() { return m_parser; }
 
         parser_w<return_value>& set(parser_w<return_value>& init) {
@@ -532,54 +797,55 @@ namespace lang {
         return non_owning_transform(std::move(parser), transformer);
     }
 
-    template <typename constructor, typename... arg_types>
-    parser_w<std::shared_ptr<constructor>>
-        non_owning_construct(parser_w<std::tuple<arg_types...>>&& parser) {
+    // Nodes built with construct<> live in lang::current_arena (see arena_scope)
+    // and are freed all together with it, so they are referenced by plain pointers
 
+    template <typename constructor, typename... arg_types>
+    parser_w<constructor*> non_owning_construct(parser_w<std::tuple<arg_types...>>&& parser) {
         return non_owning_transform(std::move(parser), [](auto tree) {
             return std::apply([](auto&&... args) {
-                return std::make_shared<constructor>(args...);
+                return allocate_node<constructor>(args...);
             }, tree);
         });
     }
 
     template <typename constructor, typename arg_type>
-    parser_w<std::shared_ptr<constructor>> non_owning_construct(parser_w<arg_type>&& parser) {
+    parser_w<constructor*> non_owning_construct(parser_w<arg_type>&& parser) {
         return non_owning_transform(std::move(parser), [](auto tree) {
-            return std::make_shared<constructor>(tree);
+            return allocate_node<constructor>(tree);
         });
     }
 
     template <typename constructor, typename arg_type>
-    parser_w<std::shared_ptr<constructor>> construct(parser_w<arg_type>& parser) {
+    parser_w<constructor*> construct(parser_w<arg_type>& parser) {
         return non_owning_construct<constructor>(std::move(parser));
     }
 
     template <typename constructor, typename arg_type>
-    parser_w<std::shared_ptr<constructor>> construct(parser_w<arg_type>&& parser) {
+    parser_w<constructor*> construct(parser_w<arg_type>&& parser) {
         return non_owning_construct<constructor>(std::move(parser)).own(parser);
     }
 
     template<typename return_value>
     class alloc_p {
     public:
-        typedef std::shared_ptr<return_value> target_parser_type; // For use in generic operators
+        typedef return_value* target_parser_type; // For use in generic operators
 
         template <compatible_parser_w input_parser>
         alloc_p(input_parser&& parser)
             : m_parser(construct<return_value>(std::forward<input_parser>(parser))) {}
 
-        operator parser_w<std::shared_ptr<return_value>>() { return m_parser; }
+        operator parser_w<return_value*>() { return m_parser; }
 
     private:
-        parser_w<std::shared_ptr<return_value>> m_parser;
+        parser_w<return_value*> m_parser;
     };
 
     template <typename target_type, typename original_type>
     auto variant_upcast(parser_w<original_type>&& parser) {
         return transform(std::move(parser), [](auto tree) {
             return std::visit([](auto&& alternative) {
-                return std::static_pointer_cast<target_type>(alternative);
+                return static_cast<target_type*>(alternative);
             }, tree);
         });
     }
@@ -662,6 +928,26 @@ namespace lang {
             owning.own(subject);
     }
 
+    // Make /owning/ keep /subjects/ alive too, grammars built from named
+    // parsers only reference each other, so someone has to own all of them
+    template <typename type, typename subject_type>
+    void share_ownership(parser_w<type>& owning, subject_type& subject) {
+        parser_w<compatible_parser_return_t<subject_type>> shared = subject;
+        owning.own(shared);
+    }
+
+    template <typename type, typename... subject_types>
+    void share_ownership(parser_w<type>& owning, subject_types&... subjects) {
+        (share_ownership(owning, subjects), ...);
+    }
+
+    // Node of named parser in combinator graph, see grammar_node
+    template <typename subject_type>
+    grammar_node& node_of(subject_type& subject) {
+        parser_w<compatible_parser_return_t<subject_type>> wrapped = subject;
+        return wrapped.node();
+    }
+
     template <compatible_parser_w type_0, compatible_parser_w type_1>
     auto operator&(type_0&& parser_0, type_1&& parser_1) {
         using parser_0_type = typename std::remove_reference_t<type_0>::target_parser_type;
@@ -772,6 +1058,16 @@ namespace lang {
         return parser_w(*new_parser).own(new_parser).own(wrapped_parser);
     }
 
+    template <compatible_parser_w parser_type>
+    auto recovering_many(parser_type&& parser, recovery_tokens tokens) {
+        using parsed_type = compatible_parser_return_t<parser_type>;
+
+        parser_w<parsed_type> wrapped_parser = parser;
+
+        auto&& new_parser = std::make_shared<recovering_many_p<parsed_type>>(wrapped_parser.raw(), std::move(tokens));
+        return parser_w(*new_parser).own(new_parser).own(wrapped_parser);
+    }
+
     //------------------------------------------------------------------------------
 
     template <typename parsed_type>
@@ -794,13 +1090,34 @@ namespace lang {
 
     //------------------------------------------------------------------------------
 
+    template <typename parsed_type>
+    auto commit(parser_w<parsed_type>& parser) {
+        auto&& new_parser = std::make_shared<commit_p<parsed_type>>(parser.raw());
+        return parser_w(*new_parser).own(new_parser);
+    }
+
+    template <typename parsed_type>
+    auto commit(parser_w<parsed_type>&& parser) {
+        return commit(parser).own(parser);
+    }
+
+    //------------------------------------------------------------------------------
+
     class lexem_parser_p: public parser<lang::lexem> {
     public:
         lexem_parser_p(named_lexem id);
-        std::optional<lang::lexem> parse(lexem_iterator& lexems) override;
+        std::optional<lang::lexem> do_parse(token_cursor& lexems) override;
+
+        grammar_node_kind kind() override { return grammar_node_kind::TOKEN; }
+        std::vector<grammar_node*> children() override { return {}; }
+
+        language_lexem token() override { return m_named_token.id; }
+
+        std::any build(std::vector<std::any>& parts, size_t) override { return parts[0]; }
 
     private:
         named_lexem m_named_token;
+        const std::string* m_expected; // Interned name, see note_failure
 
         std::string node_name() override;
         void connect_children(SUBGRAPH_CONTEXT, std::map<void*, node_id>& graphed, node_id current) override;
@@ -816,9 +1133,14 @@ namespace lang {
 
     template <typename type>
     class test: public parser<type> {
-        std::optional<type> parse(lexem_iterator& lexems) override {
+        std::optional<type> do_parse(token_cursor& lexems) override {
             return type {};
         }
+
+        grammar_node_kind kind() override { return grammar_node_kind::EMPTY; }
+
+        std::any build(std::vector<std::any>&, size_t) override { return type {}; }
+        std::vector<grammar_node*> children() override { return {}; }
     };
 
     template <size_t id>
@@ -0,0 +1,191 @@
+#include "left-factoring.h"
+#include "table-parser.h"
+#include "test-framework.h"
+
+#include <optional>
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+using namespace lang;
+using enum language_lexem;
+
+static lexer& test_lexer() {
+    static lexer lexer = [] {
+        lang::lexer created;
+        created.ignore_rule("[\n \t]([\n \t])");
+
+        created.add_rules({
+            { named(COMMA),  ","                       },
+            { named(PLUS),   "+"                       },
+            { named(LRB),    "[(]"                     },
+            { named(RRB),    "[)]"                     },
+            { named(NAME),   "[A-Za-z_]([A-Za-z0-9_])" },
+            { named(NUMBER), "[0-9]([0-9])"            }
+        });
+
+        return created;
+    }();
+
+    return lexer;
+}
+
+/**
+ * Expressions with calls, like f(1, x + 2), parsed to their fully
+ * parenthesized text. In the right recursive form sums share their first
+ * operand, as calls and variables share the name, so it's LL(1) only
+ * once left factored.
+ */
+struct expression_grammar {
+    parser_w<std::string> root;
+
+    expression_grammar(bool right_recursive) : root(build(right_recursive)) {}
+
+    static std::string first(std::variant<std::string> value) { return std::get<0>(value); }
+
+    static std::string call_text(const std::string& name, const std::vector<std::string>& arguments) {
+        std::string text = name + "(";
+        for (const auto& argument: arguments)
+            text += (text.back() == '(' ? "" : ", ") + argument;
+
+        return text + ")";
+    }
+
+    static parser_w<std::string> build(bool right_recursive) {
+        lazy_w<std::string> expression;
+
+        auto name   = transform(static_p(NAME),   [](lexem token) { return token.value; });
+        auto number = transform(static_p(NUMBER), [](lexem token) { return token.value; });
+
+        auto arguments = ignore_p(LRB) & separated_by(expression, ignore_p(COMMA)) & ignore_p(RRB);
+        auto wrapped = ignore_p(LRB) & expression & ignore_p(RRB);
+
+        auto call = transform(name & arguments, [](std::tuple<std::string, std::vector<std::string>> parsed) {
+            return call_text(std::get<0>(parsed), std::get<1>(parsed));
+        });
+
+        auto name_or_call = transform(name & optional(arguments), [](auto parsed) {
+            auto& [called, arguments] = parsed;
+            return arguments ? call_text(called, *arguments) : called;
+        });
+
+        auto sum = [](std::tuple<std::string, std::string> parsed) {
+            return "(" + std::get<0>(parsed) + " + " + std::get<1>(parsed) + ")";
+        };
+
+        parser_w<std::string> atom = right_recursive ? transform(wrapped | number | call | name, first)
+                                                     : transform(wrapped | number | name_or_call, first);
+
+        if (right_recursive)
+            expression = transform(transform(atom & ignore_p(PLUS) & expression, sum) | atom, first);
+        else
+            expression = transform(atom & many(ignore_p(PLUS) & atom), [](auto parsed) {
+                std::string text = std::get<0>(parsed);
+                for (const auto& operand: std::get<1>(parsed))
+                    text = "(" + text + " + " + operand + ")";
+
+                return text;
+            });
+
+        parser_w<std::string> root = expression;
+        share_ownership(root, name, number, arguments, wrapped, call, name_or_call, atom);
+        return root;
+    }
+};
+
+// Result of both parsers and where they stopped, or "no parse"
+static std::string parse_with(const std::string& source, expression_grammar& grammar, bool table) {
+    token_buffer tokens(test_lexer().analyse(source, "test.prog"));
+    token_cursor cursor(tokens.span());
+
+    std::optional<std::string> parsed;
+    if (table)
+        parsed = compiled_parser<std::string>(grammar.root).parse(cursor);
+    else
+        parsed = grammar.root.parse(cursor);
+
+    if (!parsed)
+        return "no parse";
+
+    return *parsed + (cursor.at_end() ? "" : " and more");
+}
+
+static const std::vector<std::string> sources = {
+    "1", "x", "f()", "1 + 2 + 3", "f(1, g(x) + 2, (y + 3)) + h(z)", "((1)) + (f(2) + 3)", ")"
+};
+
+TEST(ll1_grammar_compiles_without_conflicts) {
+    expression_grammar grammar(false);
+    compiled_parser<std::string> table(grammar.root);
+
+    ASSERT_EQUAL((int) table.conflicts().size(), 0);
+}
+
+TEST(table_parser_builds_the_same_as_combinators) {
+    expression_grammar grammar(false);
+
+    for (const auto& source: sources)
+        ASSERT_STRING_EQUAL(parse_with(source, grammar, true), parse_with(source, grammar, false));
+
+    ASSERT_STRING_EQUAL(parse_with("1 + f(x, 2)", grammar, true), std::string("(1 + f(x, 2))"));
+}
+
+TEST(table_parser_fails_as_a_whole) {
+    expression_grammar grammar(false);
+
+    ASSERT_STRING_EQUAL(parse_with("1 + 2 )", grammar, true), std::string("(1 + 2) and more"));
+    ASSERT_STRING_EQUAL(parse_with("1 + 2 +", grammar, true), std::string("no parse"));
+    ASSERT_STRING_EQUAL(parse_with("1 + 2 +", grammar, false), std::string("(1 + 2) and more"));
+}
+
+TEST(common_prefixes_conflict_until_factored) {
+    expression_grammar grammar(true);
+    ASSERT_EQUAL(compiled_parser<std::string>(grammar.root).conflicts().empty(), false);
+
+    ASSERT_EQUAL((int) left_factor(grammar.root.node()), 2);
+    ASSERT_EQUAL((int) compiled_parser<std::string>(grammar.root).conflicts().size(), 0);
+}
+
+TEST(factored_table_parser_builds_the_same_as_combinators) {
+    expression_grammar grammar(true);
+    left_factor(grammar.root.node());
+
+    for (const auto& source: sources)
+        ASSERT_STRING_EQUAL(parse_with(source, grammar, true), parse_with(source, grammar, false));
+
+    ASSERT_STRING_EQUAL(parse_with("1 + 2 + 3", grammar, true), std::string("(1 + (2 + 3))"));
+}
+
+// Result of combinators, where they stopped, and the furthest failure with lexems expected there
+static std::string parse_with_failure(const std::string& source, expression_grammar& grammar) {
+    token_buffer tokens(test_lexer().analyse(source, "test.prog"));
+    token_cursor cursor(tokens.span());
+
+    furthest_failure = { cursor, {} };
+
+    std::optional<std::string> parsed = grammar.root.parse(cursor);
+    std::string text = parsed ? *parsed + " up to " + std::to_string(cursor.index()) : "no parse";
+
+    text += ", failed at " + std::to_string(furthest_failure.at->index()) + " expecting";
+    for (const std::string* expected: furthest_failure.expected)
+        text += " " + *expected;
+
+    return text;
+}
+
+TEST(factored_combinators_parse_and_fail_the_same) {
+    expression_grammar plain(true), factored(true);
+    left_factor(factored.root.node());
+
+    std::vector<std::string> broken = { "f(", "f(1,", "f(1 2)", "1 + + 2", "(1 + x", "x y" };
+    for (const auto& source: sources)
+        broken.push_back(source);
+
+    for (const auto& source: broken)
+        ASSERT_STRING_EQUAL(parse_with_failure(source, factored), parse_with_failure(source, plain));
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,341 @@
+#include "table-parser.h"
+
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace lang {
+
+    using enum grammar_node_kind;
+
+    table_parser::table_parser(grammar_node& root, const rule_names& names) {
+        // Grammars that don't terminate can't be compiled whatever the lookahead
+        for (const auto& diagnostic: analyse_grammar(root, names).diagnostics)
+            if (diagnostic.level == grammar_diagnostic_level::ERROR)
+                m_conflicts.push_back(diagnostic.message);
+
+        if (!m_conflicts.empty())
+            return;
+
+        grammar_sets sets = compute_grammar_sets(root);
+
+        auto factored_plan = [](grammar_node* node) -> const factored_choice* {
+            auto* choice = dynamic_cast<factorable_choice*>(node);
+            return choice == nullptr ? nullptr : choice->factored();
+        };
+
+        // Factored chains are parsed by their plan, so choices nested
+        // in them are only compiled if something else uses them
+        auto compiled_children = [&](grammar_node* node) {
+            const factored_choice* plan = factored_plan(node);
+            if (plan == nullptr)
+                return sets.children[node];
+
+            std::vector<grammar_node*> children;
+            for (const auto& group: plan->groups) {
+                children.push_back(group.prefix);
+
+                for (const auto& steps: group.alternatives)
+                    for (const auto& step: steps)
+                        children.insert(children.end(), step.rest.begin(), step.rest.end());
+            }
+
+            return children;
+        };
+
+        std::vector<grammar_node*> reachable = { &root };
+        std::unordered_map<grammar_node*, uint32_t> index = { { &root, 0 } };
+
+        for (size_t i = 0; i < reachable.size(); ++ i)
+            for (grammar_node* child: compiled_children(reachable[i]))
+                if (index.emplace(child, (uint32_t) reachable.size()).second)
+                    reachable.push_back(child);
+
+        std::map<language_lexem, std::string> token_names;
+        for (grammar_node* node: sets.nodes)
+            if (node->kind() == TOKEN)
+                token_names[node->token()] = node->node_name();
+
+        for (grammar_node* node: reachable) {
+            m_nodes.push_back({ node->kind(), node, node->token(), {} });
+
+            const factored_choice* plan = factored_plan(node);
+            if (plan == nullptr) {
+                for (grammar_node* child: sets.children[node])
+                    m_nodes.back().children.push_back(index[child]);
+
+                continue;
+            }
+
+            m_nodes.back().first_group = (uint32_t) m_groups.size();
+            for (const auto& group: plan->groups) {
+                m_nodes.back().children.push_back(index[group.prefix]);
+
+                compiled_group& compiled = m_groups.emplace_back();
+                for (const auto& steps: group.alternatives) {
+                    auto& alternative = compiled.alternatives.emplace_back();
+
+                    for (const auto& step: steps) {
+                        alternative.push_back((uint32_t) m_steps.size());
+                        m_steps.push_back({ step.node, (uint8_t) step.alternative, {} });
+
+                        for (grammar_node* rest: step.rest)
+                            m_steps.back().rest.push_back(index[rest]);
+                    }
+                }
+            }
+        }
+
+        m_table.assign(m_nodes.size() * token_count, no_prediction);
+        m_group_table.assign(m_groups.size() * token_count, no_prediction);
+
+        auto fill = [&](uint8_t* row, const token_set& tokens, uint8_t action) {
+            std::string conflicting;
+            for (language_lexem token: tokens) {
+                uint8_t& cell = row[(size_t) token];
+                if (cell != no_prediction && cell != action)
+                    conflicting += (conflicting.empty() ? "" : ", ") + token_names[token];
+
+                cell = action;
+            }
+
+            return conflicting;
+        };
+
+        // Lexems that can come first when /node/ is parsed in /context/
+        auto predict_set = [&](grammar_node* node, grammar_node* context) {
+            token_set predicted = sets.first[node];
+            if (sets.nullable[node])
+                predicted.insert(sets.follow[context].begin(), sets.follow[context].end());
+
+            return predicted;
+        };
+
+        // Same for the rest of factored alternative after it's prefix
+        auto predict_rest = [&](const std::vector<uint32_t>& steps, grammar_node* context) {
+            token_set predicted;
+            for (uint32_t step: steps)
+                for (uint32_t rest: m_steps[step].rest) {
+                    grammar_node* node = m_nodes[rest].source;
+                    predicted.insert(sets.first[node].begin(), sets.first[node].end());
+
+                    if (!sets.nullable[node])
+                        return predicted;
+                }
+
+            predicted.insert(sets.follow[context].begin(), sets.follow[context].end());
+            return predicted;
+        };
+
+        auto report_conflict = [&](const std::string& rule, const std::string& conflicting) {
+            if (!conflicting.empty())
+                m_conflicts.push_back("in " + rule + ": can't choose by " + conflicting + " what to parse");
+        };
+
+        for (uint32_t i = 0; i < m_nodes.size(); ++ i) {
+            grammar_node* node = m_nodes[i].source;
+            const auto& nested = sets.children[node];
+            uint8_t* row = &m_table[i * token_count];
+
+            switch (m_nodes[i].kind) {
+            case CHOICE:
+                if (m_nodes[i].first_group != not_factored) {
+                    std::string conflicting;
+                    for (uint8_t group = 0; group < m_nodes[i].children.size(); ++ group) {
+                        std::string repeated = fill(row, predict_set(m_nodes[m_nodes[i].children[group]].source, node), group);
+                        conflicting += (conflicting.empty() || repeated.empty() ? "" : ", ") + repeated;
+                    }
+
+                    report_conflict(describe_rule(node, names), conflicting);
+
+                    for (uint32_t group = 0; group < m_nodes[i].children.size(); ++ group) {
+                        uint32_t group_index = m_nodes[i].first_group + group;
+                        const auto& alternatives = m_groups[group_index].alternatives;
+
+                        conflicting.clear();
+                        for (uint8_t alternative = 0; alternative < alternatives.size(); ++ alternative) {
+                            std::string repeated = fill(&m_group_table[group_index * token_count],
+                                                        predict_rest(alternatives[alternative], node), alternative);
+                            conflicting += (conflicting.empty() || repeated.empty() ? "" : ", ") + repeated;
+                        }
+
+                        report_conflict(describe_rule(node, names) + " after " +
+                                        describe_rule(m_nodes[m_nodes[i].children[group]].source, names), conflicting);
+                    }
+
+                    break;
+                }
+
+                fill(row, predict_set(nested[0], node), 0);
+                report_conflict(describe_rule(node, names), fill(row, predict_set(nested[1], node), 1));
+                break;
+
+            case MANY:
+            case OPTIONAL:
+                fill(row, sets.follow[node], skip);
+                report_conflict(describe_rule(node, names), fill(row, predict_set(nested[0], node), take));
+
+                // Anything else isn't a part of this node, leave it to the parent
+                for (size_t token = 0; token < token_count; ++ token)
+                    if (row[token] == no_prediction)
+                        row[token] = skip;
+
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    std::optional<std::any> table_parser::parse_any(token_cursor& lexems) const {
+        if (!m_conflicts.empty())
+            throw std::logic_error("error: grammar isn't LL(1), see table_parser::conflicts");
+
+        enum class task_kind: uint8_t {
+            EXPAND, // Start parsing node
+            REPEAT, // Decide if MANY should parse one more child
+            BUILD,  // Replace /count/ values on top with node's result
+
+            CONTINUE,  // Pick alternative of factored group after it's prefix
+            BUILD_STEP // Same as BUILD, for step of factored alternative
+        };
+
+        struct task {
+            task_kind kind;
+            uint8_t alternative;
+
+            uint32_t node;
+            uint32_t count;
+        };
+
+        token_cursor start = lexems;
+
+        std::vector<task> tasks = { { task_kind::EXPAND, 0, 0, 0 } };
+        std::vector<std::any> values, parts;
+
+        auto fail = [&]() {
+            lexems = start;
+            return std::nullopt;
+        };
+
+        while (!tasks.empty()) {
+            task current = tasks.back();
+            tasks.pop_back();
+
+            // Factored tasks refer to m_groups and m_steps instead
+            bool factored = current.kind == task_kind::CONTINUE || current.kind == task_kind::BUILD_STEP;
+            const compiled_node& node = m_nodes[factored ? 0 : current.node];
+            language_lexem lookahead = lexems.id();
+
+            switch (current.kind) {
+            case task_kind::EXPAND:
+                switch (node.kind) {
+                case TOKEN:
+                    if (lookahead != node.token)
+                        return fail();
+
+                    values.emplace_back(*lexems);
+                    ++ lexems;
+                    break;
+
+                case SEQUENCE:
+                    tasks.push_back({ task_kind::BUILD, 0, current.node, (uint32_t) node.children.size() });
+                    for (size_t i = node.children.size(); i -- > 0; )
+                        tasks.push_back({ task_kind::EXPAND, 0, node.children[i], 0 });
+                    break;
+
+                case CHOICE: {
+                    uint8_t alternative = predict(current.node, lookahead);
+                    if (alternative == no_prediction)
+                        return fail();
+
+                    if (node.first_group != not_factored) {
+                        tasks.push_back({ task_kind::CONTINUE, 0, node.first_group + alternative, 0 });
+                        tasks.push_back({ task_kind::EXPAND, 0, node.children[alternative], 0 });
+                        break;
+                    }
+
+                    tasks.push_back({ task_kind::BUILD, alternative, current.node, 1 });
+                    tasks.push_back({ task_kind::EXPAND, 0, node.children[alternative], 0 });
+                    break;
+                }
+
+                case MANY:
+                    tasks.push_back({ task_kind::REPEAT, 0, current.node, 0 });
+                    break;
+
+                case OPTIONAL:
+                    if (predict(current.node, lookahead) == skip) {
+                        tasks.push_back({ task_kind::BUILD, 0, current.node, 0 });
+                        break;
+                    }
+
+                    [[fallthrough]];
+
+                case WRAPPER:
+                    tasks.push_back({ task_kind::BUILD, 0, current.node, 1 });
+                    tasks.push_back({ task_kind::EXPAND, 0, node.children[0], 0 });
+                    break;
+
+                case EMPTY:
+                    tasks.push_back({ task_kind::BUILD, 0, current.node, 0 });
+                    break;
+                }
+
+                break;
+
+            case task_kind::REPEAT:
+                if (predict(current.node, lookahead) == skip) {
+                    tasks.push_back({ task_kind::BUILD, 0, current.node, current.count });
+                    break;
+                }
+
+                tasks.push_back({ task_kind::REPEAT, 0, current.node, current.count + 1 });
+                tasks.push_back({ task_kind::EXPAND, 0, node.children[0], 0 });
+                break;
+
+            case task_kind::BUILD:
+                parts.assign(std::make_move_iterator(values.end() - current.count),
+                             std::make_move_iterator(values.end()));
+                values.resize(values.size() - current.count);
+
+                values.push_back(node.source->build(parts, current.alternative));
+                break;
+
+            case task_kind::CONTINUE: {
+                uint8_t alternative = predict_in_group(current.node, lookahead);
+                if (alternative == no_prediction)
+                    return fail();
+
+                // Prefix's value is on top already, every step adds it's rest and builds
+                const auto& steps = m_groups[current.node].alternatives[alternative];
+                for (size_t i = steps.size(); i -- > 0; ) {
+                    const compiled_step& step = m_steps[steps[i]];
+                    tasks.push_back({ task_kind::BUILD_STEP, 0, steps[i], (uint32_t) step.rest.size() + 1 });
+
+                    for (size_t j = step.rest.size(); j -- > 0; )
+                        tasks.push_back({ task_kind::EXPAND, 0, step.rest[j], 0 });
+                }
+
+                break;
+            }
+
+            case task_kind::BUILD_STEP: {
+                const compiled_step& step = m_steps[current.node];
+
+                parts.assign(std::make_move_iterator(values.end() - current.count),
+                             std::make_move_iterator(values.end()));
+                values.resize(values.size() - current.count);
+
+                values.push_back(step.source->build(parts, step.alternative));
+                break;
+            }
+            }
+        }
+
+        return std::move(values.back());
+    }
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "grammar-analysis.h"
+#include "parser.h"
+
+#include <any>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lang {
+
+    //------------------------------------------------------------------------------
+
+    /**
+     * Combinator graph lowered to LL(1) predictive parser: every or_p, many_p
+     * and optional_p picks what to do by a single lookahead lexem from table
+     * built with FIRST/FOLLOW sets. Parsing uses explicit stack instead of
+     * recursion and never backtracks, so it's linear and can't overflow the
+     * stack on deeply nested input.
+     *
+     * or_p chains factored by left_factor are compiled from their plan, so
+     * alternatives with a common prefix are told apart by the lexem after it.
+     *
+     * Results are built by the same transform/construct callbacks as the
+     * combinators use (see grammar_node::build). Unlike combinators, which
+     * return whatever prefix of input they managed to parse, table parser
+     * fails as a whole on the first unexpected lexem.
+     */
+    class table_parser {
+    public:
+        table_parser(grammar_node& root, const rule_names& names = {});
+
+        // Reasons grammar isn't LL(1), parser can't be used if there are any
+        const std::vector<std::string>& conflicts() const { return m_conflicts; }
+
+        // Lexems are left where parsing stopped on success, and untouched otherwise
+        std::optional<std::any> parse_any(token_cursor& lexems) const;
+
+    private:
+        struct compiled_node {
+            grammar_node_kind kind;
+            grammar_node* source;           // Holds semantic action
+
+            language_lexem token;           // For TOKEN
+            std::vector<uint32_t> children; // Indices in m_nodes, group prefixes for factored CHOICE
+
+            uint32_t first_group = not_factored; // Index in m_groups for factored CHOICE
+        };
+
+        // Alternatives of factored or_p chain that share a prefix, see factored_choice
+        struct compiled_group {
+            std::vector<std::vector<uint32_t>> alternatives; // Indices in m_steps, from prefix up
+        };
+
+        struct compiled_step {
+            grammar_node* source;       // Built from the value so far and /rest/
+            uint8_t alternative;
+            std::vector<uint32_t> rest; // Indices in m_nodes
+        };
+
+        static constexpr uint32_t not_factored = UINT32_MAX;
+
+        static constexpr size_t token_count = (size_t) language_lexem::END + 1;
+
+        // Table cells: alternative of CHOICE, or whether MANY and OPTIONAL
+        // should parse their child once more
+        static constexpr uint8_t no_prediction = 0xFF;
+        static constexpr uint8_t skip = 0, take = 1;
+
+        std::vector<compiled_node> m_nodes; // Root is the first one
+        std::vector<uint8_t> m_table;       // [node * token_count + lookahead]
+
+        std::vector<compiled_group> m_groups;
+        std::vector<compiled_step> m_steps;
+        std::vector<uint8_t> m_group_table; // [group * token_count + lookahead], alternative in group
+
+        std::vector<std::string> m_conflicts;
+
+        uint8_t predict(uint32_t node, language_lexem lookahead) const {
+            return m_table[node * token_count + (size_t) lookahead];
+        }
+
+        uint8_t predict_in_group(uint32_t group, language_lexem lookahead) const {
+            return m_group_table[group * token_count + (size_t) lookahead];
+        }
+    };
+
+    //------------------------------------------------------------------------------
+
+    template <typename type>
+    class compiled_parser {
+    public:
+        compiled_parser(parser_w<type>& source, const rule_names& names = {})
+            : m_source(source), m_table(source.node(), names) {}
+
+        const std::vector<std::string>& conflicts() const { return m_table.conflicts(); }
+
+        std::optional<type> parse(token_cursor& lexems) const {
+            std::optional<std::any> result = m_table.parse_any(lexems);
+            if (!result)
+                return std::nullopt;
+
+            return std::any_cast<type>(std::move(*result));
+        }
+
+    private:
+        parser_w<type> m_source; // Keeps combinators, and their callbacks, alive
+        table_parser m_table;
+    };
+
+}
@@ -0,0 +1,17 @@
+#include "token-cursor.h"
+
+#include <utility>
+
+namespace lang {
+
+    token_buffer::token_buffer(std::vector<lexem> lexems)
+        : m_lexems(std::move(lexems)), m_ids(), m_span() {
+
+        m_ids.reserve(m_lexems.size());
+        for (const lexem& current: m_lexems)
+            m_ids.push_back(current.id);
+
+        m_span = { m_ids.data(), m_lexems.data(), m_lexems.size() };
+    }
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "lexer.h"
+#include "../impl/definitions.h"
+
+#include <compare>
+#include <cstddef>
+#include <vector>
+
+namespace lang {
+
+    //------------------------------------------------------------------------------
+
+    /**
+     * Lexems in SoA layout: parsers mostly look at ids only, so those are
+     * packed in their own array and full lexems are touched only when they
+     * are consumed. Span doesn't own arrays, they may as well be streamed
+     * or memory-mapped, there's no END lexem at the end.
+     */
+    struct token_span {
+        const language_lexem* ids;
+        const lexem* lexems;
+
+        size_t size;
+    };
+
+    // Owning storage for lexer output
+    class token_buffer {
+    public:
+        token_buffer(std::vector<lexem> lexems);
+
+        // Span points into buffer, so it can't be moved
+        token_buffer(const token_buffer&) = delete;
+        token_buffer& operator=(const token_buffer&) = delete;
+
+        const token_span& span() const { return m_span; }
+
+    private:
+        std::vector<lexem> m_lexems;
+        std::vector<language_lexem> m_ids;
+
+        token_span m_span;
+    };
+
+    //------------------------------------------------------------------------------
+
+    // Position in token span, END is reported past the last lexem
+    class token_cursor {
+    public:
+        token_cursor(const token_span& tokens, size_t index = 0)
+            : m_tokens(&tokens), m_index(index) {}
+
+        language_lexem id() const {
+            return m_index < m_tokens->size ? m_tokens->ids[m_index] : language_lexem::END;
+        }
+
+        bool at_end() const { return m_index >= m_tokens->size; }
+
+        // Only valid before the end
+        const lexem& operator*()  const { return  m_tokens->lexems[m_index]; }
+        const lexem* operator->() const { return &m_tokens->lexems[m_index]; }
+
+        const token_span& tokens() const { return *m_tokens; }
+        size_t index() const { return m_index; }
+
+        token_cursor& operator++() {
+            ++ m_index;
+            return *this;
+        }
+
+        token_cursor operator+(ptrdiff_t offset) const { return token_cursor(*m_tokens, m_index + offset); }
+        ptrdiff_t operator-(const token_cursor& other) const { return (ptrdiff_t) (m_index - other.m_index); }
+
+        // Only cursors in the same span are ordered
+        bool operator==(const token_cursor& other) const = default;
+        std::strong_ordering operator<=>(const token_cursor& other) const { return m_index <=> other.m_index; }
+
+    private:
+        const token_span* m_tokens;
+        size_t m_index;
+    };
+
+}